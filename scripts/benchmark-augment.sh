@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+# benchmark-augment.sh: Time pileup-based vg augment on a 30x synthetic GAM
+#
+# usage: benchmark-augment.sh [work-dir] [genome-length] [depth] [thread counts...]
+#
+# Builds a random linear graph (10 Mbp by default), simulates reads with errors
+# against it to the given depth (30x by default), and augments the graph from
+# the pileup of the reads with 1, 8 and 32 threads by default. Reports the wall
+# time and peak RSS of each run, which are dominated by computing the sharded
+# pileups, and checks that every run writes the same pileup.
+
+set -e
+
+WORK_DIR="${1:-augment-bench}"
+GENOME_LENGTH="${2:-10000000}"
+DEPTH="${3:-30}"
+shift $(( $# < 3 ? $# : 3 ))
+THREAD_COUNTS="${@:-1 8 32}"
+READ_LENGTH=150
+READ_COUNT=$((GENOME_LENGTH * DEPTH / READ_LENGTH))
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+if [ ! -e synthetic.xg ]; then
+    # Make a random reference and a graph of it
+    awk -v len=${GENOME_LENGTH} 'BEGIN {
+        srand(42);
+        print ">synthetic";
+        split("A C G T", bases, " ");
+        line = "";
+        for (i = 0; i < len; i++) {
+            line = line bases[int(rand() * 4) + 1];
+            if (length(line) == 80) { print line; line = ""; }
+        }
+        if (length(line) > 0) { print line; }
+    }' > synthetic.fa
+    vg construct -r synthetic.fa -m 32 > synthetic.vg
+    vg index -x synthetic.xg synthetic.vg
+fi
+
+if [ ! -e synthetic.gam ]; then
+    vg sim -x synthetic.xg -n ${READ_COUNT} -l ${READ_LENGTH} -e 0.01 -i 0.002 -s 1 -a > synthetic.gam
+fi
+
+for THREADS in ${THREAD_COUNTS}; do
+    echo "Augmenting from a ${DEPTH}x pileup of ${READ_COUNT} reads with ${THREADS} threads"
+    /usr/bin/time -v vg augment -t ${THREADS} -P synthetic.${THREADS}.vgpu synthetic.vg synthetic.gam > synthetic.aug.vg 2> augment.${THREADS}.time
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" augment.${THREADS}.time
+done
+echo "Pileup written: $(du -h synthetic.${THREADS}.vgpu | cut -f1)"
+
+# Pileups are written in node order, so every thread count should agree exactly
+FIRST=""
+for THREADS in ${THREAD_COUNTS}; do
+    SUM=$(vg view -l synthetic.${THREADS}.vgpu | md5sum | cut -f1 -d' ')
+    if [ -z "${FIRST}" ]; then
+        FIRST="${SUM}"
+    elif [ "${SUM}" != "${FIRST}" ]; then
+        echo "Pileup with ${THREADS} threads differs"
+        exit 1
+    fi
+done
+echo "Pileups verified"
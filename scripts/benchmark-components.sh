@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# benchmark-components.sh: Time splitting a large graph into its weakly connected components
+#
+# usage: benchmark-components.sh [work-dir] [contig-count] [contig-length] [thread counts...]
+#
+# Builds a graph of many random contigs with a SNP every 100 bp on average,
+# which makes millions of nodes in thousands of components at the default
+# sizes. Then, for each thread count, times vg explode on it, reporting the
+# wall time and peak RSS of each run, and checks that every thread count
+# finds the same components.
+
+set -e
+
+WORK_DIR="${1:-components-bench}"
+CONTIG_COUNT="${2:-2000}"
+CONTIG_LENGTH="${3:-50000}"
+shift $(( $# < 3 ? $# : 3 ))
+THREAD_COUNTS="${@:-1 8 32}"
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+if [ ! -e synthetic.vg ]; then
+    # Make random contigs and SNPs against them
+    awk -v count=${CONTIG_COUNT} -v len=${CONTIG_LENGTH} 'BEGIN {
+        srand(42);
+        split("A C G T", bases, " ");
+        print "##fileformat=VCFv4.2" > "synthetic.vcf";
+        for (c = 1; c <= count; c++) {
+            print "##contig=<ID=contig" c ",length=" len ">" > "synthetic.vcf";
+        }
+        print "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO" > "synthetic.vcf";
+        for (c = 1; c <= count; c++) {
+            print ">contig" c > "synthetic.fa";
+            line = "";
+            for (i = 1; i <= len; i++) {
+                b = int(rand() * 4) + 1;
+                line = line bases[b];
+                if (length(line) == 80) { print line > "synthetic.fa"; line = ""; }
+                if (rand() < 0.01) {
+                    print "contig" c "\t" i "\t.\t" bases[b] "\t" bases[(b % 4) + 1] "\t60\tPASS\t." > "synthetic.vcf";
+                }
+            }
+            if (length(line) > 0) { print line > "synthetic.fa"; }
+        }
+    }'
+    bgzip -f synthetic.vcf
+    tabix -f -p vcf synthetic.vcf.gz
+    vg construct -r synthetic.fa -v synthetic.vcf.gz > synthetic.vg
+fi
+vg stats -N synthetic.vg
+
+for THREADS in ${THREAD_COUNTS}; do
+    echo "Exploding with ${THREADS} threads"
+    rm -rf parts.${THREADS}
+    /usr/bin/time -v vg explode -t ${THREADS} synthetic.vg parts.${THREADS} > parts.${THREADS}.tsv 2> explode.${THREADS}.time
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" explode.${THREADS}.time
+done
+
+# Every thread count should find the same components, with the same paths
+FIRST=""
+for THREADS in ${THREAD_COUNTS}; do
+    SUM=$(sed "s/^parts\.${THREADS}\///" parts.${THREADS}.tsv | md5sum | cut -f 1 -d' ')
+    if [ -z "${FIRST}" ]; then
+        FIRST="${SUM}"
+    elif [ "${SUM}" != "${FIRST}" ]; then
+        echo "Components found with ${THREADS} threads differ from the first"
+        exit 1
+    fi
+done
+echo "Components verified"
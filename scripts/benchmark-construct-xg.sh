@@ -0,0 +1,43 @@
+#!/usr/bin/env bash
+# benchmark-construct-xg.sh: Compare building an xg index directly in vg construct against the multi-step pipeline
+#
+# usage: benchmark-construct-xg.sh reference.fa variants.vcf.gz [threads] [work-dir]
+#
+# Builds an xg index of the graph for the given reference and tabix-indexed
+# VCF, once as vg construct > .vg, vg ids -j, vg index -x, and once with
+# vg construct -x. Reports the wall time and peak RSS of each step, and checks
+# that both indexes are identical. benchmark-construct.sh makes suitable
+# synthetic inputs.
+
+set -e
+
+REFERENCE="$(realpath "${1}")"
+VCF="$(realpath "${2}")"
+THREADS="${3:-$(nproc)}"
+WORK_DIR="${4:-construct-xg-bench}"
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+# Run a command under time and report its cost
+timed() {
+    local LABEL="${1}"
+    shift
+    /usr/bin/time -v "$@" 2> step.time
+    echo "${LABEL}:"
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" step.time
+}
+
+echo "Multi-step pipeline"
+timed "vg construct" sh -c "vg construct -r '${REFERENCE}' -v '${VCF}' -t ${THREADS} > pipeline.vg"
+timed "vg ids -j" vg ids -j pipeline.vg
+timed "vg index -x" vg index -x pipeline.xg -t ${THREADS} pipeline.vg
+
+echo "Direct construction"
+timed "vg construct -x" vg construct -r "${REFERENCE}" -v "${VCF}" -t ${THREADS} -x direct.xg
+
+if ! cmp -s pipeline.xg direct.xg; then
+    echo "Directly constructed xg index differs from the pipeline one"
+    exit 1
+fi
+echo "Indexes are identical"
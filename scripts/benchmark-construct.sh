@@ -0,0 +1,78 @@
+#!/usr/bin/env bash
+# benchmark-construct.sh: Time vg construct on a synthetic reference and dense VCF at several thread counts
+#
+# usage: benchmark-construct.sh [work-dir] [genome-length] [thread counts...]
+#
+# Makes a random reference (20 Mbp over two contigs by default) and a VCF
+# with a SNP or small deletion about every 10 bases. Builds the graph with
+# each of the given thread counts (default 1, 8 and 32), and reports the wall
+# time and peak RSS of each. Checks that every build writes byte-identical
+# output.
+
+set -e
+
+WORK_DIR="${1:-construct-bench}"
+GENOME_LENGTH="${2:-20000000}"
+shift $(( $# < 2 ? $# : 2 ))
+THREAD_COUNTS="${@:-1 8 32}"
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+if [ ! -e synthetic.vcf.gz.tbi ]; then
+    # Make a random reference of two contigs and a dense VCF against it
+    awk -v len=$((GENOME_LENGTH / 2)) 'BEGIN {
+        srand(42);
+        split("A C G T", bases, " ");
+        print "##fileformat=VCFv4.2" > "synthetic.vcf";
+        print "##contig=<ID=contig1,length=" len ">" > "synthetic.vcf";
+        print "##contig=<ID=contig2,length=" len ">" > "synthetic.vcf";
+        print "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO" > "synthetic.vcf";
+        for (c = 1; c <= 2; c++) {
+            print ">contig" c;
+            next_pos = 10;
+            for (start = 1; start <= len; start += 80) {
+                line = "";
+                for (i = 0; i < 80 && start + i <= len; i++) {
+                    line = line bases[int(rand() * 4) + 1];
+                }
+                print line;
+                # Place variants that fit entirely in this line
+                while (next_pos + 3 < start + length(line) && next_pos + 10 < len) {
+                    if (next_pos >= start) {
+                        ref = substr(line, next_pos - start + 1, 1);
+                        if (rand() < 0.2) {
+                            # A small deletion
+                            print "contig" c "\t" next_pos "\t.\t" substr(line, next_pos - start + 1, 3) "\t" ref "\t30\tPASS\t." > "synthetic.vcf";
+                            next_pos += 3;
+                        } else {
+                            alt = bases[int(rand() * 4) + 1];
+                            if (alt == ref) { alt = (ref == "A" ? "C" : "A"); }
+                            print "contig" c "\t" next_pos "\t.\t" ref "\t" alt "\t30\tPASS\t." > "synthetic.vcf";
+                        }
+                    }
+                    next_pos += 5 + int(rand() * 10);
+                }
+            }
+        }
+    }' > synthetic.fa
+    bgzip -f synthetic.vcf
+    tabix -p vcf synthetic.vcf.gz
+fi
+
+echo "Constructing from $(zcat synthetic.vcf.gz | grep -vc '^#') variants on ${GENOME_LENGTH} bp"
+REFERENCE_SUM=""
+for THREADS in ${THREAD_COUNTS}; do
+    /usr/bin/time -v vg construct -r synthetic.fa -v synthetic.vcf.gz -t ${THREADS} > synthetic.${THREADS}.vg 2> construct.time
+    echo "${THREADS} threads:"
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" construct.time
+
+    SUM=$(md5sum < synthetic.${THREADS}.vg | cut -f1 -d' ')
+    if [ -z "${REFERENCE_SUM}" ]; then
+        REFERENCE_SUM="${SUM}"
+    elif [ "${SUM}" != "${REFERENCE_SUM}" ]; then
+        echo "Graph built with ${THREADS} threads differs from the first build"
+        exit 1
+    fi
+done
+echo "All builds are identical"
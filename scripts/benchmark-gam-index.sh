@@ -0,0 +1,63 @@
+#!/usr/bin/env bash
+# benchmark-gam-index.sh: Time building a rocksdb alignment index through the memtables and by SST ingestion
+#
+# usage: benchmark-gam-index.sh [work-dir] [read-count] [threads]
+#
+# Builds a random 10 Mbp linear graph and simulates read alignments against it
+# (5M by default). Indexes them with vg index -a and -N, once through the
+# bulk-load memtable path and once with -I, and reports the wall time and peak
+# RSS of each build. Checks that both indexes hold the same alignments.
+
+set -e
+
+WORK_DIR="${1:-gam-index-bench}"
+READ_COUNT="${2:-5000000}"
+THREADS="${3:-$(nproc)}"
+GENOME_LENGTH=10000000
+READ_LENGTH=150
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+if [ ! -e synthetic.xg ]; then
+    # Make a random reference and a graph of it
+    awk -v len=${GENOME_LENGTH} 'BEGIN {
+        srand(42);
+        print ">synthetic";
+        split("A C G T", bases, " ");
+        line = "";
+        for (i = 0; i < len; i++) {
+            line = line bases[int(rand() * 4) + 1];
+            if (length(line) == 80) { print line; line = ""; }
+        }
+        if (length(line) > 0) { print line; }
+    }' > synthetic.fa
+    vg construct -r synthetic.fa -m 32 > synthetic.vg
+    vg index -x synthetic.xg synthetic.vg
+fi
+
+if [ ! -e synthetic.gam ]; then
+    vg sim -x synthetic.xg -n ${READ_COUNT} -l ${READ_LENGTH} -e 0.01 -i 0.002 -s 1 -a > synthetic.gam
+fi
+
+for MODE in memtable sst; do
+    for KIND in a N; do
+        rm -rf synthetic.${MODE}.${KIND}.index
+        FLAGS="-${KIND}"
+        if [ "${MODE}" == "sst" ]; then
+            FLAGS="${FLAGS} -I -y -b ."
+        fi
+        echo "Indexing ${READ_COUNT} reads with vg index ${FLAGS} and ${THREADS} threads"
+        /usr/bin/time -v vg index ${FLAGS} -t ${THREADS} -d synthetic.${MODE}.${KIND}.index synthetic.gam 2> index.time
+        grep -E "Elapsed \(wall clock\)|Maximum resident set size" index.time
+    done
+done
+
+# Both ways of building the alignment index should store the same alignments
+MEMTABLE_SUM=$(vg index -A -d synthetic.memtable.a.index | vg view -a - | sort | md5sum | cut -f1 -d' ')
+SST_SUM=$(vg index -A -d synthetic.sst.a.index | vg view -a - | sort | md5sum | cut -f1 -d' ')
+if [ "${MEMTABLE_SUM}" != "${SST_SUM}" ]; then
+    echo "Ingested alignment index differs from the memtable one"
+    exit 1
+fi
+echo "Ingested alignment index verified"
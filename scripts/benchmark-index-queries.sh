@@ -0,0 +1,88 @@
+#!/usr/bin/env bash
+# benchmark-index-queries.sh: Time node range queries against rocksdb alignment indexes
+#
+# usage: benchmark-index-queries.sh [work-dir] [read-count] [query-count]
+#
+# Builds a random 10 Mbp linear graph, simulates read alignments against it
+# (1M by default), and indexes them by lowest node (vg index -a) and by node
+# traversal (vg index -N), with and without node prefix filters. Then times
+# the same random node range queries (vg find -i and -o) against each index.
+# Run it against two builds of vg to compare their query performance.
+
+set -e
+
+WORK_DIR="${1:-index-query-bench}"
+READ_COUNT="${2:-1000000}"
+QUERY_COUNT="${3:-200}"
+GENOME_LENGTH=10000000
+READ_LENGTH=150
+RANGE_NODES=50
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+if [ ! -e synthetic.xg ]; then
+    # Make a random reference and a graph of it
+    awk -v len=${GENOME_LENGTH} 'BEGIN {
+        srand(42);
+        print ">synthetic";
+        split("A C G T", bases, " ");
+        line = "";
+        for (i = 0; i < len; i++) {
+            line = line bases[int(rand() * 4) + 1];
+            if (length(line) == 80) { print line; line = ""; }
+        }
+        if (length(line) > 0) { print line; }
+    }' > synthetic.fa
+    vg construct -r synthetic.fa -m 32 > synthetic.vg
+    vg index -x synthetic.xg synthetic.vg
+fi
+
+if [ ! -e synthetic.gam ]; then
+    vg sim -x synthetic.xg -n ${READ_COUNT} -l ${READ_LENGTH} -e 0.01 -i 0.002 -s 1 -a > synthetic.gam
+fi
+
+NODE_COUNT=$(vg stats -N synthetic.vg)
+awk -v n=${QUERY_COUNT} -v max=${NODE_COUNT} -v width=${RANGE_NODES} 'BEGIN {
+    srand(7);
+    for (i = 0; i < n; i++) {
+        start = int(rand() * (max - width)) + 1;
+        print start ":" (start + width - 1);
+    }
+}' > queries.txt
+
+for FILTER in plain prefix; do
+    FLAGS="-I"
+    if [ "${FILTER}" == "prefix" ]; then
+        FLAGS="${FLAGS} -y"
+    fi
+    if [ ! -e synthetic.${FILTER}.a.index ]; then
+        vg index -a ${FLAGS} -d synthetic.${FILTER}.a.index synthetic.gam
+    fi
+    if [ ! -e synthetic.${FILTER}.N.index ]; then
+        vg index -N ${FLAGS} -d synthetic.${FILTER}.N.index synthetic.gam
+    fi
+
+    for QUERY in i o; do
+        if [ "${QUERY}" == "i" ]; then
+            DB=synthetic.${FILTER}.a.index
+        else
+            DB=synthetic.${FILTER}.N.index
+        fi
+        START=$(date +%s.%N)
+        while read RANGE; do
+            vg find -${QUERY} ${RANGE} -d ${DB} | vg view -a - | wc -l
+        done < queries.txt > ${FILTER}.${QUERY}.counts
+        END=$(date +%s.%N)
+        echo "vg find -${QUERY} with ${FILTER} keys: ${QUERY_COUNT} queries in $(echo "${END} - ${START}" | bc) seconds, $(awk '{ s += $1 } END { print s }' ${FILTER}.${QUERY}.counts) alignments"
+    done
+done
+
+# Filters only change how fast the queries are, not what they find
+for QUERY in i o; do
+    if ! cmp -s plain.${QUERY}.counts prefix.${QUERY}.counts; then
+        echo "vg find -${QUERY} results differ with prefix filters"
+        exit 1
+    fi
+done
+echo "Query results verified"
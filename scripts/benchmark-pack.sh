@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+# benchmark-pack.sh: Time vg pack on a large synthetic GAM at several thread counts
+#
+# usage: benchmark-pack.sh [work-dir] [read-count] [thread counts...]
+#
+# Builds a random 10 Mbp linear graph, simulates read alignments against it
+# (10M by default), and packs them with 1, 8 and 32 threads by default.
+# Reports the wall time and peak RSS of each run, and checks that every run
+# finds the same coverage. Then times depth queries for 1M BED intervals
+# against the pack.
+
+set -e
+
+WORK_DIR="${1:-pack-bench}"
+READ_COUNT="${2:-10000000}"
+shift $(( $# < 2 ? $# : 2 ))
+THREAD_COUNTS="${@:-1 8 32}"
+GENOME_LENGTH=10000000
+READ_LENGTH=150
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+if [ ! -e synthetic.xg ]; then
+    # Make a random reference and a graph of it
+    awk -v len=${GENOME_LENGTH} 'BEGIN {
+        srand(42);
+        print ">synthetic";
+        split("A C G T", bases, " ");
+        line = "";
+        for (i = 0; i < len; i++) {
+            line = line bases[int(rand() * 4) + 1];
+            if (length(line) == 80) { print line; line = ""; }
+        }
+        if (length(line) > 0) { print line; }
+    }' > synthetic.fa
+    vg construct -r synthetic.fa -m 32 > synthetic.vg
+    vg index -x synthetic.xg synthetic.vg
+fi
+
+if [ ! -e synthetic.gam ]; then
+    vg sim -x synthetic.xg -n ${READ_COUNT} -l ${READ_LENGTH} -e 0.01 -i 0.002 -s 1 -a > synthetic.gam
+fi
+
+for THREADS in ${THREAD_COUNTS}; do
+    echo "Packing ${READ_COUNT} reads with ${THREADS} threads"
+    /usr/bin/time -v vg pack -x synthetic.xg -g synthetic.gam -t ${THREADS} -o synthetic.${THREADS}.pack 2> pack.${THREADS}.time
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" pack.${THREADS}.time
+done
+
+# Every thread count should find the same coverage
+FIRST=""
+for THREADS in ${THREAD_COUNTS}; do
+    SUM=$(vg pack -x synthetic.xg -di synthetic.${THREADS}.pack | cut -f 1-3 | md5sum | cut -f 1 -d' ')
+    if [ -z "${FIRST}" ]; then
+        FIRST="${SUM}"
+    elif [ "${SUM}" != "${FIRST}" ]; then
+        echo "Pack with ${THREADS} threads differs from the first"
+        exit 1
+    fi
+done
+echo "Packs verified"
+
+if [ ! -e synthetic.bed ]; then
+    # Random 1 kbp intervals along the reference path
+    awk -v len=${GENOME_LENGTH} 'BEGIN {
+        srand(7);
+        for (i = 0; i < 1000000; i++) {
+            start = int(rand() * (len - 1000));
+            print "synthetic\t" start "\t" start + 1000;
+        }
+    }' > synthetic.bed
+fi
+
+for THREADS in ${THREAD_COUNTS}; do
+    echo "Querying depth of $(wc -l < synthetic.bed) BED intervals with ${THREADS} threads"
+    /usr/bin/time -v vg pack -x synthetic.xg -i synthetic.${THREADS}.pack -R synthetic.bed -t ${THREADS} > synthetic.${THREADS}.depth 2> depth.${THREADS}.time
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" depth.${THREADS}.time
+done
@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+# benchmark-packed-graph.sh: Compare peak memory of vg ids, vg mod and vg prune
+# on a whole-chromosome graph with and without --packed
+#
+# usage: benchmark-packed-graph.sh [work-dir] [reference.fa variants.vcf.gz]
+#
+# Without a reference and VCF, builds a random 50 Mbp chromosome with a SNP
+# every 100 bp on average. Runs each command on the plain VG representation
+# and on the packed graph, reports the wall time and peak RSS of each run, and
+# checks that both representations produce the same graph.
+
+set -e
+
+WORK_DIR="${1:-packed-graph-bench}"
+REFERENCE="${2:-}"
+VARIANTS="${3:-}"
+GENOME_LENGTH=50000000
+
+if [ -n "${REFERENCE}" ]; then
+    REFERENCE="$(realpath "${REFERENCE}")"
+    VARIANTS="$(realpath "${VARIANTS}")"
+fi
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+if [ ! -e chrom.vg ]; then
+    if [ -z "${REFERENCE}" ]; then
+        # Make a random chromosome and SNPs against it
+        awk -v len=${GENOME_LENGTH} 'BEGIN {
+            srand(42);
+            split("A C G T", bases, " ");
+            print ">synthetic" > "synthetic.fa";
+            print "##fileformat=VCFv4.2" > "synthetic.vcf";
+            print "##contig=<ID=synthetic,length=" len ">" > "synthetic.vcf";
+            print "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO" > "synthetic.vcf";
+            line = "";
+            for (i = 1; i <= len; i++) {
+                b = int(rand() * 4) + 1;
+                line = line bases[b];
+                if (length(line) == 80) { print line > "synthetic.fa"; line = ""; }
+                if (rand() < 0.01) {
+                    print "synthetic\t" i "\t.\t" bases[b] "\t" bases[(b % 4) + 1] "\t60\tPASS\t." > "synthetic.vcf";
+                }
+            }
+            if (length(line) > 0) { print line > "synthetic.fa"; }
+        }'
+        bgzip -f synthetic.vcf
+        tabix -f -p vcf synthetic.vcf.gz
+        REFERENCE=synthetic.fa
+        VARIANTS=synthetic.vcf.gz
+    fi
+    vg construct -r "${REFERENCE}" -v "${VARIANTS}" > chrom.vg
+fi
+
+# Run a command on both representations and compare their output
+compare() {
+    NAME="$1"
+    shift
+    echo "vg $* (VG)"
+    /usr/bin/time -v vg "$@" chrom.vg > "${NAME}.vg.out" 2> "${NAME}.vg.time"
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" "${NAME}.vg.time"
+    echo "vg $* --packed"
+    /usr/bin/time -v vg "$@" --packed chrom.vg > "${NAME}.packed.out" 2> "${NAME}.packed.time"
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" "${NAME}.packed.time"
+
+    VG_SUM=$(vg view -j "${NAME}.vg.out" | jq -c '.node[], .edge[]' | sort | md5sum | cut -f 1 -d' ')
+    PACKED_SUM=$(vg view -j "${NAME}.packed.out" | jq -c '.node[], .edge[]' | sort | md5sum | cut -f 1 -d' ')
+    if [ "${VG_SUM}" != "${PACKED_SUM}" ]; then
+        echo "Packed output of ${NAME} differs from the VG output"
+        exit 1
+    fi
+}
+
+compare ids ids -i 1000
+compare sort ids -s
+compare mod mod -M 8
+compare prune prune -k 24 -e 3
+echo "Outputs verified"
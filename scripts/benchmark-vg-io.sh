@@ -0,0 +1,70 @@
+#!/usr/bin/env bash
+# benchmark-vg-io.sh: Time loading and saving a large .vg file at several thread counts
+#
+# usage: benchmark-vg-io.sh [work-dir] [genome-length] [thread counts...]
+#
+# Builds a graph of a random 100 Mbp reference with a SNP every 100 bp on
+# average. Then, for each thread count, times vg stats -z, which only loads
+# the graph, and vg mod with no operations, which loads and saves it. Reports
+# the wall time and peak RSS of each run, and checks that every thread count
+# writes the same graph.
+
+set -e
+
+WORK_DIR="${1:-vg-io-bench}"
+GENOME_LENGTH="${2:-100000000}"
+shift $(( $# < 2 ? $# : 2 ))
+THREAD_COUNTS="${@:-1 8 32}"
+
+mkdir -p "${WORK_DIR}"
+cd "${WORK_DIR}"
+
+if [ ! -e synthetic.vg ]; then
+    # Make a random reference and SNPs against it
+    awk -v len=${GENOME_LENGTH} 'BEGIN {
+        srand(42);
+        split("A C G T", bases, " ");
+        print ">synthetic" > "synthetic.fa";
+        print "##fileformat=VCFv4.2" > "synthetic.vcf";
+        print "##contig=<ID=synthetic,length=" len ">" > "synthetic.vcf";
+        print "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO" > "synthetic.vcf";
+        line = "";
+        for (i = 1; i <= len; i++) {
+            b = int(rand() * 4) + 1;
+            line = line bases[b];
+            if (length(line) == 80) { print line > "synthetic.fa"; line = ""; }
+            if (rand() < 0.01) {
+                print "synthetic\t" i "\t.\t" bases[b] "\t" bases[(b % 4) + 1] "\t60\tPASS\t." > "synthetic.vcf";
+            }
+        }
+        if (length(line) > 0) { print line > "synthetic.fa"; }
+    }'
+    bgzip -f synthetic.vcf
+    tabix -f -p vcf synthetic.vcf.gz
+    vg construct -r synthetic.fa -v synthetic.vcf.gz > synthetic.vg
+fi
+ls -l synthetic.vg
+
+for THREADS in ${THREAD_COUNTS}; do
+    echo "Loading with ${THREADS} threads"
+    OMP_NUM_THREADS=${THREADS} /usr/bin/time -v vg stats -z synthetic.vg 2> load.${THREADS}.time
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" load.${THREADS}.time
+
+    echo "Loading and saving with ${THREADS} threads"
+    OMP_NUM_THREADS=${THREADS} /usr/bin/time -v vg mod synthetic.vg > saved.${THREADS}.vg 2> save.${THREADS}.time
+    grep -E "Elapsed \(wall clock\)|Maximum resident set size" save.${THREADS}.time
+done
+
+# Every thread count should write the same graph, although maybe not in the
+# same chunks
+FIRST=""
+for THREADS in ${THREAD_COUNTS}; do
+    SUM=$(vg view -g saved.${THREADS}.vg | md5sum | cut -f 1 -d' ')
+    if [ -z "${FIRST}" ]; then
+        FIRST="${SUM}"
+    elif [ "${SUM}" != "${FIRST}" ]; then
+        echo "Graph saved with ${THREADS} threads differs from the first"
+        exit 1
+    fi
+done
+echo "Saved graphs verified"
@@ -0,0 +1,114 @@
+/**
+ * \file dijkstra.cpp
+ *
+ * Implementation for a bounded shortest distance search over a HandleGraph.
+ */
+
+#include "dijkstra.hpp"
+#include "../epoch_map.hpp"
+#include "../radix_heap.hpp"
+
+#include <memory>
+
+//#define debug_vg_algorithms
+
+namespace vg {
+namespace algorithms {
+
+using namespace std;
+
+    namespace {
+
+        /// The state of one search, kept around so the next search on this thread can reuse its memory
+        struct DijkstraState {
+            /// The best distance found so far to each handle
+            EpochMap<handle_t, size_t> best;
+            /// Handles waiting to be visited, by distance. A handle can be in here more than once, and the
+            /// entries that don't match its best distance are stale.
+            RadixHeap<handle_t> queue;
+        };
+
+        /// A stack of states for each thread, so that a visit function can run a search of its own
+        thread_local vector<unique_ptr<DijkstraState>> state_pool;
+        thread_local size_t states_in_use = 0;
+
+        /// Claims a state from the pool for as long as it exists
+        struct PooledState {
+            PooledState() {
+                if (states_in_use == state_pool.size()) {
+                    state_pool.emplace_back(new DijkstraState());
+                }
+                state = state_pool[states_in_use].get();
+                states_in_use++;
+                state->best.clear();
+                state->queue.clear();
+            }
+            ~PooledState() {
+                states_in_use--;
+            }
+            DijkstraState* state;
+        };
+    }
+
+    void dijkstra(const HandleGraph* g, const vector<pair<handle_t, size_t>>& starts,
+                  const function<bool(const handle_t&, size_t)>& visit,
+                  size_t max_distance) {
+
+        PooledState pooled;
+        auto& best = pooled.state->best;
+        auto& queue = pooled.state->queue;
+
+        // queue up a handle if this is the shortest way to it so far
+        auto reach = [&](const handle_t& next, size_t distance) {
+            if (distance > max_distance) {
+                return;
+            }
+            size_t count_before = best.size();
+            size_t& best_distance = best[next];
+            if (best.size() != count_before || distance < best_distance) {
+                best_distance = distance;
+                queue.push(distance, next);
+            }
+        };
+
+        // the start handles themselves are passed through at their given distances
+        for (const pair<handle_t, size_t>& start : starts) {
+            g->follow_edges(start.first, false, [&](const handle_t& next) {
+                reach(next, start.second);
+            });
+        }
+
+        while (!queue.empty()) {
+            handle_t here = queue.top().second;
+            size_t distance = queue.top().first;
+            queue.pop();
+
+            if (*best.find(here) != distance) {
+                // we already visited this handle at a shorter distance
+                continue;
+            }
+
+#ifdef debug_vg_algorithms
+            cerr << "DIJKSTRA: visiting " << g->get_id(here) << (g->get_is_reverse(here) ? "-" : "+")
+                 << " at distance " << distance << endl;
+#endif
+
+            if (!visit(here, distance)) {
+                break;
+            }
+
+            size_t distance_thru = distance + g->get_length(here);
+            g->follow_edges(here, false, [&](const handle_t& next) {
+                reach(next, distance_thru);
+            });
+        }
+    }
+
+    void dijkstra(const HandleGraph* g, handle_t start,
+                  const function<bool(const handle_t&, size_t)>& visit,
+                  size_t max_distance) {
+        dijkstra(g, vector<pair<handle_t, size_t>>{make_pair(start, 0)}, visit, max_distance);
+    }
+
+}
+}
@@ -0,0 +1,45 @@
+#ifndef VG_ALGORITHMS_DIJKSTRA_HPP_INCLUDED
+#define VG_ALGORITHMS_DIJKSTRA_HPP_INCLUDED
+
+/**
+ * \file dijkstra.hpp
+ *
+ * Definitions for a bounded shortest distance search over a HandleGraph.
+ */
+
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "../handle.hpp"
+
+namespace vg {
+namespace algorithms {
+
+using namespace std;
+
+    /// Walk rightward from the ends of the given start handles, visiting the oriented nodes that can be
+    /// reached in order of their shortest distance in bases from the end of a start handle to their own
+    /// start. Each start handle comes with a distance that is added to everything reached from it, so
+    /// that a search can begin partway along a node or from several places at once. The start handles are
+    /// not themselves visited unless they can be reached again by a walk.
+    ///
+    /// The visit function is called once for each handle, with its shortest distance, and can return false
+    /// to stop the search. Handles farther than max_distance are never visited, and the search ends once
+    /// everything within it has been.
+    ///
+    /// Distances are kept in a monotone radix heap, and the search state is cleared in constant time, so
+    /// the cost of a search is proportional to the part of the graph it actually visits.
+    void dijkstra(const HandleGraph* g, const vector<pair<handle_t, size_t>>& starts,
+                  const function<bool(const handle_t&, size_t)>& visit,
+                  size_t max_distance = numeric_limits<size_t>::max());
+
+    /// Same as above, but from the end of a single start handle.
+    void dijkstra(const HandleGraph* g, handle_t start,
+                  const function<bool(const handle_t&, size_t)>& visit,
+                  size_t max_distance = numeric_limits<size_t>::max());
+
+}
+}
+
+#endif
@@ -5,11 +5,167 @@
  */
  
 #include "extract_connecting_graph.hpp"
+#include "../epoch_map.hpp"
+#include "../radix_heap.hpp"
+
+#include <deque>
 
 //#define debug_vg_algorithms
 
 namespace vg {
 namespace algorithms {
+    
+    // a local struct for Nodes that maintains edge lists
+    struct LocalNode {
+        LocalNode() {}
+        LocalNode(string sequence) : sequence(sequence) {}
+        string sequence;
+        // edges are stored as (node id, is reversing?)
+        vector<pair<id_t, bool>> edges_left;
+        vector<pair<id_t, bool>> edges_right;
+    };
+    
+    /// The graph we build up before storing it in a Graph, as a map from node ID to LocalNode.
+    /// Nodes live in a pool of slots that is reused from call to call, so their strings and edge
+    /// vectors keep their memory, and references to them stay valid when more nodes are added.
+    /// Iterates in the order the nodes were added.
+    class LocalGraph {
+    public:
+        
+        /// Remove all the nodes
+        void clear() {
+            used = 0;
+            slot_of.clear();
+        }
+        
+        /// Return 1 if the node is present and 0 otherwise
+        size_t count(id_t node_id) const {
+            const size_t* slot = slot_of.find(node_id);
+            return slot != nullptr && alive[*slot];
+        }
+        
+        /// Get a node, adding an empty one if it isn't present
+        LocalNode& operator[](id_t node_id) {
+            size_t* slot = slot_of.find(node_id);
+            if (slot != nullptr && alive[*slot]) {
+                return records[*slot].second;
+            }
+            if (used == records.size()) {
+                records.emplace_back();
+                alive.push_back(false);
+            }
+            pair<id_t, LocalNode>& record = records[used];
+            record.first = node_id;
+            record.second.sequence.clear();
+            record.second.edges_left.clear();
+            record.second.edges_right.clear();
+            alive[used] = true;
+            slot_of[node_id] = used;
+            used++;
+            return record.second;
+        }
+        
+        /// Remove a node, if it is present
+        void erase(id_t node_id) {
+            size_t* slot = slot_of.find(node_id);
+            if (slot != nullptr) {
+                alive[*slot] = false;
+            }
+        }
+        
+        /// Iterator over the (ID, node) records that are present
+        class iterator {
+        public:
+            iterator(LocalGraph& graph, size_t slot) : graph(graph), slot(slot) {
+                skip_dead();
+            }
+            pair<id_t, LocalNode>& operator*() const {
+                return graph.records[slot];
+            }
+            pair<id_t, LocalNode>* operator->() const {
+                return &graph.records[slot];
+            }
+            iterator& operator++() {
+                slot++;
+                skip_dead();
+                return *this;
+            }
+            bool operator!=(const iterator& other) const {
+                return slot != other.slot;
+            }
+        private:
+            void skip_dead() {
+                while (slot < graph.used && !graph.alive[slot]) {
+                    slot++;
+                }
+            }
+            LocalGraph& graph;
+            size_t slot;
+        };
+        
+        iterator begin() {
+            return iterator(*this, 0);
+        }
+        
+        iterator end() {
+            return iterator(*this, used);
+        }
+        
+    private:
+        /// All the slots we have ever used, of which the first used are in use for this graph
+        deque<pair<id_t, LocalNode>> records;
+        /// Whether each slot holds a node that hasn't been erased
+        vector<bool> alive;
+        size_t used = 0;
+        /// The slot of each node ID
+        EpochMap<id_t, size_t> slot_of;
+    };
+    
+    struct ConnectingGraphWorkspace::State {
+        LocalGraph graph;
+        EpochSet<pair<handle_t, handle_t>> observed_edges;
+        EpochSet<handle_t> queued_traversals;
+        RadixHeap<handle_t> queue;
+        EpochSet<pair<id_t, bool>> local_queued_traversals;
+        RadixHeap<pair<id_t, bool>> local_queue;
+        EpochMap<pair<id_t, bool>, int64_t> forward_trav_dist;
+        EpochMap<pair<id_t, bool>, int64_t> reverse_trav_dist;
+        vector<pair<id_t, bool>> stack;
+        EpochSet<pair<id_t, bool>> forward_reachable;
+        EpochSet<pair<id_t, bool>> reverse_reachable;
+        EpochMap<id_t, int64_t> left_degree;
+        EpochMap<id_t, int64_t> right_degree;
+        deque<id_t> to_check;
+        vector<id_t> to_erase;
+    };
+    
+    ConnectingGraphWorkspace::ConnectingGraphWorkspace() : state(new State()) {
+        // Nothing to do
+    }
+    
+    ConnectingGraphWorkspace::~ConnectingGraphWorkspace() {
+        // Nothing to do
+    }
+    
+    ConnectingGraphWorkspace::State& ConnectingGraphWorkspace::reset() {
+        state->graph.clear();
+        state->observed_edges.clear();
+        state->queued_traversals.clear();
+        state->queue.clear();
+        state->local_queued_traversals.clear();
+        state->local_queue.clear();
+        state->forward_trav_dist.clear();
+        state->reverse_trav_dist.clear();
+        state->stack.clear();
+        state->forward_reachable.clear();
+        state->reverse_reachable.clear();
+        state->left_degree.clear();
+        state->right_degree.clear();
+        state->to_check.clear();
+        state->to_erase.clear();
+        return *state;
+    }
+    
     unordered_map<id_t, id_t> extract_connecting_graph(const HandleGraph* source, Graph& g, int64_t max_len,
                                                        pos_t pos_1, pos_t pos_2,
                                                        bool include_terminal_positions,
@@ -17,33 +173,32 @@ namespace algorithms {
                                                        bool no_additional_tips,
                                                        bool only_paths,
                                                        bool strict_max_len) {
+        ConnectingGraphWorkspace workspace;
+        return extract_connecting_graph(source, g, max_len, pos_1, pos_2, workspace, include_terminal_positions,
+                                        detect_terminal_cycles, no_additional_tips, only_paths, strict_max_len);
+    }
+    
+    /// Does the work of extract_connecting_graph, leaving the extracted graph in the state's local graph
+    /// and filling in the ID translator. Returns false if there is no path under the maximum length, in
+    /// which case nothing should be extracted.
+    static bool find_connecting_graph(const HandleGraph* source, int64_t max_len,
+                                      pos_t pos_1, pos_t pos_2,
+                                      ConnectingGraphWorkspace::State& state,
+                                      unordered_map<id_t, id_t>& id_trans,
+                                      bool include_terminal_positions,
+                                      bool detect_terminal_cycles,
+                                      bool no_additional_tips,
+                                      bool only_paths,
+                                      bool strict_max_len) {
 #ifdef debug_vg_algorithms
         cerr << "[extract_connecting_graph] max len: " << max_len << ", pos 1: " << pos_1 << ", pos 2: " << pos_2 << endl;
 #endif
         
-        if (g.node_size() || g.edge_size()) {
-            cerr << "error:[extract_connecting_graph] must extract into an empty graph" << endl;
-            exit(1);
-        }
-        
-        // a local struct for Nodes that maintains edge lists
-        struct LocalNode {
-            LocalNode() {}
-            LocalNode(string sequence) : sequence(sequence) {}
-            string sequence;
-            // edges are stored as (node id, is reversing?)
-            vector<pair<id_t, bool>> edges_left;
-            vector<pair<id_t, bool>> edges_right;
-        };
-        
         // a local struct that packages a handle with its distance from the first position
         struct Traversal {
             Traversal(handle_t handle, int64_t dist) : handle(handle), dist(dist) {}
             int64_t dist; // distance from pos to the right side of this node
             handle_t handle; // Oriented node traversal
-            inline bool operator<(const Traversal& other) const {
-                return dist > other.dist; // opposite order so priority queue selects minimum
-            }
         };
         
         // local enum to keep track of the cases where the positions are on the same node
@@ -93,16 +248,13 @@ namespace algorithms {
         // for finding the largest node id in the subgraph
         id_t max_id = max(id(pos_1), id(pos_2));
         
-        // a translator for node ids in g to node ids in the original graph
-        unordered_map<id_t, id_t> id_trans;
-        
         // the edges we have encountered in the traversal
-        unordered_set<pair<handle_t, handle_t>> observed_edges;
+        auto& observed_edges = state.observed_edges;
         
         // the representation of the graph we're going to build up before storing in g (allows easier
         // subsetting operations than Graph, XG, or VG objects)
         // TODO: reduce duplicate get_handle calls!
-        unordered_map<id_t, LocalNode> graph;
+        LocalGraph& graph = state.graph;
         graph[id(pos_1)] = LocalNode(source->get_sequence(source->get_handle(id(pos_1), false)));
         if (id(pos_2) != id(pos_1)) {
             graph[id(pos_2)] = LocalNode(source->get_sequence(source->get_handle(id(pos_2), false)));
@@ -111,14 +263,15 @@ namespace algorithms {
         // keep track of whether we find a path or not
         bool found_target = false;
         
-        unordered_set<handle_t> queued_traversals{source->get_handle(id(pos_1), is_rev(pos_1))};
+        auto& queued_traversals = state.queued_traversals;
+        queued_traversals.insert(source->get_handle(id(pos_1), is_rev(pos_1)));
         // mark final position as "queued" so that we won't look for additional traversals unless that's
         // the only way to find terminal cycles
         if (!(colocation == SharedNodeReverse && detect_terminal_cycles)) {
             queued_traversals.insert(source->get_handle(id(pos_2), is_rev(pos_2)));
         }
-        // initialize the queue
-        priority_queue<Traversal> queue;
+        // initialize the queue, which is keyed on distance and only ever moves forward
+        auto& queue = state.queue;
         
         // the distance to the ends of the starting nodes
         int64_t first_traversal_length = graph[id(pos_1)].sequence.size() - offset(pos_1);
@@ -149,13 +302,13 @@ namespace algorithms {
             
             // if we can reach the end of this node, init the queue with it
             if (first_traversal_length <= forward_max_len) {
-                queue.emplace(source->get_handle(id(pos_1), is_rev(pos_1)), first_traversal_length);
+                queue.push(first_traversal_length, source->get_handle(id(pos_1), is_rev(pos_1)));
             }
             
             // search along a Dijkstra tree
             while (!queue.empty()) {
                 // get the next closest node to the starting position
-                Traversal trav = queue.top();
+                Traversal trav(queue.top().second, queue.top().first);
                 queue.pop();
                 
 #ifdef debug_vg_algorithms
@@ -193,7 +346,7 @@ namespace algorithms {
                     if (!queued_traversals.count(next) && dist_thru <= forward_max_len) {
                         // we can add more nodes along same path without going over the max length
                         // and we have not reached the target node yet
-                        queue.emplace(next, dist_thru);
+                        queue.push(dist_thru, next);
                         queued_traversals.insert(next);
 #ifdef debug_vg_algorithms
                         cerr << "FORWARD SEARCH: distance " << dist_thru << " is under maximum, adding to queue" << endl;
@@ -218,10 +371,10 @@ namespace algorithms {
             }
         }
         
-        // there is no path between the nodes under the maximum distance, leave g empty and return
-        // an empty translator
+        // there is no path between the nodes under the maximum distance, so nothing gets extracted
+        // and the translator stays empty
         if (!found_target) {
-            return id_trans;
+            return false;
         }
         
         // STEP 2: BACKWARD SEARCH (TO EXTRACT CYCLES ON THE FINAL NODE)
@@ -240,7 +393,7 @@ namespace algorithms {
             
             // initialize the queue going backward from the last position if it's reachable
             if (last_traversal_length <= backward_max_len) {
-                queue.emplace(source->get_handle(id(pos_2), !is_rev(pos_2)), last_traversal_length);
+                queue.push(last_traversal_length, source->get_handle(id(pos_2), !is_rev(pos_2)));
             }
             
             // reset the queued traversal list and add the two reverse traversals
@@ -251,7 +404,7 @@ namespace algorithms {
             // search along a Dijkstra tree
             while (!queue.empty()) {
                 // get the next closest node to the starting position
-                Traversal trav = queue.top();
+                Traversal trav(queue.top().second, queue.top().first);
                 queue.pop();
                 
 #ifdef debug_vg_algorithms
@@ -284,7 +437,7 @@ namespace algorithms {
                     if (!queued_traversals.count(next) && dist_thru <= forward_max_len) {
                         // we can add more nodes along same path without going over the max length
                         // and we have not reached the target node yet
-                        queue.emplace(next, dist_thru);
+                        queue.push(dist_thru, next);
                         queued_traversals.insert(next);
 #ifdef debug_vg_algorithms
                         cerr << "BACKWARD SEARCH: distance " << dist_thru << " is under maximum, adding to queue" << endl;
@@ -993,39 +1146,37 @@ namespace algorithms {
             int64_t dist; // distance from pos_1 to the right side of this node
             id_t id;      // node ID
             bool rev;     // strand
-            inline bool operator<(const LocalTraversal& other) const {
-                return dist > other.dist; // opposite order so priority queue selects minimum
-            }
         };
         
         // Define new queue
-        unordered_set<pair<id_t, bool>> local_queued_traversals;
-        priority_queue<LocalTraversal> local_queue;
+        auto& local_queued_traversals = state.local_queued_traversals;
+        auto& local_queue = state.local_queue;
         
         if (strict_max_len) {
             // OPTION 1: PRUNE TO PATHS UNDER MAX LENGTH
             // some nodes in the current graph may not be on paths, or the paths that they are on may be
             // above the maximum distance, so we do a forward-backward distance search to check
             
-            unordered_map<pair<id_t, bool>, int64_t> forward_trav_dist;
-            unordered_map<pair<id_t, bool>, int64_t> reverse_trav_dist;
+            auto& forward_trav_dist = state.forward_trav_dist;
+            auto& reverse_trav_dist = state.reverse_trav_dist;
             
             // re-initialize the queue in the forward direction
-            local_queue.emplace(id(pos_1), is_rev(pos_1), graph[id(pos_1)].sequence.size());
+            local_queue.push(graph[id(pos_1)].sequence.size(), make_pair(id(pos_1), is_rev(pos_1)));
             
             // reset the queued traversal list and the first traversal
             local_queued_traversals.clear();
-            local_queued_traversals.emplace(id(pos_1), is_rev(pos_1));
+            local_queued_traversals.insert(make_pair(id(pos_1), is_rev(pos_1)));
             
             // if we duplicated the start node, add that too
             if (duplicate_node_1) {
-                local_queue.emplace(duplicate_node_1, is_rev(pos_1), graph[duplicate_node_1].sequence.size());
-                local_queued_traversals.emplace(duplicate_node_1, is_rev(pos_1));
+                local_queue.push(graph[duplicate_node_1].sequence.size(), make_pair(duplicate_node_1, is_rev(pos_1)));
+                local_queued_traversals.insert(make_pair(duplicate_node_1, is_rev(pos_1)));
             }
             
             while (!local_queue.empty()) {
                 // get the next closest node traversal
-                LocalTraversal trav = local_queue.top();
+                LocalTraversal trav(local_queue.top().second.first, local_queue.top().second.second,
+                                    local_queue.top().first);
                 local_queue.pop();
                 forward_trav_dist[make_pair(trav.id, trav.rev)] = trav.dist;
                 
@@ -1043,29 +1194,31 @@ namespace algorithms {
                     // queue up the node traversal if it hasn't been seen before
                     pair<id_t, bool> next_trav = make_pair(edge.first, edge.second != trav.rev);
                     if (!local_queued_traversals.count(next_trav)) {
-                        local_queue.emplace(next_trav.first, next_trav.second, dist_thru);
+                        local_queue.push(dist_thru, next_trav);
                         local_queued_traversals.insert(next_trav);
                     }
                 }
             }
             
             // re-initialize the queue
-            local_queue.emplace(id(pos_2), !is_rev(pos_2), 0);
-            
-            // reset the queued traversal list and add the reverse traversal
-            local_queued_traversals.clear();
-            local_queued_traversals.insert(make_pair(id(pos_2), !is_rev(pos_2)));
+            local_queue.push(0, make_pair(id(pos_2), !is_rev(pos_2)));
             
             // if we duplicated the end node, add that too
             if (duplicate_node_2) {
-                local_queue.emplace(duplicate_node_2, !is_rev(pos_2), 0);
-                local_queued_traversals.insert(make_pair(duplicate_node_2, !is_rev(pos_2)));
+                local_queue.push(0, make_pair(duplicate_node_2, !is_rev(pos_2)));
             }
             
             while (!local_queue.empty()) {
                 // get the next closest node traversal
-                LocalTraversal trav = local_queue.top();
+                LocalTraversal trav(local_queue.top().second.first, local_queue.top().second.second,
+                                    local_queue.top().first);
                 local_queue.pop();
+                
+                // the distances here are to the near side of the node, so a traversal can be queued
+                // again from a nearer neighbor after it was first queued, and only its first pop counts
+                if (reverse_trav_dist.count(make_pair(trav.id, trav.rev))) {
+                    continue;
+                }
                 reverse_trav_dist[make_pair(trav.id, trav.rev)] = trav.dist;
                 
 #ifdef debug_vg_algorithms
@@ -1079,11 +1232,10 @@ namespace algorithms {
                 auto& edges_out = trav.rev ? graph[trav.id].edges_left : graph[trav.id].edges_right;
                 
                 for (const pair<id_t, bool>& edge : edges_out) {
-                    // queue up the node traversal if it hasn't been seen before
+                    // queue up the node traversal if it hasn't been reached yet
                     pair<id_t, bool> next_trav = make_pair(edge.first, edge.second != trav.rev);
-                    if (!local_queued_traversals.count(next_trav)) {
-                        local_queue.emplace(next_trav.first, next_trav.second, dist_thru);
-                        local_queued_traversals.insert(next_trav);
+                    if (!reverse_trav_dist.count(next_trav)) {
+                        local_queue.push(dist_thru, next_trav);
                     }
                 }
             }
@@ -1092,8 +1244,8 @@ namespace algorithms {
             // with these, we can compute the shortest path that uses each node and edge to see if it
             // should be included in the final graph
             
-            vector<unordered_map<id_t, LocalNode>::iterator> to_erase;
-            for (auto iter = graph.begin(); iter != graph.end(); iter++) {
+            auto& to_erase = state.to_erase;
+            for (auto iter = graph.begin(); iter != graph.end(); ++iter) {
                 bool erase_node = true;
                 id_t node_id = (*iter).first;
                 // did a short enough path use one or the other traversal directions?
@@ -1114,7 +1266,7 @@ namespace algorithms {
                 
                 if (erase_node) {
                     // the shortest path using this node is too long
-                    to_erase.push_back(iter);
+                    to_erase.push_back(node_id);
                 }
                 else {
                     LocalNode& node = (*iter).second;
@@ -1168,12 +1320,12 @@ namespace algorithms {
             }
             
             // remove the nodes
-            for (auto& iter : to_erase) {
+            for (id_t node_id : to_erase) {
                 // if we're removing one of the duplicated nodes, remove it from the ID translator
-                if (id_trans.count((*iter).first)) {
-                    id_trans.erase((*iter).first);
+                if (id_trans.count(node_id)) {
+                    id_trans.erase(node_id);
                 }
-                graph.erase(iter);
+                graph.erase(node_id);
             }
         }
         else if (only_paths) {
@@ -1181,19 +1333,19 @@ namespace algorithms {
             // some nodes in the current graph may not be on paths, so we do a forward-backward
             // reachability search to check
             
-            list<pair<id_t, bool>> stack;
+            auto& stack = state.stack;
             
-            unordered_set<pair<id_t, bool>> forward_reachable;
-            unordered_set<pair<id_t, bool>> reverse_reachable;
+            auto& forward_reachable = state.forward_reachable;
+            auto& reverse_reachable = state.reverse_reachable;
             
             // initialize the stack in the forward direction
             stack.emplace_back(id(pos_1), is_rev(pos_1));
-            forward_reachable.emplace(id(pos_1), is_rev(pos_1));
+            forward_reachable.insert(make_pair(id(pos_1), is_rev(pos_1)));
             
             // if we duplicated the start node, add that too
             if (duplicate_node_1) {
                 stack.emplace_back(duplicate_node_1, is_rev(pos_1));
-                forward_reachable.emplace(duplicate_node_1, is_rev(pos_1));
+                forward_reachable.insert(make_pair(duplicate_node_1, is_rev(pos_1)));
             }
             
             while (!stack.empty()) {
@@ -1216,12 +1368,12 @@ namespace algorithms {
             
             // re-initialize the stack in the reverse direction
             stack.emplace_back(id(pos_2), !is_rev(pos_2));
-            reverse_reachable.emplace(id(pos_2), !is_rev(pos_2));
+            reverse_reachable.insert(make_pair(id(pos_2), !is_rev(pos_2)));
             
             // if we duplicated the second end node, add that too
             if (duplicate_node_2) {
                 stack.emplace_back(duplicate_node_2, !is_rev(pos_2));
-                reverse_reachable.emplace(duplicate_node_2, !is_rev(pos_2));
+                reverse_reachable.insert(make_pair(duplicate_node_2, !is_rev(pos_2)));
             }
             
             while (!stack.empty()) {
@@ -1245,8 +1397,8 @@ namespace algorithms {
             // now we know which nodes are reachable from both ends, to be on a path between the end positions,
             // a node or edge must be reachable from both directions
             
-            vector<unordered_map<id_t, LocalNode>::iterator> to_erase;
-            for (auto iter = graph.begin(); iter != graph.end(); iter++) {
+            auto& to_erase = state.to_erase;
+            for (auto iter = graph.begin(); iter != graph.end(); ++iter) {
                 id_t node_id = (*iter).first;
                 // did a path use one or the other traversal directions?
                 if (!(forward_reachable.count(make_pair(node_id, true)) &&
@@ -1254,7 +1406,7 @@ namespace algorithms {
                     !(forward_reachable.count(make_pair(node_id, false)) &&
                       reverse_reachable.count(make_pair(node_id, true)))) {
                         
-                    to_erase.push_back(iter);
+                    to_erase.push_back(node_id);
                 }
                 else {
                     LocalNode& node = (*iter).second;
@@ -1280,12 +1432,12 @@ namespace algorithms {
             }
             
             // remove the nodes
-            for (auto& iter : to_erase) {
+            for (id_t node_id : to_erase) {
                 // if we're removing one of the duplicated nodes, remove it from the ID translator
-                if (id_trans.count((*iter).first)) {
-                    id_trans.erase((*iter).first);
+                if (id_trans.count(node_id)) {
+                    id_trans.erase(node_id);
                 }
-                graph.erase(iter);
+                graph.erase(node_id);
             }
         }
         else if (no_additional_tips) {
@@ -1295,8 +1447,8 @@ namespace algorithms {
             // next we remove all tips (except if the tip is a node with our end position on it)
             
             if (no_additional_tips) {
-                unordered_map<id_t, int64_t> left_degree;
-                unordered_map<id_t, int64_t> right_degree;
+                auto& left_degree = state.left_degree;
+                auto& right_degree = state.right_degree;
                 
                 for (const pair<id_t, LocalNode>& node_record : graph) {
                     left_degree[node_record.first] = node_record.second.edges_left.size();
@@ -1304,12 +1456,13 @@ namespace algorithms {
                 }
                 
                 // remove nodes from the graph if they are tips or only connect to tips
-                list<id_t> to_check;
-                for (const pair<id_t, int64_t>& left_deg_record : left_degree) {
+                auto& to_check = state.to_check;
+                // the graph can only lose nodes while we do this, so we can iterate over it
+                for (const pair<id_t, LocalNode>& node_record : graph) {
                     // check every node in the graph once
-                    to_check.push_front(left_deg_record.first);
+                    to_check.push_front(node_record.first);
 #ifdef debug_vg_algorithms
-                    cerr << "TIP REMOVAL: initializing queue with node " << left_deg_record.first << endl;
+                    cerr << "TIP REMOVAL: initializing queue with node " << node_record.first << endl;
 #endif
                     while (!to_check.empty()) {
                         id_t node_id = to_check.back();
@@ -1390,9 +1543,6 @@ namespace algorithms {
         }
 #endif
         
-        // STEP 6: TRANSLATION TO PROTOBUF
-        // transfer the local graph we've been building to g
-        
         // add all remaining nodes that do not have recorded translations to the ID translator
         for (auto& node_record : graph) {
             if (!id_trans.count(node_record.first)) {
@@ -1400,6 +1550,38 @@ namespace algorithms {
             }
         }
         
+        return true;
+    }
+    
+    unordered_map<id_t, id_t> extract_connecting_graph(const HandleGraph* source, Graph& g, int64_t max_len,
+                                                       pos_t pos_1, pos_t pos_2,
+                                                       ConnectingGraphWorkspace& workspace,
+                                                       bool include_terminal_positions,
+                                                       bool detect_terminal_cycles,
+                                                       bool no_additional_tips,
+                                                       bool only_paths,
+                                                       bool strict_max_len) {
+        
+        if (g.node_size() || g.edge_size()) {
+            cerr << "error:[extract_connecting_graph] must extract into an empty graph" << endl;
+            exit(1);
+        }
+        
+        // all our search state lives in the workspace
+        ConnectingGraphWorkspace::State& state = workspace.reset();
+        
+        // a translator for node ids in g to node ids in the original graph
+        unordered_map<id_t, id_t> id_trans;
+        
+        if (!find_connecting_graph(source, max_len, pos_1, pos_2, state, id_trans, include_terminal_positions,
+                                   detect_terminal_cycles, no_additional_tips, only_paths, strict_max_len)) {
+            return id_trans;
+        }
+        
+        // STEP 6: TRANSLATION TO PROTOBUF
+        // transfer the local graph we've been building to g
+        
+        LocalGraph& graph = state.graph;
         for (const pair<id_t, LocalNode>& node_record : graph) {
             // add in each node
             Node* node = g.add_node();
@@ -1434,5 +1616,52 @@ namespace algorithms {
         // the function, which are obviously available in the environment that calls it)
         return id_trans;
     }
+    
+    unordered_map<id_t, id_t> extract_connecting_graph(const HandleGraph* source, MutableHandleGraph* into,
+                                                       int64_t max_len, pos_t pos_1, pos_t pos_2,
+                                                       ConnectingGraphWorkspace& workspace,
+                                                       bool include_terminal_positions,
+                                                       bool detect_terminal_cycles,
+                                                       bool no_additional_tips,
+                                                       bool only_paths,
+                                                       bool strict_max_len) {
+        
+        if (into->node_size()) {
+            cerr << "error:[extract_connecting_graph] must extract into an empty graph" << endl;
+            exit(1);
+        }
+        
+        ConnectingGraphWorkspace::State& state = workspace.reset();
+        unordered_map<id_t, id_t> id_trans;
+        
+        if (!find_connecting_graph(source, max_len, pos_1, pos_2, state, id_trans, include_terminal_positions,
+                                   detect_terminal_cycles, no_additional_tips, only_paths, strict_max_len)) {
+            return id_trans;
+        }
+        
+        // make all the nodes before any of the edges between them
+        LocalGraph& graph = state.graph;
+        for (const pair<id_t, LocalNode>& node_record : graph) {
+            into->create_handle(node_record.second.sequence, node_record.first);
+        }
+        
+        for (const pair<id_t, LocalNode>& node_record : graph) {
+            // break symmetry on the edges the same way as for a Graph
+            for (const pair<id_t, bool>& edge : node_record.second.edges_left) {
+                if (edge.first > node_record.first || (edge.first == node_record.first && edge.second)) {
+                    into->create_edge(into->get_handle(node_record.first, true),
+                                      into->get_handle(edge.first, !edge.second));
+                }
+            }
+            for (const pair<id_t, bool>& edge : node_record.second.edges_right) {
+                if (edge.first >= node_record.first) {
+                    into->create_edge(into->get_handle(node_record.first, false),
+                                      into->get_handle(edge.first, edge.second));
+                }
+            }
+        }
+        
+        return id_trans;
+    }
 }
 }
@@ -8,6 +8,7 @@
  */
 
 #include <unordered_map>
+#include <memory>
 
 #include "../position.hpp"
 #include "../cached_position.hpp"
@@ -18,6 +19,24 @@
 namespace vg {
 namespace algorithms {
     
+    /// Scratch space for extract_connecting_graph that can be reused across calls, so that
+    /// extracting a graph for every pair of MEMs doesn't build fresh hash tables and queues every
+    /// time. It holds no results between calls. Each thread needs its own.
+    class ConnectingGraphWorkspace {
+    public:
+        ConnectingGraphWorkspace();
+        ~ConnectingGraphWorkspace();
+        
+        /// The search state, defined with the algorithm
+        struct State;
+        
+        /// Get the search state, cleared for a new extraction
+        State& reset();
+        
+    private:
+        unique_ptr<State> state;
+    };
+    
     /// Fills Graph g with the subgraph of the VG graph vg that connects two positions. The nodes that contain
     /// the two positions will be "cut" at the position and will be tips in the returned graph. Sometimes it
     /// is necessary to duplicate nodes in order to do this, so a map is returned that translates node IDs in
@@ -50,6 +69,28 @@ namespace algorithms {
                                                        bool no_additional_tips = false,
                                                        bool only_paths = false,
                                                        bool strict_max_len = false);
+    
+    /// Same as above, but keeps its search state in the given workspace instead of allocating it.
+    unordered_map<id_t, id_t> extract_connecting_graph(const HandleGraph* source, Graph& g, int64_t max_len,
+                                                       pos_t pos_1, pos_t pos_2,
+                                                       ConnectingGraphWorkspace& workspace,
+                                                       bool include_terminal_positions = false,
+                                                       bool detect_terminal_cycles = false,
+                                                       bool no_additional_tips = false,
+                                                       bool only_paths = false,
+                                                       bool strict_max_len = false);
+    
+    /// Same as above, but extracts into an empty handle graph instead of a Graph, so a caller that
+    /// only walks the subgraph doesn't need to build Protobuf objects. The nodes, edges and ID
+    /// translation are the same as for a Graph.
+    unordered_map<id_t, id_t> extract_connecting_graph(const HandleGraph* source, MutableHandleGraph* into,
+                                                       int64_t max_len, pos_t pos_1, pos_t pos_2,
+                                                       ConnectingGraphWorkspace& workspace,
+                                                       bool include_terminal_positions = false,
+                                                       bool detect_terminal_cycles = false,
+                                                       bool no_additional_tips = false,
+                                                       bool only_paths = false,
+                                                       bool strict_max_len = false);
 
 }
 }
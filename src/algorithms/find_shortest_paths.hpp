@@ -19,7 +19,7 @@ namespace algorithms {
     
     /// Finds the length of the shortest oriented path from the given handle
     /// leftward to all reachable oriented nodes on a directed walk. Uses
-    /// Dijkstra's Algorithm.
+    /// Dijkstra's Algorithm, as implemented in dijkstra.hpp.
     unordered_map<handle_t, size_t>  find_shortest_paths(const HandleGraph* g, handle_t start);
                                                       
 }
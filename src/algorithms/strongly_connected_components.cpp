@@ -0,0 +1,108 @@
+#include "strongly_connected_components.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace vg {
+namespace algorithms {
+
+using namespace std;
+
+vector<unordered_set<id_t>> strongly_connected_components(const HandleGraph* graph) {
+
+    vector<unordered_set<id_t>> components;
+
+    // The order in which each node orientation was discovered
+    unordered_map<handle_t, size_t> discovered;
+    // The earliest discovered orientation still on the stack that each one
+    // can reach
+    unordered_map<handle_t, size_t> lowlink;
+    // Orientations that haven't been put in a component yet
+    vector<handle_t> stack;
+    unordered_set<handle_t> on_stack;
+
+    // Where we are in the search from each orientation on the DFS path
+    struct Frame {
+        handle_t handle;
+        vector<handle_t> successors;
+        size_t next;
+    };
+    vector<Frame> dfs;
+
+    auto discover = [&](const handle_t& handle) {
+        size_t order = discovered.size();
+        discovered[handle] = order;
+        lowlink[handle] = order;
+        stack.push_back(handle);
+        on_stack.insert(handle);
+        dfs.push_back(Frame{handle, vector<handle_t>(), 0});
+        graph->follow_edges(handle, false, [&](const handle_t& next) {
+            dfs.back().successors.push_back(next);
+        });
+    };
+
+    auto search_from = [&](const handle_t& start) {
+        if (discovered.count(start)) {
+            return;
+        }
+        discover(start);
+        while (!dfs.empty()) {
+            Frame& frame = dfs.back();
+            if (frame.next < frame.successors.size()) {
+                handle_t next = frame.successors[frame.next];
+                frame.next++;
+                if (!discovered.count(next)) {
+                    discover(next);
+                } else if (on_stack.count(next)) {
+                    lowlink[frame.handle] = min(lowlink[frame.handle], discovered[next]);
+                }
+                continue;
+            }
+
+            handle_t handle = frame.handle;
+            dfs.pop_back();
+            if (!dfs.empty()) {
+                lowlink[dfs.back().handle] = min(lowlink[dfs.back().handle], lowlink[handle]);
+            }
+
+            if (lowlink[handle] == discovered[handle]) {
+                // This is the root of a component, which is everything above
+                // it on the stack
+                vector<handle_t> members;
+                handle_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    on_stack.erase(member);
+                    members.push_back(member);
+                } while (member != handle);
+
+                // The mirror image of this component is also a component. Keep
+                // the one with its lowest node forward, or the component
+                // itself if it is its own mirror image.
+                unordered_set<handle_t> member_set(members.begin(), members.end());
+                handle_t lowest = *min_element(members.begin(), members.end(), [&](const handle_t& a, const handle_t& b) {
+                    return graph->get_id(a) < graph->get_id(b);
+                });
+                if (graph->get_is_reverse(lowest) && !member_set.count(graph->flip(lowest))) {
+                    continue;
+                }
+
+                components.emplace_back();
+                for (auto& kept : members) {
+                    components.back().insert(graph->get_id(kept));
+                }
+            }
+        }
+    };
+
+    graph->for_each_handle([&](const handle_t& handle) {
+        search_from(handle);
+        search_from(graph->flip(handle));
+    });
+
+    return components;
+}
+
+}
+}
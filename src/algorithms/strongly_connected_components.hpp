@@ -0,0 +1,34 @@
+#ifndef VG_ALGORITHMS_STRONGLY_CONNECTED_COMPONENTS_HPP_INCLUDED
+#define VG_ALGORITHMS_STRONGLY_CONNECTED_COMPONENTS_HPP_INCLUDED
+
+/**
+ * \file strongly_connected_components.hpp
+ *
+ * Defines an algorithm for finding strongly connected components in a
+ * bidirected graph.
+ */
+
+#include "../handle.hpp"
+
+#include <unordered_set>
+#include <vector>
+
+namespace vg {
+namespace algorithms {
+
+using namespace std;
+
+/// Returns sets of IDs defining components in which every oriented node can
+/// reach every other on a directed walk, like VG::strongly_connected_components
+/// does for a VG. Each node orientation is in one component, and a component
+/// and its mirror image are reported once; a node can appear in two components
+/// if its two orientations are not strongly connected to each other. Nodes
+/// that are not in any cycle get components of their own.
+///
+/// Uses an iterative version of Tarjan's algorithm over the node orientations.
+vector<unordered_set<id_t>> strongly_connected_components(const HandleGraph* graph);
+
+}
+}
+
+#endif
@@ -0,0 +1,203 @@
+/**
+ * \file three_edge_connected_components.cpp
+ *
+ * Implementation of Tsin's 3-edge-connected components algorithm.
+ */
+
+#include "three_edge_connected_components.hpp"
+
+#include <cstdint>
+#include <limits>
+
+//#define debug_vg_algorithms
+
+#ifdef debug_vg_algorithms
+#include <iostream>
+#endif
+
+namespace vg {
+namespace algorithms {
+
+using namespace std;
+
+size_t three_edge_connected_component_labels(size_t vertex_count,
+                                             const function<void(const function<void(size_t, size_t)>&)>& for_each_edge,
+                                             vector<size_t>& labels) {
+
+    const size_t NONE = numeric_limits<size_t>::max();
+
+    // Lay out the adjacency lists end to end, with each edge in both of its
+    // vertices' lists. Self loops can't separate anything, so leave them out.
+    vector<size_t> adjacency_start(vertex_count + 1, 0);
+    for_each_edge([&](size_t a, size_t b) {
+        if (a != b) {
+            adjacency_start[a + 1]++;
+            adjacency_start[b + 1]++;
+        }
+    });
+    for (size_t i = 0; i < vertex_count; i++) {
+        adjacency_start[i + 1] += adjacency_start[i];
+    }
+    vector<size_t> adjacency(adjacency_start.back());
+    {
+        vector<size_t> filled(adjacency_start.begin(), adjacency_start.end() - 1);
+        for_each_edge([&](size_t a, size_t b) {
+            if (a != b) {
+                adjacency[filled[a]++] = b;
+                adjacency[filled[b]++] = a;
+            }
+        });
+    }
+
+    // DFS preorder number of each vertex, from 1, or 0 if not visited yet
+    vector<size_t> pre(vertex_count, 0);
+    // Lowest preorder number reachable by a back edge from the vertex's subtree
+    vector<size_t> lowpt(vertex_count);
+    // Number of descendants of the vertex, including itself
+    vector<size_t> nd(vertex_count);
+    // Number of edges leaving the component the vertex has absorbed so far
+    vector<int64_t> deg(vertex_count);
+    // Next vertex on the path of not-yet-absorbed vertices hanging off of each
+    // vertex, or NONE
+    vector<size_t> path_next(vertex_count, NONE);
+    // The vertex that absorbed each vertex, or itself
+    vector<size_t> absorbed_into(vertex_count);
+    for (size_t i = 0; i < vertex_count; i++) {
+        absorbed_into[i] = i;
+    }
+
+    // Absorb the vertices of the path starting at the given vertex into the
+    // given vertex. Each vertex on a path is a descendant of the one before,
+    // so absorb them for as long as until is in their subtrees, or the whole
+    // path if until is NONE. Returns what is left of the path.
+    auto absorb_path = [&](size_t into, size_t path, size_t until) {
+        while (path != NONE && (until == NONE ||
+                                (pre[path] <= pre[until] && pre[until] < pre[path] + nd[path]))) {
+#ifdef debug_vg_algorithms
+            cerr << "3ECC: absorb " << path << " into " << into << endl;
+#endif
+            deg[into] += deg[path] - 2;
+            absorbed_into[path] = into;
+            path = path_next[path];
+        }
+        return path;
+    };
+
+    struct Frame {
+        size_t vertex;
+        size_t parent;
+        size_t next_edge;
+        bool parent_edge_seen;
+    };
+    vector<Frame> stack;
+    size_t visit_count = 0;
+
+    auto visit = [&](size_t vertex, size_t parent) {
+        visit_count++;
+        pre[vertex] = visit_count;
+        lowpt[vertex] = visit_count;
+        nd[vertex] = 1;
+        deg[vertex] = 0;
+        stack.push_back(Frame{vertex, parent, adjacency_start[vertex], false});
+    };
+
+    for (size_t root = 0; root < vertex_count; root++) {
+        if (pre[root]) {
+            continue;
+        }
+        visit(root, NONE);
+
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            size_t w = frame.vertex;
+
+            if (frame.next_edge != adjacency_start[w + 1]) {
+                size_t u = adjacency[frame.next_edge];
+                frame.next_edge++;
+                deg[w]++;
+
+                if (!pre[u]) {
+                    // Tree edge; finish the child before coming back here
+                    visit(u, w);
+                } else if (u == frame.parent && !frame.parent_edge_seen) {
+                    // The tree edge we came in on. Any parallel copies of it
+                    // are back edges.
+                    frame.parent_edge_seen = true;
+                } else if (pre[u] < pre[w]) {
+                    // Back edge up from here
+                    if (pre[u] < lowpt[w]) {
+                        // Everything on our path is in a cycle with w now
+                        absorb_path(w, path_next[w], NONE);
+                        path_next[w] = NONE;
+                        lowpt[w] = pre[u];
+                    }
+                } else {
+                    // Back edge up to here from a descendant, which closes a
+                    // cycle through the part of our path above it
+                    deg[w] -= 2;
+                    path_next[w] = absorb_path(w, path_next[w], u);
+                }
+            } else {
+                // Done with w, so tell its parent
+                size_t v = frame.parent;
+                stack.pop_back();
+                if (v == NONE) {
+                    continue;
+                }
+
+                nd[v] += nd[w];
+                size_t w_path = w;
+                if (deg[w] <= 2) {
+                    // Cutting one or two edges cuts off w's component, so it
+                    // is finished and the rest of its path carries on past it
+#ifdef debug_vg_algorithms
+                    cerr << "3ECC: component of " << w << " is finished" << endl;
+#endif
+                    w_path = path_next[w];
+                    if (deg[w] == 1) {
+                        // The edge to w is a bridge, so it can't be part of
+                        // any cut that matters to v
+                        deg[v]--;
+                    }
+                }
+                if (lowpt[v] <= lowpt[w]) {
+                    // Nothing from w reaches above v, so w's path ends here
+                    absorb_path(v, w_path, NONE);
+                } else {
+                    // w's path reaches higher than v's, so take it over
+                    lowpt[v] = lowpt[w];
+                    absorb_path(v, path_next[v], NONE);
+                    path_next[v] = w_path;
+                }
+            }
+        }
+    }
+
+    // Number the components in order of their lowest vertices. Everything a
+    // vertex absorbed comes after it in the DFS, so look up the chain.
+    labels.assign(vertex_count, NONE);
+    vector<size_t> component_of_root(vertex_count, NONE);
+    size_t component_count = 0;
+    for (size_t i = 0; i < vertex_count; i++) {
+        size_t root = i;
+        while (absorbed_into[root] != root) {
+            root = absorbed_into[root];
+        }
+        // Shorten the chain for the next lookup
+        size_t here = i;
+        while (absorbed_into[here] != root) {
+            size_t next = absorbed_into[here];
+            absorbed_into[here] = root;
+            here = next;
+        }
+        if (component_of_root[root] == NONE) {
+            component_of_root[root] = component_count++;
+        }
+        labels[i] = component_of_root[root];
+    }
+
+    return component_count;
+}
+
+}
+}
@@ -1,5 +1,8 @@
 #include "topological_sort.hpp"
 
+#include <algorithm>
+#include <queue>
+
 namespace vg {
 namespace algorithms {
 
@@ -49,208 +52,306 @@ vector<handle_t> tail_nodes(const HandleGraph* g) {
     
 }
 
-vector<handle_t> topological_sort(const HandleGraph* g) {
-    
-    // Make a vector to hold the ordered and oriented nodes.
-    vector<handle_t> sorted;
-    sorted.reserve(g->node_size());
-    
-    // Instead of actually removing edges, we add them to this set of masked edges.
-    unordered_set<pair<handle_t, handle_t>> masked_edges;
-    
-    // This (s) is our set of oriented nodes.
-    // using a map instead of a set ensures a stable sort across different systems
-    map<id_t, handle_t> s;
+namespace {
 
-    // We find the head and tails, if there are any
-    vector<handle_t> heads{head_nodes(g)};
-    // No need to fetch the tails since we don't use them
+/**
+ * A snapshot of the adjacency of a HandleGraph over dense node ranks, which
+ * are assigned in node ID order. Each side of each node has a run of records
+ * for the edges on it, in the order follow_edges() reports them from the
+ * node's forward handle. Every record also knows the number of its edge, so
+ * per-edge state can go in a flat bit vector instead of a hash set.
+ */
+struct RankedAdjacency {
 
-    
-    // Maps from node ID to first orientation we suggested for it.
-    map<id_t, handle_t> seeds;
-    
-    
-    for(handle_t& head : heads) {
-        // Dump all the heads into the oriented set, rather than having them as
-        // seeds. We will only go for cycle-breaking seeds when we run out of
-        // heads. This is bad for contiguity/ordering consistency in cyclic
-        // graphs and reversing graphs, but makes sure we work out to just
-        // topological sort on DAGs. It mimics the effect we used to get when we
-        // joined all the head nodes to a new root head node and seeded that. We
-        // ignore tails since we only orient right from nodes we pick.
-        s[g->get_id(head)] = head;
-    }
+    /// Build the snapshot, following edges in parallel
+    RankedAdjacency(const HandleGraph* g);
 
-    // We will use an ordered map handles by ID for nodes we have not visited
-    // yet. This ensures a consistent sort order across systems.
-    map<id_t, handle_t> unvisited;
-    g->for_each_handle([&](const handle_t& found) {
-        if (!s.count(g->get_id(found))) {
-            // Only nodes that aren't yet in s are unvisited.
-            // Nodes in s are visited but just need to be added tot he ordering.
-            unvisited.emplace(g->get_id(found), found);
+    /// Get the rank of a node ID
+    size_t rank_of(id_t id) const {
+        if (dense_ids) {
+            return id - ids.front();
         }
+        return lower_bound(ids.begin(), ids.end(), id) - ids.begin();
+    }
+
+    /// Get the first record for the given side of the given rank's forward handle
+    size_t side_begin(size_t rank, bool right_side) const {
+        return side_starts[2 * rank + right_side];
+    }
+
+    /// Get the past-the-end record for the given side of the given rank's forward handle
+    size_t side_end(size_t rank, bool right_side) const {
+        return side_starts[2 * rank + right_side + 1];
+    }
+
+    /// Forward handle of the node at each rank
+    vector<handle_t> handles;
+    /// ID of the node at each rank, ascending
+    vector<id_t> ids;
+    /// True if the IDs have no gaps, so ranks are just offset IDs
+    bool dense_ids = true;
+    /// Where each node side's records start, at 2 * rank + (right side), plus
+    /// an end sentinel
+    vector<size_t> side_starts;
+    /// The handle on the other end of each record, as 2 * rank + is_reverse
+    vector<uint64_t> neighbors;
+    /// The edge of each record, as the index of the first record of that edge
+    vector<size_t> edge_numbers;
+};
+
+RankedAdjacency::RankedAdjacency(const HandleGraph* g) {
+    // Rank the nodes by ID
+    vector<pair<id_t, handle_t>> by_id;
+    by_id.reserve(g->node_size());
+    g->for_each_handle([&](const handle_t& handle) {
+        by_id.emplace_back(g->get_id(handle), handle);
     });
+    std::sort(by_id.begin(), by_id.end(), [](const pair<id_t, handle_t>& a, const pair<id_t, handle_t>& b) {
+        return a.first < b.first;
+    });
+    size_t node_count = by_id.size();
+    handles.reserve(node_count);
+    ids.reserve(node_count);
+    for (auto& entry : by_id) {
+        ids.push_back(entry.first);
+        handles.push_back(entry.second);
+    }
+    by_id.clear();
+    by_id.shrink_to_fit();
+    dense_ids = ids.empty() || (size_t) (ids.back() - ids.front()) + 1 == node_count;
+
+    // Count the records on each side, shifted by one so a prefix sum makes
+    // them into starts
+    side_starts.resize(2 * node_count + 1, 0);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t rank = 0; rank < node_count; rank++) {
+        for (bool right_side : {false, true}) {
+            size_t count = 0;
+            g->follow_edges(handles[rank], !right_side, [&](const handle_t& ignored) {
+                count++;
+            });
+            side_starts[2 * rank + right_side + 1] = count;
+        }
+    }
+    for (size_t i = 1; i < side_starts.size(); i++) {
+        side_starts[i] += side_starts[i - 1];
+    }
+
+    // Fill in the records
+    neighbors.resize(side_starts.back());
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t rank = 0; rank < node_count; rank++) {
+        for (bool right_side : {false, true}) {
+            size_t record = side_begin(rank, right_side);
+            g->follow_edges(handles[rank], !right_side, [&](const handle_t& other) {
+                neighbors[record++] = (rank_of(g->get_id(other)) << 1) | g->get_is_reverse(other);
+            });
+        }
+    }
+
+    // Pair each record up with the record for the same edge from its other
+    // end, which is on the side of the neighbor that the edge reaches. A
+    // reversing self loop may be its own twin.
+    edge_numbers.resize(neighbors.size());
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (size_t rank = 0; rank < node_count; rank++) {
+        for (bool right_side : {false, true}) {
+            for (size_t record = side_begin(rank, right_side); record < side_end(rank, right_side); record++) {
+                size_t other_rank = neighbors[record] >> 1;
+                bool other_reverse = neighbors[record] & 1;
+                bool other_right_side = right_side ? other_reverse : !other_reverse;
+                uint64_t expected = (rank << 1) | other_reverse;
+
+                size_t twin = record;
+                for (size_t i = side_begin(other_rank, other_right_side); i < side_end(other_rank, other_right_side); i++) {
+                    if (neighbors[i] == expected) {
+                        twin = i;
+                        break;
+                    }
+                }
+                edge_numbers[record] = min(record, twin);
+            }
+        }
+    }
+}
+
+}
+
+vector<handle_t> topological_sort(const HandleGraph* g) {
+
+    // Take a snapshot of the graph over dense ranks in ID order. Taking the
+    // lowest rank from a set is then taking the lowest ID, which keeps the
+    // sort stable across systems.
+    RankedAdjacency adjacency(g);
+    size_t node_count = adjacency.handles.size();
 
-    while(!unvisited.empty() || !s.empty()) {
+    // Make a vector to hold the ordered and oriented nodes.
+    vector<handle_t> sorted;
+    sorted.reserve(node_count);
+
+    // Instead of actually removing edges, we mask them, by edge number.
+    vector<bool> masked_edges(adjacency.neighbors.size(), false);
+
+    // This (s) is our set of oriented nodes, as a min-heap of ranks, with the
+    // orientation each one was given.
+    priority_queue<size_t, vector<size_t>, greater<size_t>> s;
+    vector<bool> oriented_reverse(node_count, false);
+
+    // Nodes we have not visited yet. Visiting only ever removes nodes, so the
+    // lowest-ranked unvisited node can only move up.
+    vector<bool> unvisited(node_count, true);
+    size_t unvisited_count = node_count;
+    size_t first_unvisited = 0;
+
+    // Nodes suggested as cycle entry points, with the first orientation we
+    // suggested for each. A node is suggested at most once.
+    priority_queue<size_t, vector<size_t>, greater<size_t>> seeds;
+    vector<bool> seeded(node_count, false);
+    vector<bool> seed_reverse(node_count, false);
+
+    for (size_t rank = 0; rank < node_count; rank++) {
+        if (adjacency.side_begin(rank, false) == adjacency.side_end(rank, false)) {
+            // Dump all the heads into the oriented set, rather than having them as
+            // seeds. We will only go for cycle-breaking seeds when we run out of
+            // heads. This is bad for contiguity/ordering consistency in cyclic
+            // graphs and reversing graphs, but makes sure we work out to just
+            // topological sort on DAGs. It mimics the effect we used to get when we
+            // joined all the head nodes to a new root head node and seeded that. We
+            // ignore tails since we only orient right from nodes we pick.
+            s.push(rank);
+            unvisited[rank] = false;
+            unvisited_count--;
+        }
+    }
+
+    while (unvisited_count > 0 || !s.empty()) {
 
         // Put something in s. First go through seeds until we can find one
         // that's not already oriented.
-        while(s.empty() && !seeds.empty()) {
+        while (s.empty() && !seeds.empty()) {
             // Look at the first seed
-            auto first_seed = (*seeds.begin()).second;
+            size_t seed = seeds.top();
+            seeds.pop();
 
-            if(unvisited.count(g->get_id(first_seed))) {
+            if (unvisited[seed]) {
                 // We have an unvisited seed. Use it
 #ifdef debug
 #pragma omp critical (cerr)
-                cerr << "Starting from seed " << g->get_id(first_seed) << " orientation " << g->get_is_reverse(first_seed) << endl;
+                cerr << "Starting from seed " << adjacency.ids[seed] << " orientation " << seed_reverse[seed] << endl;
 #endif
-
-                s[g->get_id(first_seed)] = first_seed;
-                unvisited.erase(g->get_id(first_seed));
+                oriented_reverse[seed] = seed_reverse[seed];
+                s.push(seed);
+                unvisited[seed] = false;
+                unvisited_count--;
             }
             // Whether we used the seed or not, don't keep it around
-            seeds.erase(seeds.begin());
         }
 
-        if(s.empty()) {
-            // If we couldn't find a seed, just grab any old node.
-            // Since map order is stable across systems, we can take the first node by id and put it locally forward.
+        if (s.empty()) {
+            // If we couldn't find a seed, just grab any old node. We take the
+            // first node by ID and put it locally forward.
+            while (!unvisited[first_unvisited]) {
+                first_unvisited++;
+            }
 #ifdef debug
 #pragma omp critical (cerr)
-            cerr << "Starting from arbitrary node " << unvisited.begin()->first << " locally forward" << endl;
+            cerr << "Starting from arbitrary node " << adjacency.ids[first_unvisited] << " locally forward" << endl;
 #endif
-
-            s[unvisited.begin()->first] = unvisited.begin()->second;
-            unvisited.erase(unvisited.begin()->first);
+            oriented_reverse[first_unvisited] = false;
+            s.push(first_unvisited);
+            unvisited[first_unvisited] = false;
+            unvisited_count--;
         }
 
         while (!s.empty()) {
             // Grab an oriented node
-            auto n = s.begin()->second;
-            s.erase(g->get_id(n));
+            size_t rank = s.top();
+            s.pop();
+            bool is_reverse = oriented_reverse[rank];
             // Emit it
-            sorted.push_back(n);
+            sorted.push_back(is_reverse ? g->flip(adjacency.handles[rank]) : adjacency.handles[rank]);
 #ifdef debug
 #pragma omp critical (cerr)
-            cerr << "Using oriented node " << g->get_id(n) << " orientation " << g->get_is_reverse(n) << endl;
+            cerr << "Using oriented node " << adjacency.ids[rank] << " orientation " << is_reverse << endl;
 #endif
 
+            // Records are stored from the forward handle, so the oriented
+            // node's left side is the forward right side if it is reversed,
+            // and the neighbors flip along with it.
+
             // See if it has an edge from its start to the start of some node
             // where both were picked as places to break into cycles. A
             // reversing self loop on a cycle entry point is a special case of
-            // this.
-            g->follow_edges(n, true, [&](const handle_t& prev_node) {
-                if(!unvisited.count(g->get_id(prev_node))) {
-                    // Look at the edge
-                    auto edge = g->edge_handle(prev_node, n);
-                    if (masked_edges.count(edge)) {
-                        // We removed this edge, so skip it.
-                        return;
-                    }
-                    
-#ifdef debug
-#pragma omp critical (cerr)
-                    cerr << "\tHas left-side edge to cycle entry point " << g->get_id(prev_node)
-                         << " orientation " << g->get_is_reverse(prev_node) << endl;
-#endif
-
-                    // Mask the edge
-                    masked_edges.insert(edge);
-                    
-#ifdef debug
-#pragma omp critical (cerr)
-                    cerr << "\t\tEdge: " << g->get_id(edge.first) << " " << g->get_is_reverse(edge.first)
-                        << " -> " << g->get_id(edge.second) << " " << g->get_is_reverse(edge.second) << endl;
-#endif
+            // this. Mask any such edges.
+            for (size_t record = adjacency.side_begin(rank, is_reverse);
+                 record < adjacency.side_end(rank, is_reverse); record++) {
+                if (!unvisited[adjacency.neighbors[record] >> 1]) {
+                    masked_edges[adjacency.edge_numbers[record]] = true;
                 }
-            });
+            }
 
             // All other connections and self loops are handled by looking off the right side.
 
             // See what all comes next, minus deleted edges.
-            g->follow_edges(n, false, [&](const handle_t& next_node) {
+            for (size_t record = adjacency.side_begin(rank, !is_reverse);
+                 record < adjacency.side_end(rank, !is_reverse); record++) {
 
-                // Look at the edge
-                auto edge = g->edge_handle(n, next_node);
-                if (masked_edges.count(edge)) {
+                if (masked_edges[adjacency.edge_numbers[record]]) {
                     // We removed this edge, so skip it.
-                    return;
+                    continue;
                 }
-
-#ifdef debug
-#pragma omp critical (cerr)
-                cerr << "\tHas edge to " << g->get_id(next_node) << " orientation " << g->get_is_reverse(next_node) << endl;
-#endif
-
                 // Mask the edge connecting these nodes in this order and
                 // relative orientation, so we can't traverse it again
+                masked_edges[adjacency.edge_numbers[record]] = true;
+
+                uint64_t next = adjacency.neighbors[record] ^ is_reverse;
+                size_t next_rank = next >> 1;
+                bool next_reverse = next & 1;
 
 #ifdef debug
 #pragma omp critical (cerr)
-                cerr << "\t\tEdge: " << g->get_id(edge.first) << " " << g->get_is_reverse(edge.first)
-                    << " -> " << g->get_id(edge.second) << " " << g->get_is_reverse(edge.second) << endl;
+                cerr << "\tHas edge to " << adjacency.ids[next_rank] << " orientation " << next_reverse << endl;
 #endif
 
-                // Mask the edge
-                masked_edges.insert(edge);
-
-                if(unvisited.count(g->get_id(next_node))) {
+                if (unvisited[next_rank]) {
                     // We haven't already started here as an arbitrary cycle entry point
 
-#ifdef debug
-#pragma omp critical (cerr)
-                    cerr << "\t\tAnd node hasn't been visited yet" << endl;
-#endif
-
                     bool unmasked_incoming_edge = false;
-                    g->follow_edges(next_node, true, [&](const handle_t& prev_node) {
-                        // Get a handle for each incoming edge
-                        auto prev_edge = g->edge_handle(prev_node, next_node);
-                        
-                        if (!masked_edges.count(prev_edge)) {
-                            // We found such an edghe and can stop looking
+                    for (size_t incoming = adjacency.side_begin(next_rank, next_reverse);
+                         incoming < adjacency.side_end(next_rank, next_reverse); incoming++) {
+                        if (!masked_edges[adjacency.edge_numbers[incoming]]) {
+                            // We found such an edge and can stop looking
                             unmasked_incoming_edge = true;
-                            return false;
+                            break;
                         }
-                        // Otherwise check all the edges on the left of this handle
-                        return true;
-                    });
-
-                    if(!unmasked_incoming_edge) {
+                    }
 
-#ifdef debug
-#pragma omp critical (cerr)
-                        cerr << "\t\t\tIs last incoming edge" << endl;
-#endif
+                    if (!unmasked_incoming_edge) {
                         // Keep this orientation and put it here
-                        s[g->get_id(next_node)] = next_node;
+                        oriented_reverse[next_rank] = next_reverse;
+                        s.push(next_rank);
                         // Remember that we've visited and oriented this node, so we
                         // don't need to use it as a seed.
-                        unvisited.erase(g->get_id(next_node));
+                        unvisited[next_rank] = false;
+                        unvisited_count--;
 
-                    } else if(!seeds.count(g->get_id(next_node))) {
+                    } else if (!seeded[next_rank]) {
                         // We came to this node in this orientation; when we need a
                         // new node and orientation to start from (i.e. an entry
                         // point to the node's cycle), we might as well pick this
                         // one.
                         // Only take it if we don't already know of an orientation for this node.
-                        seeds[g->get_id(next_node)] = next_node;
+                        seeded[next_rank] = true;
+                        seed_reverse[next_rank] = next_reverse;
+                        seeds.push(next_rank);
 
 #ifdef debug
 #pragma omp critical (cerr)
-                        cerr << "\t\t\tSuggests seed " << g->get_id(next_node) << " orientation " << g->get_is_reverse(next_node) << endl;
+                        cerr << "\t\t\tSuggests seed " << adjacency.ids[next_rank] << " orientation " << next_reverse << endl;
 #endif
                     }
-                } else {
-#ifdef debug
-#pragma omp critical (cerr)
-                    cerr << "\t\tAnd node was already visited (to break a cycle)" << endl;
-#endif
                 }
-            });
+            }
         }
     }
 
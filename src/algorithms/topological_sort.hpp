@@ -54,6 +54,10 @@ vector<handle_t> tail_nodes(const HandleGraph* g);
  *                 put an oriented m on the list of arbitrary places to start when S is empty
  *                     (This helps start at natural entry points to cycles)
  *     return L (a topologically sorted order and orientation)
+ *
+ * Internally, the graph's adjacency is copied out over dense node ranks in ID
+ * order, so N, S, and the removed edges are bit vectors and heaps rather than
+ * hash tables. Copying out the adjacency is done in parallel.
  */
 vector<handle_t> topological_sort(const HandleGraph* g);
 
@@ -1,52 +1,122 @@
 #include "weakly_connected_components.hpp"
 
+#include <algorithm>
+#include <atomic>
+
 namespace vg {
 namespace algorithms {
 
 using namespace std;
 
-vector<unordered_set<id_t>> weakly_connected_components(const HandleGraph* graph) {
-    vector<unordered_set<id_t>> to_return;
-    
-    // This only holds locally forward handles
-    unordered_set<handle_t> traversed;
-    
-    graph->for_each_handle([&](const handle_t& handle) {
-        
-        // Only think about it in the forward orientation
-        auto forward = graph->forward(handle);
-        
-        if (traversed.count(forward)) {
-            // Already have this node, so don't start a search from it.
+namespace {
+
+/// Find the root of the union-find tree an element is in, halving the path
+/// to it on the way. Parents always have lower ranks than their children, so
+/// this is safe to run concurrently with other finds and with links.
+size_t find_root(vector<atomic<size_t>>& parents, size_t element) {
+    while (true) {
+        size_t parent = parents[element].load();
+        if (parent == element) {
+            return element;
+        }
+        size_t grandparent = parents[parent].load();
+        if (grandparent != parent) {
+            // Skip the parent. If someone beat us to changing this, they
+            // moved it closer to the root anyway.
+            parents[element].compare_exchange_weak(parent, grandparent);
+        }
+        element = grandparent;
+    }
+}
+
+/// Put two elements in the same union-find tree, by hanging the higher root
+/// under the lower one. The root of each tree is its lowest-ranked element.
+void link(vector<atomic<size_t>>& parents, size_t a, size_t b) {
+    while (true) {
+        a = find_root(parents, a);
+        b = find_root(parents, b);
+        if (a == b) {
             return;
         }
-        
-        // The stack only holds locally forward handles
-        vector<handle_t> stack{forward};
-        to_return.emplace_back();
-        while (!stack.empty()) {
-            handle_t here = stack.back();
-            stack.pop_back();
-            
-            traversed.insert(here);
-            to_return.back().insert(graph->get_id(here));
-            
-            // We have a function to handle all connected handles
-            auto handle_other = [&](const handle_t& other) {
-                // Again, make it forward
-                auto other_forward = graph->forward(other);
-                
-                if (!traversed.count(other_forward)) {
-                    stack.push_back(other_forward);
-                }
-            };
-            
-            // Look at edges in both directions
-            graph->follow_edges(here, false, handle_other);
-            graph->follow_edges(here, true, handle_other);
-            
+        if (a < b) {
+            swap(a, b);
+        }
+        size_t expected = a;
+        if (parents[a].compare_exchange_strong(expected, b)) {
+            return;
         }
+        // Someone else hung a somewhere first, so try again from its new root
+    }
+}
+
+}
+
+size_t weakly_connected_component_labels(const HandleGraph* graph, vector<id_t>& node_ids,
+                                         vector<size_t>& labels) {
+
+    // Rank the nodes by ID
+    node_ids.clear();
+    node_ids.reserve(graph->node_size());
+    graph->for_each_handle([&](const handle_t& handle) {
+        node_ids.push_back(graph->get_id(handle));
     });
+    std::sort(node_ids.begin(), node_ids.end());
+    size_t node_count = node_ids.size();
+
+    // If the IDs have no gaps, ranks are just offset IDs
+    bool dense_ids = node_ids.empty() || (size_t) (node_ids.back() - node_ids.front()) + 1 == node_count;
+    auto rank_of = [&](id_t id) -> size_t {
+        if (dense_ids) {
+            return id - node_ids.front();
+        }
+        return lower_bound(node_ids.begin(), node_ids.end(), id) - node_ids.begin();
+    };
+
+    // Every node starts out in its own tree
+    vector<atomic<size_t>> parents(node_count);
+#pragma omp parallel for
+    for (size_t i = 0; i < node_count; i++) {
+        parents[i].store(i);
+    }
+
+    graph->for_each_handle([&](const handle_t& handle) {
+        size_t rank = rank_of(graph->get_id(handle));
+        // Each edge is seen from both ends, so only link from the higher one
+        auto link_lower = [&](const handle_t& other) {
+            size_t other_rank = rank_of(graph->get_id(other));
+            if (other_rank < rank) {
+                link(parents, rank, other_rank);
+            }
+        };
+        graph->follow_edges(handle, false, link_lower);
+        graph->follow_edges(handle, true, link_lower);
+    }, true);
+
+    labels.resize(node_count);
+#pragma omp parallel for
+    for (size_t i = 0; i < node_count; i++) {
+        labels[i] = find_root(parents, i);
+    }
+
+    // Number the roots in rank order. Each root comes before the rest of its
+    // tree, so everything else can just copy its root's number.
+    size_t component_count = 0;
+    for (size_t i = 0; i < node_count; i++) {
+        labels[i] = labels[i] == i ? component_count++ : labels[labels[i]];
+    }
+
+    return component_count;
+}
+
+vector<unordered_set<id_t>> weakly_connected_components(const HandleGraph* graph) {
+    vector<id_t> node_ids;
+    vector<size_t> labels;
+    size_t component_count = weakly_connected_component_labels(graph, node_ids, labels);
+
+    vector<unordered_set<id_t>> to_return(component_count);
+    for (size_t i = 0; i < node_ids.size(); i++) {
+        to_return[labels[i]].insert(node_ids[i]);
+    }
     return to_return;
 }
 
@@ -21,9 +21,20 @@ using namespace std;
 /// of nodes and edges, even if it is not a valid bidirected walk. TODO: It
 /// might make sense to have a handle-returning version, but the consumers of
 /// weakly connected components right now want IDs, and membership in a weakly
-/// connected component is orientation-independent.
+/// connected component is orientation-independent. Components are in order of
+/// their lowest node IDs.
 vector<unordered_set<id_t>> weakly_connected_components(const HandleGraph* graph);
 
+/// Label every node with the weakly connected component it is in. Fills
+/// node_ids with all the node IDs in ascending order, and labels with the
+/// component number of each of those nodes. Components are numbered from 0 in
+/// order of their lowest node IDs. Returns the number of components.
+///
+/// Uses a concurrent union-find over node ranks, and looks at the edges in
+/// parallel.
+size_t weakly_connected_component_labels(const HandleGraph* graph, vector<id_t>& node_ids,
+                                         vector<size_t>& labels);
+
 
 }
 }
@@ -16,16 +16,27 @@ void build_gcsa_lcp(VG& graph,
     Node* head_node = nullptr; Node* tail_node = nullptr;
     // TODO add this for MutableHandleGraphs
     graph.add_start_end_markers(kmer_size, '#', '$', head_node, tail_node, head_id, tail_id);
-    string tmpfile = write_gcsa_kmers_to_tmpfile(graph, kmer_size,
-                                                 head_id, tail_id,
-                                                 base_file_name);
+    // the kmer file counts against the temporary space limit, in GB, along with GCSA2 construction
+    size_t kmer_bytes = size_limit * 1024 * 1024 * 1024;
+    string tmpfile;
+    try {
+        tmpfile = write_gcsa_kmers_to_tmpfile(graph, kmer_size, kmer_bytes,
+                                              head_id, tail_id,
+                                              base_file_name);
+    } catch (SizeLimitExceededException& e) {
+        graph.destroy_node(head_node);
+        graph.destroy_node(tail_node);
+        throw;
+    }
     graph.destroy_node(head_node);
     graph.destroy_node(tail_node);
+    // GCSA2 gets whatever the kmers left of the limit, rounded up to whole GB and at least 1
+    size_t gcsa_limit = max<size_t>((kmer_bytes + 1024 * 1024 * 1024 - 1) / (1024 * 1024 * 1024), 1);
     // set up the input graph using the kmers
     gcsa::InputGraph input_graph({ tmpfile }, true);
     gcsa::ConstructionParameters params;
     params.setSteps(doubling_steps);
-    params.setLimit(size_limit);
+    params.setLimit(gcsa_limit);
     // run the GCSA construction
     gcsa = new gcsa::GCSA(input_graph, params);
     // and the LCP array construction
@@ -19,6 +19,10 @@ namespace vg {
 
 using namespace std;
 
+/// Build GCSA2 and LCP indexes of the graph's kmers. The size limit, in
+/// gigabytes, covers the temporary kmer file as well as GCSA2's own temporary
+/// files, which get what the kmers leave, rounded up to a whole gigabyte;
+/// SizeLimitExceededException is thrown if the kmers alone go over it.
 void build_gcsa_lcp(VG& graph,
                     gcsa::GCSA*& gcsa,
                     gcsa::LCPArray*& lcp,
@@ -161,15 +161,13 @@ int64_t PathChunker::extract_gam_for_ids(vector<vg::id_t>& graph_ids,
         };
     }
     int filter_count = 0;
-    function<bool(const Alignment&)> in_range = [&](const Alignment& alignment) {
-        if (alignment.has_path()) {
-            for (size_t i = 0; i < alignment.path().mapping_size(); ++i) {
-                bool check = check_id(alignment.path().mapping(i).position().node_id());
-                if (only_fully_contained && check == false) {
-                    return false;
-                } else if (!only_fully_contained && check == true) {
-                    return true;
-                }
+    function<bool(const Path&)> in_range = [&](const Path& path) {
+        for (size_t i = 0; i < path.mapping_size(); ++i) {
+            bool check = check_id(path.mapping(i).position().node_id());
+            if (only_fully_contained && check == false) {
+                return false;
+            } else if (!only_fully_contained && check == true) {
+                return true;
             }
         }
         if (only_fully_contained) {
@@ -180,11 +178,14 @@ int64_t PathChunker::extract_gam_for_ids(vector<vg::id_t>& graph_ids,
         }
     };
 
+    // The index only parses the rest of an alignment once its path passes
+    function<bool(const Path&)> path_filter = [&](const Path& path) {
+        return (!only_fully_contained && !unsorted_index) || in_range(path);
+    };
+
     function<void(const Alignment&)> write_alignment = [&](const Alignment& alignment) {
-        if ((!only_fully_contained && !unsorted_index) || in_range(alignment)) {
-            gam_buffer.push_back(alignment);
-            stream::write_buffered(*out_stream, gam_buffer, gam_buffer_size);
-        }
+        gam_buffer.push_back(alignment);
+        stream::write_buffered(*out_stream, gam_buffer, gam_buffer_size);
     };
 
     if (search_all_positions) {
@@ -196,22 +197,22 @@ int64_t PathChunker::extract_gam_for_ids(vector<vg::id_t>& graph_ids,
                 graph_ids.push_back(i);
             }
         }
-        index.for_alignment_to_nodes(graph_ids, write_alignment);
+        index.for_alignment_to_nodes(graph_ids, path_filter, write_alignment);
     } else {
         if (contiguous) {
-            index.for_alignment_in_range(graph_ids[0], graph_ids[graph_ids.size() - 1], write_alignment);
+            index.for_alignment_in_range(graph_ids[0], graph_ids[graph_ids.size() - 1], path_filter, write_alignment);
         } else {
             std::sort(graph_ids.begin(), graph_ids.end());
             size_t range_start = 0;
             size_t range_end = 1;
             for (; range_end < graph_ids.size(); ++range_end) {
                 if (graph_ids[range_end] > graph_ids[range_end - 1] + 1) {
-                    index.for_alignment_in_range(graph_ids[range_start], graph_ids[range_end - 1], write_alignment);
+                    index.for_alignment_in_range(graph_ids[range_start], graph_ids[range_end - 1], path_filter, write_alignment);
                     range_start = range_end;
                 }
             }
             if (range_end > range_start) {
-                index.for_alignment_in_range(graph_ids[range_start], graph_ids[range_end - 1], write_alignment);
+                index.for_alignment_in_range(graph_ids[range_start], graph_ids[range_end - 1], path_filter, write_alignment);
             }
         }
     }
@@ -228,4 +229,67 @@ int64_t PathChunker::extract_gam_for_ids(vector<vg::id_t>& graph_ids,
 
 }
 
+int64_t PathChunker::extract_gam_for_subgraph(VG& subgraph, const GAMIndex& index, istream& sorted_gam,
+                                              ostream* out_stream, bool only_fully_contained) {
+
+    vector<vg::id_t> graph_ids;
+    subgraph.for_each_node([&](Node* node) {
+        graph_ids.push_back(node->id());
+    });
+
+    return extract_gam_for_ids(graph_ids, index, sorted_gam, out_stream, false, only_fully_contained);
+}
+
+int64_t PathChunker::extract_gam_for_ids(const vector<vg::id_t>& graph_ids, const GAMIndex& index,
+                                         istream& sorted_gam, ostream* out_stream,
+                                         bool contiguous,
+                                         bool only_fully_contained) {
+
+    if (graph_ids.empty()) {
+        return 0;
+    }
+
+    // The index only produces alignments that visit one of our nodes, so we
+    // only need to check the rest of their nodes for -f
+    function<bool(vg::id_t)> check_id;
+    unordered_set<vg::id_t> id_lookup;
+    if (contiguous) {
+        check_id = [&](vg::id_t node_id) {
+            return node_id >= graph_ids.front() && node_id <= graph_ids.back();
+        };
+    } else {
+        id_lookup.insert(graph_ids.begin(), graph_ids.end());
+        check_id = [&](vg::id_t node_id) {
+            return id_lookup.count(node_id) == 1;
+        };
+    }
+
+    vector<Alignment> gam_buffer;
+    int64_t gam_count = 0;
+    auto write_alignment = [&](const Alignment& alignment) {
+        if (only_fully_contained) {
+            for (auto& mapping : alignment.path().mapping()) {
+                if (!check_id(mapping.position().node_id())) {
+                    return;
+                }
+            }
+        }
+        gam_buffer.push_back(alignment);
+        ++gam_count;
+        stream::write_buffered(*out_stream, gam_buffer, gam_buffer_size);
+    };
+
+    if (contiguous) {
+        index.find(sorted_gam, vector<pair<vg::id_t, vg::id_t>>{make_pair(graph_ids.front(), graph_ids.back())},
+                   write_alignment);
+    } else {
+        index.find(sorted_gam, graph_ids, write_alignment);
+    }
+
+    // flush buffer
+    stream::write_buffered(*out_stream, gam_buffer, 0);
+
+    return gam_count;
+}
+
 }
@@ -11,6 +11,7 @@
 #include "json2pb.h"
 #include "region.hpp"
 #include "index.hpp"
+#include "gam_index.hpp"
 
 namespace vg {
 
@@ -19,8 +20,8 @@ using namespace std;
 
 /** Chunk up a graph along a path, using a given number of
  * context expansion steps to fill out the chunks.  Most of the 
- * work done by exising xg functions. For gams, the rocksdb
- * index is also required. 
+ * work done by exising xg functions. For gams, either a sorted
+ * gam with its GAMIndex or the rocksdb index is also required. 
  */
 class PathChunker {
 
@@ -65,6 +66,21 @@ public:
                                 bool only_fully_contained = false,
                                 bool search_all_positions = false,
                                 bool unsorted_index = false);
+
+    /** Extract all alignments that touch a node in a subgraph and write them
+     * to an output stream, reading them from a gam sorted by vg gamsort using
+     * its GAMIndex. Every node an alignment visits is indexed, so there is no
+     * need to choose which positions to search. Returns the number of
+     * alignments written. */
+    int64_t extract_gam_for_subgraph(VG& subgraph, const GAMIndex& index, istream& sorted_gam,
+                                     ostream* out_stream, bool only_fully_contained = false);
+
+    /** More general interface used by above function. If contiguous_id_range
+     * is set, graph_ids holds the first and last IDs of an inclusive range. */
+    int64_t extract_gam_for_ids(const vector<vg::id_t>& graph_ids, const GAMIndex& index,
+                                istream& sorted_gam, ostream* out_stream,
+                                bool contiguous_id_range = false,
+                                bool only_fully_contained = false);
     
 };
 
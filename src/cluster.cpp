@@ -1855,6 +1855,30 @@ vector<pair<pair<size_t, size_t>, int64_t>> OrientedDistanceClusterer::pair_clus
     cerr << "beginning clustering of MEM cluster pairs for " << left_clusters.size() << " left clusters and " << right_clusters.size() << " right clusters" << endl;
 #endif
     
+    if (!unstranded) {
+        // we can pair up clusters by their positions along path strands without building distance trees
+        return pair_clusters_by_path_projection(alignment_1, alignment_2, left_clusters, right_clusters, xgindex,
+                                                min_inter_cluster_distance, max_inter_cluster_distance,
+                                                paths_of_node_memo, oriented_occurences_memo, handle_memo);
+    }
+    
+    return pair_clusters_by_distance_tree(alignment_1, alignment_2, left_clusters, right_clusters, xgindex,
+                                          min_inter_cluster_distance, max_inter_cluster_distance, unstranded,
+                                          paths_of_node_memo, oriented_occurences_memo, handle_memo);
+}
+
+vector<pair<pair<size_t, size_t>, int64_t>> OrientedDistanceClusterer::pair_clusters_by_distance_tree(const Alignment& alignment_1,
+                                                                                                      const Alignment& alignment_2,
+                                                                                                      const vector<cluster_t*>& left_clusters,
+                                                                                                      const vector<cluster_t*>& right_clusters,
+                                                                                                      xg::XG* xgindex,
+                                                                                                      int64_t min_inter_cluster_distance,
+                                                                                                      int64_t max_inter_cluster_distance,
+                                                                                                      bool unstranded,
+                                                                                                      paths_of_node_memo_t* paths_of_node_memo,
+                                                                                                      oriented_occurences_memo_t* oriented_occurences_memo,
+                                                                                                      handle_memo_t* handle_memo) {
+    
     // We will fill this in with all sufficiently close pairs of clusters from different reads.
     vector<pair<pair<size_t, size_t>, int64_t>> to_return;
     
@@ -1981,6 +2005,172 @@ vector<pair<pair<size_t, size_t>, int64_t>> OrientedDistanceClusterer::pair_clus
     return to_return;
 }
 
+vector<pair<pair<size_t, size_t>, int64_t>> OrientedDistanceClusterer::pair_clusters_by_path_projection(const Alignment& alignment_1,
+                                                                                                        const Alignment& alignment_2,
+                                                                                                        const vector<cluster_t*>& left_clusters,
+                                                                                                        const vector<cluster_t*>& right_clusters,
+                                                                                                        xg::XG* xgindex,
+                                                                                                        int64_t min_inter_cluster_distance,
+                                                                                                        int64_t max_inter_cluster_distance,
+                                                                                                        paths_of_node_memo_t* paths_of_node_memo,
+                                                                                                        oriented_occurences_memo_t* oriented_occurences_memo,
+                                                                                                        handle_memo_t* handle_memo) {
+    
+    // We think of the clusters as a single linear ordering, with the left clusters coming first.
+    size_t total_clusters = left_clusters.size() + right_clusters.size();
+    
+    auto get_position = [&](size_t cluster_num) -> pos_t {
+        // Assumes the clusters are nonempty. Use the first hit, which is sorted to be the largest one.
+        if (cluster_num < left_clusters.size()) {
+            return left_clusters[cluster_num]->front().second;
+        }
+        else {
+            return right_clusters[cluster_num - left_clusters.size()]->front().second;
+        }
+    };
+    
+    auto get_offset = [&](size_t cluster_num) -> int64_t {
+        // Give the offset of the position we chose to either the start or end of the read
+        if (cluster_num < left_clusters.size()) {
+            return alignment_1.sequence().begin() - left_clusters[cluster_num]->front().first->begin;
+        }
+        else {
+            return alignment_2.sequence().end() - right_clusters[cluster_num - left_clusters.size()]->front().first->begin;
+        }
+    };
+    
+    // project every cluster onto the strands of the paths that its node occurs on, recording the coordinate
+    // of the read end along the strand (reverse strand coordinates are negated so they also increase in the
+    // direction of the strand)
+    unordered_map<pair<size_t, bool>, vector<pair<int64_t, size_t>>> strand_coordinates;
+    // the paths that each cluster was projected onto, in ascending order
+    vector<vector<size_t>> projected_paths(total_clusters);
+    for (size_t i = 0; i < total_clusters; i++) {
+        pos_t pos = get_position(i);
+        int64_t read_offset = get_offset(i);
+        for (size_t path : xgindex->memoized_paths_of_node(id(pos), paths_of_node_memo)) {
+            vector<pair<size_t, bool>> occurrences = xgindex->memoized_oriented_occurrences_on_path(id(pos), path,
+                                                                                                   oriented_occurences_memo);
+            vector<size_t> node_starts = xgindex->position_in_path(id(pos), path);
+            for (size_t k = 0; k < occurrences.size(); k++) {
+                bool on_reverse = occurrences[k].second != is_rev(pos);
+                int64_t coordinate;
+                if (on_reverse) {
+                    coordinate = -((int64_t) (node_starts[k] + xgindex->node_length(id(pos)) - offset(pos)));
+                }
+                else {
+                    coordinate = node_starts[k] + offset(pos);
+                }
+                strand_coordinates[make_pair(path, on_reverse)].emplace_back(coordinate + read_offset, i);
+            }
+            projected_paths[i].push_back(path);
+        }
+        sort(projected_paths[i].begin(), projected_paths[i].end());
+    }
+    
+    auto share_a_path = [&](size_t i, size_t j) {
+        auto iter_i = projected_paths[i].begin();
+        auto iter_j = projected_paths[j].begin();
+        while (iter_i != projected_paths[i].end() && iter_j != projected_paths[j].end()) {
+            if (*iter_i == *iter_j) {
+                return true;
+            }
+            else if (*iter_i < *iter_j) {
+                iter_i++;
+            }
+            else {
+                iter_j++;
+            }
+        }
+        return false;
+    };
+    
+    // the closest distance we've found for each pair of clusters
+    map<pair<size_t, size_t>, int64_t> pair_distances;
+    auto record_distance = [&](size_t left, size_t right, int64_t dist) {
+        auto key = make_pair(left, right - left_clusters.size());
+        auto iter = pair_distances.find(key);
+        if (iter == pair_distances.end()) {
+            pair_distances[key] = dist;
+        }
+        else if (abs(dist) < abs(iter->second)) {
+            iter->second = dist;
+        }
+    };
+    
+    for (pair<const pair<size_t, bool>, vector<pair<int64_t, size_t>>>& strand : strand_coordinates) {
+        vector<pair<int64_t, size_t>>& sorted_coordinates = strand.second;
+        sort(sorted_coordinates.begin(), sorted_coordinates.end());
+        
+#ifdef debug_od_clusterer
+        cerr << "sweeping " << sorted_coordinates.size() << " projections on path " << strand.first.first << (strand.first.second ? "-" : "+") << endl;
+#endif
+        
+        // the window of coordinates that are in the fragment length range of the current left cluster
+        // only moves forward, since the left clusters are visited in sorted order
+        size_t window_start = 0;
+        size_t window_end = 0;
+        for (size_t i = 0; i < sorted_coordinates.size(); i++) {
+            if (sorted_coordinates[i].second >= left_clusters.size()) {
+                // we're looking for left to right connections, so don't start from the right
+                continue;
+            }
+            int64_t coordinate_interval_start = sorted_coordinates[i].first + min_inter_cluster_distance;
+            int64_t coordinate_interval_end = sorted_coordinates[i].first + max_inter_cluster_distance;
+            while (window_start < sorted_coordinates.size() && sorted_coordinates[window_start].first < coordinate_interval_start) {
+                window_start++;
+            }
+            window_end = max(window_end, window_start);
+            while (window_end < sorted_coordinates.size() && sorted_coordinates[window_end].first <= coordinate_interval_end) {
+                window_end++;
+            }
+            for (size_t j = window_start; j < window_end; j++) {
+                if (sorted_coordinates[j].second >= left_clusters.size()) {
+                    record_distance(sorted_coordinates[i].second, sorted_coordinates[j].second,
+                                    sorted_coordinates[j].first - sorted_coordinates[i].first);
+                }
+            }
+        }
+    }
+    
+    // pairs of clusters that don't share a path (including clusters that are on no path at all) can't be
+    // compared in path space, so measure their distances in the graph, like the distance tree would
+    for (size_t i = 0; i < left_clusters.size(); i++) {
+        pos_t pos_left = get_position(i);
+        for (size_t j = left_clusters.size(); j < total_clusters; j++) {
+            if (share_a_path(i, j)) {
+                // the sweep has already measured them
+                continue;
+            }
+            if (!projected_paths[i].empty() && !projected_paths[j].empty()
+                && !xgindex->paths_on_same_component(projected_paths[i].front(), projected_paths[j].front())) {
+                // they're in separate components, so there's no distance to find
+                continue;
+            }
+            pos_t pos_right = get_position(j);
+            int64_t dist = xgindex->closest_shared_path_oriented_distance(id(pos_left), offset(pos_left), is_rev(pos_left),
+                                                                          id(pos_right), offset(pos_right), is_rev(pos_right),
+                                                                          false, 50, paths_of_node_memo, oriented_occurences_memo,
+                                                                          handle_memo);
+            if (dist == numeric_limits<int64_t>::max()) {
+                continue;
+            }
+            dist += get_offset(j) - get_offset(i);
+            
+#ifdef debug_od_clusterer
+            cerr << "pair " << i << ", " << j - left_clusters.size() << " without a shared path at graph distance " << dist << endl;
+#endif
+            
+            if (dist >= min_inter_cluster_distance && dist <= max_inter_cluster_distance) {
+                record_distance(i, j, dist);
+            }
+        }
+    }
+    
+    vector<pair<pair<size_t, size_t>, int64_t>> to_return(pair_distances.begin(), pair_distances.end());
+    return to_return;
+}
+
 Graph cluster_subgraph(const xg::XG& xg, const Alignment& aln, const vector<vg::MaximalExactMatch>& mems, double expansion) {
     assert(mems.size());
     auto& start_mem = mems.front();
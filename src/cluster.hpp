@@ -196,7 +196,9 @@ public:
     /**
      * Given two vectors of clusters, an xg index, an bounds on the distance between clusters,
      * returns a vector of pairs of cluster numbers (one in each vector) matched with the estimated
-     * distance
+     * distance. In stranded mode, clusters are projected onto path coordinates and paired with a
+     * sweep over the sorted coordinates, so that graph distance queries are only needed for
+     * pairs of clusters that do not share a path.
      */
     static vector<pair<pair<size_t, size_t>, int64_t>> pair_clusters(const Alignment& alignment_1,
                                                                      const Alignment& alignment_2,
@@ -210,6 +212,23 @@ public:
                                                                      oriented_occurences_memo_t* oriented_occurences_memo = nullptr,
                                                                      handle_memo_t* handle_memo = nullptr);
     
+    /**
+     * Pair clusters as pair_clusters does, but always by building a distance tree over all the
+     * clusters with graph distance queries and sweeping over the linear spaces it flattens to. This
+     * is what pair_clusters does in unstranded mode.
+     */
+    static vector<pair<pair<size_t, size_t>, int64_t>> pair_clusters_by_distance_tree(const Alignment& alignment_1,
+                                                                                      const Alignment& alignment_2,
+                                                                                      const vector<cluster_t*>& left_clusters,
+                                                                                      const vector<cluster_t*>& right_clusters,
+                                                                                      xg::XG* xgindex,
+                                                                                      int64_t min_inter_cluster_distance,
+                                                                                      int64_t max_inter_cluster_distance,
+                                                                                      bool unstranded,
+                                                                                      paths_of_node_memo_t* paths_of_node_memo = nullptr,
+                                                                                      oriented_occurences_memo_t* oriented_occurences_memo = nullptr,
+                                                                                      handle_memo_t* handle_memo = nullptr);
+    
     //static size_t PRUNE_COUNTER;
     //static size_t CLUSTER_TOTAL;
     //static size_t MEM_FILTER_COUNTER;
@@ -220,6 +239,23 @@ private:
     class ODEdge;
     struct DPScoreComparator;
     
+    /**
+     * Stranded implementation of pair_clusters. Projects the first hit of each cluster onto every
+     * strand of every path its node occurs on, sorts the projections on each strand, and sweeps the
+     * fragment length window over them. Pairs of clusters that were not projected onto a shared path
+     * are checked with a direct graph distance query instead.
+     */
+    static vector<pair<pair<size_t, size_t>, int64_t>> pair_clusters_by_path_projection(const Alignment& alignment_1,
+                                                                                        const Alignment& alignment_2,
+                                                                                        const vector<cluster_t*>& left_clusters,
+                                                                                        const vector<cluster_t*>& right_clusters,
+                                                                                        xg::XG* xgindex,
+                                                                                        int64_t min_inter_cluster_distance,
+                                                                                        int64_t max_inter_cluster_distance,
+                                                                                        paths_of_node_memo_t* paths_of_node_memo,
+                                                                                        oriented_occurences_memo_t* oriented_occurences_memo,
+                                                                                        handle_memo_t* handle_memo);
+    
     /// Internal constructor that public constructors filter into
     OrientedDistanceClusterer(const Alignment& alignment,
                               const vector<MaximalExactMatch>& mems,
@@ -13,6 +13,7 @@
 #include <list>
 #include <algorithm>
 #include <memory>
+#include <omp.h>
 
 
 namespace vg {
@@ -1196,6 +1197,50 @@ namespace vg {
             callback(chunk.graph);
         };
 
+        // Chunks are cut and their reference sequence read in order, but
+        // constructed a batch at a time in parallel. Construction doesn't
+        // depend on IDs, which are only assigned as each finished chunk is
+        // wired up in order, so the output is the same as a serial build.
+        struct PendingChunk {
+            string reference_sequence;
+            vector<vcflib::Variant> variants;
+            size_t start;
+            size_t end;
+        };
+        vector<PendingChunk> pending_chunks;
+        size_t max_pending_chunks = max(omp_get_max_threads(), 1);
+
+        // Construct, wire up and emit all the pending chunks
+        auto finish_pending_chunks = [&]() {
+            vector<ConstructedChunk> results(pending_chunks.size());
+#pragma omp parallel for schedule(dynamic, 1)
+            for (size_t i = 0; i < pending_chunks.size(); i++) {
+                auto& pending = pending_chunks[i];
+                results[i] = construct_chunk(std::move(pending.reference_sequence), reference_contig,
+                                             std::move(pending.variants), pending.start);
+            }
+            for (size_t i = 0; i < results.size(); i++) {
+                wire_and_emit(results[i]);
+                // Say we've completed the chunk
+                update_progress(pending_chunks[i].end - leading_offset);
+            }
+            pending_chunks.clear();
+        };
+
+        // Queue up a chunk of the reference and the variants in it
+        auto add_chunk = [&](size_t start, size_t end, vector<vcflib::Variant>& variants) {
+            pending_chunks.emplace_back();
+            auto& pending = pending_chunks.back();
+            pending.reference_sequence = reference.getSubSequence(reference_contig, start, end - start);
+            pending.variants = std::move(variants);
+            pending.start = start;
+            pending.end = end;
+            variants.clear();
+            if (pending_chunks.size() >= max_pending_chunks) {
+                finish_pending_chunks();
+            }
+        };
+
         bool do_external_insertions = false;
         FastaReference* insertion_fasta;
 
@@ -1299,22 +1344,12 @@ namespace vg {
                             min((size_t) reference_end,
                                 (size_t) (chunk_start + bases_per_chunk))));
 
-                // Get the ref sequence we need
-                auto chunk_ref = reference.getSubSequence(reference_contig, chunk_start, chunk_end - chunk_start);
-
-                // Call the construction
-                auto result = construct_chunk(chunk_ref, reference_contig, chunk_variants, chunk_start);
-
-                // Wire up and emit the chunk graph
-                wire_and_emit(result);
-
-                // Say we've completed the chunk
-                update_progress(chunk_end - leading_offset);
+                // Get the ref sequence we need and queue the chunk for construction
+                add_chunk(chunk_start, chunk_end, chunk_variants);
 
                 // Set up a new chunk
                 chunk_start = chunk_end;
                 chunk_end = 0;
-                chunk_variants.clear();
 
                 // Loop again on the same variant.
             }
@@ -1331,23 +1366,14 @@ namespace vg {
                     min((size_t) reference_end,
                         (size_t) (chunk_start + bases_per_chunk)));
 
-            // Get the ref sequence we need
-            auto chunk_ref = reference.getSubSequence(reference_contig, chunk_start, chunk_end - chunk_start);
-
-            // Call the construction
-            auto result = construct_chunk(chunk_ref, reference_contig, chunk_variants, chunk_start);
-
-            // Wire up and emit the chunk graph
-            wire_and_emit(result);
-
-            // Say we've completed the chunk
-            update_progress(chunk_end - leading_offset);
+            // Get the ref sequence we need and queue the chunk for construction
+            add_chunk(chunk_start, chunk_end, chunk_variants);
 
             // Set up a new chunk
             chunk_start = chunk_end;
             chunk_end = 0;
-            chunk_variants.clear();
         }
+        finish_pending_chunks();
 
         // All the chunks have been wired and emitted. Now emit the very last node, if any
         emit_reference_node(last_node_buffer);
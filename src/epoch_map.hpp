@@ -0,0 +1,157 @@
+#ifndef VG_EPOCH_MAP_HPP_INCLUDED
+#define VG_EPOCH_MAP_HPP_INCLUDED
+
+/**
+ * \file epoch_map.hpp
+ *
+ * A hash map for per-query scratch state that can be cleared in constant time.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "hash_map.hpp"
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * An open-addressing hash map that is meant to be cleared and refilled many
+ * times, like the visited set of a search that runs once per read. Each slot
+ * is stamped with the epoch it was filled in, and clearing just starts a new
+ * epoch, so it is constant time and keeps all the memory. Entries cannot be
+ * removed individually.
+ */
+template<typename Key, typename Value>
+class EpochMap {
+public:
+
+    EpochMap() : slots(16) {
+        // Nothing is in the initial slots
+    }
+
+    /// Remove everything
+    void clear() {
+        filled = 0;
+        epoch++;
+        if (epoch == 0) {
+            // We wrapped around, so old stamps could look current
+            for (auto& slot : slots) {
+                slot.epoch = 0;
+            }
+            epoch = 1;
+        }
+    }
+
+    /// Return the number of entries
+    inline size_t size() const {
+        return filled;
+    }
+
+    /// Return true if there are no entries
+    inline bool empty() const {
+        return filled == 0;
+    }
+
+    /// Return 1 if the key is present and 0 otherwise
+    inline size_t count(const Key& key) const {
+        return find(key) != nullptr;
+    }
+
+    /// Get the value for a key, or null if it is absent
+    inline const Value* find(const Key& key) const {
+        for (size_t i = index_of(key);; i = (i + 1) & (slots.size() - 1)) {
+            const Slot& slot = slots[i];
+            if (slot.epoch != epoch) {
+                return nullptr;
+            }
+            if (slot.key == key) {
+                return &slot.value;
+            }
+        }
+    }
+
+    /// Get the value for a key, or null if it is absent
+    inline Value* find(const Key& key) {
+        return const_cast<Value*>(static_cast<const EpochMap&>(*this).find(key));
+    }
+
+    /// Get the value for a key, adding a default-constructed value if it is
+    /// absent
+    inline Value& operator[](const Key& key) {
+        if ((filled + 1) * 4 > slots.size() * 3) {
+            grow();
+        }
+        return claim(key);
+    }
+
+    /// Add a key with a default-constructed value if it is absent. Returns
+    /// true if it was added.
+    inline bool insert(const Key& key) {
+        size_t before = filled;
+        (*this)[key];
+        return filled != before;
+    }
+
+private:
+
+    struct Slot {
+        Key key;
+        Value value;
+        uint32_t epoch = 0;
+    };
+
+    /// Get the home slot for a key, mixing the hash so that identity hashes
+    /// of nearby integers spread out
+    inline size_t index_of(const Key& key) const {
+        return (std::hash<Key>()(key) * 0x9E3779B97F4A7C15ull) >> shift;
+    }
+
+    /// Find or fill the slot for a key, without checking the load
+    inline Value& claim(const Key& key) {
+        for (size_t i = index_of(key);; i = (i + 1) & (slots.size() - 1)) {
+            Slot& slot = slots[i];
+            if (slot.epoch != epoch) {
+                slot.key = key;
+                slot.value = Value();
+                slot.epoch = epoch;
+                filled++;
+                return slot.value;
+            }
+            if (slot.key == key) {
+                return slot.value;
+            }
+        }
+    }
+
+    /// Double the number of slots
+    void grow() {
+        vector<Slot> old_slots(slots.size() * 2);
+        swap(old_slots, slots);
+        shift--;
+        uint32_t old_epoch = epoch;
+        epoch = 1;
+        filled = 0;
+        for (auto& slot : old_slots) {
+            if (slot.epoch == old_epoch) {
+                claim(slot.key) = std::move(slot.value);
+            }
+        }
+    }
+
+    vector<Slot> slots;
+    /// Shift that takes a 64-bit mixed hash to a slot index
+    size_t shift = 60;
+    uint32_t epoch = 1;
+    size_t filled = 0;
+};
+
+/// A set version of EpochMap
+template<typename Key>
+using EpochSet = EpochMap<Key, bool>;
+
+}
+
+#endif
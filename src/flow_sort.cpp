@@ -3,6 +3,7 @@
 #include "gssw_aligner.hpp"
 #include "vg.pb.h"
 #include "flow_sort.hpp"
+#include "packed_graph.hpp"
 #include <raptor2/raptor2.h>
 
 namespace vg {
@@ -123,6 +124,182 @@ void FlowSort::fast_linear_sort(const string& ref_name, bool isGrooming)
     vg.rebuild_indexes();
 }
 
+void FlowSort::fast_linear_sort(PackedGraph& graph, const string& ref_name)
+{
+    size_t node_count = graph.node_size();
+    if (node_count <= 1) return;
+
+    // Number the nodes in their stored order
+    vector<handle_t> handles;
+    handles.reserve(node_count);
+    unordered_map<id_t, size_t> number_of;
+    graph.for_each_handle([&](const handle_t& handle) {
+        number_of[graph.get_id(handle)] = handles.size();
+        handles.push_back(handle);
+    });
+
+    // Keep the edges that read forward. A doubly reversed edge is seen here
+    // as the forward edge it is equivalent to.
+    vector<size_t> edge_from;
+    vector<size_t> edge_to;
+    vector<vector<size_t>> edges_out(node_count);
+    vector<vector<size_t>> edges_in(node_count);
+    for (size_t i = 0; i < node_count; i++) {
+        graph.follow_edges(handles[i], false, [&](const handle_t& next) {
+            if (!graph.get_is_reverse(next)) {
+                size_t to = number_of[graph.get_id(next)];
+                edges_out[i].push_back(edge_from.size());
+                edges_in[to].push_back(edge_from.size());
+                edge_from.push_back(i);
+                edge_to.push_back(to);
+            }
+        });
+    }
+
+    // Count the paths that go straight from one end of each edge to the
+    // other, as WeightedGraph::construct() does
+    vector<int> path_count(edge_from.size(), 0);
+    vector<bool> on_ref(edge_from.size(), false);
+    vector<size_t> last_path(edge_from.size(), numeric_limits<size_t>::max());
+    size_t path_number = 0;
+    graph.for_each_path([&](const string& name, const vector<handle_t>& steps) {
+        for (size_t i = 1; i < steps.size(); i++) {
+            size_t from = number_of[graph.get_id(steps[i - 1])];
+            size_t to = number_of[graph.get_id(steps[i])];
+            for (auto& edge : edges_out[from]) {
+                if (edge_to[edge] == to && last_path[edge] != path_number) {
+                    last_path[edge] = path_number;
+                    path_count[edge]++;
+                    if (name == ref_name) {
+                        on_ref[edge] = true;
+                    }
+                }
+            }
+        }
+        path_number++;
+    });
+    int ref_weight = path_number;
+    if (ref_weight < FlowSort::DEFAULT_PATH_WEIGHT) {
+        ref_weight = FlowSort::DEFAULT_PATH_WEIGHT;
+    }
+    vector<int> edge_weight(edge_from.size());
+    for (size_t edge = 0; edge < edge_from.size(); edge++) {
+        edge_weight[edge] = 1 + path_count[edge] + (on_ref[edge] ? ref_weight : 0);
+    }
+
+    auto get_degree = [&](size_t node) {
+        int degree = 0;
+        for (auto& edge : edges_out[node]) {
+            degree += edge_weight[edge];
+        }
+        for (auto& edge : edges_in[node]) {
+            degree -= edge_weight[edge];
+        }
+        return degree;
+    };
+
+    //index - degree of nodes
+    vector<set<size_t>> nodes_degree;
+    auto file_node = [&](size_t node, int degree) {
+        if (degree >= 0) {
+            if (degree + 1 > nodes_degree.size()) {
+                nodes_degree.resize(degree + 1);
+            }
+            nodes_degree[degree].insert(node);
+        }
+    };
+    auto unfile_node = [&](size_t node, int degree) {
+        if (degree >= 0 && degree < nodes_degree.size()) {
+            nodes_degree[degree].erase(node);
+        }
+    };
+
+    set<size_t> sources;
+    for (size_t i = 0; i < node_count; i++) {
+        if (edges_in[i].empty()) {
+            sources.insert(i);
+        } else {
+            file_node(i, get_degree(i));
+        }
+    }
+
+    // Take out sources, or else the node with the most weight going out, and
+    // prefer a node that just became a source
+    vector<size_t> sorted_nodes;
+    sorted_nodes.reserve(node_count);
+    const size_t no_node = numeric_limits<size_t>::max();
+    size_t next = no_node;
+    while (sorted_nodes.size() < node_count) {
+        if (next == no_node) {
+            if (!sources.empty()) {
+                next = *sources.rbegin();
+            } else {
+                while (nodes_degree.back().empty()) {
+                    nodes_degree.pop_back();
+                }
+                next = *nodes_degree.back().rbegin();
+            }
+        }
+        sources.erase(next);
+        unfile_node(next, get_degree(next));
+        sorted_nodes.push_back(next);
+
+        size_t node = next;
+        next = no_node;
+        for (auto& edge : edges_in[node]) {
+            size_t from = edge_from[edge];
+            if (from == node) {
+                continue;
+            }
+            int degree = get_degree(from);
+            unfile_node(from, degree);
+            if (!sources.count(from)) {
+                file_node(from, degree - edge_weight[edge]);
+            }
+            auto& related_edges = edges_out[from];
+            related_edges.erase(std::remove(related_edges.begin(), related_edges.end(), edge), related_edges.end());
+        }
+        for (auto& edge : edges_out[node]) {
+            size_t to = edge_to[edge];
+            if (to == node) {
+                continue;
+            }
+            int degree = get_degree(to);
+            unfile_node(to, degree);
+            auto& related_edges = edges_in[to];
+            related_edges.erase(std::remove(related_edges.begin(), related_edges.end(), edge), related_edges.end());
+            if (related_edges.empty()) {
+                sources.insert(to);
+                next = to;
+            } else {
+                file_node(to, degree + edge_weight[edge]);
+            }
+        }
+        edges_in[node].clear();
+        edges_out[node].clear();
+    }
+
+    // Put the nodes in the order we got
+    vector<size_t> position_of(node_count);
+    vector<size_t> node_at(node_count);
+    for (size_t i = 0; i < node_count; i++) {
+        position_of[i] = i;
+        node_at[i] = i;
+    }
+    for (size_t i = 0; i < node_count; i++) {
+        size_t node = sorted_nodes[i];
+        size_t j = position_of[node];
+        if (j != i) {
+            size_t displaced = node_at[i];
+            graph.swap_handles(handles[displaced], handles[node]);
+            node_at[i] = node;
+            node_at[j] = displaced;
+            position_of[node] = i;
+            position_of[displaced] = j;
+        }
+    }
+}
+
 void FlowSort::flow_sort_nodes(list<NodeTraversal>& sorted_nodes, 
         const string& ref_name, bool isGrooming) 
 {
@@ -4,6 +4,8 @@
 #include "vg.pb.h"
 
 namespace vg {
+
+class PackedGraph;
     
 typedef std::map<id_t, std::vector<Edge*>> EdgeMapping;
 static const map<char, char> COMPLEMENTARY_NUCLEOTIDES = {
@@ -34,6 +36,12 @@ public:
      * Fast linear sort
      */
     void fast_linear_sort(const string& ref_name, bool isGrooming = true);
+    /*
+     * Fast linear sort of a packed graph, weighting edges by its embedded
+     * paths as above. Reversing edges are left out, as they are without
+     * grooming, and node IDs are kept.
+     */
+    static void fast_linear_sort(PackedGraph& graph, const string& ref_name);
     
 
     //Structure for holding weighted edges of the graph
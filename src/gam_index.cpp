@@ -0,0 +1,178 @@
+#include "gam_index.hpp"
+#include "stream.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace vg {
+
+using namespace std;
+
+/// First line of a saved index, so we can reject other files
+static const string GAM_INDEX_HEADER = "#vg-gam-index\tv1";
+
+void GAMIndex::add_chunk(int64_t start_offset, int64_t end_offset, const vector<Alignment>& alns) {
+    Chunk chunk;
+    chunk.min_id = numeric_limits<id_t>::max();
+    chunk.max_id = numeric_limits<id_t>::min();
+    chunk.start_offset = start_offset;
+    chunk.end_offset = end_offset;
+
+    for (auto& aln : alns) {
+        for (auto& mapping : aln.path().mapping()) {
+            id_t node_id = mapping.position().node_id();
+            chunk.min_id = min(chunk.min_id, node_id);
+            chunk.max_id = max(chunk.max_id, node_id);
+        }
+    }
+
+    if (chunk.min_id > chunk.max_id) {
+        // Nothing in the chunk is mapped, so no query can want it
+        return;
+    }
+
+    append(chunk);
+}
+
+void GAMIndex::append(const Chunk& chunk) {
+    if (!chunks.empty() && chunk.start_offset < chunks.back().end_offset) {
+        throw runtime_error("[vg::GAMIndex] chunks must be added in file order");
+    }
+
+    chunks.push_back(chunk);
+    prefix_max_ids.push_back(prefix_max_ids.empty() ? chunk.max_id : max(prefix_max_ids.back(), chunk.max_id));
+
+    // In sorted input this loop almost never runs, since min IDs only dip when
+    // a read doubles back to lower IDs
+    suffix_min_ids.push_back(chunk.min_id);
+    for (size_t i = suffix_min_ids.size() - 1; i > 0 && suffix_min_ids[i - 1] > chunk.min_id; i--) {
+        suffix_min_ids[i - 1] = chunk.min_id;
+    }
+}
+
+void GAMIndex::find(istream& sorted_gam, const vector<id_t>& node_ids,
+                    const function<void(const Alignment&)>& iteratee) const {
+
+    // Collapse the IDs into ranges of consecutive IDs
+    vector<id_t> sorted_ids = node_ids;
+    std::sort(sorted_ids.begin(), sorted_ids.end());
+    vector<pair<id_t, id_t>> ranges;
+    for (id_t id : sorted_ids) {
+        if (!ranges.empty() && id <= ranges.back().second + 1) {
+            ranges.back().second = max(ranges.back().second, id);
+        }
+        else {
+            ranges.emplace_back(id, id);
+        }
+    }
+
+    find(sorted_gam, ranges, iteratee);
+}
+
+void GAMIndex::find(istream& sorted_gam, const vector<pair<id_t, id_t>>& ranges,
+                    const function<void(const Alignment&)>& iteratee) const {
+
+    // Sort and merge the ranges so we can binary search them
+    vector<pair<id_t, id_t>> merged;
+    {
+        vector<pair<id_t, id_t>> sorted_ranges = ranges;
+        std::sort(sorted_ranges.begin(), sorted_ranges.end());
+        for (auto& range : sorted_ranges) {
+            if (!merged.empty() && range.first <= merged.back().second + 1) {
+                merged.back().second = max(merged.back().second, range.second);
+            }
+            else {
+                merged.push_back(range);
+            }
+        }
+    }
+
+    // Returns true if the node is in one of the ranges
+    auto in_ranges = [&](id_t node_id) {
+        auto it = upper_bound(merged.begin(), merged.end(), make_pair(node_id, numeric_limits<id_t>::max()));
+        return it != merged.begin() && (--it)->second >= node_id;
+    };
+
+    // Find all the chunks that overlap a range. Only chunks between the first
+    // one that reaches up to the range and the last one that starts at or
+    // below it can overlap it.
+    vector<size_t> wanted;
+    for (auto& range : merged) {
+        size_t first = lower_bound(prefix_max_ids.begin(), prefix_max_ids.end(), range.first) - prefix_max_ids.begin();
+        size_t past_last = upper_bound(suffix_min_ids.begin(), suffix_min_ids.end(), range.second) - suffix_min_ids.begin();
+        for (size_t i = first; i < past_last; i++) {
+            if (chunks[i].min_id <= range.second && chunks[i].max_id >= range.first) {
+                wanted.push_back(i);
+            }
+        }
+    }
+    std::sort(wanted.begin(), wanted.end());
+    wanted.erase(unique(wanted.begin(), wanted.end()), wanted.end());
+
+    function<void(Alignment&)> filter = [&](Alignment& aln) {
+        for (auto& mapping : aln.path().mapping()) {
+            if (in_ranges(mapping.position().node_id())) {
+                iteratee(aln);
+                return;
+            }
+        }
+    };
+
+    // Read runs of adjacent chunks in one go, straight from the GAM
+    for (size_t i = 0; i < wanted.size();) {
+        int64_t start_offset = chunks[wanted[i]].start_offset;
+        int64_t end_offset = chunks[wanted[i]].end_offset;
+        for (i++; i < wanted.size() && chunks[wanted[i]].start_offset == end_offset; i++) {
+            end_offset = chunks[wanted[i]].end_offset;
+        }
+
+        sorted_gam.clear();
+        sorted_gam.seekg(start_offset);
+        if (!sorted_gam) {
+            throw runtime_error("[vg::GAMIndex] could not seek to indexed chunk at offset " + to_string(start_offset)
+                                + "; does the index match the GAM?");
+        }
+        stream::for_each_limited(sorted_gam, end_offset - start_offset, filter);
+    }
+}
+
+void GAMIndex::save(ostream& out) const {
+    out << GAM_INDEX_HEADER << "\n";
+    for (auto& chunk : chunks) {
+        out << chunk.min_id << "\t" << chunk.max_id << "\t"
+            << chunk.start_offset << "\t" << chunk.end_offset << "\n";
+    }
+    if (!out) {
+        throw runtime_error("[vg::GAMIndex] could not write index");
+    }
+}
+
+void GAMIndex::load(istream& in) {
+    chunks.clear();
+    prefix_max_ids.clear();
+    suffix_min_ids.clear();
+
+    string line;
+    if (!getline(in, line) || line != GAM_INDEX_HEADER) {
+        throw runtime_error("[vg::GAMIndex] input is not a GAM index");
+    }
+    while (getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        Chunk chunk;
+        stringstream fields(line);
+        if (!(fields >> chunk.min_id >> chunk.max_id >> chunk.start_offset >> chunk.end_offset)) {
+            throw runtime_error("[vg::GAMIndex] malformed index line: " + line);
+        }
+        append(chunk);
+    }
+}
+
+size_t GAMIndex::chunk_count() const {
+    return chunks.size();
+}
+
+}
@@ -0,0 +1,88 @@
+#ifndef VG_GAM_INDEX_HPP_INCLUDED
+#define VG_GAM_INDEX_HPP_INCLUDED
+
+/**
+ * \file gam_index.hpp
+ * A lightweight sidecar index for position-sorted GAM files, as written by
+ * vg gamsort, that lets queries by node ID read only the parts of the file
+ * that can contain matching alignments.
+ */
+
+#include <iostream>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "vg.pb.h"
+#include "types.hpp"
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * Maps ranges of node IDs to the byte offsets of the compressed chunks of a
+ * sorted GAM file that contain alignments visiting them. Each chunk of the
+ * stream format is an independent gzip member, so reading can start at any
+ * chunk boundary.
+ *
+ * The index is saved as text, with one line per chunk giving the lowest and
+ * highest node IDs visited by any alignment in the chunk and the chunk's byte
+ * range in the GAM file.
+ */
+class GAMIndex {
+public:
+
+    /// Record a chunk of the GAM file occupying the given bytes, holding the
+    /// given alignments. Chunks must be added in file order, and chunks
+    /// holding only unmapped alignments are not recorded.
+    void add_chunk(int64_t start_offset, int64_t end_offset, const vector<Alignment>& alns);
+
+    /// Call the iteratee with every alignment in the sorted GAM that visits at
+    /// least one of the given node IDs. Each alignment is produced once, in
+    /// file order.
+    void find(istream& sorted_gam, const vector<id_t>& node_ids,
+              const function<void(const Alignment&)>& iteratee) const;
+
+    /// Call the iteratee with every alignment in the sorted GAM that visits
+    /// at least one node in one of the given inclusive node ID ranges.
+    void find(istream& sorted_gam, const vector<pair<id_t, id_t>>& ranges,
+              const function<void(const Alignment&)>& iteratee) const;
+
+    /// Write the index to a stream
+    void save(ostream& out) const;
+
+    /// Replace the contents of the index with those read from a stream
+    void load(istream& in);
+
+    /// Number of chunks in the index
+    size_t chunk_count() const;
+
+private:
+
+    /// A compressed chunk of the GAM file
+    struct Chunk {
+        id_t min_id;
+        id_t max_id;
+        int64_t start_offset;
+        int64_t end_offset;
+    };
+
+    /// Add a chunk to the end of the index and update the running bounds
+    void append(const Chunk& chunk);
+
+    /// Chunks in file order. Alignments are sorted by the lower of their end
+    /// positions, so min_id mostly increases but may dip when a read doubles
+    /// back to lower IDs.
+    vector<Chunk> chunks;
+
+    /// The largest max_id among this and all earlier chunks
+    vector<id_t> prefix_max_ids;
+
+    /// The smallest min_id among this and all later chunks
+    vector<id_t> suffix_min_ids;
+};
+
+}
+
+#endif
@@ -1,4 +1,9 @@
 #include "gamsorter.hpp"
+#include "utility.hpp"
+#include <omp.h>
+#include <cstdio>
+#include <memory>
+#include <limits>
 /*
 *  GAMSorter: sort a gam by position and offset
 *  dumbly store unmapped reads at the end.
@@ -7,440 +12,372 @@
 using namespace std;
 using namespace vg;
 
+/// Alignments count against the memory budget as this many times their
+/// serialized size, to account for the overhead of holding them as objects
+static const size_t IN_MEMORY_EXPANSION = 4;
+
+/// The most runs that are merged at once. Beyond this, runs are merged in
+/// more than one pass to keep the number of open files down.
+static const size_t MAX_MERGE_FAN_IN = 128;
+
+/// How many alignments to buffer before writing them to the output. Each
+/// buffer becomes one compressed chunk, which is the unit a GAMIndex can seek
+/// to.
+static const size_t OUTPUT_BUFFER_SIZE = 1000;
+
+/**
+ * Writes sorted alignments to a GAM stream in chunks of OUTPUT_BUFFER_SIZE,
+ * recording each chunk in an index if there is one. Output streams like
+ * standard output can't tell us where we are, so we count the bytes ourselves.
+ */
+class SortedOutput
+{
+  public:
+    SortedOutput(ostream& out, GAMIndex* index) : out(out), index(index)
+    {
+        buffer.reserve(OUTPUT_BUFFER_SIZE);
+    }
 
-class AlnSorter{
-    bool invert = false;
-public:
-  bool mycomparison(const bool& reverse=false)
-  {invert = reverse;}
-  bool operator() (const Alignment& a_one, const Alignment& a_two) const
-  {
-
-        // Unmapped case
-        int xf_size = a_one.path().mapping_size();
-        int xb_size = a_two.path().mapping_size();
-        
-        if (xf_size == 0 || xb_size == 0){
-            bool both_zero = (xf_size == xb_size);
-            if (both_zero){
-                return false;
-            }
-            else{
-                return (xf_size > xb_size) ? false : true;
-            }
-        }
-
-        Position x_front = a_one.path().mapping(0).position();
-        Position x_back = a_one.path().mapping(a_one.path().mapping_size() - 1).position();
-
-        Position lhs;
-        Position rhs;
-        if (x_front.node_id() < x_back.node_id())
-        {
-            lhs = x_front;
-        }
-        else
-        {
-            lhs = x_back;
-        }
-        Position y_front = a_two.path().mapping(0).position();
-        Position y_back = a_two.path().mapping(a_two.path().mapping_size() - 1).position();
-        if (y_front.node_id() < y_back.node_id())
-        {
-            rhs = y_front;
-        }
-        else
+    void push(Alignment&& aln)
+    {
+        buffer.emplace_back(std::move(aln));
+        if (buffer.size() >= OUTPUT_BUFFER_SIZE)
         {
-            rhs = y_back;
+            flush();
         }
+    }
 
-        if (lhs.node_id() == rhs.node_id())
+    /// Write out anything buffered. Must be called at the end.
+    void flush()
+    {
+        if (index == nullptr)
         {
-            return lhs.offset() < rhs.offset();
+            stream::write_buffered(out, buffer, 0);
+            return;
         }
-        else
+        if (buffer.empty())
         {
-            return lhs.node_id() < rhs.node_id();
+            return;
         }
-  }
-};
 
+        stringstream chunk;
+        stream::write_objects<Alignment>(chunk, buffer.size(), [&](uint64_t n) -> const Alignment& {
+            return buffer[n];
+        });
+        string chunk_data = chunk.str();
+        index->add_chunk(bytes_written, bytes_written + chunk_data.size(), buffer);
+        out.write(chunk_data.data(), chunk_data.size());
+        bytes_written += chunk_data.size();
+        buffer.clear();
+    }
+
+  private:
+    ostream& out;
+    GAMIndex* index;
+    vector<Alignment> buffer;
+    int64_t bytes_written = 0;
+};
 
-struct custom_pos_sort_key
+/// Write sorted alignments to the output, consuming them
+static void write_sorted(vector<Alignment>& alns, ostream& out, GAMIndex* index)
 {
-    bool operator()(const Position lhs, const Position rhs)
+    SortedOutput output(out, index);
+    for (auto& aln : alns)
     {
-        if (lhs.node_id() == rhs.node_id())
-        {
-            return lhs.offset() < rhs.offset();
-        }
-        else
-        {
-            return lhs.node_id() < rhs.node_id();
-        }
+        output.push(std::move(aln));
     }
-} possortkey;
+    output.flush();
+    alns.clear();
+}
 
-struct custom_aln_sort_key
+/// Sort the items using all threads, by sorting chunks and merging them pairwise
+template<typename T>
+static void parallel_sort(vector<T>& items)
 {
-    bool operator()(const Alignment a_one, const Alignment a_two)
+    size_t num_chunks = omp_get_max_threads();
+    if (num_chunks <= 1 || items.size() < 16 * 1024)
     {
-        int xf_size = a_one.path().mapping_size();
-        int xb_size = a_two.path().mapping_size();
-        
-        if (xf_size == 0 || xb_size == 0){
-            bool both_zero = (xf_size == xb_size);
-            if (both_zero){
-                return false;
-            }
-            else{
-                return (xf_size > xb_size) ? false : true;
-            }
-        }
-        Position x_front = a_one.path().mapping(0).position();
-        Position x_back = a_one.path().mapping(a_one.path().mapping_size() - 1).position();
+        std::sort(items.begin(), items.end());
+        return;
+    }
 
-        Position lhs;
-        Position rhs;
-        if (x_front.node_id() < x_back.node_id())
-        {
-            lhs = x_front;
-        }
-        else
-        {
-            lhs = x_back;
-        }
-        Position y_front = a_two.path().mapping(0).position();
-        Position y_back = a_two.path().mapping(a_two.path().mapping_size() - 1).position();
-        if (y_front.node_id() < y_back.node_id())
-        {
-            rhs = y_front;
-        }
-        else
-        {
-            rhs = y_back;
-        }
+    vector<size_t> bounds(num_chunks + 1);
+    for (size_t i = 0; i <= num_chunks; i++)
+    {
+        bounds[i] = items.size() * i / num_chunks;
+    }
 
-        if (lhs.node_id() == rhs.node_id())
-        {
-            return lhs.offset() < rhs.offset();
-        }
-        else
+#pragma omp parallel for
+    for (size_t i = 0; i < num_chunks; i++)
+    {
+        std::sort(items.begin() + bounds[i], items.begin() + bounds[i + 1]);
+    }
+
+    for (size_t width = 1; width < num_chunks; width *= 2)
+    {
+#pragma omp parallel for
+        for (size_t i = 0; i < num_chunks; i += 2 * width)
         {
-            return lhs.node_id() < rhs.node_id();
+            if (i + width < num_chunks)
+            {
+                std::inplace_merge(items.begin() + bounds[i], items.begin() + bounds[i + width],
+                                   items.begin() + bounds[min(i + 2 * width, num_chunks)]);
+            }
         }
     }
-} alnsortkey;
+}
 
-void GAMSorter::sort(vector<Alignment> &alns)
+GAMSorter::GAMSorter(size_t max_buffer_bytes, const string& temp_dir, bool show_progress) :
+    max_buffer_bytes(max_buffer_bytes),
+    temp_dir(temp_dir.empty() ? find_temp_dir() : temp_dir),
+    show_progress(show_progress)
 {
-    std::sort(alns.begin(), alns.end(), alnsortkey);
+    // Nothing to do
 }
 
-void GAMSorter::paired_sort(string gamfile)
+GAMSorter::sort_key_t GAMSorter::unit_sort_key(const Alignment* unit, size_t unit_size) const
 {
-
-    std::unordered_map<string, Alignment> pair_seconds;
-    vector<Alignment> firsts;
-    firsts.reserve(100000);
-    std::function<void(Alignment &, Alignment &)> sort_the_gam = [&](Alignment &alpha, Alignment &beta) {
-        bool first_min = min_aln_first(alpha, beta);
-        if (!alpha.fragment_next().name().empty())
-        {
-            if (first_min)
-            {
-                firsts.push_back(alpha);
-                pair_seconds[beta.name()] = beta;
-            }
-            else
-            {
-                firsts.push_back(beta);
-                pair_seconds[alpha.name()] = alpha;
-            }
-        }
-        else
+    // Unmapped reads sort after everything
+    sort_key_t key(numeric_limits<int64_t>::max(), numeric_limits<int64_t>::max());
+    for (size_t i = 0; i < unit_size; i++)
+    {
+        if (unit[i].path().mapping_size() != 0)
         {
-            firsts.push_back(alpha);
+            Position min_pos = get_min_position(unit[i]);
+            key = min(key, sort_key_t(min_pos.node_id(), min_pos.offset()));
         }
-
-    };
-
-    ifstream gammy;
-    gammy.open(gamfile);
-    stream::for_each_interleaved_pair_parallel(gammy, sort_the_gam);
-
-    sort(firsts);
-    vector<Alignment> ret;
-    for (auto x : firsts)
-    {
-        // write first read.
-        ret.push_back(x);
-        // grab second read and write it.
-        if (!x.fragment_next().name().empty())
-            ret.push_back(pair_seconds[x.fragment_next().name()]);
     }
+    return key;
 }
 
-void GAMSorter::write_temp(vector<Alignment>& alns)
+void GAMSorter::sort(vector<Alignment>& alns) const
 {
-    string t_name = "tmp_sort_" + std::to_string(tmp_filenames.size());
-    tmp_filenames.push_back(t_name);
-    ofstream t_file;
-    t_file.open(t_name);
-    stream::write_buffered(t_file, alns, 0);
-    t_file.close();
+    sort_units(alns, 1);
 }
 
-void GAMSorter::dumb_sort(string gamfile)
+void GAMSorter::sort_units(vector<Alignment>& alns, size_t unit_size) const
 {
-    std::vector<Alignment> buf;
-    buf.reserve(1000000);
-
-    std::function<void(Alignment&)> presort = [&](Alignment &aln) {
-        buf.push_back(aln);
-    };
-    ifstream gammy;
-    gammy.open(gamfile);
-    stream::for_each(gammy, presort);
+    if (alns.size() % unit_size != 0)
+    {
+        throw runtime_error("[vg::GAMSorter] paired input has an unpaired alignment");
+    }
+    size_t num_units = alns.size() / unit_size;
 
-    std::sort(buf.begin(), buf.end(), alnsortkey);
+    // Sort the keys along with the units' input order, which breaks ties
+    vector<pair<sort_key_t, size_t>> order(num_units);
+#pragma omp parallel for
+    for (size_t i = 0; i < num_units; i++)
+    {
+        order[i] = make_pair(unit_sort_key(&alns[i * unit_size], unit_size), i);
+    }
+    parallel_sort(order);
 
-    std::function<void(uint64_t)> x_buf_func = [&](uint64_t) {
+    vector<Alignment> sorted;
+    sorted.reserve(alns.size());
+    for (auto& entry : order)
+    {
+        for (size_t j = 0; j < unit_size; j++)
+        {
+            sorted.emplace_back(std::move(alns[entry.second * unit_size + j]));
+        }
+    }
+    alns = std::move(sorted);
+}
 
-    };
+void GAMSorter::write_run(vector<Alignment>& alns, size_t unit_size, vector<string>& run_names) const
+{
+    sort_units(alns, unit_size);
 
-    ofstream outfi;
-    outfi.open(gamfile + ".sorted.gam");
-    stream::write_buffered(outfi, buf, buf.size());
+    run_names.push_back(tmpfilename(temp_dir + "/vg-gamsort-run"));
+    ofstream run_file(run_names.back());
+    if (!run_file)
+    {
+        throw runtime_error("[vg::GAMSorter] could not write temporary file " + run_names.back());
+    }
+    if (show_progress)
+    {
+        cerr << "[vg::GAMSorter] writing run " << run_names.size() << " of " << alns.size() << " alignments" << endl;
+    }
+    // The stream format compresses the run
+    stream::write_buffered(run_file, alns, 0);
+    alns.clear();
 }
 
-void GAMSorter::stream_sort(string gamfile){
-
-    std::vector<Alignment> buffer;
-    buffer.reserve(1000);
-    std::function<void(Alignment&)> firstpass_bufsort = [&](Alignment& a){
-        #pragma omp critical
-        buffer.push_back(a);
-        if (buffer.size() == max_buf_size){
-                sort(buffer);
-                write_temp(buffer);
-                buffer.clear();
+void GAMSorter::merge_runs(const vector<string>& run_names, ostream& out, size_t unit_size,
+                           GAMIndex* index) const
+{
+    // The next unit from each run, and where it's coming from
+    vector<unique_ptr<ifstream>> run_files;
+    vector<unique_ptr<stream::ProtobufIterator<Alignment>>> run_iters;
+    vector<vector<Alignment>> run_units(run_names.size(), vector<Alignment>(unit_size));
+
+    // Pull the next unit from a run into run_units, or return false if the run is done
+    auto advance = [&](size_t run) {
+        auto& iter = *run_iters[run];
+        for (size_t j = 0; j < unit_size; j++)
+        {
+            if (!iter.has_next())
+            {
+                if (j != 0)
+                {
+                    throw runtime_error("[vg::GAMSorter] temporary run ended in the middle of a pair");
+                }
+                return false;
+            }
+            run_units[run][j] = iter.take();
+            iter.get_next();
         }
+        return true;
     };
 
-    
-
-
-    ifstream gammy;
-    gammy.open(gamfile);
-    stream::for_each(gammy, firstpass_bufsort);
+    // Min-heap of the next unit from each run, with ties going to the run
+    // with earlier input
+    typedef pair<sort_key_t, size_t> heap_entry_t;
+    priority_queue<heap_entry_t, vector<heap_entry_t>, greater<heap_entry_t>> heap;
 
-    sort(buffer);
-    write_temp(buffer);
-    buffer.clear();
-
-
-
-   
-    int num_valid = tmp_filenames.size();
-    vector<bool> still_valid(tmp_filenames.size());
-    vector<uint64_t> curr_file_count (tmp_filenames.size());
-    typedef priority_queue<Alignment,std::vector<Alignment>, AlnSorter> AlnHeap;
-    
-
-    for (int i = 0; i < tmp_filenames.size(); ++i){
-        ifstream tfile;
-        tfile.open(tmp_filenames[i]);
-        tmp_files.emplace_back(&tfile);
+    for (size_t i = 0; i < run_names.size(); i++)
+    {
+        run_files.emplace_back(new ifstream(run_names[i]));
+        if (!*run_files.back())
+        {
+            throw runtime_error("[vg::GAMSorter] could not read temporary file " + run_names[i]);
+        }
+        run_iters.emplace_back(new stream::ProtobufIterator<Alignment>(*run_files.back()));
+        if (advance(i))
+        {
+            heap.emplace(unit_sort_key(run_units[i].data(), unit_size), i);
+        }
     }
 
+    SortedOutput output(out, index);
+    while (!heap.empty())
+    {
+        size_t run = heap.top().second;
+        heap.pop();
+        for (auto& aln : run_units[run])
+        {
+            output.push(std::move(aln));
+        }
 
-    
+        // Refill from the run we just took from
+        if (advance(run))
+        {
+            heap.emplace(unit_sort_key(run_units[run].data(), unit_size), run);
+        }
+    }
+    output.flush();
 
-    vector<::google::protobuf::io::CodedInputStream*> protostreams;
-    vector<::google::protobuf::io::GzipInputStream*> zipstreams;
+    run_iters.clear();
+    run_files.clear();
+    for (auto& run_name : run_names)
+    {
+        std::remove(run_name.c_str());
+    }
+}
 
-    for (auto x : tmp_files){
-        ::google::protobuf::io::ZeroCopyInputStream *raw_in =
-          new ::google::protobuf::io::IstreamInputStream(x);
-        ::google::protobuf::io::GzipInputStream *gzip_in =
-          new ::google::protobuf::io::GzipInputStream(raw_in);
-        ::google::protobuf::io::CodedInputStream *pstream =
-          new ::google::protobuf::io::CodedInputStream(gzip_in);
+void GAMSorter::stream_sort(istream& gam_in, ostream& gam_out, bool paired, GAMIndex* index)
+{
+    size_t unit_size = paired ? 2 : 1;
 
-        protostreams.push_back(pstream);
-        zipstreams.push_back(gzip_in);
-    }
+    vector<string> run_names;
+    vector<Alignment> buffer;
+    size_t buffer_bytes = 0;
 
-    std::function<bool(int)> handle_count_line = [&](int tmp_index){
-        uint64_t count;
-        protostreams[tmp_index]->ReadVarint64((::google::protobuf::uint64*) &count);
-        curr_file_count[tmp_index] = count;
-        cerr << std::to_string(count) << endl;
-        if (!count){
-            return false;
+    function<void(Alignment&)> buffer_alignment = [&](Alignment& aln) {
+        buffer_bytes += aln.ByteSizeLong() * IN_MEMORY_EXPANSION + sizeof(Alignment);
+        buffer.emplace_back(std::move(aln));
+        // Only cut runs between pairs
+        if (buffer_bytes >= max_buffer_bytes && buffer.size() % unit_size == 0)
+        {
+            write_run(buffer, unit_size, run_names);
+            buffer_bytes = 0;
         }
-        return true;
     };
+    stream::for_each(gam_in, buffer_alignment);
 
-    for (int i = 0; i < protostreams.size(); i++){
-        handle_count_line(i);
+    if (run_names.empty())
+    {
+        // Everything fit in memory
+        sort_units(buffer, unit_size);
+        write_sorted(buffer, gam_out, index);
+        return;
     }
-
-    
-    
-    std::function<bool(int, Alignment&)> read_dat_buf = [&](int tmp_index, Alignment& ret){
-
-        // Read our message of size count.
-        std::string s;
-        //for (uint64_t i = 0; i < count; ++i) {
-            (curr_file_count[tmp_index])--;
-            if (curr_file_count[tmp_index] <= 0){
-                return handle_count_line(tmp_index);
-            }
-            uint32_t msgSize = 0;
-            delete (protostreams[tmp_index]);
-            (protostreams[tmp_index]) = new ::google::protobuf::io::CodedInputStream( (zipstreams[tmp_index]));
-            // the messages are prefixed by their size
-            (protostreams[tmp_index])->ReadVarint32(&msgSize);
-            if ((msgSize > 0) &&
-                (protostreams[tmp_index]->ReadString(&s, msgSize))) {
-                ret.ParseFromString(s);
-                return true;
-            }
-        //}
-     };
-
-
-    // Heap of size (tmp_files.size())
-    AlnHeap lil_heap;
-    for(int i = 0; i < tmp_files.size(); i++){
-        Alignment a;
-        read_dat_buf(i, a);
-        lil_heap.push( a );
+    if (!buffer.empty())
+    {
+        write_run(buffer, unit_size, run_names);
     }
+    buffer.shrink_to_fit();
 
-    
-    // Rotating index within the tmp_files array,
-    // for accessing the ifstream and associated Proto readers/writers
-    int tmp_file_index = 0;
-
-    // This is just an output buffer.
-    vector<Alignment> sorted_out_buf;
-    sorted_out_buf.reserve(1000);
-
-    // Our output stream
-    string outname = gamfile + ".sorted.gam";
-    ofstream ofile;
-    ofile.open(outname);
-
-    cerr << "in the loop" << endl;
-
-    while(!lil_heap.empty()){
-
-        Alignment a;
-        bool valid = read_dat_buf(tmp_file_index, a);
-        if (valid){
-            lil_heap.push(a);
-        }
-        else{
-            //handle_count_line(tmp_file_index);
+    // Merge in rounds, each of which merges every group of consecutive runs
+    // into one, so each alignment is rewritten once per round. Groups stay in
+    // input order so ties still resolve in input order.
+    while (run_names.size() > MAX_MERGE_FAN_IN)
+    {
+        vector<string> merged_names;
+        for (size_t i = 0; i < run_names.size(); i += MAX_MERGE_FAN_IN)
+        {
+            vector<string> to_merge(run_names.begin() + i,
+                                    run_names.begin() + min(i + MAX_MERGE_FAN_IN, run_names.size()));
+            if (to_merge.size() == 1)
+            {
+                // Nothing to merge this run with
+                merged_names.push_back(to_merge.front());
+                continue;
+            }
+            merged_names.push_back(tmpfilename(temp_dir + "/vg-gamsort-run"));
+            ofstream merged_file(merged_names.back());
+            merge_runs(to_merge, merged_file, unit_size);
         }
-        
-
-        
-        sorted_out_buf.push_back(lil_heap.top());
-        cerr << "writing " << lil_heap.top().name() << endl;
-        if (sorted_out_buf.size() % 100 == 0){
-            cerr << "Done " << sorted_out_buf.size() << " records" << endl;
+        if (show_progress)
+        {
+            cerr << "[vg::GAMSorter] merged " << run_names.size() << " runs into " << merged_names.size() << endl;
         }
-        lil_heap.pop();
-        stream::write_buffered(ofile, sorted_out_buf, 1000);
-        tmp_file_index = (tmp_file_index + 1) % tmp_files.size();
-
+        run_names = std::move(merged_names);
     }
-    cerr << "out the loop" << endl;
-
-    // write any remaining records in our buffer
-    stream::write_buffered(ofile, sorted_out_buf, 0);
 
+    merge_runs(run_names, gam_out, unit_size, index);
 }
 
-void GAMSorter::write_index(string gamfile, string outfile, bool isSorted)
+void GAMSorter::dumb_sort(istream& gam_in, ostream& gam_out, bool paired, GAMIndex* index)
 {
-
-    map<int64_t, vector<string>> node_to_alns;
-
-    std::function<void(Alignment &)> node_grabber = [&](Alignment &aln) {
-        vector<int64_t> ret;
-        Path p = aln.path();
-        for (int i = 0; i < p.mapping_size(); i++)
-        {
-            Mapping m = p.mapping(i);
-            ret.push_back(m.position().node_id());
-        }
-        for (auto x : ret)
-        {
-            node_to_alns[x].push_back(aln.name());
-        }
+    vector<Alignment> buffer;
+    function<void(Alignment&)> buffer_alignment = [&](Alignment& aln) {
+        buffer.emplace_back(std::move(aln));
     };
+    stream::for_each(gam_in, buffer_alignment);
+
+    sort_units(buffer, paired ? 2 : 1);
+    write_sorted(buffer, gam_out, index);
 }
 
-bool GAMSorter::min_aln_first(Alignment &a, Alignment &b)
+bool GAMSorter::min_aln_first(const Alignment& a, const Alignment& b) const
 {
-
-    if (less_than(get_min_position(a), get_min_position(b)))
-    {
-        return true;
-    }
-    else
-    {
-        return false;
-    }
+    return less_than(get_min_position(a), get_min_position(b));
 }
 
-Position GAMSorter::get_min_position(Alignment a)
+Position GAMSorter::get_min_position(const Alignment& a) const
 {
     return get_min_position(a.path());
 }
 
-Position GAMSorter::get_min_position(Path pat)
+Position GAMSorter::get_min_position(const Path& pat) const
 {
-    Position p = pat.mapping(0).position();
-    Position p_prime = pat.mapping(pat.mapping_size() - 1).position();
+    const Position& p = pat.mapping(0).position();
+    const Position& p_prime = pat.mapping(pat.mapping_size() - 1).position();
     return less_than(p, p_prime) ? p : p_prime;
 }
 
-bool GAMSorter::equal_to(Position a, Position b)
+bool GAMSorter::equal_to(const Position& a, const Position& b) const
 {
-    if (a.node_id() == b.node_id() &&
-        a.offset() == b.offset())
-    {
-        return true;
-    }
-    return false;
+    return a.node_id() == b.node_id() && a.offset() == b.offset();
 }
 
-bool GAMSorter::less_than(Position a, Position b)
+bool GAMSorter::less_than(const Position& a, const Position& b) const
 {
-    if (a.node_id() > b.node_id())
-    {
-        return false;
-    }
-    else
-    {
-        return (a.node_id() == b.node_id()) ? (a.offset() < b.offset()) : true;
-    }
+    return (a.node_id() == b.node_id()) ? (a.offset() < b.offset()) : (a.node_id() < b.node_id());
 }
 
-bool GAMSorter::greater_than(Position a, Position b)
+bool GAMSorter::greater_than(const Position& a, const Position& b) const
 {
-    if (a.node_id() < b.node_id())
-    {
-        return false;
-    }
-    else
-    {
-        return (a.node_id() == b.node_id()) ? (a.offset() > b.offset()) : true;
-    }
+    return (a.node_id() == b.node_id()) ? (a.offset() > b.offset()) : (a.node_id() > b.node_id());
 }
@@ -3,6 +3,7 @@
 
 #include "vg.pb.h"
 #include "stream.hpp"
+#include "gam_index.hpp"
 #include <string>
 #include <queue>
 #include <sstream>
@@ -14,72 +15,84 @@
 #include <unordered_map>
 #include <tuple>
 
-#include "google/protobuf/stubs/common.h"
-#include "google/protobuf/io/zero_copy_stream.h"
-#include "google/protobuf/io/zero_copy_stream_impl.h"
-#include "google/protobuf/io/gzip_stream.h"
-#include "google/protobuf/io/coded_stream.h"
-
 /**
- Gam sort
-*/
+ * \file gamsorter.hpp
+ * Sorting of GAM files by graph position, in memory or as an external merge
+ * sort that keeps its memory use bounded.
+ */
 using namespace std;
 namespace vg
 {
 
-
-
+/**
+ * Sorts alignments by the lowest (node ID, offset) position at either end of
+ * their paths, with unmapped reads at the end.
+ *
+ * In paired mode the input must be interleaved pairs. Each pair is kept
+ * together, in its original mate order, and sorts by the lower of its two
+ * mates. If one mate is unmapped, the pair sorts by the other one. Pairs with
+ * two unmapped mates come at the end.
+ *
+ * Reads or pairs that sort at the same position keep their input order.
+ */
 class GAMSorter
 {
-
-  
   public:
-    // vector<Alignment> merge(vector<vector<Alignment>> a);
 
-    // void merge(map<int, vector<Alignment>> m, map<int, int> split_to_sz);
+    /// Make a sorter that keeps approximately max_buffer_bytes of alignments
+    /// in memory at once. Sorted runs are written to compressed temporary
+    /// files in temp_dir, or in the system temporary directory if it is empty.
+    GAMSorter(size_t max_buffer_bytes = 1024 * 1024 * 1024, const string& temp_dir = "",
+              bool show_progress = false);
 
-    void sort(vector<Alignment>& alns);
+    /// Sort alignments in memory.
+    void sort(vector<Alignment>& alns) const;
 
-    void paired_sort(string gamfile);
+    /// Sort a GAM stream with an external merge sort. Batches of alignments
+    /// up to the memory budget are sorted in parallel and written to
+    /// temporary runs, which are then merged into the output stream. If an
+    /// index is given, each chunk of the output is recorded in it, with
+    /// offsets relative to where the output starts.
+    void stream_sort(istream& gam_in, ostream& gam_out, bool paired = false, GAMIndex* index = nullptr);
 
-    void write_temp(vector<Alignment>& alns);
+    /// Sort a GAM stream by loading it all into memory. This is faster for
+    /// small GAMs.
+    void dumb_sort(istream& gam_in, ostream& gam_out, bool paired = false, GAMIndex* index = nullptr);
 
-    void stream_sort(string gamfile);
+    bool min_aln_first(const Alignment& a, const Alignment& b) const;
 
-    void dumb_sort(string gamfile);
+    Position get_min_position(const Alignment& a) const;
 
-    // vector<Alignment> split(vector<Alignment> a, int s);
+    Position get_min_position(const Path& p) const;
 
-    bool min_aln_first(Alignment& a, Alignment& b);
+    bool equal_to(const Position& a, const Position& b) const;
 
-    Position get_min_position(Alignment a);
+    bool less_than(const Position& a, const Position& b) const;
 
-    Position get_min_position(Path p);
+    bool greater_than(const Position& a, const Position& b) const;
 
-    void write_index(string gamfile, string outfile, bool isSorted = false);
+  private:
 
-    bool equal_to(Position a, Position b);
+    /// The (node ID, offset) position that an alignment or pair sorts at
+    typedef pair<int64_t, int64_t> sort_key_t;
 
-    bool less_than(Position a, Position b);
+    /// Get the sort key of the unit_size alignments starting at the given one
+    sort_key_t unit_sort_key(const Alignment* unit, size_t unit_size) const;
 
-    bool greater_than(Position a, Position b);
+    /// Sort units of unit_size consecutive alignments, using all threads
+    void sort_units(vector<Alignment>& alns, size_t unit_size) const;
 
-  private:
-    map<int, int> split_to_split_size;
-    vector<string> tmp_filenames;
-    vector<ifstream*> tmp_files;
-    int max_buf_size = 20000;
-    /**
-    * We want to keep pairs together, with the lowest-coordinate pair coming first.
-    * If one read is unmapped, it follows its partner in the sorted GAM file.
-    * Pairs with two unmapped reads are considered the highest-mapped in the graph, i.e.
-    * they come at the end of a sorted GAM file.
-
-    * Since we can't hash alignments, we store both mates in the unordered map by name.
-    */
-    unordered_map<string, Alignment> pairs;
-    unordered_map<string, pair<Alignment, Alignment> > paired_pairs;
-   
+    /// Sort the buffered alignments and write them to a new temporary run
+    void write_run(vector<Alignment>& alns, size_t unit_size, vector<string>& run_names) const;
+
+    /// Merge sorted runs into the output stream, deleting the run files, and
+    /// index the output if an index is given
+    void merge_runs(const vector<string>& run_names, ostream& out, size_t unit_size,
+                    GAMIndex* index = nullptr) const;
+
+    size_t max_buffer_bytes;
+    string temp_dir;
+    bool show_progress;
 };
 }
 #endif
@@ -325,26 +325,11 @@ int32_t BaseAligner::score_gap(size_t gap_length) {
     return gap_length ? -gap_open - (gap_length - 1) * gap_extension : 0;
 }
 
-double BaseAligner::maximum_mapping_quality_exact(vector<double>& scaled_scores, size_t* max_idx_out) {
-    
-    // if necessary, assume a null alignment of 0.0 for comparison since this is local
-    if (scaled_scores.size() == 1) {
-        scaled_scores.push_back(0.0);
-    }
-    
-    // work in log transformed values to avoid risk of overflow
-    double log_sum_exp = numeric_limits<double>::lowest();
-    double max_score = numeric_limits<double>::lowest();
-    // go in reverse order because this has fewer numerical problems when the scores are sorted (as usual)
-    for (int64_t i = scaled_scores.size() - 1; i >= 0; i--) {
-        log_sum_exp = add_log(log_sum_exp, scaled_scores[i]);
-        if (scaled_scores[i] > max_score) {
-            *max_idx_out = i;
-            max_score = scaled_scores[i];
-        }
-    }
-    double direct_mapq = -quality_scale_factor * subtract_log(0.0, max_score - log_sum_exp);
-    return std::isinf(direct_mapq) ? (double) numeric_limits<int32_t>::max() : direct_mapq;
+double BaseAligner::maximum_mapping_quality_exact(const ScaledScores& scaled_scores, size_t* max_idx_out) {
+    double direct_mapq = quality_scale_factor * max_score_error_neg_log(scaled_scores.data(), scaled_scores.size(),
+                                                                        max_idx_out, fast_exp_mapping_quality);
+    return (std::isinf(direct_mapq) || direct_mapq > numeric_limits<int32_t>::max()) ?
+           (double) numeric_limits<int32_t>::max() : direct_mapq;
 }
 
 // TODO: this algorithm has numerical problems that would be difficult to solve without increasing the
@@ -382,69 +367,13 @@ double BaseAligner::maximum_mapping_quality_exact(vector<double>& scaled_scores,
 //    return mapping_qualities;
 //}
 
-double BaseAligner::maximum_mapping_quality_approx(vector<double>& scaled_scores, size_t* max_idx_out) {
-    
-    // if necessary, assume a null alignment of 0.0 for comparison since this is local
-    if (scaled_scores.size() == 1) {
-        scaled_scores.push_back(0.0);
-    }
-    
-    double max_score = scaled_scores[0];
-    size_t max_idx = 0;
-    
-    double next_score = std::numeric_limits<double>::lowest();
-    int32_t next_count = 0;
-    
-    for (int32_t i = 1; i < scaled_scores.size(); ++i) {
-        double score = scaled_scores[i];
-        if (score > max_score) {
-            if (next_score == max_score) {
-                next_count++;
-            }
-            else {
-                next_score = max_score;
-                next_count = 1;
-            }
-            max_score = score;
-            max_idx = i;
-        }
-        else if (score > next_score) {
-            next_score = score;
-            next_count = 1;
-        }
-        else if (score == next_score) {
-            next_count++;
-        }
-    }
-    
-    *max_idx_out = max_idx;
-
-    return max(0.0, quality_scale_factor * (max_score - next_score - (next_count > 1 ? log(next_count) : 0.0)));
+double BaseAligner::maximum_mapping_quality_approx(const ScaledScores& scaled_scores, size_t* max_idx_out) {
+    return quality_scale_factor * max_score_error_neg_log_approx(scaled_scores.data(), scaled_scores.size(), max_idx_out);
 }
 
-double BaseAligner::group_mapping_quality_exact(vector<double>& scaled_scores, vector<size_t>& group) {
-    
-    // if necessary, assume a null alignment of 0.0 for comparison since this is local
-    if (scaled_scores.size() == 1) {
-        scaled_scores.push_back(0.0);
-    }
-    
-    // work in log transformed values to avoid risk of overflow
-    double total_log_sum_exp = numeric_limits<double>::lowest();
-    double non_group_log_sum_exp = numeric_limits<double>::lowest();
-    
-    // go in reverse order because this has fewer numerical problems when the scores are sorted (as usual)
-    int64_t group_idx = group.size() - 1;
-    for (int64_t i = scaled_scores.size() - 1; i >= 0; i--) {
-        total_log_sum_exp = add_log(total_log_sum_exp, scaled_scores[i]);
-        if (group_idx >= 0 ? i == group[group_idx] : false) {
-            group_idx--;
-        }
-        else {
-            non_group_log_sum_exp = add_log(non_group_log_sum_exp, scaled_scores[i]);
-        }
-    }
-    double direct_mapq = quality_scale_factor * (total_log_sum_exp - non_group_log_sum_exp);
+double BaseAligner::group_mapping_quality_exact(const ScaledScores& scaled_scores, const vector<size_t>& group) {
+    double direct_mapq = quality_scale_factor * group_error_neg_log(scaled_scores.data(), scaled_scores.size(),
+                                                                    group, fast_exp_mapping_quality);
     return (std::isinf(direct_mapq) || direct_mapq > numeric_limits<int32_t>::max()) ?
            (double) numeric_limits<int32_t>::max() : direct_mapq;
 }
@@ -468,7 +397,7 @@ void BaseAligner::compute_mapping_quality(vector<Alignment>& alignments,
         return;
     }
     
-    vector<double> scaled_scores(alignments.size());
+    ScaledScores scaled_scores(alignments.size());
     for (size_t i = 0; i < alignments.size(); i++) {
         scaled_scores[i] = log_base * alignments[i].score();
     }
@@ -518,7 +447,7 @@ void BaseAligner::compute_mapping_quality(vector<Alignment>& alignments,
 
 int32_t BaseAligner::compute_mapping_quality(vector<double>& scores, bool fast_approximation) {
     
-    vector<double> scaled_scores(scores.size(), 0.0);
+    ScaledScores scaled_scores(scores.size());
     for (size_t i = 0; i < scores.size(); i++) {
         scaled_scores[i] = log_base * scores[i];
     }
@@ -534,7 +463,7 @@ int32_t BaseAligner::compute_group_mapping_quality(vector<double>& scores, vecto
         sort(group.begin(), group.end());
     }
     
-    vector<double> scaled_scores(scores.size(), 0.0);
+    ScaledScores scaled_scores(scores.size());
     for (size_t i = 0; i < scores.size(); i++) {
         scaled_scores[i] = log_base * scores[i];
     }
@@ -567,7 +496,7 @@ void BaseAligner::compute_paired_mapping_quality(pair<vector<Alignment>, vector<
         return;
     }
     
-    vector<double> scaled_scores(size);
+    ScaledScores scaled_scores(size);
     
     for (size_t i = 0; i < size; i++) {
         auto& aln1 = alignment_pairs.first[i];
@@ -658,16 +587,16 @@ double BaseAligner::estimate_next_best_score(int length, double min_diffs) {
 }
 
 double BaseAligner::max_possible_mapping_quality(int length) {
-    double max_score = log_base * length * match;
-    vector<double> v = { max_score };
+    ScaledScores v(1);
+    v[0] = log_base * length * match;
     size_t max_idx;
     return maximum_mapping_quality_approx(v, &max_idx);
 }
 
 double BaseAligner::estimate_max_possible_mapping_quality(int length, double min_diffs, double next_min_diffs) {
-    double max_score = log_base * ((length - min_diffs) * match - min_diffs * mismatch);
-    double next_max_score = log_base * ((length - next_min_diffs) * match - next_min_diffs * mismatch);
-    vector<double> v = { max_score, next_max_score };
+    ScaledScores v(2);
+    v[0] = log_base * ((length - min_diffs) * match - min_diffs * mismatch);
+    v[1] = log_base * ((length - next_min_diffs) * match - next_min_diffs * mismatch);
     size_t max_idx;
     return maximum_mapping_quality_approx(v, &max_idx);
 }
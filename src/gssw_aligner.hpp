@@ -15,6 +15,7 @@
 #include "path.hpp"
 #include "utility.hpp"
 #include "banded_global_aligner.hpp"
+#include "mapping_quality.hpp"
 
 namespace vg {
 
@@ -59,9 +60,9 @@ namespace vg {
                                        bool print_score_matrices = false);
         string graph_cigar(gssw_graph_mapping* gm);
         
-        double maximum_mapping_quality_exact(vector<double>& scaled_scores, size_t* max_idx_out);
-        double maximum_mapping_quality_approx(vector<double>& scaled_scores, size_t* max_idx_out);
-        double group_mapping_quality_exact(vector<double>& scaled_scores, vector<size_t>& group);
+        double maximum_mapping_quality_exact(const ScaledScores& scaled_scores, size_t* max_idx_out);
+        double maximum_mapping_quality_approx(const ScaledScores& scaled_scores, size_t* max_idx_out);
+        double group_mapping_quality_exact(const ScaledScores& scaled_scores, const vector<size_t>& group);
         double estimate_next_best_score(int length, double min_diffs);
         
         // must be called before querying mapping_quality
@@ -211,6 +212,10 @@ namespace vg {
         // log of the base of the logarithm underlying the log-odds interpretation of the scores
         double log_base = 0.0;
         
+        /// Evaluate the exponentials in exact mapping qualities with a fast
+        /// approximation (relative error below 1e-8) instead of the library exp
+        bool fast_exp_mapping_quality = false;
+        
     };
     
     /**
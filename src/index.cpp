@@ -1,4 +1,10 @@
 #include "index.hpp"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
+
+#include <cstdio>
+#include <fstream>
+#include <queue>
 
 namespace vg {
 
@@ -16,6 +22,8 @@ Index::Index(void) {
     // in the event of power failure etc. which is not really relevant to our use case.
     write_options.disableWAL = true;
     db = nullptr;
+    node_prefix_filter = false;
+    key_version = current_key_version;
 
     threads = 1;
 #pragma omp parallel
@@ -52,6 +60,10 @@ rocksdb::Options Index::GetOptions(bool read_only) {
     topt.filter_policy.reset(rocksdb::NewBloomFilterPolicy(10, true));
     topt.block_cache = rocksdb::NewLRUCache(block_cache_bytes);
     options.table_factory.reset(NewBlockBasedTableFactory(topt));
+    if (node_prefix_filter) {
+        // the filters also get the node ID prefix of each key
+        options.prefix_extractor.reset(rocksdb::NewFixedPrefixTransform(node_prefix_length));
+    }
 
     // set up concurrency
     options.IncreaseParallelism(threads);
@@ -122,11 +134,48 @@ void Index::open(const std::string& dir, bool read_only) {
         throw indexOpenException("index was not built cleanly, and should be recreated from scratch");
     }
 
+    // The prefix extractor has to match the one the filters were built with,
+    // so we remember whether the index has them and reopen if we guessed wrong.
+    string prefix_filter_key = key_for_metadata("node_prefix_filter");
+    bool has_prefix_filter = db->Get(rocksdb::ReadOptions(), prefix_filter_key, &data).ok();
+    if (has_prefix_filter && !node_prefix_filter) {
+        delete db;
+        db = nullptr;
+        node_prefix_filter = true;
+        open(dir, read_only);
+        return;
+    }
+    // an index that has never been closed is one we are creating
+    bool creating = !read_only && get_metadata("next_nonce", data).IsNotFound();
+    if (node_prefix_filter && !has_prefix_filter && !creating) {
+        // files already in the index were built without prefix filters
+        throw indexOpenException("node prefix filters can only be enabled when creating an index");
+    }
+
+    // Keep writing keys in the format the index already has
+    string key_version_key = key_for_metadata("key_version");
+    if (db->Get(rocksdb::ReadOptions(), key_version_key, &data).ok()) {
+        key_version = atoi(data.c_str());
+        if (key_version > current_key_version) {
+            throw indexOpenException("index has key version " + data + ", newer than this vg supports");
+        }
+    } else {
+        key_version = creating ? current_key_version : 1;
+    }
+
     if (!read_only) {
+        rocksdb::WriteBatch batch;
+        batch.Put(dirty_key, "");
+        if (node_prefix_filter) {
+            batch.Put(prefix_filter_key, "");
+        }
+        if (creating) {
+            batch.Put(key_version_key, to_string(key_version));
+        }
         rocksdb::WriteOptions dirty_write_options;
         dirty_write_options.sync = true;
         dirty_write_options.disableWAL = false;
-        if (!db->Put(dirty_write_options, dirty_key, "").ok() || !db->Flush(rocksdb::FlushOptions()).ok()) {
+        if (!db->Write(dirty_write_options, &batch).ok() || !db->Flush(rocksdb::FlushOptions()).ok()) {
             throw indexOpenException("couldn't write to index");
         }
     }
@@ -464,7 +513,13 @@ const string Index::key_for_traversal(int64_t aln_id, const Mapping& mapping) {
     aln_id = htobe64(aln_id);
     memcpy(k + sizeof(char)*3+sizeof(int64_t), &aln_id, sizeof(int64_t));
     int16_t rank = mapping.rank() * (mapping.position().is_reverse() ? -1 : 1);
-    memcpy(k + sizeof(char)*3+sizeof(int64_t)*2, &rank, sizeof(int16_t));
+    if (key_version >= 2) {
+        // flip the sign bit so reverse strand ranks sort before forward ones
+        uint16_t encoded = htobe16((uint16_t) rank ^ 0x8000);
+        memcpy(k + sizeof(char)*3+sizeof(int64_t)*2, &encoded, sizeof(int16_t));
+    } else {
+        memcpy(k + sizeof(char)*3+sizeof(int64_t)*2, &rank, sizeof(int16_t));
+    }
     return key;
 }
 
@@ -702,6 +757,32 @@ void Index::parse_base(const string& key, const string& value, int64_t& aln_id,
     alignment.ParseFromString(value);
 }
 
+bool Index::parse_alignment_path(const char* data, size_t size, Path& path) {
+    using ::google::protobuf::internal::WireFormatLite;
+    path.Clear();
+    ::google::protobuf::io::CodedInputStream in((const uint8_t*) data, size);
+    const int path_field = Alignment::kPathFieldNumber;
+    uint32_t tag;
+    while ((tag = in.ReadTag()) != 0) {
+        if (WireFormatLite::GetTagFieldNumber(tag) == path_field
+            && WireFormatLite::GetTagWireType(tag) == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+            // repeated occurrences of a message field are merged, as in a full parse
+            uint32_t length;
+            if (!in.ReadVarint32(&length)) {
+                return false;
+            }
+            auto limit = in.PushLimit(length);
+            if (!path.MergePartialFromCodedStream(&in) || !in.ConsumedEntireMessage()) {
+                return false;
+            }
+            in.PopLimit(limit);
+        } else if (!WireFormatLite::SkipField(&in, tag)) {
+            return false;
+        }
+    }
+    return in.ConsumedEntireMessage();
+}
+
 void Index::parse_traversal(const string& key, const string& value, int64_t& node_id, int16_t& rank, bool& backward, int64_t& aln_id) {
     const char* k = key.c_str();
     memcpy(&node_id, (k + 3*sizeof(char)), sizeof(int64_t));
@@ -709,6 +790,9 @@ void Index::parse_traversal(const string& key, const string& value, int64_t& nod
     memcpy(&aln_id, (k + 3*sizeof(char)+sizeof(int64_t)), sizeof(int64_t));
     aln_id = be64toh(aln_id);
     memcpy(&rank, (k + 3*sizeof(char) + 2*sizeof(int64_t)), sizeof(int16_t));
+    if (key_version >= 2) {
+        rank = (int16_t) (be16toh((uint16_t) rank) ^ 0x8000);
+    }
     if (rank < 0) { backward = true; } else { backward = false; }
     rank = abs(rank);
 }
@@ -798,7 +882,7 @@ string Index::traversal_entry_to_string(const string& key, const string& value)
 }
 
 void Index::dump(ostream& out) {
-    rocksdb::Iterator* it = db->NewIterator(rocksdb::ReadOptions());
+    rocksdb::Iterator* it = db->NewIterator(scan_options());
     for (it->SeekToFirst(); it->Valid(); it->Next()) {
         out << entry_to_string(it->key().ToString(), it->value().ToString()) << endl;
     }
@@ -922,6 +1006,24 @@ void Index::put_base(int64_t aln_id, const Alignment& alignment) {
     S(db->Put(write_options, key_for_base(aln_id), data));
 }
 
+void Index::put_alignment(const Alignment& alignment, BulkIngester& ingester) {
+    string data;
+    alignment.SerializeToString(&data);
+    ingester.put(key_for_alignment(alignment), data);
+}
+
+void Index::cross_alignment(int64_t aln_id, const Alignment& alignment, BulkIngester& ingester) {
+    string data;
+    alignment.SerializeToString(&data);
+    ingester.put(key_for_base(aln_id), data);
+    if (alignment.has_path()) {
+        auto& path = alignment.path();
+        for (int i = 0; i < path.mapping_size(); ++i) {
+            ingester.put(key_for_traversal(aln_id, path.mapping(i)), "");
+        }
+    }
+}
+
 void Index::put_traversal(int64_t aln_id, const Mapping& mapping) {
     string data; // empty data
     S(db->Put(write_options, key_for_traversal(aln_id, mapping), data));
@@ -1140,63 +1242,125 @@ void Index::get_mappings(int64_t node_id, vector<Mapping>& mappings) {
 }
 
 void Index::get_alignments(int64_t node_id, vector<Alignment>& alignments) {
-    string start = key_for_alignment_prefix(node_id);
-    string end = start + end_sep;
-    for_range(start, end, [this, &alignments](string& key, string& value) {
+    Scanner scanner(*this, true);
+    scanner.scan_prefix(key_for_alignment_prefix(node_id), [&alignments](const rocksdb::Slice& key, const rocksdb::Slice& value) {
             alignments.emplace_back();
-            Alignment& alignment = alignments.back();
-            alignment.ParseFromString(value);
+            alignments.back().ParseFromArray(value.data(), value.size());
         });
 }
 
 void Index::get_alignments(int64_t id1, int64_t id2, vector<Alignment>& alignments) {
     string start = key_for_alignment_prefix(id1);
     string end = key_for_alignment_prefix(id2) + end_sep;
-    for_range(start, end, [this, &alignments](string& key, string& value) {
+    Scanner scanner(*this);
+    scanner.scan(start, end, [&alignments](const rocksdb::Slice& key, const rocksdb::Slice& value) {
             alignments.emplace_back();
-            Alignment& alignment = alignments.back();
-            alignment.ParseFromString(value);
+            alignments.back().ParseFromArray(value.data(), value.size());
         });
 }
 
 void Index::for_alignment_in_range(int64_t id1, int64_t id2, std::function<void(const Alignment&)> lambda) {
     string start = key_for_alignment_prefix(id1);
     string end = key_for_alignment_prefix(id2) + end_sep;
-    for_range(start, end, [this, &lambda](string& key, string& value) {
+    Scanner scanner(*this);
+    // parse straight out of the table blocks, reusing one message
+    Alignment alignment;
+    scanner.scan(start, end, [&lambda, &alignment](const rocksdb::Slice& key, const rocksdb::Slice& value) {
+            alignment.ParseFromArray(value.data(), value.size());
+            lambda(alignment);
+        });
+}
+
+void Index::for_alignment_in_range(int64_t id1, int64_t id2, const function<bool(const Path&)>& path_filter,
+                                   std::function<void(const Alignment&)> lambda) {
+    string start = key_for_alignment_prefix(id1);
+    string end = key_for_alignment_prefix(id2) + end_sep;
+    Scanner scanner(*this);
+    Path path;
+    Alignment alignment;
+    scanner.scan(start, end, [&](const rocksdb::Slice& key, const rocksdb::Slice& value) {
+            if (parse_alignment_path(value.data(), value.size(), path) && !path_filter(path)) {
+                return;
+            }
+            alignment.ParseFromArray(value.data(), value.size());
+            lambda(alignment);
+        });
+}
+
+void Index::for_alignment_to_node(int64_t node_id, std::function<void(const Alignment&)> lambda) {
+    // alignments stored with -a are keyed by the lowest node they visit
+    Scanner scanner(*this, true);
+    scanner.scan_prefix(key_for_alignment_prefix(node_id), [&lambda](const rocksdb::Slice& key, const rocksdb::Slice& value) {
             Alignment alignment;
-            alignment.ParseFromString(value);
+            alignment.ParseFromArray(value.data(), value.size());
             lambda(alignment);
         });
 }
 
 void Index::for_alignment_to_nodes(const vector<int64_t>& ids, std::function<void(const Alignment&)> lambda) {
     set<int64_t> aln_ids;
+    Scanner scanner(*this, true);
     for (auto id : ids) {
-        string start = key_prefix_for_traversal(id);
-        string end = start + end_sep;
-        for_range(start, end, [this, &lambda, &aln_ids](string& key, string& value) {
-                // parse the alignment id out
-                int64_t node_id;
-                int16_t rank;
-                bool backward;
-                int64_t aln_id;
-                parse_traversal(key, value, node_id, rank, backward, aln_id);
-                aln_ids.insert(aln_id);
+        scanner.scan_prefix(key_prefix_for_traversal(id), [this, &aln_ids](const rocksdb::Slice& key, const rocksdb::Slice& value) {
+                aln_ids.insert(traversal_alignment_id(key));
             });
     }
     for_base_alignments(aln_ids, lambda);
 }
 
+void Index::for_alignment_to_nodes(const vector<int64_t>& ids, const function<bool(const Path&)>& path_filter,
+                                   std::function<void(const Alignment&)> lambda) {
+    set<int64_t> aln_ids;
+    Scanner scanner(*this, true);
+    for (auto id : ids) {
+        scanner.scan_prefix(key_prefix_for_traversal(id), [this, &aln_ids](const rocksdb::Slice& key, const rocksdb::Slice& value) {
+                aln_ids.insert(traversal_alignment_id(key));
+            });
+    }
+    for_base_alignments(aln_ids, path_filter, lambda);
+}
+
+int64_t Index::traversal_alignment_id(const rocksdb::Slice& key) {
+    int64_t aln_id;
+    memcpy(&aln_id, key.data() + 3*sizeof(char) + sizeof(int64_t), sizeof(int64_t));
+    return be64toh(aln_id);
+}
+
 void Index::for_base_alignments(const set<int64_t>& aln_ids, std::function<void(const Alignment&)> lambda) {
     for (auto id : aln_ids) {
-        string start = key_for_base(id);
-        string end = start + end_sep;
-        for_range(start, end, [this, &lambda](string& key, string& value) {
-                Alignment alignment;
-                int64_t aln_id;
-                parse_base(key, value, aln_id, alignment);
-                lambda(alignment);
-            });
+        // base keys are exact, so a point lookup can use the whole key filters
+        string key = key_for_base(id);
+        string value;
+        rocksdb::Status s = db->Get(rocksdb::ReadOptions(), key, &value);
+        if (s.IsNotFound()) {
+            continue;
+        }
+        S(s);
+        Alignment alignment;
+        int64_t aln_id;
+        parse_base(key, value, aln_id, alignment);
+        lambda(alignment);
+    }
+}
+
+void Index::for_base_alignments(const set<int64_t>& aln_ids, const function<bool(const Path&)>& path_filter,
+                                std::function<void(const Alignment&)> lambda) {
+    Path path;
+    for (auto id : aln_ids) {
+        string key = key_for_base(id);
+        string value;
+        rocksdb::Status s = db->Get(rocksdb::ReadOptions(), key, &value);
+        if (s.IsNotFound()) {
+            continue;
+        }
+        S(s);
+        if (parse_alignment_path(value.data(), value.size(), path) && !path_filter(path)) {
+            continue;
+        }
+        Alignment alignment;
+        int64_t aln_id;
+        parse_base(key, value, aln_id, alignment);
+        lambda(alignment);
     }
 }
 
@@ -1516,7 +1680,7 @@ map<string, int64_t> Index::paths_by_id(void) {
 pair<int64_t, bool> Index::path_first_node(int64_t path_id) {
     string k = key_for_path_position(path_id, 0, false, 0);
     k = k.substr(0, 4 + sizeof(int64_t));
-    rocksdb::Iterator* it = db->NewIterator(rocksdb::ReadOptions());
+    rocksdb::Iterator* it = db->NewIterator(scan_options());
     rocksdb::Slice start = rocksdb::Slice(k);
     rocksdb::Slice end = rocksdb::Slice(k+end_sep);
     int64_t node_id = 0;
@@ -1536,7 +1700,7 @@ pair<int64_t, bool> Index::path_last_node(int64_t path_id, int64_t& path_length)
     // we aim to seek to the first item in the next path, then step back
     string key_start = key_for_path_position(path_id, 0, false, 0);
     string key_end = key_for_path_position(path_id+1, 0, false, 0);
-    rocksdb::Iterator* it = db->NewIterator(rocksdb::ReadOptions());
+    rocksdb::Iterator* it = db->NewIterator(scan_options());
     //rocksdb::Slice start = rocksdb::Slice(key_start);
     rocksdb::Slice end = rocksdb::Slice(key_end);
     int64_t node_id = 0;
@@ -1632,7 +1796,7 @@ void Index::get_connected_nodes(VG& graph) {
 }
 
 void Index::get_context(int64_t id, VG& graph) {
-    rocksdb::Iterator* it = db->NewIterator(rocksdb::ReadOptions());
+    rocksdb::Iterator* it = db->NewIterator(scan_options());
     string key_start = key_for_node(id).substr(0,3+sizeof(int64_t));
     rocksdb::Slice start = rocksdb::Slice(key_start);
     string key_end = key_start+end_sep;
@@ -1689,29 +1853,36 @@ void Index::get_context(int64_t id, VG& graph) {
 }
 
 void Index::get_range(int64_t from_id, int64_t to_id, VG& graph) {
-    auto handle_entry = [this, &graph](string& key, string& value) {
+    // path names are looked up once per path rather than once per mapping
+    map<int64_t, string> path_names;
+    auto handle_entry = [&](const rocksdb::Slice& k, const rocksdb::Slice& v) {
+        string key(k.data(), k.size());
         char keyt = graph_key_type(key);
         switch (keyt) {
         case 'n': {
             // Key describes a node
             Node node;
-            node.ParseFromString(value);
+            node.ParseFromArray(v.data(), v.size());
             graph.add_node(node);
         } break;
-        case 's': {
-            // Key describes an edge on the start of a node
-            Edge edge;
-            int64_t id1, id2;
-            char type;
-            parse_edge(key, value, type, id1, id2, edge);
-            graph.add_edge(edge);
-        } break;
+        case 's':
         case 'e': {
-            // Key describes an edge on the end of a node
+            // Key describes an edge on the start or end of a node. The half
+            // without the edge data can be skipped when the half with it is
+            // also in the range.
+            if (v.empty()) {
+                char type;
+                int64_t node_id, other_id;
+                bool backward;
+                parse_edge(key, type, node_id, other_id, backward);
+                if (other_id >= from_id && other_id <= to_id) {
+                    break;
+                }
+            }
             Edge edge;
             int64_t id1, id2;
             char type;
-            parse_edge(key, value, type, id1, id2, edge);
+            parse_edge(key, v.ToString(), type, id1, id2, edge);
             graph.add_edge(edge);
         } break;
         case 'p': {
@@ -1719,10 +1890,14 @@ void Index::get_range(int64_t from_id, int64_t to_id, VG& graph) {
             int64_t node_id, path_id, path_pos;
             Mapping mapping;
             bool backward;
-            parse_node_path(key, value,
+            parse_node_path(key, v.ToString(),
                             node_id, path_id, path_pos, backward, mapping);
+            auto found = path_names.find(path_id);
+            if (found == path_names.end()) {
+                found = path_names.emplace(path_id, get_path_name(path_id)).first;
+            }
             // We don't need to pass backward here since it's included in the Mapping object.
-            graph.paths.append_mapping(get_path_name(path_id), mapping);
+            graph.paths.append_mapping(found->second, mapping);
         } break;
         default:
             cerr << "vg::Index unrecognized key type " << keyt << endl;
@@ -1730,7 +1905,11 @@ void Index::get_range(int64_t from_id, int64_t to_id, VG& graph) {
             break;
         }
     };
-    for_graph_range(from_id, to_id, handle_entry);
+    // same bounds as for_graph_range
+    string start = key_for_node(from_id).substr(0,3+sizeof(int64_t));
+    string end = key_for_node(to_id+1).substr(0,3+sizeof(int64_t));
+    Scanner scanner(*this);
+    scanner.scan(start, end, handle_entry);
 }
 
 void Index::get_kmer_subgraph(const string& kmer, VG& graph) {
@@ -1809,7 +1988,7 @@ void Index::get_edges_of(int64_t node, vector<Edge>& edges) {
 }
 
 void Index::get_edges_on_start(int64_t node_id, vector<Edge>& edges) {
-    rocksdb::Iterator* it = db->NewIterator(rocksdb::ReadOptions());
+    rocksdb::Iterator* it = db->NewIterator(scan_options());
     string key_start = key_prefix_for_edges_on_node_start(node_id);
     rocksdb::Slice start = rocksdb::Slice(key_start);
     string key_end = key_start+end_sep;
@@ -1866,7 +2045,7 @@ void Index::get_edges_on_start(int64_t node_id, vector<Edge>& edges) {
 }
 
 void Index::get_edges_on_end(int64_t node_id, vector<Edge>& edges) {
-    rocksdb::Iterator* it = db->NewIterator(rocksdb::ReadOptions());
+    rocksdb::Iterator* it = db->NewIterator(scan_options());
     string key_start = key_prefix_for_edges_on_node_end(node_id);
     rocksdb::Slice start = rocksdb::Slice(key_start);
     string key_end = key_start+end_sep;
@@ -2058,21 +2237,64 @@ void Index::for_all(std::function<void(string&, string&)> lambda) {
 
 void Index::for_range(string& key_start, string& key_end,
                       std::function<void(string&, string&)> lambda) {
-    rocksdb::Iterator* it = db->NewIterator(rocksdb::ReadOptions());
-    rocksdb::Slice start = rocksdb::Slice(key_start);
-    rocksdb::Slice end = rocksdb::Slice(key_end);
-    for (it->Seek(start);
-         it->Valid() && it->key().ToString() < key_end;
-         it->Next()) {
-        S(it->status());
-        string key = it->key().ToString();
-        string value = it->value().ToString();
-        lambda(key, value);
+    Scanner scanner(*this);
+    string key, value;
+    scanner.scan(key_start, key_end, [&](const rocksdb::Slice& k, const rocksdb::Slice& v) {
+            key.assign(k.data(), k.size());
+            value.assign(v.data(), v.size());
+            lambda(key, value);
+        });
+}
+
+void Index::for_prefix(const string& prefix, std::function<void(string&, string&)> lambda) {
+    Scanner scanner(*this, prefix.size() == node_prefix_length);
+    string key, value;
+    scanner.scan_prefix(prefix, [&](const rocksdb::Slice& k, const rocksdb::Slice& v) {
+            key.assign(k.data(), k.size());
+            value.assign(v.data(), v.size());
+            lambda(key, value);
+        });
+}
+
+Index::Scanner::Scanner(Index& index, bool by_prefix) {
+    rocksdb::ReadOptions read_options = index.scan_options();
+    if (by_prefix && index.node_prefix_filter) {
+        read_options.total_order_seek = false;
+        read_options.prefix_same_as_start = true;
     }
-    S(it->status());
+    // keep the blocks we hand out slices of from being released
+    read_options.pin_data = true;
+    it = index.db->NewIterator(read_options);
+}
+
+Index::Scanner::~Scanner(void) {
     delete it;
 }
 
+void Index::Scanner::scan(const rocksdb::Slice& start, const rocksdb::Slice& end,
+                          const function<void(const rocksdb::Slice&, const rocksdb::Slice&)>& lambda) {
+    for (it->Seek(start); it->Valid() && it->key().compare(end) < 0; it->Next()) {
+        lambda(it->key(), it->value());
+    }
+    S(it->status());
+}
+
+void Index::Scanner::scan_prefix(const rocksdb::Slice& prefix,
+                                 const function<void(const rocksdb::Slice&, const rocksdb::Slice&)>& lambda) {
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        lambda(it->key(), it->value());
+    }
+    S(it->status());
+}
+
+rocksdb::ReadOptions Index::scan_options(void) {
+    rocksdb::ReadOptions read_options;
+    // with a prefix extractor, seeks would otherwise only be good for keys
+    // sharing the prefix of the seek key
+    read_options.total_order_seek = true;
+    return read_options;
+}
+
 // todo, get range estimated size
 
 void Index::prune_kmers(int max_kb_on_disk) {
@@ -2188,4 +2410,207 @@ pair<int64_t, int64_t> Index::compare_kmers(Index& other) {
     return pair<int64_t, int64_t>(outFound, outNotFound);
 }
 
+// Runs hold length-prefixed keys and values
+static void write_run_record(ostream& out, const string& key, const string& value) {
+    uint32_t key_size = key.size();
+    uint32_t value_size = value.size();
+    out.write((char*) &key_size, sizeof(uint32_t));
+    out.write(key.c_str(), key_size);
+    out.write((char*) &value_size, sizeof(uint32_t));
+    out.write(value.c_str(), value_size);
+}
+
+static bool read_run_record(istream& in, string& key, string& value) {
+    uint32_t size;
+    if (!in.read((char*) &size, sizeof(uint32_t))) {
+        return false;
+    }
+    key.resize(size);
+    in.read(&key[0], size);
+    in.read((char*) &size, sizeof(uint32_t));
+    value.resize(size);
+    in.read(&value[0], size);
+    if (!in) {
+        throw runtime_error("[vg::BulkIngester] truncated run file");
+    }
+    return true;
+}
+
+BulkIngester::BulkIngester(Index& index, size_t max_buffer_bytes, const string& temp_dir) :
+    index(index), temp_dir(temp_dir.empty() ? find_temp_dir() : temp_dir), finished(false) {
+    buffers.resize(omp_get_max_threads());
+    buffer_bytes.resize(buffers.size(), 0);
+    max_thread_bytes = max(max_buffer_bytes / buffers.size(), (size_t) 1);
+}
+
+BulkIngester::~BulkIngester(void) {
+    for (auto& run : runs) {
+        std::remove(run.file_name.c_str());
+    }
+}
+
+void BulkIngester::put(const string& key, const string& value) {
+    int tid = omp_get_thread_num();
+    auto& buffer = buffers[tid];
+    buffer.emplace_back(key, value);
+    buffer_bytes[tid] += key.size() + value.size() + sizeof(pair<string, string>);
+    if (buffer_bytes[tid] > max_thread_bytes) {
+        spill(buffer);
+        buffer_bytes[tid] = 0;
+    }
+}
+
+void BulkIngester::spill(vector<pair<string, string>>& buffer) {
+    std::sort(buffer.begin(), buffer.end());
+
+    Run run;
+    run.file_name = tmpfilename(temp_dir + "/vg-ingest-run");
+    ofstream out(run.file_name, ios::binary);
+    for (size_t i = 0; i < buffer.size(); ++i) {
+        if (i % sample_interval == 0) {
+            run.samples.emplace_back(buffer[i].first, (streamoff) out.tellp());
+        }
+        write_run_record(out, buffer[i].first, buffer[i].second);
+    }
+    out.close();
+    if (!out) {
+        throw runtime_error("[vg::BulkIngester] could not write run file " + run.file_name);
+    }
+    buffer.clear();
+
+#pragma omp critical (bulk_ingester_runs)
+    runs.push_back(std::move(run));
+}
+
+bool BulkIngester::write_range(const string& start, const string& end, const string& sst_file_name) {
+    // Open each run at the last sample before the range
+    vector<unique_ptr<ifstream>> inputs;
+    // Heap of the next key in each run, with its value
+    typedef pair<pair<string, string>, size_t> entry_t;
+    priority_queue<entry_t, vector<entry_t>, greater<entry_t>> heap;
+    auto advance = [&](size_t i) {
+        string key, value;
+        while (read_run_record(*inputs[i], key, value)) {
+            if (!end.empty() && key >= end) {
+                return;
+            }
+            if (key >= start) {
+                heap.emplace(make_pair(std::move(key), std::move(value)), i);
+                return;
+            }
+        }
+    };
+    for (size_t i = 0; i < runs.size(); ++i) {
+        auto& samples = runs[i].samples;
+        auto it = upper_bound(samples.begin(), samples.end(), start,
+                              [](const string& key, const pair<string, streamoff>& sample) {
+                                  return key < sample.first;
+                              });
+        inputs.emplace_back(new ifstream(runs[i].file_name, ios::binary));
+        if (it != samples.begin()) {
+            inputs.back()->seekg((it - 1)->second);
+        }
+        advance(i);
+    }
+    if (heap.empty()) {
+        return false;
+    }
+
+    rocksdb::SstFileWriter writer(rocksdb::EnvOptions(), index.db_options);
+    S(writer.Open(sst_file_name));
+    string last_key;
+    while (!heap.empty()) {
+        auto& top = heap.top();
+        size_t i = top.second;
+        // SST files need strictly increasing keys, so later copies of a key
+        // are dropped
+        if (last_key.empty() || top.first.first != last_key) {
+            S(writer.Add(top.first.first, top.first.second));
+            last_key = top.first.first;
+        }
+        heap.pop();
+        advance(i);
+    }
+    S(writer.Finish());
+    return true;
+}
+
+void BulkIngester::finish(void) {
+    if (finished) {
+        return;
+    }
+    finished = true;
+
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        if (!buffers[i].empty()) {
+            spill(buffers[i]);
+        }
+        buffer_bytes[i] = 0;
+    }
+    if (runs.empty()) {
+        return;
+    }
+
+    // Split the key space into ranges of about equal size using the samples
+    vector<string> samples;
+    for (auto& run : runs) {
+        for (auto& sample : run.samples) {
+            samples.push_back(sample.first);
+        }
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t range_count = min((size_t) index.threads * 4, samples.size());
+    vector<string> bounds(1, "");
+    for (size_t i = 1; i < range_count; ++i) {
+        const string& bound = samples[i * samples.size() / range_count];
+        if (bound > bounds.back()) {
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back("");
+
+    // Write the ranges in parallel, next to the database so ingestion can
+    // move them in rather than copying
+    size_t sst_count = bounds.size() - 1;
+    vector<string> sst_file_names(sst_count);
+    vector<char> written(sst_count, false);
+    string error;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < sst_count; ++i) {
+        sst_file_names[i] = index.name + "/vg-ingest-" + to_string(i) + ".sst";
+        try {
+            written[i] = write_range(bounds[i], bounds[i + 1], sst_file_names[i]);
+        } catch (const exception& e) {
+#pragma omp critical (bulk_ingester_error)
+            error = e.what();
+        }
+    }
+
+    vector<string> to_ingest;
+    for (size_t i = 0; i < sst_count; ++i) {
+        if (written[i]) {
+            to_ingest.push_back(sst_file_names[i]);
+        }
+    }
+    rocksdb::Status s;
+    if (error.empty() && !to_ingest.empty()) {
+        rocksdb::IngestExternalFileOptions ingest_options;
+        ingest_options.move_files = true;
+        s = index.db->IngestExternalFile(to_ingest, ingest_options);
+    }
+
+    for (auto& file_name : sst_file_names) {
+        std::remove(file_name.c_str());
+    }
+    for (auto& run : runs) {
+        std::remove(run.file_name.c_str());
+    }
+    runs.clear();
+
+    if (!error.empty()) {
+        throw runtime_error("[vg::BulkIngester] " + error);
+    }
+    S(s);
+}
+
 }
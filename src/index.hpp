@@ -16,6 +16,7 @@
 #include "rocksdb/slice_transform.h"
 #include "rocksdb/table.h"
 #include "rocksdb/filter_policy.h"
+#include "rocksdb/sst_file_writer.h"
 
 #include "json2pb.h"
 #include "vg.hpp"
@@ -79,9 +80,22 @@ namespace vg {
   +s+node_id+offset                     mapping [vg::Mapping] // mapping-only "side" against one node
   +a+node_id+offset                     align_id // for sorting
   +b+align_id                           alignment [vg::Alignment] // stores base alignments
-  +t+node_id+strand+align_id            alignment traversal // allows us to quickly go from node traversal to alignments
+  +t+node_id+align_id+rank              alignment traversal // allows us to quickly go from node traversal to alignments
+
+  Integers in keys are fixed-width and big-endian, so keys sort numerically.
+  The traversal rank is negated for reverse strand traversals; since key
+  version 2 it is also stored big-endian with its sign bit flipped, where
+  version 1 indexes stored it in host byte order. The key version is kept in
+  the metadata, and indexes without it are version 1.
+
+  Graph, alignment and traversal keys all begin with a fixed-length prefix of
+  the separators, the type character, and a node ID. Indexes created with
+  node_prefix_filter set keep bloom filters on these prefixes, which lets
+  per-node range scans skip files that hold nothing for the node.
  */
 
+class BulkIngester;
+
 class Index {
 
 public:
@@ -114,11 +128,46 @@ public:
     bool bulk_load;
     std::atomic<uint64_t> next_nonce;
 
+    // Build bloom filters on node ID key prefixes. Set this before opening an
+    // index to create it with prefix filters; opening an index that was
+    // created with them turns it on automatically.
+    bool node_prefix_filter;
+    // Length of the separator, type and node ID prefix the filters are built on
+    static const size_t node_prefix_length = 3*sizeof(char) + sizeof(int64_t);
+
+    // Key format of the open index, and the one new indexes are created with
+    int key_version;
+    static const int current_key_version = 2;
+
+    // A rocksdb iterator that can be reused for many scans. Keys and values
+    // are handed to the lambda as slices into pinned blocks, so nothing is
+    // copied unless the caller wants a copy.
+    class Scanner {
+    public:
+        // A scanner by prefix uses the node prefix filters, if the index has
+        // them, and can only scan prefixes of node_prefix_length.
+        Scanner(Index& index, bool by_prefix = false);
+        ~Scanner(void);
+        // Run the lambda on every key in [start, end)
+        void scan(const rocksdb::Slice& start, const rocksdb::Slice& end,
+                  const function<void(const rocksdb::Slice&, const rocksdb::Slice&)>& lambda);
+        // Run the lambda on every key starting with the prefix
+        void scan_prefix(const rocksdb::Slice& prefix,
+                         const function<void(const rocksdb::Slice&, const rocksdb::Slice&)>& lambda);
+    private:
+        rocksdb::Iterator* it;
+    };
+
     void load_graph(VG& graph);
     void dump(std::ostream& out);
     void for_all(std::function<void(string&, string&)> lambda);
     void for_range(string& key_start, string& key_end,
                    std::function<void(string&, string&)> lambda);
+    // Run the lambda on every key starting with the given prefix. Node ID
+    // prefixes are looked up through the prefix filters, if we have them.
+    void for_prefix(const string& prefix, std::function<void(string&, string&)> lambda);
+    // Options for iterators that may scan across node ID prefixes
+    rocksdb::ReadOptions scan_options(void);
 
     void put_node(const Node* node);
     void put_edge(const Edge* edge);
@@ -145,6 +194,9 @@ public:
 
     // cross-index alignment by aln_id and record its traversals
     void cross_alignment(int64_t aln_id, const Alignment& alignment);
+    // versions of the above that go through a bulk ingester instead of the memtables
+    void put_alignment(const Alignment& alignment, BulkIngester& ingester);
+    void cross_alignment(int64_t aln_id, const Alignment& alignment, BulkIngester& ingester);
 
     rocksdb::Status get_node(int64_t id, Node& node);
     // Takes the nodes and orientations and gets the Edge object with any associated edge data.
@@ -160,6 +212,14 @@ public:
     void for_alignment_to_node(int64_t node_id, std::function<void(const Alignment&)> lambda);
     void for_alignment_to_nodes(const vector<int64_t>& ids, std::function<void(const Alignment&)> lambda);
     void for_base_alignments(const set<int64_t>& aln_ids, std::function<void(const Alignment&)> lambda);
+    // Versions of the above that first parse just the path of each alignment,
+    // and only parse the rest of the alignments whose paths pass the filter.
+    void for_alignment_in_range(int64_t id1, int64_t id2, const function<bool(const Path&)>& path_filter,
+                                std::function<void(const Alignment&)> lambda);
+    void for_alignment_to_nodes(const vector<int64_t>& ids, const function<bool(const Path&)>& path_filter,
+                                std::function<void(const Alignment&)> lambda);
+    void for_base_alignments(const set<int64_t>& aln_ids, const function<bool(const Path&)>& path_filter,
+                             std::function<void(const Alignment&)> lambda);
 
     // obtain the key corresponding to each entity
     const string key_for_node(int64_t id);
@@ -198,6 +258,9 @@ public:
     void parse_mapping(const string& key, const string& value, int64_t& node_id, uint64_t& nonce, Mapping& mapping);
     void parse_alignment(const string& key, const string& value, int64_t& node_id, uint64_t& nonce, Alignment& alignment);
     void parse_base(const string& key, const string& value, int64_t& aln_id, Alignment& alignment);
+    // Parse only the path out of a serialized Alignment, skipping every other
+    // field. Returns false if the data is malformed.
+    static bool parse_alignment_path(const char* data, size_t size, Path& path);
     void parse_traversal(const string& key, const string& value, int64_t& node_id, int16_t& rank, bool& backward, int64_t& aln_id);
 
     // for dumping graph state/ inspection
@@ -213,6 +276,9 @@ public:
     string base_entry_to_string(const string& key, const string& value);
     string traversal_entry_to_string(const string& key, const string& value);
 
+    // pull the alignment id out of a traversal key
+    int64_t traversal_alignment_id(const rocksdb::Slice& key);
+
     // accessors, traversal, context
     void get_context(int64_t id, VG& graph);
     // Augment the given graph with the nodes referenced by orphan edges, and
@@ -333,6 +399,54 @@ public:
 
 };
 
+/**
+ * Loads large numbers of keys into an open Index without going through its
+ * memtables. Keys are buffered per thread and spilled to sorted runs in a
+ * temporary directory. When finished, the runs are merged into one SST file
+ * per key range, with the ranges written in parallel, and the files are
+ * ingested into the database in one step.
+ *
+ * put() may be called from any OpenMP thread. Keys must be unique.
+ */
+class BulkIngester {
+public:
+
+    // Buffer at most max_buffer_bytes of keys and values in memory across all
+    // threads, and spill runs into temp_dir
+    BulkIngester(Index& index, size_t max_buffer_bytes = size_t(1) << 30, const string& temp_dir = "");
+    ~BulkIngester(void);
+
+    void put(const string& key, const string& value);
+
+    // Write the SST files and ingest them into the index
+    void finish(void);
+
+private:
+
+    // A sorted run spilled to disk, with every sample_interval-th key and its
+    // offset so merges can start partway through
+    struct Run {
+        string file_name;
+        vector<pair<string, streamoff>> samples;
+    };
+
+    static const size_t sample_interval = 1024;
+
+    // Sort a thread's buffer and write it out as a run
+    void spill(vector<pair<string, string>>& buffer);
+    // Merge the keys in [start, end) from all the runs into an SST file.
+    // An empty end means no upper bound. Returns false if the range is empty.
+    bool write_range(const string& start, const string& end, const string& sst_file_name);
+
+    Index& index;
+    string temp_dir;
+    size_t max_thread_bytes;
+    vector<vector<pair<string, string>>> buffers;
+    vector<size_t> buffer_bytes;
+    vector<Run> runs;
+    bool finished;
+};
+
 class indexOpenException: public exception
 {
     string message;
@@ -1,5 +1,10 @@
 #include "kmer.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <tuple>
+
 namespace vg {
 
 void for_each_kmer(const HandleGraph& graph, size_t k,
@@ -8,7 +13,7 @@ void for_each_kmer(const HandleGraph& graph, size_t k,
     // for each position on the forward and reverse of the graph
     // TODO -- add parallel interface in handlegraph
     bool using_head_tail = head_id + tail_id > 0;
-    graph.for_each_handle([&](const handle_t& h) {
+    auto kmers_from_handle = [&](const handle_t& h) {
             // for the forward and reverse of this handle
             // walk k bases from the end, so that any kmer starting on the node will be represented in the tree we build
             for (auto handle_is_rev : { false, true }) {
@@ -167,7 +172,19 @@ void for_each_kmer(const HandleGraph& graph, size_t k,
                     }
                 }
             }
-        }, true);
+        };
+
+    // Give each thread a run of nodes at a time, rather than one node, so
+    // that the kmers it finds together come from the same part of the graph
+    vector<handle_t> handles;
+    handles.reserve(graph.node_size());
+    graph.for_each_handle([&](const handle_t& h) {
+            handles.push_back(h);
+        });
+#pragma omp parallel for schedule(dynamic, 64)
+    for (size_t i = 0; i < handles.size(); ++i) {
+        kmers_from_handle(handles[i]);
+    }
 }
 
 ostream& operator<<(ostream& out, const kmer_t& kmer) {
@@ -220,6 +237,12 @@ gcsa::byte_type encode_chars(const vector<char>& chars, const gcsa::Alphabet& al
 }
 
 void write_gcsa_kmers(const HandleGraph& graph, int kmer_size, ostream& out, id_t head_id, id_t tail_id) {
+    size_t size_limit = numeric_limits<size_t>::max();
+    write_gcsa_kmers(graph, kmer_size, out, size_limit, head_id, tail_id);
+}
+
+void write_gcsa_kmers(const HandleGraph& graph, int kmer_size, ostream& out, size_t& size_limit,
+                      id_t head_id, id_t tail_id) {
 
     // We need an alphabet to parse the internal string format
     const gcsa::Alphabet alpha;
@@ -233,17 +256,44 @@ void write_gcsa_kmers(const HandleGraph& graph, int kmer_size, ostream& out, id_
             thread_outputs.resize(omp_get_num_threads());
         }
     }
+    // How many bytes we have written, and whether we have had to stop
+    size_t total_size = 0;
+    atomic<bool> over_limit(false);
     // This handles the buffered writing for each thread
     size_t buffer_limit = 1e5; // max 100k kmers per buffer
     auto handle_kmers = [&](vector<gcsa::KMer>& kmers, bool more) {
         if (!more || kmers.size() > buffer_limit) {
+            // Walks with the same sequence from the same start can make the
+            // same KMers, and a thread's buffer covers a run of nodes, so
+            // drop duplicates before they ever hit the disk
+            sort(kmers.begin(), kmers.end(), [](const gcsa::KMer& a, const gcsa::KMer& b) {
+                return tie(a.key, a.from, a.to) < tie(b.key, b.from, b.to);
+            });
+            kmers.erase(unique(kmers.begin(), kmers.end(), [](const gcsa::KMer& a, const gcsa::KMer& b) {
+                return a.key == b.key && a.from == b.from && a.to == b.to;
+            }), kmers.end());
 #pragma omp critical (gcsa_kmer_out)
-            gcsa::writeBinary(out, kmers, kmer_size);
+            if (!over_limit) {
+                streampos before = out.tellp();
+                gcsa::writeBinary(out, kmers, kmer_size);
+                streampos after = out.tellp();
+                // Charge what the stream actually grew by, block header and
+                // all, unless it can't tell us (like a pipe)
+                total_size += (before != streampos(-1) && after != streampos(-1)) ?
+                    size_t(after - before) : kmers.size() * sizeof(gcsa::KMer);
+                if (total_size > size_limit) {
+                    over_limit = true;
+                }
+            }
             kmers.clear();
         }
     };
     // Here we convert our kmer_t to gcsa::KMer
-    auto convert_kmer = [&thread_outputs, &alpha, &head_id, &tail_id, &handle_kmers](const kmer_t& kmer) {
+    auto convert_kmer = [&thread_outputs, &alpha, &over_limit, &handle_kmers](const kmer_t& kmer) {
+        if (over_limit) {
+            // There's no point in finishing
+            return;
+        }
         // Convert this KmerPosition to several gcsa::KMers, and save them in thread_outputs
         vector<gcsa::KMer>& thread_output = thread_outputs[omp_get_thread_num()];
         kmer_to_gcsa_kmers(kmer, alpha, [&thread_output](const gcsa::KMer& k) { thread_output.push_back(k); });
@@ -256,15 +306,32 @@ void write_gcsa_kmers(const HandleGraph& graph, int kmer_size, ostream& out, id_
         // Flush our buffers
         handle_kmers(thread_output, false);
     }
+    if (over_limit) {
+        throw SizeLimitExceededException();
+    }
+    size_limit -= total_size;
 }
 
 string write_gcsa_kmers_to_tmpfile(const HandleGraph& graph, int kmer_size, id_t head_id, id_t tail_id,
                                    const string& base_file_name) {
+    size_t size_limit = numeric_limits<size_t>::max();
+    return write_gcsa_kmers_to_tmpfile(graph, kmer_size, size_limit, head_id, tail_id, base_file_name);
+}
+
+string write_gcsa_kmers_to_tmpfile(const HandleGraph& graph, int kmer_size, size_t& size_limit,
+                                   id_t head_id, id_t tail_id,
+                                   const string& base_file_name) {
     // open a temporary file for the kmers
     string tmpfile = tmpfilename(base_file_name);
     ofstream out(tmpfile);
     // write the kmers to the temporary file
-    write_gcsa_kmers(graph, kmer_size, out, head_id, tail_id);
+    try {
+        write_gcsa_kmers(graph, kmer_size, out, size_limit, head_id, tail_id);
+    } catch (SizeLimitExceededException& e) {
+        out.close();
+        remove(tmpfile.c_str());
+        throw;
+    }
     out.close();
     return tmpfile;
 }
@@ -2,6 +2,7 @@
 #define VG_KMER_HPP_INCLUDED
 
 #include "vg.pb.h"
+#include <exception>
 #include <iostream>
 #include "json2pb.h"
 #include "handle.hpp"
@@ -40,7 +41,16 @@ struct kmer_t {
     vector<char> next_char;
 };
 
-/// Iterate over all the kmers in the graph, running lambda on each
+/// Thrown when writing out kmers would go over the space we were allowed
+class SizeLimitExceededException : public exception {
+public:
+    virtual const char* what() const noexcept {
+        return "kmer files exceeded the temporary space limit";
+    }
+};
+
+/// Iterate over all the kmers in the graph, running lambda on each. Threads
+/// take contiguous ranges of nodes, and lambda may run on any of them at once.
 void for_each_kmer(const HandleGraph& graph, size_t k,
                    const function<void(const kmer_t&)>& lambda,
                    id_t head_id = 0, id_t tail_id = 0);
@@ -54,13 +64,28 @@ void kmer_to_gcsa_kmers(const kmer_t& kmer, const gcsa::Alphabet& alpha, const f
 /// Encode the chars into the gcsa2 byte
 gcsa::byte_type encode_chars(const vector<char>& chars, const gcsa::Alphabet& alpha);
 
-/// Write GCSA2 formatted binary KMers to the given ostream
+/// Write GCSA2 formatted binary KMers to the given ostream. Each thread's
+/// buffer of KMers is sorted and deduplicated before it is written.
 void write_gcsa_kmers(const HandleGraph& graph, int kmer_size, ostream& out, id_t head_id, id_t tail_id);
 
+/// Write GCSA2 formatted binary KMers to the given ostream, using no more than
+/// size_limit bytes. Takes the bytes written off of size_limit, so one limit
+/// can be shared by several calls. Throws SizeLimitExceededException, leaving
+/// the stream incomplete, once the written bytes pass the limit.
+void write_gcsa_kmers(const HandleGraph& graph, int kmer_size, ostream& out, size_t& size_limit,
+                      id_t head_id, id_t tail_id);
+
 /// Open a tempfile and write the kmers to it. The calling context should remove it.
 string write_gcsa_kmers_to_tmpfile(const HandleGraph& graph, int kmer_size, id_t head_id, id_t tail_id,
                                    const string& base_file_name = ".vg-kmers-tmp-");
 
+/// Open a tempfile and write the kmers to it, within a size limit in bytes as
+/// for write_gcsa_kmers(). The calling context should remove it, and it is
+/// removed already if SizeLimitExceededException is thrown.
+string write_gcsa_kmers_to_tmpfile(const HandleGraph& graph, int kmer_size, size_t& size_limit,
+                                   id_t head_id, id_t tail_id,
+                                   const string& base_file_name = ".vg-kmers-tmp-");
+
 }
 
 #endif
@@ -1398,6 +1398,19 @@ void BaseMapper::init_aligner(int8_t match, int8_t mismatch, int8_t gap_open, in
     qual_adj_aligner = new QualAdjAligner(match, mismatch, gap_open, gap_extend, full_length_bonus,
                                           max_score, 255, gc_content);
     regular_aligner = new Aligner(match, mismatch, gap_open, gap_extend, full_length_bonus);
+    
+    qual_adj_aligner->fast_exp_mapping_quality = fast_exp_mapping_quality;
+    regular_aligner->fast_exp_mapping_quality = fast_exp_mapping_quality;
+}
+    
+void BaseMapper::set_fast_exp_mapping_quality(bool fast_exp) {
+    fast_exp_mapping_quality = fast_exp;
+    if (qual_adj_aligner) {
+        qual_adj_aligner->fast_exp_mapping_quality = fast_exp;
+    }
+    if (regular_aligner) {
+        regular_aligner->fast_exp_mapping_quality = fast_exp;
+    }
 }
 
 void BaseMapper::apply_haplotype_consistency_scores(const vector<Alignment*>& alns) {
@@ -1547,8 +1560,7 @@ void BaseMapper::set_fragment_length_distr_params(size_t maximum_sample_size, si
         cerr << "warning:[vg::Mapper] overwriting a fragment length distribution that has already been estimated" << endl;
     }
     
-    fragment_length_distr = FragmentLengthDistribution(maximum_sample_size, reestimation_frequency,
-                                                       robust_estimation_fraction);
+    fragment_length_distr.reset(maximum_sample_size, reestimation_frequency, robust_estimation_fraction);
 }
     
 Mapper::Mapper(xg::XG* xidex,
@@ -1585,11 +1597,16 @@ Mapper::Mapper(xg::XG* xidex,
     , pair_rescue_retry_threshold(0.5)
     , include_full_length_bonuses(true)
 {
-    
+    // Estimate fragment lengths continuously, at the same interval the cached
+    // fragment model is updated
+    frag_stats.length_distr = &fragment_length_distr;
+    fragment_length_distr.reset(0, frag_stats.fragment_model_update_interval, 0.95);
 }
 
 Mapper::Mapper(void) : BaseMapper() {
-    // Nothing to do. Default constructed and can't really do anything.
+    // Default constructed and can't really do anything, but keep the fragment
+    // model pointed somewhere valid
+    frag_stats.length_distr = &fragment_length_distr;
 }
 
 Mapper::~Mapper(void) {
@@ -2056,6 +2073,12 @@ pair<vector<Alignment>, vector<Alignment>> Mapper::align_paired_multi(
     bool only_top_scoring_pair,
     bool retrying) {
 
+    pair<vector<Alignment>, vector<Alignment>> cached;
+    if (read_cache != nullptr && !retrying && read_cache->lookup_pair(first_mate, second_mate, cached)) {
+        // We've already mapped an identical pair
+        return cached;
+    }
+
     Alignment read1;
     read1.set_name(first_mate.name());
     read1.set_sequence(first_mate.sequence());
@@ -2492,7 +2515,7 @@ pair<vector<Alignment>, vector<Alignment>> Mapper::align_paired_multi(
     }
     int k = 0;
     for (auto& se_aln : se_alns) {
-        alns.push_back(se_aln);
+        alns.push_back(std::move(se_aln));
         cluster_ptrs.push_back(se_cluster_ptrs[k]);
         ++k;
     }
@@ -2558,7 +2581,7 @@ pair<vector<Alignment>, vector<Alignment>> Mapper::align_paired_multi(
     }
     k = 0;
     for (auto& pe_aln : pe_alns) {
-        alns.push_back(pe_aln);
+        alns.push_back(std::move(pe_aln));
         cluster_ptrs.push_back(pe_cluster_ptrs[k]);
         ++k;
     }
@@ -2600,9 +2623,10 @@ pair<vector<Alignment>, vector<Alignment>> Mapper::align_paired_multi(
     for (auto& p : aln_ptrs) {
         read1_max_score = max(p->first.score(), read1_max_score);
         read2_max_score = max(p->second.score(), read2_max_score);
-        results.first.push_back(p->first);
-        results.second.push_back(p->second);
         possible_pairs += p->first.score() > 0 && p->second.score() > 0;
+        // the pairs are not needed after this, so hand them over without copying
+        results.first.push_back(std::move(p->first));
+        results.second.push_back(std::move(p->second));
     }
     bool max_first = results.first.size() && (read1_max_score == results.first.front().score() && read2_max_score == results.second.front().score());
 
@@ -2718,6 +2742,11 @@ pair<vector<Alignment>, vector<Alignment>> Mapper::align_paired_multi(
     annotate_with_initial_path_positions(results.first);
     annotate_with_initial_path_positions(results.second);
 
+    if (read_cache != nullptr && !queued_resolve_later && frag_stats.fragment_size) {
+        // Only remember pairs mapped under an established fragment model
+        read_cache->store_pair(first_mate, second_mate, results);
+    }
+
     return results;
 
 }
@@ -3026,7 +3055,7 @@ Mapper::align_mem_multi(const Alignment& aln,
 #endif
 
         if (!seen_alignments.count(sig)) {
-            alns.push_back(candidate);
+            alns.push_back(std::move(candidate));
             used_clusters.push_back(&cluster);
             seen_alignments.insert(sig);
         }
@@ -3076,14 +3105,11 @@ Mapper::align_mem_multi(const Alignment& aln,
             }),
         aln_ptrs.end());
     if (aln_ptrs.size()) {
+        // alns is about to be replaced, so move out of it rather than copying
         vector<Alignment> best_alns;
-        int i = 0;
-        for ( ; i < min((int)aln_ptrs.size(), keep_multimaps); ++i) {
-            Alignment* alnp = aln_ptrs.at(i);
-            best_alns.push_back(*alnp);
-        }
-        for ( ; i < aln_ptrs.size(); ++i) {
-            best_alns.push_back(*aln_ptrs[i]);
+        best_alns.reserve(aln_ptrs.size());
+        for (Alignment* alnp : aln_ptrs) {
+            best_alns.push_back(std::move(*alnp));
         }
         alns = score_sort_and_deduplicate_alignments(best_alns, aln);
     }
@@ -3387,30 +3413,36 @@ void FragmentLengthStatistics::record_fragment_configuration(const Alignment& al
             fragment_directions.pop_back();
         }
         // assume we can record the fragment length
-        fragment_lengths.push_front(abs(length));
-        if (fragment_lengths.size() > fragment_length_cache_size) {
-            auto last = fragment_lengths.back();
-            fragment_lengths.pop_back();
-        }
-        if (++since_last_fragment_length_estimate > fragment_model_update_interval) {
-            cached_fragment_length_mean = fragment_length_mean();
-            cached_fragment_length_stdev = fragment_length_stdev();
-            cached_fragment_orientation_same = fragment_orientation();
-            cached_fragment_direction = fragment_direction();
-            // set our fragment size cap to the cached mean + 10x the standard deviation
-            fragment_size = cached_fragment_length_mean + fragment_sigma * cached_fragment_length_stdev;
-            since_last_fragment_length_estimate = 1;
+        length_distr->register_fragment_length(abs(length));
+        // until we have a fragment size, pick up the first estimate as soon as any thread's
+        // measurements produce one
+        if (++since_last_fragment_length_estimate > fragment_model_update_interval || fragment_size == 0) {
+            update_cached_parameters();
         }
     }
 }
 
+void FragmentLengthStatistics::update_cached_parameters(void) {
+    FragmentLengthDistribution::Estimate estimate = length_distr->snapshot();
+    if (estimate.sample_size == 0) {
+        // nothing has been estimated yet
+        return;
+    }
+    cached_fragment_length_mean = estimate.mean;
+    cached_fragment_length_stdev = estimate.stdev;
+    cached_fragment_orientation_same = fragment_orientation();
+    cached_fragment_direction = fragment_direction();
+    // set our fragment size cap to the cached mean + 10x the standard deviation
+    fragment_size = cached_fragment_length_mean + fragment_sigma * cached_fragment_length_stdev;
+    since_last_fragment_length_estimate = 1;
+}
+
 double FragmentLengthStatistics::fragment_length_stdev(void) {
-    return stdev(fragment_lengths);
+    return length_distr->stdev();
 }
 
 double FragmentLengthStatistics::fragment_length_mean(void) {
-    double sum = std::accumulate(fragment_lengths.begin(), fragment_lengths.end(), 0.0);
-    return sum / fragment_lengths.size();
+    return length_distr->mean();
 }
 
 double FragmentLengthStatistics::fragment_length_pdf(double length) {
@@ -3914,11 +3946,11 @@ vector<Alignment> Mapper::score_sort_and_deduplicate_alignments(vector<Alignment
             if(!serializedAlignmentsUsed.count(serialized)) {
                 // This alignment hasn't been produced yet. Produce it. The
                 // order in the alignment vector doesn't matter for things with
-                // the same score.
-                sorted_unique_alignments.push_back(*pointer);
+                // the same score. The input is consumed, so we can move it.
+                sorted_unique_alignments.push_back(std::move(*pointer));
                 
                 // Save it so we can avoid putting it in the vector again
-                serializedAlignmentsUsed.insert(serialized);
+                serializedAlignmentsUsed.insert(std::move(serialized));
             }
         }
     }
@@ -3939,12 +3971,23 @@ void Mapper::filter_and_process_multimaps(vector<Alignment>& sorted_unique_align
 }
     
 vector<Alignment> Mapper::align_multi(const Alignment& aln, int kmer_size, int stride, int max_mem_length, int band_width) {
+    vector<Alignment> alignments;
+    if (read_cache != nullptr && read_cache->lookup(aln, alignments)) {
+        // We've already mapped an identical read
+        return alignments;
+    }
+    
     double cluster_mq = 0;
     Alignment clean_aln;
     clean_aln.set_name(aln.name());
     clean_aln.set_sequence(aln.sequence());
     clean_aln.set_quality(aln.quality());
-    return align_multi_internal(true, clean_aln, kmer_size, stride, max_mem_length, band_width, cluster_mq, max_multimaps, extra_multimaps, nullptr);
+    alignments = align_multi_internal(true, clean_aln, kmer_size, stride, max_mem_length, band_width, cluster_mq, max_multimaps, extra_multimaps, nullptr);
+    
+    if (read_cache != nullptr) {
+        read_cache->store(aln, alignments);
+    }
+    return alignments;
 }
     
 vector<Alignment> Mapper::align_multi_internal(bool compute_unpaired_quality,
@@ -5159,12 +5202,9 @@ void AlignmentChainModel::display(ostream& out) {
 
 FragmentLengthDistribution::FragmentLengthDistribution(size_t maximum_sample_size,
                                                        size_t reestimation_frequency,
-                                                       double robust_estimation_fraction) :
-    maximum_sample_size(maximum_sample_size),
-    reestimation_frequency(reestimation_frequency),
-    robust_estimation_fraction(robust_estimation_fraction)
+                                                       double robust_estimation_fraction)
 {
-    assert(0.0 < robust_estimation_fraction && robust_estimation_fraction < 1.0);
+    reset(maximum_sample_size, reestimation_frequency, robust_estimation_fraction);
 }
 
 FragmentLengthDistribution::FragmentLengthDistribution() : FragmentLengthDistribution(0, 1, 0.5)
@@ -5175,10 +5215,43 @@ FragmentLengthDistribution::FragmentLengthDistribution() : FragmentLengthDistrib
 FragmentLengthDistribution::~FragmentLengthDistribution() {
     
 }
+    
+void FragmentLengthDistribution::reset(size_t maximum_sample_size,
+                                       size_t reestimation_frequency,
+                                       double robust_estimation_fraction) {
+    assert(0.0 < robust_estimation_fraction && robust_estimation_fraction < 1.0);
+    assert(reestimation_frequency > 0);
+    
+    this->maximum_sample_size = maximum_sample_size;
+    this->reestimation_frequency = reestimation_frequency;
+    this->robust_estimation_fraction = robust_estimation_fraction;
+    
+    length_counts.clear();
+    sample_size = 0;
+    is_fixed = false;
+    
+    // one buffer for every thread we might be asked to run on
+    thread_buffers.clear();
+    thread_buffers.resize(max(omp_get_max_threads(), omp_get_num_procs()));
+    
+    // merge in batches that evenly divide the reestimation frequency and the maximum
+    // sample size, so that a single thread reestimates at exactly the same points
+    // it would if every measurement were merged as soon as it arrived
+    merge_batch_size = 32;
+    while (reestimation_frequency % merge_batch_size != 0
+           || (maximum_sample_size != 0 && maximum_sample_size % merge_batch_size != 0)) {
+        merge_batch_size /= 2;
+    }
+    
+    estimate_version = 0;
+    mu = 0.0;
+    sigma = 1.0;
+    estimate_sample_size = 0;
+}
 
 void FragmentLengthDistribution::force_parameters(double mean, double stddev) {
-    mu = mean;
-    sigma = stddev;
+    lock_guard<mutex> guard(histogram_mutex);
+    publish(mean, stddev);
     is_fixed = true;
 }
 
@@ -5188,49 +5261,97 @@ void FragmentLengthDistribution::register_fragment_length(int64_t length) {
     if (is_fixed) {
         return;
     }
-#pragma omp critical
-    {
-        // in case the distribution became fixed while this thread was waiting
-        // to execute the critical block
-        if (!is_fixed) {
-            lengths.insert((double) length);
-            if (lengths.size() == maximum_sample_size) {
-                // we've reached the maximum sample we wanted, so fix the estimation
-                estimate_distribution();
-                is_fixed = true;
-            }
-            else if (lengths.size() % reestimation_frequency == 0) {
-                estimate_distribution();
-            }
+    
+    size_t thread_num = omp_get_thread_num();
+    if (thread_num >= thread_buffers.size()) {
+        // this thread has no buffer of its own, so merge the measurement directly
+        vector<int64_t> single(1, length);
+        lock_guard<mutex> guard(histogram_mutex);
+        merge_buffer(single);
+        return;
+    }
+    
+    vector<int64_t>& buffer = thread_buffers[thread_num].lengths;
+    buffer.push_back(length);
+    
+    // merge the buffer if it's full and nobody else is merging right now; if
+    // someone is, we'll keep collecting and try again with the next measurement
+    if (buffer.size() >= merge_batch_size && histogram_mutex.try_lock()) {
+        merge_buffer(buffer);
+        histogram_mutex.unlock();
+    }
+}
+    
+void FragmentLengthDistribution::flush() {
+    lock_guard<mutex> guard(histogram_mutex);
+    for (ThreadBuffer& thread_buffer : thread_buffers) {
+        merge_buffer(thread_buffer.lengths);
+    }
+    // bring the estimate up to date with measurements that fell between reestimations
+    if (!is_fixed && sample_size > 0 && estimate_sample_size != sample_size) {
+        estimate_distribution();
+    }
+}
+    
+void FragmentLengthDistribution::merge_buffer(vector<int64_t>& buffer) {
+    for (int64_t length : buffer) {
+        // in case the distribution became fixed while this buffer was filling
+        if (is_fixed) {
+            break;
+        }
+        length_counts[length]++;
+        size_t new_size = ++sample_size;
+        if (new_size == maximum_sample_size) {
+            // we've reached the maximum sample we wanted, so fix the estimation
+            estimate_distribution();
+            is_fixed = true;
+        }
+        else if (new_size % reestimation_frequency == 0) {
+            estimate_distribution();
         }
     }
+    buffer.clear();
 }
     
 void FragmentLengthDistribution::estimate_distribution() {
     // remove the tails from the estimation
-    size_t to_skip = (size_t) (lengths.size() * (1.0 - robust_estimation_fraction) * 0.5);
-    auto begin = lengths.begin();
-    auto end = lengths.end();
-    for (size_t i = 0; i < to_skip; i++) {
-        begin++;
-        end--;
-        
-    }
-    // compute cumulants
+    size_t total = sample_size;
+    size_t to_skip = (size_t) (total * (1.0 - robust_estimation_fraction) * 0.5);
+    size_t window_end = total - to_skip;
+    
+    // compute cumulants over the measurements with sorted rank in [to_skip, total - to_skip)
     double count = 0.0;
     double sum = 0.0;
     double sum_of_sqs = 0.0;
-    for (auto iter = begin; iter != end; iter++) {
-        count += 1.0;
-        sum += *iter;
-        sum_of_sqs += (*iter) * (*iter);
+    size_t rank = 0;
+    for (auto iter = length_counts.begin(); iter != length_counts.end() && rank < window_end; iter++) {
+        size_t first = max(rank, to_skip);
+        rank += iter->second;
+        size_t last = min(rank, window_end);
+        if (first < last) {
+            double length = (double) iter->first;
+            double multiplicity = (double) (last - first);
+            count += multiplicity;
+            sum += multiplicity * length;
+            sum_of_sqs += multiplicity * length * length;
+        }
     }
     // use cumulants to compute moments
-    mu = sum / count;
-    double raw_var = sum_of_sqs / count - mu * mu;
+    double new_mu = sum / count;
+    double raw_var = sum_of_sqs / count - new_mu * new_mu;
     // apply method of moments estimation using the appropriate truncated normal distribution
     double a = normal_inverse_cdf(1.0 - 0.5 * (1.0 - robust_estimation_fraction));
-    sigma = sqrt(raw_var / (1.0 - 2.0 * a * normal_pdf(a, 0.0, 1.0)));
+    publish(new_mu, sqrt(raw_var / (1.0 - 2.0 * a * normal_pdf(a, 0.0, 1.0))));
+}
+    
+void FragmentLengthDistribution::publish(double new_mu, double new_sigma) {
+    // an odd version tells readers that the parameters are being changed
+    uint64_t version = estimate_version;
+    estimate_version = version + 1;
+    mu = new_mu;
+    sigma = new_sigma;
+    estimate_sample_size = sample_size.load();
+    estimate_version = version + 2;
 }
     
 double FragmentLengthDistribution::mean() const {
@@ -5240,6 +5361,22 @@ double FragmentLengthDistribution::mean() const {
 double FragmentLengthDistribution::stdev() const {
     return sigma;
 }
+    
+FragmentLengthDistribution::Estimate FragmentLengthDistribution::snapshot() const {
+    Estimate estimate;
+    while (true) {
+        uint64_t version = estimate_version;
+        if (version % 2 == 0) {
+            estimate.mean = mu;
+            estimate.stdev = sigma;
+            estimate.sample_size = estimate_sample_size;
+            if (estimate_version == version) {
+                // nothing was published while we were reading
+                return estimate;
+            }
+        }
+    }
+}
 
 bool FragmentLengthDistribution::is_finalized() const {
     return is_fixed;
@@ -5250,14 +5387,14 @@ size_t FragmentLengthDistribution::max_sample_size() const {
 }
     
 size_t FragmentLengthDistribution::curr_sample_size() const {
-    return lengths.size();
+    return sample_size;
 }
     
-multiset<double>::const_iterator FragmentLengthDistribution::measurements_begin() const {
-    return lengths.begin();
+map<int64_t, size_t>::const_iterator FragmentLengthDistribution::measurements_begin() const {
+    return length_counts.begin();
 }
 
-multiset<double>::const_iterator FragmentLengthDistribution::measurements_end() const {
-    return lengths.end();
+map<int64_t, size_t>::const_iterator FragmentLengthDistribution::measurements_end() const {
+    return length_counts.end();
 }
 }
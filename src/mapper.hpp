@@ -5,6 +5,8 @@
 #include <map>
 #include <chrono>
 #include <ctime>
+#include <atomic>
+#include <mutex>
 #include "omp.h"
 #include "vg.hpp"
 #include "xg.hpp"
@@ -24,6 +26,7 @@
 #include "cluster.hpp"
 #include "graph.hpp"
 #include "translator.hpp"
+#include "read_cache.hpp"
 
 namespace vg {
 
@@ -80,10 +83,22 @@ public:
 /*
  * A class that keeps a running estimation of a fragment length distribution
  * using a robust estimation formula in order to be insensitive to outliers.
+ *
+ * Measurements may be registered from many threads at once. Each thread
+ * collects measurements in its own buffer and merges them into a shared
+ * histogram only when it can do so without waiting, so registering never
+ * blocks. Readers see the most recently published estimate without locking.
  */
 class FragmentLengthDistribution {
 public:
     
+    /// A consistent view of the estimated parameters
+    struct Estimate {
+        double mean;
+        double stdev;
+        size_t sample_size;
+    };
+    
     /// Initialize distribution
     ///
     /// Args:
@@ -96,12 +111,25 @@ public:
     FragmentLengthDistribution(void);
     ~FragmentLengthDistribution();
     
+    /// Discard all measurements and start estimating again with new parameters.
+    /// Not safe to call concurrently with any other method.
+    void reset(size_t maximum_sample_size,
+               size_t reestimation_frequency,
+               double robust_estimation_fraction);
     
     /// Instead of estimating anything, just use these parameters.
     void force_parameters(double mean, double stddev);
     
-    /// Record an observed fragment length
+    /// Record an observed fragment length. Measurements are buffered per
+    /// thread, so they may not show up in the estimate until flush() is
+    /// called.
     void register_fragment_length(int64_t length);
+    
+    /// Merge the measurements that every thread still has buffered,
+    /// reestimating as necessary. Not safe to call concurrently with
+    /// register_fragment_length(); call it once a batch of work that records
+    /// measurements has finished.
+    void flush();
 
     /// Robust mean of the distribution observed so far
     double mean() const;
@@ -109,6 +137,10 @@ public:
     /// Robust standard deviation of the distribution observed so far
     double stdev() const;
     
+    /// The mean and standard deviation from the same estimation, along with
+    /// the number of measurements it used
+    Estimate snapshot() const;
+    
     /// Returns true if the maximum sample size has been reached, which finalizes the
     /// distribution estimate
     bool is_finalized() const;
@@ -117,29 +149,58 @@ public:
     /// parameters
     size_t max_sample_size() const;
     
-    /// Returns the number of samples that have been collected so far
+    /// Returns the number of samples that have been merged into the estimate so far
     size_t curr_sample_size() const;
     
-    /// Begin iterator to the measurements that the distribution has used to estimate the
-    /// parameters
-    multiset<double>::const_iterator measurements_begin() const;
+    /// Begin iterator to the (length, count) histogram of measurements that the
+    /// distribution has used to estimate the parameters. Only stable once finalized.
+    map<int64_t, size_t>::const_iterator measurements_begin() const;
     
-    /// End iterator to the measurements that the distribution has used to estimate the
-    /// parameters
-    multiset<double>::const_iterator measurements_end() const;
+    /// End iterator to the (length, count) histogram of measurements that the
+    /// distribution has used to estimate the parameters. Only stable once finalized.
+    map<int64_t, size_t>::const_iterator measurements_end() const;
     
 private:
-    multiset<double> lengths;
-    bool is_fixed = false;
+    
+    /// Measurements waiting to be merged by one thread, padded to keep
+    /// different threads' buffers off each other's cache lines
+    struct ThreadBuffer {
+        vector<int64_t> lengths;
+        char padding[64];
+    };
+    
+    /// Merge this buffer into the histogram, reestimating as necessary.
+    /// Must hold histogram_mutex.
+    void merge_buffer(vector<int64_t>& buffer);
+    
+    /// Recompute the parameters from the histogram and publish them. Must hold
+    /// histogram_mutex.
+    void estimate_distribution();
+    
+    /// Make new parameters visible to readers. Must hold histogram_mutex.
+    void publish(double new_mu, double new_sigma);
+    
+    /// Counts of each measured length
+    map<int64_t, size_t> length_counts;
+    /// Total of the counts in length_counts
+    atomic<size_t> sample_size;
+    mutex histogram_mutex;
+    vector<ThreadBuffer> thread_buffers;
+    /// How many measurements a thread collects before trying to merge them
+    size_t merge_batch_size = 1;
+    
+    atomic<bool> is_fixed;
     
     double robust_estimation_fraction;
     size_t maximum_sample_size;
     size_t reestimation_frequency;
     
-    double mu = 0.0;
-    double sigma = 1.0;
-    
-    void estimate_distribution();
+    /// The published parameters, guarded by a sequence lock so that readers
+    /// can see a consistent pair without blocking the writer
+    atomic<uint64_t> estimate_version;
+    atomic<double> mu;
+    atomic<double> sigma;
+    atomic<size_t> estimate_sample_size;
 };
     
 class BaseMapper : public Progressive {
@@ -167,6 +228,10 @@ public:
     
     void set_cache_size(int new_cache_size);
     
+    /// Use a fast approximation of exp when computing exact mapping qualities.
+    /// Persists when the aligners are recreated with new scores.
+    void set_fast_exp_mapping_quality(bool fast_exp);
+    
     /// Returns true if fragment length distribution has been fixed
     bool has_fixed_fragment_length_distr();
     
@@ -293,6 +358,8 @@ protected:
     
     int alignment_threads; // how many threads will *this* mapper use. Should not be set directly.
     
+    bool fast_exp_mapping_quality = false; // passed on to the aligners
+    
     void init_aligner(int8_t match, int8_t mismatch, int8_t gap_open, int8_t gap_extend, int8_t full_length_bonus);
     void clear_aligners(void);
     
@@ -352,6 +419,11 @@ class FragmentLengthStatistics {
 public:
 
     void record_fragment_configuration(const Alignment& aln1, const Alignment& aln2, Mapper* mapper);
+    
+    /// Update the cached parameters from the length distribution and the
+    /// orientations and directions recorded so far, if the distribution has
+    /// produced an estimate
+    void update_cached_parameters(void);
 
     string fragment_model_str(void);
     void save_frag_lens_to_alns(Alignment& aln1, Alignment& aln2, const map<string, int64_t>& approx_frag_lengths, bool is_consistent);
@@ -374,8 +446,11 @@ public:
     int64_t since_last_fragment_length_estimate = 0;
     int64_t fragment_model_update_interval = 100;
     
-    // These deques are used for the periodic running estimation of the fragment length distribution
-    deque<double> fragment_lengths;
+    // The distribution that fragment lengths are recorded into and estimated from, which may be
+    // shared between the Mappers for different threads
+    FragmentLengthDistribution* length_distr = nullptr;
+    
+    // These deques are used for the periodic running estimation of the fragment orientation and direction
     deque<bool> fragment_orientations;
     deque<bool> fragment_directions;
 
@@ -418,6 +493,8 @@ private:
                                            vector<MaximalExactMatch>* restricted_mems = nullptr);
     void compute_mapping_qualities(vector<Alignment>& alns, double cluster_mq, double mq_estimate, double mq_cap);
     void compute_mapping_qualities(pair<vector<Alignment>, vector<Alignment>>& pair_alns, double cluster_mq, double mq_estmate1, double mq_estimate2, double mq_cap1, double mq_cap2);
+    /// Sort the alignments by descending score and remove exact duplicates.
+    /// The contents of all_alns are moved into the result.
     vector<Alignment> score_sort_and_deduplicate_alignments(vector<Alignment>& all_alns, const Alignment& original_alignment);
     void filter_and_process_multimaps(vector<Alignment>& all_alns, int total_multimaps);
     // make the bands used in banded alignment
@@ -650,6 +727,11 @@ public:
     
     // Keep track of fragment length distribution statistics
     FragmentLengthStatistics frag_stats;
+    
+    /// If set, results for byte-identical reads and read pairs are looked up
+    /// here before mapping and stored here afterward. May be shared between
+    /// the Mappers of different threads.
+    ReadAlignmentCache* read_cache = nullptr;
 
 };
 
@@ -0,0 +1,151 @@
+#include "mapping_quality.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vg {
+
+using namespace std;
+
+ScaledScores::ScaledScores(size_t size) : values(stack_values), count(size) {
+    if (size > STACK_CAPACITY) {
+        heap_values.resize(size);
+        values = heap_values.data();
+    }
+}
+
+/// Sum exp(scores[i] - shift) over the range [begin, end). The approximate
+/// loop keeps independent partial sums in lanes so that it vectorizes without
+/// needing the compiler to reassociate floating point addition.
+static double sum_exp_shifted(const double* scores, size_t begin, size_t end, double shift, bool approximate_exp) {
+    double sum = 0.0;
+    if (approximate_exp) {
+        const size_t LANES = 4;
+        double lane_sums[LANES] = {0.0, 0.0, 0.0, 0.0};
+        size_t i = begin;
+        for (; i + LANES <= end; i += LANES) {
+            for (size_t j = 0; j < LANES; j++) {
+                lane_sums[j] += fast_exp(scores[i + j] - shift);
+            }
+        }
+        for (; i < end; i++) {
+            sum += fast_exp(scores[i] - shift);
+        }
+        sum += (lane_sums[0] + lane_sums[1]) + (lane_sums[2] + lane_sums[3]);
+    }
+    else {
+        for (size_t i = begin; i < end; i++) {
+            sum += exp(scores[i] - shift);
+        }
+    }
+    return sum;
+}
+
+/// Find the index of the maximum score, preferring later indexes among ties
+static size_t max_score_index(const double* scores, size_t count) {
+    size_t max_idx = 0;
+    for (size_t i = 1; i < count; i++) {
+        if (scores[i] >= scores[max_idx]) {
+            max_idx = i;
+        }
+    }
+    return max_idx;
+}
+
+double log_sum_exp(const double* scores, size_t count, bool approximate_exp) {
+    double max_score = scores[max_score_index(scores, count)];
+    return max_score + log(sum_exp_shifted(scores, 0, count, max_score, approximate_exp));
+}
+
+double max_score_error_neg_log(const double* scores, size_t count, size_t* max_idx_out, bool approximate_exp) {
+
+    if (count == 1) {
+        // assume a null alignment of 0.0 for comparison since this is local
+        double with_null[2] = {scores[0], 0.0};
+        double error_neg_log = max_score_error_neg_log(with_null, 2, max_idx_out, approximate_exp);
+        *max_idx_out = 0;
+        return error_neg_log;
+    }
+
+    size_t max_idx = max_score_index(scores, count);
+    *max_idx_out = max_idx;
+
+    // sum the likelihoods of everything but the maximum relative to it, so that
+    // a small error probability isn't lost by subtracting it from 1
+    double max_score = scores[max_idx];
+    double others = (sum_exp_shifted(scores, 0, max_idx, max_score, approximate_exp)
+                     + sum_exp_shifted(scores, max_idx + 1, count, max_score, approximate_exp));
+
+    // P(error) = others / (1 + others)
+    return log1p(1.0 / others);
+}
+
+double max_score_error_neg_log_approx(const double* scores, size_t count, size_t* max_idx_out) {
+
+    if (count == 1) {
+        // assume a null alignment of 0.0 for comparison since this is local
+        double with_null[2] = {scores[0], 0.0};
+        double error_neg_log = max_score_error_neg_log_approx(with_null, 2, max_idx_out);
+        *max_idx_out = 0;
+        return error_neg_log;
+    }
+
+    double max_score = scores[0];
+    size_t max_idx = 0;
+
+    double next_score = std::numeric_limits<double>::lowest();
+    int32_t next_count = 0;
+
+    for (size_t i = 1; i < count; ++i) {
+        double score = scores[i];
+        if (score > max_score) {
+            if (next_score == max_score) {
+                next_count++;
+            }
+            else {
+                next_score = max_score;
+                next_count = 1;
+            }
+            max_score = score;
+            max_idx = i;
+        }
+        else if (score > next_score) {
+            next_score = score;
+            next_count = 1;
+        }
+        else if (score == next_score) {
+            next_count++;
+        }
+    }
+
+    *max_idx_out = max_idx;
+
+    return max(0.0, max_score - next_score - (next_count > 1 ? log(next_count) : 0.0));
+}
+
+double group_error_neg_log(const double* scores, size_t count, const vector<size_t>& group, bool approximate_exp) {
+
+    if (count == 1) {
+        // assume a null alignment of 0.0 for comparison since this is local
+        double with_null[2] = {scores[0], 0.0};
+        return group_error_neg_log(with_null, 2, group, approximate_exp);
+    }
+
+    double max_score = scores[max_score_index(scores, count)];
+
+    double total = sum_exp_shifted(scores, 0, count, max_score, approximate_exp);
+
+    // sum the runs of scores between the group members
+    double non_group = 0.0;
+    size_t run_begin = 0;
+    for (size_t group_idx : group) {
+        non_group += sum_exp_shifted(scores, run_begin, group_idx, max_score, approximate_exp);
+        run_begin = group_idx + 1;
+    }
+    non_group += sum_exp_shifted(scores, run_begin, count, max_score, approximate_exp);
+
+    return log(total) - log(non_group);
+}
+
+}
@@ -0,0 +1,106 @@
+#ifndef VG_MAPPING_QUALITY_HPP_INCLUDED
+#define VG_MAPPING_QUALITY_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** \file
+ * Kernels for turning the scaled scores of a read's candidate alignments into
+ * mapping qualities. They work on flat arrays of scores so that callers can
+ * keep the scores in a stack buffer, and they evaluate log-sum-exp with one
+ * pass of exponentials that the compiler can vectorize instead of one
+ * add_log (an exp and a log) per alignment.
+ */
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * A buffer of scaled alignment scores that lives on the stack unless a read
+ * has an unusually large number of candidate alignments.
+ */
+class ScaledScores {
+public:
+
+    /// How many scores fit without touching the heap
+    static const size_t STACK_CAPACITY = 128;
+
+    /// Make a buffer of the given number of uninitialized scores
+    explicit ScaledScores(size_t size);
+
+    ScaledScores(const ScaledScores& other) = delete;
+    ScaledScores& operator=(const ScaledScores& other) = delete;
+
+    inline double& operator[](size_t i) {
+        return values[i];
+    }
+
+    inline const double* data() const {
+        return values;
+    }
+
+    inline size_t size() const {
+        return count;
+    }
+
+private:
+    double stack_values[STACK_CAPACITY];
+    vector<double> heap_values;
+    double* values;
+    size_t count;
+};
+
+/**
+ * Approximate exp(x) by range reduction to a power of 2 times a polynomial.
+ * Relative error is below 1e-8 for x up to 709, and results that would be
+ * denormal are flushed to 0. Written without branches or library calls so
+ * that loops over it vectorize.
+ */
+inline double fast_exp(double x) {
+    // x = k * ln(2) + r with |r| <= ln(2) / 2, rounding k to an integer by
+    // adding 1.5 * 2^52 so that it lands in the low bits of the mantissa
+    double shifted = x * 1.4426950408889634 + 6755399441055744.0;
+    double k = shifted - 6755399441055744.0;
+    int64_t k_bits;
+    memcpy(&k_bits, &shifted, sizeof(k_bits));
+    k_bits -= 0x4338000000000000;
+    double r = x - k * 0.6931471805599453;
+    // degree 8 Taylor series for exp(r) in Horner form
+    double p = 1.0 + r * (1.0 + r * (1.0 / 2.0 + r * (1.0 / 6.0 + r * (1.0 / 24.0 + r * (1.0 / 120.0
+               + r * (1.0 / 720.0 + r * (1.0 / 5040.0 + r * (1.0 / 40320.0))))))));
+    // multiply by 2^k by building its IEEE representation directly, flushing
+    // to 0 below the range of normal exponents (with a mask rather than a
+    // comparison, so that the loop vectorizes)
+    int64_t underflow_mask = -(int64_t) ((uint64_t) (k_bits + 1022) >> 63);
+    int64_t bits = (int64_t) ((uint64_t) (k_bits + 1023) << 52) & ~underflow_mask;
+    double scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+/// Compute log(sum(exp(scores))) over the given scores, which must not be
+/// empty. If approximate_exp is set, the exponentials are evaluated with
+/// fast_exp().
+double log_sum_exp(const double* scores, size_t count, bool approximate_exp);
+
+/// Return -ln(P) where P is the posterior probability that the maximum score
+/// is not the correct one, and store the index of the maximum score. A single
+/// score is compared against a null alignment with score 0. Returns infinity
+/// if the other alignments are too unlikely to represent.
+double max_score_error_neg_log(const double* scores, size_t count, size_t* max_idx_out, bool approximate_exp);
+
+/// The same as max_score_error_neg_log but only considering the maximum and
+/// the next best scores, so no exponentials are needed
+double max_score_error_neg_log_approx(const double* scores, size_t count, size_t* max_idx_out);
+
+/// Return -ln(P) where P is the posterior probability that the correct score
+/// is not among the group of indexes, which must be sorted. A single score is
+/// compared against a null alignment with score 0. Returns infinity if
+/// everything is in the group.
+double group_error_neg_log(const double* scores, size_t count, const vector<size_t>& group, bool approximate_exp);
+
+}
+
+#endif
@@ -312,12 +312,11 @@ namespace vg {
             }
             cerr << "distance measurements:" << endl;
             auto iter = fragment_length_distr.measurements_begin();
-            if (iter != fragment_length_distr.measurements_end()) {
-                cerr << *iter;
-                iter++;
-            }
-            for (; iter != fragment_length_distr.measurements_end(); iter++) {
-                cerr << ", " << *iter;
+            for (bool first = true; iter != fragment_length_distr.measurements_end(); iter++) {
+                for (size_t i = 0; i < iter->second; i++) {
+                    cerr << (first ? "" : ", ") << iter->first;
+                    first = false;
+                }
             }
             cerr << endl;
         }
@@ -448,6 +447,9 @@ namespace vg {
     // make the memo live in this .o file
     thread_local unordered_map<pair<size_t, size_t>, double> MultipathMapper::p_value_memo;
     
+    // make the workspace live in this .o file
+    thread_local algorithms::ConnectingGraphWorkspace MultipathMapper::connecting_graph_workspace;
+    
     double MultipathMapper::random_match_p_value(size_t match_length, size_t read_length) {
         // memoized to avoid transcendental functions (at least in cases where read lengths don't vary too much)
         auto iter = p_value_memo.find(make_pair(match_length, read_length));
@@ -1304,14 +1306,16 @@ namespace vg {
             
             // Chebyshev bound for 99% of all fragments regardless of distribution
             // TODO: I don't love having this internal aspect of the stranded/unstranded clustering outside the clusterer...
+            // take the mean and standard deviation from the same estimate
+            auto frag_length_estimate = fragment_length_distr.snapshot();
             int64_t max_separation, min_separation;
             if (unstranded_clustering) {
-                max_separation = (int64_t) ceil(abs(fragment_length_distr.mean()) + 10.0 * fragment_length_distr.stdev());
+                max_separation = (int64_t) ceil(abs(frag_length_estimate.mean) + 10.0 * frag_length_estimate.stdev);
                 min_separation = -max_separation;
             }
             else {
-                max_separation = (int64_t) ceil(fragment_length_distr.mean() + 10.0 * fragment_length_distr.stdev());
-                min_separation = (int64_t) fragment_length_distr.mean() - 10.0 * fragment_length_distr.stdev();
+                max_separation = (int64_t) ceil(frag_length_estimate.mean + 10.0 * frag_length_estimate.stdev);
+                min_separation = (int64_t) frag_length_estimate.mean - 10.0 * frag_length_estimate.stdev;
             }
             
             // Compute the pairs of cluster graphs and their approximate distances from each other
@@ -2339,6 +2343,7 @@ namespace vg {
                                                                                                max_dist,         // longest distance necessary
                                                                                                src_pos,          // end of earlier match
                                                                                                dest_pos,         // beginning of later match
+                                                                                               connecting_graph_workspace, // reused scratch space
                                                                                                false,            // do not extract the end positions in the matches
                                                                                                false,            // do not bother finding all cycles (it's a DAG)
                                                                                                true,             // remove tips
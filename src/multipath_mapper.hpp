@@ -21,6 +21,7 @@
 #include "edit.hpp"
 #include "snarls.hpp"
 #include "haplotypes.hpp"
+#include "algorithms/extract_connecting_graph.hpp"
 
 #include <gbwt/gbwt.h>
 
@@ -277,6 +278,9 @@ namespace vg {
         
         // a memo for the transcendental p-value function (thread local to maintain threadsafety)
         static thread_local unordered_map<pair<size_t, size_t>, double> p_value_memo;
+        
+        // scratch space for extracting the graph between each pair of MEMs (thread local to maintain threadsafety)
+        static thread_local algorithms::ConnectingGraphWorkspace connecting_graph_workspace;
     };
     
     // TODO: put in MultipathAlignmentGraph namespace
@@ -0,0 +1,935 @@
+#include "packed_graph.hpp"
+#include "stream.hpp"
+#include "utility.hpp"
+#include "vg.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+/** \file packed_graph.cpp
+ * Implement the compact mutable handle graph.
+ */
+
+namespace vg {
+
+using namespace std;
+
+/// Bases that can be packed, by their 2-bit code
+static const char PACKED_BASES[] = "ACGT";
+
+/// Get the 2-bit code for a base, or -1 if it can't be packed
+static inline int base_code(char base) {
+    switch (base) {
+    case 'A':
+        return 0;
+    case 'C':
+        return 1;
+    case 'G':
+        return 2;
+    case 'T':
+        return 3;
+    default:
+        return -1;
+    }
+}
+
+const uint64_t PackedGraph::ESCAPED;
+const uint64_t PackedGraph::DESTROYED;
+const uint64_t PackedGraph::START_MASK;
+
+PackedGraph::PackedGraph(istream& in) {
+    load(in);
+}
+
+bool PackedGraph::find_slot(id_t node_id, uint64_t& slot) const {
+    if (has_id_map) {
+        auto found = id_to_slot.find(node_id);
+        if (found == id_to_slot.end()) {
+            return false;
+        }
+        slot = found->second;
+        return true;
+    }
+
+    if (node_id < id_offset || node_id - id_offset >= (id_t) seq_starts.size()) {
+        return false;
+    }
+    slot = node_id - id_offset;
+    return !is_destroyed(slot);
+}
+
+id_t PackedGraph::slot_id(uint64_t slot) const {
+    return has_id_map ? slot_ids[slot] : id_offset + (id_t) slot;
+}
+
+id_t PackedGraph::next_id() const {
+    if (has_id_map) {
+        return max_id + 1;
+    }
+    return seq_starts.empty() ? 1 : id_offset + (id_t) seq_starts.size();
+}
+
+uint64_t PackedGraph::add_slot(id_t node_id, uint64_t seq_start, uint32_t length) {
+    if (!has_id_map) {
+        if (seq_starts.empty()) {
+            // The first node sets where the IDs start
+            id_offset = node_id;
+        }
+
+        uint64_t slot = node_id - id_offset;
+        if (node_id >= id_offset && slot >= seq_starts.size() && slot - seq_starts.size() <= seq_starts.size()) {
+            // The node goes at the end, and any gap is small enough to fill
+            // with destroyed slots and keep computing IDs from slots. Reusing
+            // an earlier slot would change the node order, so we don't.
+            while (seq_starts.size() < slot) {
+                seq_starts.push_back(DESTROYED);
+                seq_lengths.push_back(0);
+                adjacency.emplace_back();
+                if (!order.empty()) {
+                    position_of.push_back(order.size());
+                    order.push_back(seq_starts.size() - 1);
+                }
+                destroyed_count++;
+            }
+        } else {
+            use_id_map();
+        }
+    }
+
+    if (has_id_map) {
+        if (id_to_slot.count(node_id)) {
+            throw runtime_error("[vg::PackedGraph] node ID " + to_string(node_id) + " is already in use");
+        }
+        id_to_slot[node_id] = seq_starts.size();
+        slot_ids.push_back(node_id);
+        max_id = max(max_id, node_id);
+    }
+
+    seq_starts.push_back(seq_start);
+    seq_lengths.push_back(length);
+    adjacency.emplace_back();
+    if (!order.empty()) {
+        position_of.push_back(order.size());
+        order.push_back(seq_starts.size() - 1);
+    }
+    return seq_starts.size() - 1;
+}
+
+void PackedGraph::use_id_map() {
+    slot_ids.resize(seq_starts.size());
+    for (uint64_t slot = 0; slot < seq_starts.size(); slot++) {
+        slot_ids[slot] = id_offset + (id_t) slot;
+        if (!is_destroyed(slot)) {
+            id_to_slot[slot_ids[slot]] = slot;
+        }
+    }
+    max_id = seq_starts.empty() ? 0 : slot_ids.back();
+    has_id_map = true;
+}
+
+uint64_t PackedGraph::append_sequence(const string& sequence) {
+    uint64_t start = base_count;
+    base_count += sequence.size();
+    packed_bases.resize((base_count + 31) / 32, 0);
+
+    bool escaped = false;
+    for (size_t i = 0; i < sequence.size(); i++) {
+        escaped |= set_base(start + i, sequence[i]);
+    }
+    return escaped ? (start | ESCAPED) : start;
+}
+
+char PackedGraph::get_base(uint64_t offset, bool escaped) const {
+    if (escaped) {
+        auto found = other_bases.find(offset);
+        if (found != other_bases.end()) {
+            return found->second;
+        }
+    }
+    return PACKED_BASES[(packed_bases[offset / 32] >> (2 * (offset % 32))) & 3];
+}
+
+bool PackedGraph::set_base(uint64_t offset, char base) {
+    int code = base_code(base);
+    uint64_t& word = packed_bases[offset / 32];
+    word &= ~((uint64_t) 3 << (2 * (offset % 32)));
+    if (code < 0) {
+        other_bases[offset] = base;
+        return true;
+    }
+
+    word |= (uint64_t) code << (2 * (offset % 32));
+    if (!other_bases.empty()) {
+        // We might be overwriting a base that was in the side table
+        other_bases.erase(offset);
+    }
+    return false;
+}
+
+handle_t PackedGraph::get_handle(const id_t& node_id, bool is_reverse) const {
+    uint64_t slot;
+    if (!find_slot(node_id, slot)) {
+        throw runtime_error("No node " + to_string(node_id) + " in graph");
+    }
+    return slot_handle(slot, is_reverse);
+}
+
+id_t PackedGraph::get_id(const handle_t& handle) const {
+    return slot_id(handle_slot(handle));
+}
+
+bool PackedGraph::get_is_reverse(const handle_t& handle) const {
+    return as_integer(handle) & 1;
+}
+
+handle_t PackedGraph::flip(const handle_t& handle) const {
+    return as_handle(as_integer(handle) ^ 1);
+}
+
+size_t PackedGraph::get_length(const handle_t& handle) const {
+    return seq_lengths[handle_slot(handle)];
+}
+
+string PackedGraph::get_sequence(const handle_t& handle) const {
+    uint64_t slot = handle_slot(handle);
+    uint64_t start = seq_starts[slot] & START_MASK;
+    bool escaped = seq_starts[slot] & ESCAPED;
+
+    string sequence(seq_lengths[slot], 'N');
+    for (size_t i = 0; i < sequence.size(); i++) {
+        sequence[i] = get_base(start + i, escaped);
+    }
+
+    if (get_is_reverse(handle)) {
+        reverse_complement_in_place(sequence);
+    }
+    return sequence;
+}
+
+bool PackedGraph::follow_edges(const handle_t& handle, bool go_left, const function<bool(const handle_t&)>& iteratee) const {
+    bool is_reverse = get_is_reverse(handle);
+
+    // Going left on the forward strand, or right on the reverse strand, means
+    // leaving the node's left side.
+    uint64_t on_right = (go_left == is_reverse);
+
+    for (uint64_t record : adjacency[handle_slot(handle)]) {
+        if ((record & 1) == on_right) {
+            handle_t neighbor = as_handle((int64_t) (record >> 1));
+            if (!iteratee(is_reverse ? flip(neighbor) : neighbor)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void PackedGraph::for_each_handle(const function<bool(const handle_t&)>& iteratee, bool parallel) const {
+    if (parallel) {
+#pragma omp parallel for schedule(dynamic, 1024)
+        for (size_t i = 0; i < seq_starts.size(); i++) {
+            uint64_t slot = slot_at(i);
+            if (!is_destroyed(slot)) {
+                // We can't stop early in parallel
+                iteratee(slot_handle(slot, false));
+            }
+        }
+    } else {
+        // Look at the order fresh each time, since the iteratee may swap nodes
+        for (size_t i = 0; i < seq_starts.size(); i++) {
+            uint64_t slot = slot_at(i);
+            if (!is_destroyed(slot) && !iteratee(slot_handle(slot, false))) {
+                return;
+            }
+        }
+    }
+}
+
+size_t PackedGraph::node_size() const {
+    return seq_starts.size() - destroyed_count;
+}
+
+handle_t PackedGraph::create_handle(const string& sequence) {
+    return create_handle(sequence, next_id());
+}
+
+handle_t PackedGraph::create_handle(const string& sequence, const id_t& id) {
+    if (sequence.size() > numeric_limits<uint32_t>::max()) {
+        throw runtime_error("[vg::PackedGraph] sequence of node " + to_string(id) + " is too long");
+    }
+    return slot_handle(add_slot(id, append_sequence(sequence), sequence.size()), false);
+}
+
+void PackedGraph::destroy_handle(const handle_t& handle) {
+    uint64_t slot = handle_slot(handle);
+
+    // Remove the records of the node's edges from the other ends
+    for (uint64_t record : adjacency[slot]) {
+        uint64_t other = record >> 2;
+        if (other != slot) {
+            auto& records = adjacency[other];
+            records.erase(std::remove_if(records.begin(), records.end(), [&](uint64_t other_record) {
+                return (other_record >> 2) == slot;
+            }), records.end());
+        }
+    }
+    vector<uint64_t>().swap(adjacency[slot]);
+
+    // Keep the sequence position and length in case paths still visit it
+    seq_starts[slot] |= DESTROYED;
+    destroyed_count++;
+    if (has_id_map) {
+        id_to_slot.erase(slot_ids[slot]);
+    }
+}
+
+pair<uint64_t, uint64_t> PackedGraph::edge_records(const handle_t& left, const handle_t& right) const {
+    // Leaving the left handle rightward leaves the right side of its node if
+    // it is forward, and the left side if it is reverse. Entering the right
+    // handle works the other way around.
+    uint64_t at_left = get_is_reverse(left) ? make_record(flip(right), false) : make_record(right, true);
+    uint64_t at_right = get_is_reverse(right) ? make_record(flip(left), true) : make_record(left, false);
+    return make_pair(at_left, at_right);
+}
+
+void PackedGraph::add_record(uint64_t slot, uint64_t record) {
+    auto& records = adjacency[slot];
+    if (std::find(records.begin(), records.end(), record) == records.end()) {
+        records.push_back(record);
+    }
+}
+
+void PackedGraph::remove_record(uint64_t slot, uint64_t record) {
+    auto& records = adjacency[slot];
+    auto found = std::find(records.begin(), records.end(), record);
+    if (found != records.end()) {
+        records.erase(found);
+    }
+}
+
+void PackedGraph::create_edge(const handle_t& left, const handle_t& right) {
+    auto records = edge_records(left, right);
+    add_record(handle_slot(left), records.first);
+    if (handle_slot(left) != handle_slot(right) || records.first != records.second) {
+        // Self loops that reverse strand only need one record
+        add_record(handle_slot(right), records.second);
+    }
+}
+
+void PackedGraph::destroy_edge(const handle_t& left, const handle_t& right) {
+    auto records = edge_records(left, right);
+    remove_record(handle_slot(left), records.first);
+    remove_record(handle_slot(right), records.second);
+}
+
+void PackedGraph::swap_handles(const handle_t& a, const handle_t& b) {
+    if (order.empty()) {
+        // Start tracking the order separately from the slots
+        order.resize(seq_starts.size());
+        position_of.resize(seq_starts.size());
+        for (uint64_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+            position_of[i] = i;
+        }
+    }
+
+    uint64_t slot_a = handle_slot(a);
+    uint64_t slot_b = handle_slot(b);
+    std::swap(order[position_of[slot_a]], order[position_of[slot_b]]);
+    std::swap(position_of[slot_a], position_of[slot_b]);
+}
+
+handle_t PackedGraph::apply_orientation(const handle_t& handle) {
+    if (!get_is_reverse(handle)) {
+        // Nothing to do!
+        return handle;
+    }
+
+    uint64_t slot = handle_slot(handle);
+    handle_t new_handle = flip(handle);
+
+    // Find all the edges (including self loops) as seen from the orientation
+    // that is becoming forward
+    vector<handle_t> left_nodes;
+    vector<handle_t> right_nodes;
+    follow_edges(handle, true, [&](const handle_t& other) {
+        left_nodes.push_back(other);
+    });
+    follow_edges(handle, false, [&](const handle_t& other) {
+        right_nodes.push_back(other);
+    });
+    for (auto& left : left_nodes) {
+        destroy_edge(left, handle);
+    }
+    for (auto& right : right_nodes) {
+        destroy_edge(handle, right);
+    }
+
+    // Rewrite the sequence in place as its reverse complement
+    string sequence = get_sequence(handle);
+    uint64_t start = seq_starts[slot] & START_MASK;
+    bool escaped = false;
+    for (size_t i = 0; i < sequence.size(); i++) {
+        escaped |= set_base(start + i, sequence[i]);
+    }
+    seq_starts[slot] = escaped ? (start | ESCAPED) : start;
+
+    // Connect the node back up. The new forward orientation is the old
+    // reverse one, so self loops flip too.
+    auto reoriented = [&](const handle_t& other) {
+        return handle_slot(other) == slot ? flip(other) : other;
+    };
+    for (auto& left : left_nodes) {
+        create_edge(reoriented(left), new_handle);
+    }
+    for (auto& right : right_nodes) {
+        create_edge(new_handle, reoriented(right));
+    }
+
+    return new_handle;
+}
+
+vector<handle_t> PackedGraph::divide_node(const handle_t& handle, const vector<size_t>& offsets) {
+    uint64_t slot = handle_slot(handle);
+    bool is_reverse = get_is_reverse(handle);
+    handle_t forward = slot_handle(slot, false);
+    size_t length = seq_lengths[slot];
+
+    // Get the offsets along the forward strand
+    vector<size_t> forward_offsets;
+    if (is_reverse) {
+        for (auto it = offsets.rbegin(); it != offsets.rend(); ++it) {
+            forward_offsets.push_back(length - *it);
+        }
+    } else {
+        forward_offsets = offsets;
+    }
+
+    // Take off the edges on the outsides of the node
+    vector<handle_t> left_nodes;
+    vector<handle_t> right_nodes;
+    follow_edges(forward, true, [&](const handle_t& other) {
+        left_nodes.push_back(other);
+    });
+    follow_edges(forward, false, [&](const handle_t& other) {
+        right_nodes.push_back(other);
+    });
+    for (auto& left : left_nodes) {
+        destroy_edge(left, forward);
+    }
+    for (auto& right : right_nodes) {
+        destroy_edge(forward, right);
+    }
+
+    // Make the parts, which share the node's stretch of the packed store. The
+    // first part stays in the node's slot.
+    uint64_t start = seq_starts[slot] & START_MASK;
+    uint64_t flags = seq_starts[slot] & ESCAPED;
+    vector<handle_t> parts {forward};
+    size_t part_start = 0;
+    for (size_t i = 0; i <= forward_offsets.size(); i++) {
+        size_t part_end = i < forward_offsets.size() ? forward_offsets[i] : length;
+        if (i == 0) {
+            seq_lengths[slot] = part_end;
+        } else {
+            uint64_t part_slot = add_slot(next_id(), (start + part_start) | flags, part_end - part_start);
+            handle_t part = slot_handle(part_slot, false);
+            create_edge(parts.back(), part);
+            parts.push_back(part);
+        }
+        part_start = part_end;
+    }
+
+    // Connect the ends back up. Self loops now run between the first and last
+    // parts.
+    handle_t first = parts.front();
+    handle_t last = parts.back();
+    for (handle_t left : left_nodes) {
+        if (handle_slot(left) == slot) {
+            left = get_is_reverse(left) ? flip(first) : last;
+        }
+        create_edge(left, first);
+    }
+    for (handle_t right : right_nodes) {
+        if (handle_slot(right) == slot) {
+            right = get_is_reverse(right) ? flip(last) : first;
+        }
+        create_edge(last, right);
+    }
+
+    return parts;
+}
+
+void PackedGraph::replace_divided_steps(const vector<pair<uint64_t, vector<handle_t>>>& divided) {
+    if (divided.empty() || paths.empty()) {
+        return;
+    }
+
+    // Which division, plus one, each slot had, so each step costs one lookup.
+    // A single division just compares slots instead of filling in a table.
+    vector<size_t> division_of;
+    if (divided.size() > 1) {
+        division_of.resize(seq_starts.size(), 0);
+        for (size_t i = 0; i < divided.size(); i++) {
+            division_of[divided[i].first] = i + 1;
+        }
+    }
+    auto division_for = [&](uint64_t step) -> size_t {
+        if (division_of.empty()) {
+            return (step >> 1) == divided.front().first ? 1 : 0;
+        }
+        return division_of[step >> 1];
+    };
+    // The steps that replace a visit to each divided node, in each orientation
+    vector<vector<uint64_t>> forward_steps(divided.size());
+    vector<vector<uint64_t>> reverse_steps(divided.size());
+    for (size_t i = 0; i < divided.size(); i++) {
+        auto& parts = divided[i].second;
+        for (auto it = parts.begin(); it != parts.end(); ++it) {
+            forward_steps[i].push_back(as_integer(*it));
+        }
+        for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+            reverse_steps[i].push_back(as_integer(flip(*it)));
+        }
+    }
+
+    for (auto& path : paths) {
+        size_t added = 0;
+        for (uint64_t step : path.steps) {
+            size_t division = division_for(step);
+            if (division) {
+                added += divided[division - 1].second.size() - 1;
+            }
+        }
+        if (added == 0) {
+            continue;
+        }
+        vector<uint64_t> new_steps;
+        new_steps.reserve(path.steps.size() + added);
+        for (uint64_t step : path.steps) {
+            size_t division = division_for(step);
+            if (division) {
+                auto& replacement = (step & 1) ? reverse_steps[division - 1] : forward_steps[division - 1];
+                new_steps.insert(new_steps.end(), replacement.begin(), replacement.end());
+            } else {
+                new_steps.push_back(step);
+            }
+        }
+        path.steps = std::move(new_steps);
+    }
+}
+
+vector<handle_t> PackedGraph::divide_handle(const handle_t& handle, const vector<size_t>& offsets) {
+    vector<handle_t> parts = divide_node(handle, offsets);
+    replace_divided_steps(vector<pair<uint64_t, vector<handle_t>>>{make_pair(handle_slot(handle), parts)});
+
+    if (get_is_reverse(handle)) {
+        // Give back the parts in the orientation and order we were asked for
+        vector<handle_t> to_return;
+        for (auto it = parts.rbegin(); it != parts.rend(); ++it) {
+            to_return.push_back(flip(*it));
+        }
+        return to_return;
+    }
+    return parts;
+}
+
+void PackedGraph::divide_handles(const vector<pair<handle_t, vector<size_t>>>& divisions) {
+    vector<pair<uint64_t, vector<handle_t>>> divided;
+    divided.reserve(divisions.size());
+    for (auto& division : divisions) {
+        divided.emplace_back(handle_slot(division.first), divide_node(division.first, division.second));
+    }
+    replace_divided_steps(divided);
+}
+
+bool PackedGraph::has_node(id_t node_id) const {
+    uint64_t slot;
+    return find_slot(node_id, slot);
+}
+
+void PackedGraph::add_edge(const Edge& edge) {
+    uint64_t from_slot;
+    uint64_t to_slot;
+    if (find_slot(edge.from(), from_slot) && find_slot(edge.to(), to_slot)) {
+        create_edge(slot_handle(from_slot, edge.from_start()), slot_handle(to_slot, edge.to_end()));
+    } else {
+        pending_edges.push_back(PendingEdge{edge.from(), edge.to(), edge.from_start(), edge.to_end()});
+    }
+}
+
+void PackedGraph::add_path(const Path& path, bool use_ranks) {
+    size_t index;
+    auto found = path_index.find(path.name());
+    if (found == path_index.end()) {
+        index = paths.size();
+        path_index[path.name()] = index;
+        paths.emplace_back();
+        paths.back().name = path.name();
+    } else {
+        index = found->second;
+    }
+    PackedPath& packed = paths[index];
+    packed.circular |= path.is_circular();
+
+    for (auto& mapping : path.mapping()) {
+        id_t node_id = mapping.position().node_id();
+
+        // Only full-length matches can be stored as bare steps
+        bool full_match = mapping.position().offset() == 0;
+        size_t from_length = 0;
+        for (auto& edit : mapping.edit()) {
+            full_match &= edit.from_length() == edit.to_length() && edit.sequence().empty();
+            from_length += edit.from_length();
+        }
+        uint64_t slot;
+        bool have_node = find_slot(node_id, slot);
+        if (have_node && mapping.edit_size() > 0) {
+            full_match &= from_length == seq_lengths[slot];
+        }
+        if (!full_match) {
+            throw runtime_error("[vg::PackedGraph] mapping of path " + path.name() + " to node "
+                                + to_string(node_id) + " is not a full-length match");
+        }
+
+        if (use_ranks) {
+            int64_t next_rank = packed.steps.size() + 1;
+            auto ranks = pending_ranks.find(index);
+            if (ranks != pending_ranks.end()) {
+                ranks->second.push_back(mapping.rank() != 0 ? mapping.rank() : ranks->second.back() + 1);
+            } else if (mapping.rank() != 0 && mapping.rank() != next_rank) {
+                // This is the first step out of order. The ones before it
+                // were in order, so we can fill in their ranks.
+                vector<int64_t>& saved = pending_ranks[index];
+                saved.reserve(next_rank);
+                for (int64_t rank = 1; rank < next_rank; rank++) {
+                    saved.push_back(rank);
+                }
+                saved.push_back(mapping.rank());
+            }
+        }
+
+        if (have_node) {
+            packed.steps.push_back(slot_value(slot, mapping.position().is_reverse()));
+        } else {
+            pending_steps.emplace_back(make_pair(index, packed.steps.size()),
+                                       make_pair(node_id, mapping.position().is_reverse()));
+            packed.steps.push_back(0);
+        }
+    }
+}
+
+void PackedGraph::add_graph(const Graph& graph) {
+    for (auto& node : graph.node()) {
+        create_handle(node.sequence(), node.id());
+    }
+    for (auto& edge : graph.edge()) {
+        add_edge(edge);
+    }
+    for (auto& path : graph.path()) {
+        add_path(path, true);
+    }
+}
+
+void PackedGraph::finish_pending() {
+    for (auto& edge : pending_edges) {
+        uint64_t from_slot;
+        uint64_t to_slot;
+        if (find_slot(edge.from, from_slot) && find_slot(edge.to, to_slot)) {
+            create_edge(slot_handle(from_slot, edge.from_start), slot_handle(to_slot, edge.to_end));
+        }
+    }
+    vector<PendingEdge>().swap(pending_edges);
+
+    for (auto& pending : pending_steps) {
+        PackedPath& path = paths[pending.first.first];
+        uint64_t slot;
+        if (!find_slot(pending.second.first, slot)) {
+            throw runtime_error("[vg::PackedGraph] path " + path.name + " visits missing node "
+                                + to_string(pending.second.first));
+        }
+        path.steps[pending.first.second] = slot_value(slot, pending.second.second);
+    }
+    vector<pair<pair<size_t, size_t>, pair<id_t, bool>>>().swap(pending_steps);
+
+    for (auto& ranked : pending_ranks) {
+        auto& steps = paths[ranked.first].steps;
+        auto& ranks = ranked.second;
+        vector<size_t> permutation(steps.size());
+        iota(permutation.begin(), permutation.end(), 0);
+        stable_sort(permutation.begin(), permutation.end(), [&](size_t a, size_t b) {
+            return ranks[a] < ranks[b];
+        });
+        vector<uint64_t> sorted_steps;
+        sorted_steps.reserve(steps.size());
+        for (size_t i : permutation) {
+            sorted_steps.push_back(steps[i]);
+        }
+        steps = std::move(sorted_steps);
+    }
+    pending_ranks.clear();
+}
+
+void PackedGraph::extend(const Graph& graph) {
+    add_graph(graph);
+    finish_pending();
+}
+
+void PackedGraph::extend(VG& graph) {
+    graph.for_each_node([&](Node* node) {
+        create_handle(node->sequence(), node->id());
+    });
+    graph.for_each_edge([&](Edge* edge) {
+        add_edge(*edge);
+    });
+    // VG's own path order is authoritative, whatever the ranks say
+    graph.paths.for_each([&](const Path& path) {
+        add_path(path, false);
+    });
+    finish_pending();
+}
+
+void PackedGraph::load(istream& in) {
+    function<void(Graph&)> lambda = [&](Graph& graph) {
+        add_graph(graph);
+    };
+    stream::for_each(in, lambda);
+    finish_pending();
+}
+
+void PackedGraph::fill_mapping(uint64_t step, int64_t rank, Mapping& mapping) const {
+    uint64_t slot = step >> 1;
+    mapping.mutable_position()->set_node_id(slot_id(slot));
+    mapping.mutable_position()->set_is_reverse(step & 1);
+    Edit* edit = mapping.add_edit();
+    edit->set_from_length(seq_lengths[slot]);
+    edit->set_to_length(seq_lengths[slot]);
+    mapping.set_rank(rank);
+}
+
+uint64_t PackedGraph::get_path_starts(vector<uint64_t>& path_starts) const {
+    uint64_t step_count = 0;
+    path_starts.clear();
+    for (auto& path : paths) {
+        path_starts.push_back(step_count);
+        step_count += path.steps.size();
+    }
+    return step_count;
+}
+
+Graph PackedGraph::make_chunk(uint64_t start, uint64_t count, const vector<uint64_t>& path_starts,
+                              uint64_t step_count) const {
+    Graph chunk;
+    uint64_t positions = seq_starts.size();
+    Path* path = nullptr;
+    size_t path_number = 0;
+
+    for (uint64_t element = start; element < start + count; element++) {
+        if (element < positions) {
+            uint64_t slot = slot_at(element);
+            if (is_destroyed(slot)) {
+                continue;
+            }
+            Node* node = chunk.add_node();
+            node->set_id(slot_id(slot));
+            node->set_sequence(get_sequence(slot_handle(slot, false)));
+
+            for (uint64_t record : adjacency[slot]) {
+                uint64_t other = record >> 2;
+                bool other_reverse = (record >> 1) & 1;
+                bool on_right = record & 1;
+                if (other < slot || (other == slot && !on_right && !other_reverse)) {
+                    // Each edge is written from its end in the lower slot, and
+                    // self loops with two records are written from the right.
+                    continue;
+                }
+                Edge* edge = chunk.add_edge();
+                if (on_right) {
+                    edge->set_from(slot_id(slot));
+                    edge->set_to(slot_id(other));
+                    edge->set_to_end(other_reverse);
+                } else {
+                    edge->set_from(slot_id(other));
+                    edge->set_from_start(other_reverse);
+                    edge->set_to(slot_id(slot));
+                }
+            }
+        } else if (element - positions < step_count) {
+            uint64_t step_number = element - positions;
+            size_t found = upper_bound(path_starts.begin(), path_starts.end(), step_number) - path_starts.begin() - 1;
+            if (path == nullptr || found != path_number) {
+                path_number = found;
+                path = chunk.add_path();
+                path->set_name(paths[found].name);
+                path->set_is_circular(paths[found].circular);
+            }
+            uint64_t step_index = step_number - path_starts[found];
+            fill_mapping(paths[found].steps[step_index], step_index + 1, *path->add_mapping());
+        }
+    }
+
+    if (start == 0) {
+        // The first chunk carries the paths with no steps
+        for (auto& packed : paths) {
+            if (packed.steps.empty()) {
+                Path* empty = chunk.add_path();
+                empty->set_name(packed.name);
+                empty->set_is_circular(packed.circular);
+            }
+        }
+    }
+
+    return chunk;
+}
+
+void PackedGraph::to_graph(Graph& graph) const {
+    vector<uint64_t> path_starts;
+    uint64_t step_count = get_path_starts(path_starts);
+    graph = make_chunk(0, seq_starts.size() + step_count, path_starts, step_count);
+}
+
+void PackedGraph::to_vg(VG& graph) const {
+    Graph converted;
+    to_graph(converted);
+    graph.extend(converted);
+}
+
+void PackedGraph::serialize(ostream& out, size_t chunk_size) const {
+    vector<uint64_t> path_starts;
+    uint64_t step_count = get_path_starts(path_starts);
+
+    // A graph with nothing but empty paths still needs a chunk
+    uint64_t element_count = max<uint64_t>(seq_starts.size() + step_count, paths.empty() ? 0 : 1);
+
+    function<Graph(uint64_t, uint64_t)> lambda = [&](uint64_t start, uint64_t count) {
+        return make_chunk(start, count, path_starts, step_count);
+    };
+    stream::write(out, element_count, chunk_size, lambda);
+}
+
+size_t PackedGraph::edge_count() const {
+    size_t count = 0;
+    for (uint64_t slot = 0; slot < adjacency.size(); slot++) {
+        for (uint64_t record : adjacency[slot]) {
+            uint64_t other = record >> 2;
+            // Count each edge from the same end that serialization writes it from
+            if (other > slot || (other == slot && ((record & 1) || ((record >> 1) & 1)))) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+id_t PackedGraph::min_node_id() const {
+    id_t min_id = 0;
+    bool found = false;
+    for (uint64_t slot = 0; slot < seq_starts.size(); slot++) {
+        if (!is_destroyed(slot) && (!found || slot_id(slot) < min_id)) {
+            min_id = slot_id(slot);
+            found = true;
+        }
+    }
+    return min_id;
+}
+
+id_t PackedGraph::max_node_id() const {
+    id_t max_found = 0;
+    bool found = false;
+    for (uint64_t slot = 0; slot < seq_starts.size(); slot++) {
+        if (!is_destroyed(slot) && (!found || slot_id(slot) > max_found)) {
+            max_found = slot_id(slot);
+            found = true;
+        }
+    }
+    return max_found;
+}
+
+void PackedGraph::compact_ids() {
+    // Give each live slot a new slot in the stored order
+    const uint64_t NO_SLOT = numeric_limits<uint64_t>::max();
+    vector<uint64_t> new_slot(seq_starts.size(), NO_SLOT);
+    uint64_t live = 0;
+    for (uint64_t position = 0; position < seq_starts.size(); position++) {
+        uint64_t slot = slot_at(position);
+        if (!is_destroyed(slot)) {
+            new_slot[slot] = live++;
+        }
+    }
+    auto renumber = [&](uint64_t value) {
+        return (new_slot[value >> 1] << 1) | (value & 1);
+    };
+
+    // Copy the sequences over in their new order, and move the adjacency
+    // lists over without copying them
+    PackedGraph compacted;
+    compacted.seq_starts.reserve(live);
+    compacted.seq_lengths.reserve(live);
+    compacted.adjacency.reserve(live);
+    for (uint64_t position = 0; position < seq_starts.size(); position++) {
+        uint64_t slot = slot_at(position);
+        if (is_destroyed(slot)) {
+            continue;
+        }
+        uint64_t added = compacted.add_slot(new_slot[slot] + 1,
+                                            compacted.append_sequence(get_sequence(slot_handle(slot, false))),
+                                            seq_lengths[slot]);
+        auto& records = compacted.adjacency[added];
+        records = std::move(adjacency[slot]);
+        for (auto& record : records) {
+            record = (renumber(record >> 1) << 1) | (record & 1);
+        }
+    }
+
+    // Move the paths over, dropping visits to destroyed nodes
+    for (auto& path : paths) {
+        path.steps.erase(std::remove_if(path.steps.begin(), path.steps.end(), [&](uint64_t step) {
+            return new_slot[step >> 1] == NO_SLOT;
+        }), path.steps.end());
+        for (auto& step : path.steps) {
+            step = renumber(step);
+        }
+    }
+    compacted.paths = std::move(paths);
+    compacted.path_index = std::move(path_index);
+
+    *this = std::move(compacted);
+}
+
+void PackedGraph::increment_node_ids(id_t increment) {
+    if (!has_id_map) {
+        id_offset += increment;
+        return;
+    }
+
+    id_to_slot.clear();
+    for (uint64_t slot = 0; slot < slot_ids.size(); slot++) {
+        slot_ids[slot] += increment;
+        if (!is_destroyed(slot)) {
+            id_to_slot[slot_ids[slot]] = slot;
+        }
+    }
+    max_id += increment;
+}
+
+void PackedGraph::clear_paths() {
+    paths.clear();
+    path_index.clear();
+}
+
+void PackedGraph::for_each_path(const function<void(const string&, const vector<handle_t>&)>& iteratee) const {
+    vector<handle_t> handles;
+    for (auto& path : paths) {
+        handles.clear();
+        for (auto& step : path.steps) {
+            if (!is_destroyed(step >> 1)) {
+                handles.push_back(as_handle((int64_t) step));
+            }
+        }
+        iteratee(path.name, handles);
+    }
+}
+
+}
@@ -0,0 +1,406 @@
+#ifndef VG_PACKED_GRAPH_HPP_INCLUDED
+#define VG_PACKED_GRAPH_HPP_INCLUDED
+
+/**
+ * \file packed_graph.hpp
+ * A compact mutable handle graph that can stand in for VG when a whole
+ * chromosome graph has to be loaded, modified, and written back out. Nodes
+ * live in dense arrays addressed by rank instead of in Protobuf objects and
+ * hash tables.
+ */
+
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "handle.hpp"
+#include "hash_map.hpp"
+#include "vg.pb.h"
+
+namespace vg {
+
+using namespace std;
+
+class VG;
+
+/**
+ * A MutableHandleGraph that stores each node as a record in a set of parallel
+ * vectors, indexed by a rank (or slot) that never changes while the node
+ * exists. Handles hold the slot and the orientation, so following an edge
+ * never needs an ID lookup.
+ *
+ * - Sequences are packed at 2 bits per base in one shared array. Bases other
+ *   than ACGT are kept in a side table, and nodes that have any are flagged so
+ *   the common case never consults it.
+ * - Each node has one small vector of adjacency records, each holding the
+ *   handle on the other end of the edge and the side of this node it attaches
+ *   to. An edge is recorded at both of its ends.
+ * - While the node IDs are a contiguous run in slot order (as they are in
+ *   graphs from vg construct), IDs are computed from slots and no ID map
+ *   exists. Other ID assignments switch the graph over to a hash map from ID
+ *   to slot.
+ * - Destroyed nodes leave dead slots behind until compact_ids() is called.
+ *
+ * Embedded paths are supported as long as every mapping is a full-length
+ * match to its node, which is the case for the reference and alt paths that
+ * vg construct makes.
+ */
+class PackedGraph : public MutableHandleGraph {
+public:
+
+    /// Make an empty graph
+    PackedGraph() = default;
+
+    /// Load a graph from a stream in the .vg format
+    PackedGraph(istream& in);
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Handle-based interface
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// Look up the handle for the node with the given ID in the given orientation
+    virtual handle_t get_handle(const id_t& node_id, bool is_reverse = false) const;
+
+    // Copy over the visit version which would otherwise be shadowed.
+    using HandleGraph::get_handle;
+
+    /// Get the ID from a handle
+    virtual id_t get_id(const handle_t& handle) const;
+
+    /// Get the orientation of a handle
+    virtual bool get_is_reverse(const handle_t& handle) const;
+
+    /// Invert the orientation of a handle (potentially without getting its ID)
+    virtual handle_t flip(const handle_t& handle) const;
+
+    /// Get the length of a node
+    virtual size_t get_length(const handle_t& handle) const;
+
+    /// Get the sequence of a node, presented in the handle's local forward
+    /// orientation.
+    virtual string get_sequence(const handle_t& handle) const;
+
+    /// Loop over all the handles to next/previous (right/left) nodes. Passes
+    /// them to a callback which returns false to stop iterating and true to
+    /// continue. Returns true if we finished and false if we stopped early.
+    virtual bool follow_edges(const handle_t& handle, bool go_left, const function<bool(const handle_t&)>& iteratee) const;
+
+    // Copy over the template for nice calls
+    using HandleGraph::follow_edges;
+
+    /// Loop over all the nodes in the graph in their local forward
+    /// orientations, in their internal stored order. Stop if the iteratee
+    /// returns false. Can be told to run in parallel, in which case stopping
+    /// after a false return value is on a best-effort basis and iteration
+    /// order is not defined.
+    virtual void for_each_handle(const function<bool(const handle_t&)>& iteratee, bool parallel = false) const;
+
+    // Copy over the template for nice calls
+    using HandleGraph::for_each_handle;
+
+    /// Return the number of nodes in the graph
+    virtual size_t node_size() const;
+
+    /// Create a new node with the given sequence and return the handle. The
+    /// node gets an ID one past the largest ID used so far.
+    virtual handle_t create_handle(const string& sequence);
+
+    /// Create a new node with the given id and sequence, then return the handle.
+    virtual handle_t create_handle(const string& sequence, const id_t& id);
+
+    /// Remove the node belonging to the given handle and all of its edges.
+    /// Does not update any stored paths.
+    virtual void destroy_handle(const handle_t& handle);
+
+    /// Create an edge connecting the given handles in the given order and orientations.
+    /// Ignores existing edges.
+    virtual void create_edge(const handle_t& left, const handle_t& right);
+
+    /// Remove the edge connecting the given handles in the given order and orientations.
+    /// Ignores nonexistent edges.
+    /// Does not update any stored paths.
+    virtual void destroy_edge(const handle_t& left, const handle_t& right);
+
+    /// Swap the nodes corresponding to the given handles, in the ordering used
+    /// by for_each_handle when looping over the graph. Handles are not
+    /// invalidated. The first swap sets up a permutation of the slots, which
+    /// costs 16 bytes per node until compact_ids() is called.
+    virtual void swap_handles(const handle_t& a, const handle_t& b);
+
+    /// Alter the node that the given handle corresponds to so the orientation
+    /// indicated by the handle becomes the node's local forward orientation.
+    /// Rewrites the node's edges and sequence in place, so the node keeps its
+    /// ID and slot, and the returned handle is the flip of the one passed.
+    /// Does not update any stored paths.
+    virtual handle_t apply_orientation(const handle_t& handle);
+
+    /// Split a handle's underlying node at the given offsets in the handle's
+    /// orientation. The first part keeps the node's ID and slot, and the
+    /// parts share the original sequence storage. Updates stored paths, at
+    /// the cost of a scan over all path steps; use divide_handles() to
+    /// divide many nodes.
+    virtual vector<handle_t> divide_handle(const handle_t& handle, const vector<size_t>& offsets);
+
+    // Copy over the single-offset version
+    using MutableHandleGraph::divide_handle;
+
+    /// Split many nodes, each at the given offsets in its handle's
+    /// orientation, as divide_handle() would. Each node may appear only once.
+    /// Updates stored paths in a single scan over all path steps, so this is
+    /// the way to divide a large number of nodes.
+    void divide_handles(const vector<pair<handle_t, vector<size_t>>>& divisions);
+
+    /// Return true if the graph has a node with the given ID
+    bool has_node(id_t node_id) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Conversion and serialization
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// Add the nodes, edges and paths from a Graph. Edges and path mappings
+    /// must refer to nodes already in this graph or in the Graph itself.
+    void extend(const Graph& graph);
+
+    /// Add everything in a VG graph, including its paths
+    void extend(VG& graph);
+
+    /// Add the contents of a .vg stream. Edges and paths may refer to nodes
+    /// from any chunk of the stream, and path mappings are put in rank order.
+    /// Edges to nodes that never appear are dropped, as vg mod -o would.
+    void load(istream& in);
+
+    /// Fill in a Graph with everything in this graph
+    void to_graph(Graph& graph) const;
+
+    /// Add everything in this graph to a VG graph
+    void to_vg(VG& graph) const;
+
+    /// Write the graph to a stream in the .vg format, with nodes in their
+    /// stored order and path mappings in chunks of their own after the
+    /// nodes.
+    void serialize(ostream& out, size_t chunk_size = 1000) const;
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Whole-graph operations
+    ////////////////////////////////////////////////////////////////////////////
+
+    /// Get the number of edges in the graph
+    size_t edge_count() const;
+
+    /// Get the smallest ID of a node in the graph, or 0 if it is empty
+    id_t min_node_id() const;
+
+    /// Get the largest ID of a node in the graph, or 0 if it is empty
+    id_t max_node_id() const;
+
+    /// Renumber the nodes 1, 2, ... in their stored order, and rebuild the
+    /// storage without destroyed nodes, unused sequence, or an ID map. Path
+    /// steps on destroyed nodes are dropped. Invalidates all handles.
+    void compact_ids();
+
+    /// Add the given amount to every node ID
+    void increment_node_ids(id_t increment);
+
+    /// Remove all the embedded paths
+    void clear_paths();
+
+    /// Loop over the embedded paths, passing each one's name and the handles
+    /// it visits in order. Visits to destroyed nodes are left out.
+    void for_each_path(const function<void(const string&, const vector<handle_t>&)>& iteratee) const;
+
+private:
+
+    /// An embedded path, as the handles it visits in order
+    struct PackedPath {
+        string name;
+        bool circular = false;
+        vector<uint64_t> steps;
+    };
+
+    /// An edge to a node that was not loaded yet
+    struct PendingEdge {
+        id_t from;
+        id_t to;
+        bool from_start;
+        bool to_end;
+    };
+
+    /// Flag on a sequence start for nodes with non-ACGT bases
+    static const uint64_t ESCAPED = (uint64_t) 1 << 63;
+
+    /// Flag on a sequence start for destroyed nodes
+    static const uint64_t DESTROYED = (uint64_t) 1 << 62;
+
+    /// Mask for the offset part of a sequence start
+    static const uint64_t START_MASK = DESTROYED - 1;
+
+    /// Make the integer value of the handle for a slot, as stored in path
+    /// steps and adjacency records
+    inline uint64_t slot_value(uint64_t slot, bool is_reverse) const {
+        return (slot << 1) | (uint64_t) is_reverse;
+    }
+
+    /// Make the handle for a slot
+    inline handle_t slot_handle(uint64_t slot, bool is_reverse) const {
+        return as_handle((int64_t) slot_value(slot, is_reverse));
+    }
+
+    /// Determine if the node in a slot was destroyed
+    inline bool is_destroyed(uint64_t slot) const {
+        return seq_starts[slot] & DESTROYED;
+    }
+
+    /// Get the slot a handle refers to
+    inline uint64_t handle_slot(const handle_t& handle) const {
+        return ((uint64_t) as_integer(handle)) >> 1;
+    }
+
+    /// Get the slot at a position in the stored order
+    inline uint64_t slot_at(uint64_t position) const {
+        return order.empty() ? position : order[position];
+    }
+
+    /// Find the slot of a live node, or return false
+    bool find_slot(id_t node_id, uint64_t& slot) const;
+
+    /// Get the ID stored for a slot, even if its node was destroyed
+    id_t slot_id(uint64_t slot) const;
+
+    /// Get the ID that the next node made without one should get
+    id_t next_id() const;
+
+    /// Add a slot for a node with the given ID whose sequence is already in
+    /// the packed store
+    uint64_t add_slot(id_t node_id, uint64_t seq_start, uint32_t length);
+
+    /// Switch from computing IDs from slots to looking them up
+    void use_id_map();
+
+    /// Append a sequence to the packed store and return its start, with the
+    /// ESCAPED flag set if it needed the side table
+    uint64_t append_sequence(const string& sequence);
+
+    /// Get the base at an offset in the packed store
+    char get_base(uint64_t offset, bool escaped) const;
+
+    /// Set the base at an offset in the packed store. Returns true if it had
+    /// to go in the side table.
+    bool set_base(uint64_t offset, char base);
+
+    /// Adjacency record for the given neighbor on one side of a node. The
+    /// neighbor is what following edges off that side of the node's forward
+    /// orientation produces.
+    inline uint64_t make_record(const handle_t& neighbor, bool on_right) const {
+        return ((uint64_t) as_integer(neighbor) << 1) | (uint64_t) on_right;
+    }
+
+    /// Add a record to a node's adjacency unless it is already there
+    void add_record(uint64_t slot, uint64_t record);
+
+    /// Remove a record from a node's adjacency if it is there
+    void remove_record(uint64_t slot, uint64_t record);
+
+    /// Work out the records an edge needs at its two ends
+    pair<uint64_t, uint64_t> edge_records(const handle_t& left, const handle_t& right) const;
+
+    /// Split a node as divide_handle() does, without touching the paths, and
+    /// return the parts in the node's forward orientation
+    vector<handle_t> divide_node(const handle_t& handle, const vector<size_t>& offsets);
+
+    /// Replace path steps on each given slot with steps through the given
+    /// forward parts
+    void replace_divided_steps(const vector<pair<uint64_t, vector<handle_t>>>& divided);
+
+    /// Fill in a full-length match Mapping for a path step
+    void fill_mapping(uint64_t step, int64_t rank, Mapping& mapping) const;
+
+    /// Add an edge, or save it for finish_pending() if a node is missing
+    void add_edge(const Edge& edge);
+
+    /// Append a path's mappings to the path with its name, saving any to
+    /// missing nodes for finish_pending(). If using ranks, saves the ranks
+    /// of steps that come out of order.
+    void add_path(const Path& path, bool use_ranks);
+
+    /// Add a Graph's nodes, edges, and paths, saving edges and path mappings
+    /// to missing nodes for finish_pending()
+    void add_graph(const Graph& graph);
+
+    /// Resolve the saved edges and path mappings and put the paths in rank order
+    void finish_pending();
+
+    /// Find where each path's steps start in the serialization order, and
+    /// return the total number of steps
+    uint64_t get_path_starts(vector<uint64_t>& path_starts) const;
+
+    /// Make the chunk of the .vg serialization holding the given range of
+    /// elements. Elements are node order positions followed by path steps.
+    Graph make_chunk(uint64_t start, uint64_t count, const vector<uint64_t>& path_starts,
+                     uint64_t step_count) const;
+
+    /// Start of each node's sequence in the packed store, possibly flagged
+    /// ESCAPED or DESTROYED
+    vector<uint64_t> seq_starts;
+
+    /// Length of each node's sequence
+    vector<uint32_t> seq_lengths;
+
+    /// Adjacency records of each node
+    vector<vector<uint64_t>> adjacency;
+
+    /// Bases packed 32 to a word
+    vector<uint64_t> packed_bases;
+
+    /// Number of bases in the packed store
+    uint64_t base_count = 0;
+
+    /// Bases other than ACGT, by offset in the packed store
+    unordered_map<uint64_t, char> other_bases;
+
+    /// While there is no ID map, the ID of the node in slot 0
+    id_t id_offset = 1;
+
+    /// Whether IDs are looked up instead of computed from slots
+    bool has_id_map = false;
+
+    /// ID of each slot, when there is an ID map
+    vector<id_t> slot_ids;
+
+    /// Slot of each live node, when there is an ID map
+    hash_map<id_t, uint64_t> id_to_slot;
+
+    /// Largest ID ever used, when there is an ID map
+    id_t max_id = 0;
+
+    /// Slot at each position in the stored order, if nodes were swapped
+    vector<uint64_t> order;
+
+    /// Position in the stored order of each slot, if nodes were swapped
+    vector<uint64_t> position_of;
+
+    /// Number of slots of destroyed nodes
+    size_t destroyed_count = 0;
+
+    /// The embedded paths
+    vector<PackedPath> paths;
+
+    /// Index of each path by name
+    unordered_map<string, size_t> path_index;
+
+    /// While loading, ranks of path steps for paths not seen in rank order
+    unordered_map<size_t, vector<int64_t>> pending_ranks;
+
+    /// While loading, edges between nodes not loaded yet
+    vector<PendingEdge> pending_edges;
+
+    /// While loading, path mappings to nodes not loaded yet, as the path
+    /// index, the step index, and the node and orientation
+    vector<pair<pair<size_t, size_t>, pair<id_t, bool>>> pending_steps;
+};
+
+}
+
+#endif
@@ -4,9 +4,23 @@ namespace vg {
 
 Packer::Packer(void) : xgidx(nullptr) { }
 
-Packer::Packer(xg::XG* xidx, size_t binsz) : xgidx(xidx), bin_size(binsz) {
-    coverage_dynamic = gcsa::CounterArray(xgidx->seq_length, 8);
+Packer::Packer(xg::XG* xidx, size_t binsz, bool concurrent) : xgidx(xidx), bin_size(binsz), is_concurrent(concurrent) {
     if (binsz) n_bins = xgidx->seq_length / bin_size + 1;
+    if (is_concurrent) {
+        // one counter array for all threads, instead of one per thread
+        coverage_concurrent = vector<atomic<uint32_t>>(xgidx->seq_length);
+        for (auto& count : coverage_concurrent) {
+            count.store(0, memory_order_relaxed);
+        }
+        // threads can't race to open the edit files
+        ensure_edit_tmpfiles_open();
+        edit_buffers.resize(max(omp_get_max_threads(), omp_get_num_procs()));
+        for (auto& buffer : edit_buffers) {
+            buffer.bins.resize(n_bins);
+        }
+    } else {
+        coverage_dynamic = gcsa::CounterArray(xgidx->seq_length, 8);
+    }
 }
 
 Packer::~Packer(void) {
@@ -34,6 +48,7 @@ void Packer::load(istream& in) {
     }
     // We can only load compacted.
     is_compacted = true;
+    index_coverage_blocks();
 }
 
 void Packer::merge_from_files(const vector<string>& file_names) {
@@ -50,7 +65,7 @@ void Packer::merge_from_files(const vector<string>& file_names) {
         // take bin size and counts from the first, assume they are all the same
         if (first) {
             bin_size = c.get_bin_size();
-            n_bins = c.get_n_bins();
+            set_n_bins(c.get_n_bins());
             ensure_edit_tmpfiles_open();
             first = false;
         } else {
@@ -71,7 +86,7 @@ void Packer::merge_from_dynamic(vector<Packer*>& packers) {
         // take bin size and counts from the first, assume they are all the same
         if (first) {
             bin_size = c.get_bin_size();
-            n_bins = c.get_n_bins();
+            set_n_bins(c.get_n_bins());
             ensure_edit_tmpfiles_open();
             first = false;
         } else {
@@ -83,6 +98,19 @@ void Packer::merge_from_dynamic(vector<Packer*>& packers) {
     }
 }
 
+void Packer::set_n_bins(size_t bins) {
+    if (bins == n_bins) return;
+    // the edit files and buffers are laid out by bin, so start them over
+    close_edit_tmpfiles();
+    remove_edit_tmpfiles();
+    n_bins = bins;
+    for (auto& buffer : edit_buffers) {
+        buffer.bins.clear();
+        buffer.bins.resize(n_bins);
+        buffer.bytes = 0;
+    }
+}
+
 size_t Packer::get_bin_size(void) const {
     return bin_size;
 }
@@ -121,7 +149,15 @@ void Packer::collect_coverage(const Packer& c) {
     // assume the same basis vector
     assert(!is_compacted);
     for (size_t i = 0; i < c.graph_length(); ++i) {
-        coverage_dynamic.increment(i, c.coverage_at_position(i));
+        increment_coverage(i, c.coverage_at_position(i));
+    }
+}
+
+void Packer::increment_coverage(size_t i, size_t amount) {
+    if (is_concurrent) {
+        coverage_concurrent[i].fetch_add(amount, memory_order_relaxed);
+    } else {
+        coverage_dynamic.increment(i, amount);
     }
 }
 
@@ -156,11 +192,11 @@ void Packer::make_compact(void) {
     // sync edit file
     close_edit_tmpfiles();
     // temporaries for construction
-    size_t basis_length = coverage_dynamic.size();
+    size_t basis_length = graph_length();
     int_vector<> coverage_iv;
     util::assign(coverage_iv, int_vector<>(basis_length));
-    for (size_t i = 0; i < coverage_dynamic.size(); ++i) {
-        coverage_iv[i] = coverage_dynamic[i];
+    for (size_t i = 0; i < basis_length; ++i) {
+        coverage_iv[i] = coverage_at_position(i);
     }
     edit_csas.resize(edit_tmpfile_names.size());
     util::assign(coverage_civ, coverage_iv);
@@ -171,7 +207,27 @@ void Packer::make_compact(void) {
     }
     // construct the record marker bitvector
     remove_edit_tmpfiles();
+    // the concurrent counters are no longer needed
+    coverage_concurrent = vector<atomic<uint32_t>>();
     is_compacted = true;
+    index_coverage_blocks();
+}
+
+void Packer::index_coverage_blocks(void) {
+    size_t n_blocks = (coverage_civ.size() + COVERAGE_BLOCK_SIZE - 1) / COVERAGE_BLOCK_SIZE;
+    coverage_block_prefix_sums.assign(n_blocks + 1, 0);
+    coverage_block_min.assign(n_blocks, numeric_limits<uint32_t>::max());
+    coverage_block_max.assign(n_blocks, 0);
+    for (size_t i = 0; i < coverage_civ.size(); ++i) {
+        size_t coverage = coverage_civ[i];
+        size_t block = i / COVERAGE_BLOCK_SIZE;
+        coverage_block_prefix_sums[block + 1] += coverage;
+        coverage_block_min[block] = min<size_t>(coverage_block_min[block], coverage);
+        coverage_block_max[block] = max<size_t>(coverage_block_max[block], coverage);
+    }
+    for (size_t block = 0; block < n_blocks; ++block) {
+        coverage_block_prefix_sums[block + 1] += coverage_block_prefix_sums[block];
+    }
 }
 
 void Packer::make_dynamic(void) {
@@ -202,8 +258,22 @@ void Packer::ensure_edit_tmpfiles_open(void) {
     }
 }
 
+void Packer::flush_edit_buffer(size_t thread) {
+    auto& buffer = edit_buffers[thread];
+    if (buffer.bytes == 0) return;
+    lock_guard<mutex> lock(edit_tmpfile_mutex);
+    for (size_t i = 0; i < buffer.bins.size(); ++i) {
+        *tmpfstreams[i] << buffer.bins[i];
+        buffer.bins[i].clear();
+    }
+    buffer.bytes = 0;
+}
+
 void Packer::close_edit_tmpfiles(void) {
     if (!tmpfstreams.empty()) {
+        for (size_t i = 0; i < edit_buffers.size(); ++i) {
+            flush_edit_buffer(i);
+        }
         for (auto& tmpfstream : tmpfstreams) {
             *tmpfstream << delim1; // pad
             tmpfstream->close();
@@ -223,8 +293,8 @@ void Packer::remove_edit_tmpfiles(void) {
 }
 
 void Packer::add(const Alignment& aln, bool record_edits) {
-    // open tmpfile if needed
-    ensure_edit_tmpfiles_open();
+    // open tmpfile if needed (a concurrent packer opened them up front)
+    if (!is_concurrent) ensure_edit_tmpfiles_open();
     // count the nodes, edges, and edits
     for (auto& mapping : aln.path().mapping()) {
         if (!mapping.has_position()) {
@@ -241,11 +311,11 @@ void Packer::add(const Alignment& aln, bool record_edits) {
 #endif
                 if (mapping.position().is_reverse()) {
                     for (size_t j = 0; j < edit.from_length(); ++j) {
-                        coverage_dynamic.increment(i-j);
+                        increment_coverage(i-j);
                     }
                 } else {
                     for (size_t j = 0; j < edit.from_length(); ++j) {
-                        coverage_dynamic.increment(i+j);
+                        increment_coverage(i+j);
                     }
                 }
             } else if (record_edits) {
@@ -253,7 +323,18 @@ void Packer::add(const Alignment& aln, bool record_edits) {
                 string pos_repr = pos_key(i);
                 string edit_repr = edit_value(edit, mapping.position().is_reverse());
                 size_t bin = bin_for_position(i);
-                *tmpfstreams[bin] << pos_repr << edit_repr;
+                if (is_concurrent) {
+                    // buffer edits per thread so threads only meet when flushing
+                    size_t thread = omp_get_thread_num();
+                    auto& buffer = edit_buffers[thread];
+                    buffer.bins[bin].append(pos_repr).append(edit_repr);
+                    buffer.bytes += pos_repr.size() + edit_repr.size();
+                    if (buffer.bytes >= EDIT_BUFFER_BYTES) {
+                        flush_edit_buffer(thread);
+                    }
+                } else {
+                    *tmpfstreams[bin] << pos_repr << edit_repr;
+                }
             }
             if (mapping.position().is_reverse()) {
                 i -= edit.from_length();
@@ -334,6 +415,8 @@ string Packer::unescape_delim(const string& s, char d) const {
 size_t Packer::graph_length(void) const {
     if (is_compacted) {
         return coverage_civ.size();
+    } else if (is_concurrent) {
+        return coverage_concurrent.size();
     } else {
         return coverage_dynamic.size();
     }
@@ -342,11 +425,95 @@ size_t Packer::graph_length(void) const {
 size_t Packer::coverage_at_position(size_t i) const {
     if (is_compacted) {
         return coverage_civ[i];
+    } else if (is_concurrent) {
+        return coverage_concurrent[i].load(memory_order_relaxed);
     } else {
         return coverage_dynamic[i];
     }
 }
 
+double CoverageSummary::mean(void) const {
+    return length ? (double)total / length : 0.0;
+}
+
+void CoverageSummary::merge(const CoverageSummary& other) {
+    length += other.length;
+    total += other.total;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+CoverageSummary Packer::coverage_summary(size_t start, size_t end) const {
+    assert(is_compacted);
+    CoverageSummary summary;
+    end = min(end, coverage_civ.size());
+    if (start >= end) return summary;
+    summary.length = end - start;
+    size_t first_full = (start + COVERAGE_BLOCK_SIZE - 1) / COVERAGE_BLOCK_SIZE;
+    size_t past_last_full = end / COVERAGE_BLOCK_SIZE;
+    if (first_full >= past_last_full) {
+        // no whole blocks, so just scan
+        for (size_t i = start; i < end; ++i) {
+            size_t coverage = coverage_civ[i];
+            summary.total += coverage;
+            summary.min = min(summary.min, coverage);
+            summary.max = max(summary.max, coverage);
+        }
+        return summary;
+    }
+    // scan the partial blocks at the ends
+    for (size_t i = start; i < first_full * COVERAGE_BLOCK_SIZE; ++i) {
+        size_t coverage = coverage_civ[i];
+        summary.total += coverage;
+        summary.min = min(summary.min, coverage);
+        summary.max = max(summary.max, coverage);
+    }
+    for (size_t i = past_last_full * COVERAGE_BLOCK_SIZE; i < end; ++i) {
+        size_t coverage = coverage_civ[i];
+        summary.total += coverage;
+        summary.min = min(summary.min, coverage);
+        summary.max = max(summary.max, coverage);
+    }
+    // and use the summaries for the whole blocks
+    summary.total += coverage_block_prefix_sums[past_last_full] - coverage_block_prefix_sums[first_full];
+    for (size_t block = first_full; block < past_last_full; ++block) {
+        summary.min = min<size_t>(summary.min, coverage_block_min[block]);
+        summary.max = max<size_t>(summary.max, coverage_block_max[block]);
+    }
+    return summary;
+}
+
+CoverageSummary Packer::path_coverage_summary(const string& path_name, size_t start, size_t end) const {
+    if (!xgidx->path_rank(path_name)) {
+        throw runtime_error("[vg::Packer] path " + path_name + " is not in the graph");
+    }
+    CoverageSummary summary;
+    const xg::XGPath& path = xgidx->get_path(path_name);
+    end = min(end, (size_t)path.offsets.size());
+    if (start >= end) return summary;
+    // walk the path steps overlapping the range
+    size_t step = path.offsets_rank(start + 1) - 1;
+    size_t pos = start;
+    while (pos < end) {
+        id_t node_id = path.node(step);
+        size_t node_length = xgidx->node_length(node_id);
+        size_t step_start = path.positions[step];
+        // the part of the node we cover, along the path
+        size_t from = pos - step_start;
+        size_t to = min(end - step_start, node_length);
+        // our basis is on the forward strand
+        size_t node_start = xg_node_start(node_id, xgidx);
+        if (path.is_reverse(step)) {
+            summary.merge(coverage_summary(node_start + node_length - to, node_start + node_length - from));
+        } else {
+            summary.merge(coverage_summary(node_start + from, node_start + to));
+        }
+        pos = step_start + to;
+        ++step;
+    }
+    return summary;
+}
+
 vector<Edit> Packer::edits_at_position(size_t i) const {
     vector<Edit> edits;
     if (i == 0) return edits;
@@ -5,6 +5,9 @@
 #include <map>
 #include <chrono>
 #include <ctime>
+#include <atomic>
+#include <limits>
+#include <mutex>
 #include "omp.h"
 #include "xg.hpp"
 #include "alignment.hpp"
@@ -20,10 +23,30 @@ namespace vg {
 
 using namespace sdsl;
 
+/// Depth statistics over a range of graph sequence
+struct CoverageSummary {
+    /// Number of bases summarized
+    size_t length = 0;
+    /// Sum of the coverage of every base
+    size_t total = 0;
+    size_t min = numeric_limits<size_t>::max();
+    size_t max = 0;
+    /// Mean coverage per base, or 0 for an empty range
+    double mean(void) const;
+    /// Add another range's statistics to these
+    void merge(const CoverageSummary& other);
+};
+
+/// Accumulates the coverage and edits of alignments against an xg graph, and
+/// compacts them into succinct structures for querying and serialization.
 class Packer {
 public:
     Packer(void);
-    Packer(xg::XG* xidx, size_t bin_size);
+    /// Make a packer over the given graph. If concurrent is set, any number
+    /// of OMP threads can add() at once: coverage goes into one shared array
+    /// of atomic counters, and edits into per-thread buffers that are appended
+    /// to the shared edit files as they fill.
+    Packer(xg::XG* xidx, size_t bin_size, bool concurrent = false);
     ~Packer(void);
     xg::XG* xgidx;
     void merge_from_files(const vector<string>& file_names);
@@ -43,6 +66,14 @@ public:
     string edit_value(const Edit& edit, bool revcomp) const;
     vector<Edit> edits_at_position(size_t i) const;
     size_t coverage_at_position(size_t i) const;
+    /// Summarize coverage over the half-open range [start, end) of the graph
+    /// sequence basis. The packer must be compact. Runs in time proportional
+    /// to the number of summary blocks the range spans.
+    CoverageSummary coverage_summary(size_t start, size_t end) const;
+    /// Summarize coverage over the 0-based half-open range [start, end) of a
+    /// path, in time proportional to the number of nodes it touches. The range
+    /// is clipped to the path. The packer must be compact.
+    CoverageSummary path_coverage_summary(const string& path_name, size_t start, size_t end) const;
     void collect_coverage(const Packer& c);
     ostream& as_table(ostream& out, bool show_edits = true);
     ostream& show_structure(ostream& out); // debugging
@@ -53,13 +84,34 @@ public:
     bool is_dynamic(void);
 private:
     void ensure_edit_tmpfiles_open(void);
+    // change the number of bins, reopening the edit files if needed
+    void set_n_bins(size_t bins);
     void close_edit_tmpfiles(void);
     void remove_edit_tmpfiles(void);
+    // add to the dynamic coverage at a position
+    void increment_coverage(size_t i, size_t amount = 1);
+    // append this thread's buffered edits to the edit files
+    void flush_edit_buffer(size_t thread);
     bool is_compacted = false;
     // dynamic model
     gcsa::CounterArray coverage_dynamic;
     vector<string> edit_tmpfile_names;
     vector<ofstream*> tmpfstreams;
+    // concurrent dynamic model, used instead of coverage_dynamic
+    bool is_concurrent = false;
+    vector<atomic<uint32_t>> coverage_concurrent;
+    // per-thread edits waiting to be written, by bin, padded to keep threads
+    // off each other's cache lines
+    struct EditBuffer {
+        vector<string> bins;
+        size_t bytes = 0;
+        char padding[64];
+    };
+    vector<EditBuffer> edit_buffers;
+    // guards tmpfstreams when flushing edit buffers
+    mutex edit_tmpfile_mutex;
+    // flush a thread's edits when they reach this size
+    static const size_t EDIT_BUFFER_BYTES = 1 << 20;
     // which bin should we use
     size_t bin_for_position(size_t i) const;
     size_t n_bins = 1;
@@ -67,6 +119,12 @@ private:
     size_t edit_length = 0;
     size_t edit_count = 0;
     dac_vector<> coverage_civ; // graph coverage (compacted coverage_dynamic)
+    // summaries of each block of coverage_civ, for range queries
+    void index_coverage_blocks(void);
+    static const size_t COVERAGE_BLOCK_SIZE = 64;
+    vector<uint64_t> coverage_block_prefix_sums; // total coverage before each block, and in all
+    vector<uint32_t> coverage_block_min;
+    vector<uint32_t> coverage_block_max;
     //
     vector<csa_sada<enc_vector<>, 32, 32, sa_order_sa_sampling<>, isa_sampling<>, succinct_byte_alphabet<> > > edit_csas;
     // make separators that are somewhat unusual, as we escape these
@@ -1,6 +1,9 @@
 #include <cstdlib>
 #include <stdexcept>
 #include <regex>
+#include <deque>
+#include <fstream>
+#include <cstdio>
 #include "json2pb.h"
 #include "pileup.hpp"
 #include "stream.hpp"
@@ -9,6 +12,288 @@ using namespace std;
 
 namespace vg {
 
+const char CompactNodePileup::ALLELES[] = "ACGTN";
+const int CompactNodePileup::ALLELE_COUNT;
+
+CompactNodePileup::CompactNodePileup(int64_t node_id, const string& ref_sequence) :
+    _node_id(node_id),
+    _columns(ref_sequence.size()) {
+    for (size_t i = 0; i < ref_sequence.size(); ++i) {
+        _columns[i].ref_base = ref_sequence[i];
+    }
+}
+
+CompactNodePileup::CompactNodePileup(const NodePileup& pileup) :
+    _node_id(pileup.node_id()),
+    _columns(pileup.base_pileup_size()) {
+    int max_depth = numeric_limits<uint16_t>::max();
+    vector<pair<int64_t, int64_t> > offsets;
+    for (int i = 0; i < pileup.base_pileup_size(); ++i) {
+        const BasePileup& bp = pileup.base_pileup(i);
+        _columns[i].ref_base = bp.ref_base();
+        Pileups::parse_base_offsets(bp, offsets);
+        for (auto& offset : offsets) {
+            char tok = bp.bases()[offset.first];
+            int quality = offset.second >= 0 ? bp.qualities()[offset.second] : -1;
+            // extract() gives us everything on the forward strand except
+            // for the deletion strand flag
+            string val = Pileups::extract(bp, offset.first);
+            if (tok == '+') {
+                bool is_reverse = ::islower(bp.bases()[offset.first + val.length() - 1]);
+                add_indel(i, val, is_reverse, quality, max_depth);
+            } else if (tok == '-') {
+                bool is_reverse, from_start, to_end;
+                int64_t from_id, from_offset, to_id, to_offset;
+                Pileups::parse_delete(val, is_reverse, from_id, from_offset, from_start, to_id, to_offset, to_end);
+                Pileups::make_delete(val, false, from_id, from_offset, from_start, to_id, to_offset, to_end);
+                add_indel(i, val, is_reverse, quality, max_depth);
+            } else {
+                add_base(i, val[0], tok == ',' || ::islower(tok), quality, max_depth);
+            }
+        }
+    }
+}
+
+// write and read plain values in the machine's own representation, for
+// temporary files
+template<typename T>
+static void write_raw(ostream& out, const T& value) {
+    out.write((const char*)&value, sizeof(T));
+}
+
+template<typename T>
+static void read_raw(istream& in, T& value) {
+    in.read((char*)&value, sizeof(T));
+}
+
+CompactNodePileup::CompactNodePileup(istream& in) {
+    uint64_t column_count = 0;
+    read_raw(in, _node_id);
+    read_raw(in, column_count);
+    _columns.resize(column_count);
+    in.read((char*)_columns.data(), column_count * sizeof(Column));
+    uint64_t indel_count = 0;
+    read_raw(in, indel_count);
+    _indels.resize(indel_count);
+    for (Indel& indel : _indels) {
+        uint32_t token_length = 0;
+        read_raw(in, indel.offset);
+        read_raw(in, token_length);
+        indel.token.resize(token_length);
+        in.read(&indel.token[0], token_length);
+        read_raw(in, indel.counts);
+        read_raw(in, indel.qual_count);
+        read_raw(in, indel.qual_sum);
+    }
+    if (!in) {
+        throw runtime_error("[vg::CompactNodePileup] could not read serialized pileup");
+    }
+}
+
+void CompactNodePileup::serialize(ostream& out) const {
+    write_raw(out, _node_id);
+    write_raw(out, (uint64_t)_columns.size());
+    out.write((const char*)_columns.data(), _columns.size() * sizeof(Column));
+    write_raw(out, (uint64_t)_indels.size());
+    for (const Indel& indel : _indels) {
+        write_raw(out, indel.offset);
+        write_raw(out, (uint32_t)indel.token.size());
+        out.write(indel.token.data(), indel.token.size());
+        write_raw(out, indel.counts);
+        write_raw(out, indel.qual_count);
+        write_raw(out, indel.qual_sum);
+    }
+}
+
+int CompactNodePileup::allele_index(char base) {
+    switch (::toupper(base)) {
+    case 'A':
+        return 0;
+    case 'C':
+        return 1;
+    case 'G':
+        return 2;
+    case 'T':
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+pair<vector<CompactNodePileup::Indel>::const_iterator, vector<CompactNodePileup::Indel>::const_iterator>
+CompactNodePileup::indels_at(size_t offset) const {
+    auto begin = lower_bound(_indels.begin(), _indels.end(), offset, [](const Indel& indel, size_t offset) {
+            return indel.offset < offset;
+        });
+    auto end = begin;
+    while (end != _indels.end() && end->offset == offset) {
+        ++end;
+    }
+    return make_pair(begin, end);
+}
+
+CompactNodePileup::Indel& CompactNodePileup::get_create_indel(size_t offset, const string& token) {
+    auto it = lower_bound(_indels.begin(), _indels.end(), make_pair(offset, &token),
+                          [](const Indel& indel, const pair<size_t, const string*>& key) {
+                              return indel.offset < key.first ||
+                                  (indel.offset == key.first && indel.token < *key.second);
+                          });
+    if (it == _indels.end() || it->offset != offset || it->token != token) {
+        Indel indel;
+        indel.offset = offset;
+        indel.token = token;
+        it = _indels.insert(it, indel);
+    }
+    return *it;
+}
+
+bool CompactNodePileup::add_base(size_t offset, char base, bool is_reverse, int quality, int max_depth) {
+    Column& column = _columns.at(offset);
+    if (column.depth >= max_depth) {
+        return false;
+    }
+    int allele = allele_index(base);
+    ++column.depth;
+    ++column.counts[allele][is_reverse];
+    if (quality >= 0) {
+        ++column.qual_counts[allele];
+        column.qual_sums[allele] += quality;
+    }
+    return true;
+}
+
+bool CompactNodePileup::add_indel(size_t offset, const string& token, bool is_reverse, int quality, int max_depth) {
+    Column& column = _columns.at(offset);
+    if (column.depth >= max_depth) {
+        return false;
+    }
+    Indel& indel = get_create_indel(offset, token);
+    ++column.depth;
+    ++indel.counts[is_reverse];
+    if (quality >= 0) {
+        ++indel.qual_count;
+        indel.qual_sum += quality;
+    }
+    return true;
+}
+
+/// Move as many reads as fit in room from one set of strand counts to
+/// another, along with their share of the qualities.  Returns the number moved.
+static int move_counts(uint16_t* from, uint16_t& from_qual_count, uint32_t& from_qual_sum,
+                       uint16_t* to, uint16_t& to_qual_count, uint32_t& to_qual_sum, int room) {
+    int total = from[0] + from[1];
+    if (total == 0 || room <= 0) {
+        return 0;
+    }
+    int moved = 0;
+    for (int strand = 0; strand < 2; ++strand) {
+        int n = min((int)from[strand], room - moved);
+        to[strand] += n;
+        moved += n;
+    }
+    // qualities aren't kept per read, so a partial move takes its share
+    uint16_t qual_count = (uint64_t)from_qual_count * moved / total;
+    uint32_t qual_sum = (uint64_t)from_qual_sum * moved / total;
+    to_qual_count += qual_count;
+    to_qual_sum += qual_sum;
+    from[0] = from[1] = 0;
+    from_qual_count = 0;
+    from_qual_sum = 0;
+    return moved;
+}
+
+void CompactNodePileup::merge(CompactNodePileup& other, int max_depth) {
+    assert(_node_id == other._node_id);
+    if (_columns.size() < other._columns.size()) {
+        _columns.resize(other._columns.size());
+    }
+    for (size_t i = 0; i < other._columns.size(); ++i) {
+        Column& to = _columns[i];
+        Column& from = other._columns[i];
+        assert(to.depth == 0 || from.depth == 0 || to.ref_base == from.ref_base);
+        if (to.ref_base == 0) {
+            to.ref_base = from.ref_base;
+        }
+        for (int allele = 0; allele < ALLELE_COUNT; ++allele) {
+            to.depth += move_counts(from.counts[allele], from.qual_counts[allele], from.qual_sums[allele],
+                                    to.counts[allele], to.qual_counts[allele], to.qual_sums[allele],
+                                    max_depth - to.depth);
+        }
+    }
+    for (Indel& from : other._indels) {
+        Column& column = _columns[from.offset];
+        if (column.depth < max_depth) {
+            Indel& to = get_create_indel(from.offset, from.token);
+            column.depth += move_counts(from.counts, from.qual_count, from.qual_sum,
+                                        to.counts, to.qual_count, to.qual_sum,
+                                        max_depth - column.depth);
+        }
+    }
+    other._columns.clear();
+    other._indels.clear();
+}
+
+void CompactNodePileup::to_protobuf(NodePileup& pileup) const {
+    pileup.Clear();
+    pileup.set_node_id(_node_id);
+
+    // append count copies of a token and its mean quality
+    auto append_tokens = [](BasePileup& bp, const string& token, int count,
+                            uint16_t qual_count, uint32_t qual_sum) {
+        char quality = qual_count > 0 ? (qual_sum + qual_count / 2) / qual_count : 0;
+        for (int i = 0; i < count; ++i) {
+            bp.mutable_bases()->append(token);
+            if (qual_count > 0) {
+                *bp.mutable_qualities() += quality;
+            }
+        }
+    };
+
+    for (size_t i = 0; i < _columns.size(); ++i) {
+        const Column& column = _columns[i];
+        BasePileup* bp = pileup.add_base_pileup();
+        bp->set_ref_base(column.ref_base);
+        bp->set_num_bases(column.depth);
+
+        // reference matches first, then the other bases in order
+        int ref_allele = allele_index(column.ref_base);
+        for (int j = -1; j < ALLELE_COUNT; ++j) {
+            int allele = j < 0 ? ref_allele : j;
+            if (j >= 0 && allele == ref_allele) {
+                continue;
+            }
+            string fwd_token = allele == ref_allele ? "." : string(1, ALLELES[allele]);
+            string rev_token = allele == ref_allele ? "," :
+                string(1, ::tolower(reverse_complement(ALLELES[allele])));
+            append_tokens(*bp, fwd_token, column.counts[allele][0],
+                          column.qual_counts[allele], column.qual_sums[allele]);
+            append_tokens(*bp, rev_token, column.counts[allele][1],
+                          column.qual_counts[allele], column.qual_sums[allele]);
+        }
+
+        auto indels = indels_at(i);
+        for (auto it = indels.first; it != indels.second; ++it) {
+            string rev_token;
+            if (it->token[0] == '+') {
+                int64_t len;
+                string seq;
+                bool is_reverse;
+                Pileups::parse_insert(it->token, len, seq, is_reverse);
+                seq = reverse_complement(seq);
+                Pileups::make_insert(seq, true);
+                rev_token = seq;
+            } else {
+                bool is_reverse, from_start, to_end;
+                int64_t from_id, from_offset, to_id, to_offset;
+                Pileups::parse_delete(it->token, is_reverse, from_id, from_offset, from_start, to_id, to_offset, to_end);
+                Pileups::make_delete(rev_token, true, from_id, from_offset, from_start, to_id, to_offset, to_end);
+            }
+            append_tokens(*bp, it->token, it->counts[0], it->qual_count, it->qual_sum);
+            append_tokens(*bp, rev_token, it->counts[1], it->qual_count, it->qual_sum);
+        }
+    }
+}
+
 void Pileups::clear() {
     for (auto& p : _node_pileups) {
         delete p.second;
@@ -19,6 +304,7 @@ void Pileups::clear() {
         delete p.second;
     }
     _edge_pileups.clear();
+    _node_pileup_bases = 0;
     _min_quality_count = 0;
     _max_mismatch_count = 0;
     _bases_count = 0;
@@ -26,8 +312,10 @@ void Pileups::clear() {
 
 void Pileups::to_json(ostream& out) {
     out << "{\"node_pileups\": [";
+    NodePileup node_pileup;
     for (NodePileupHash::iterator i = _node_pileups.begin(); i != _node_pileups.end();) {
-        out << pb2json(*i->second);
+        i->second->to_protobuf(node_pileup);
+        out << pb2json(node_pileup);
         ++i;
         if (i != _node_pileups.end()) {
             out << ",";
@@ -68,8 +356,7 @@ void Pileups::write(ostream& out, uint64_t chunk_size) {
         pileup.clear_node_pileups();
         pileup.clear_edge_pileups();
         for (int j = 0; j < chunk_size && node_it != _node_pileups.end(); ++j, ++node_it) {
-            NodePileup* np = pileup.add_node_pileups();
-            *np = *node_it->second;
+            node_it->second->to_protobuf(*pileup.add_node_pileups());
         }
         // unlike for Graph, we don't bother to try to group edges with nodes they attach
         for (int j = 0; j < chunk_size && edge_it != _edge_pileups.end(); ++j, ++edge_it) {
@@ -83,7 +370,7 @@ void Pileups::write(ostream& out, uint64_t chunk_size) {
     stream::write(out, count, lambda);
 }
 
-void Pileups::for_each_node_pileup(const function<void(NodePileup&)>& lambda) {
+void Pileups::for_each_node_pileup(const function<void(CompactNodePileup&)>& lambda) {
     for (auto& p : _node_pileups) {
         lambda(*p.second);
     }
@@ -123,20 +410,21 @@ EdgePileup* Pileups::get_create_edge_pileup(pair<NodeSide, NodeSide> sides) {
 
 void Pileups::extend(Pileup& pileup) {
     for (int i = 0; i < pileup.node_pileups_size(); ++i) {
-        insert_node_pileup(new NodePileup(pileup.node_pileups(i)));
+        insert_node_pileup(new CompactNodePileup(pileup.node_pileups(i)));
     }
     for (int i = 0; i < pileup.edge_pileups_size(); ++i) {
         insert_edge_pileup(new EdgePileup(pileup.edge_pileups(i)));
     }
 }
 
-bool Pileups::insert_node_pileup(NodePileup* pileup) {
-    NodePileup* existing = get_node_pileup(pileup->node_id());
+bool Pileups::insert_node_pileup(CompactNodePileup* pileup) {
+    CompactNodePileup* existing = get_node_pileup(pileup->node_id());
     if (existing != NULL) {
         merge_node_pileups(*existing, *pileup);
         delete pileup;
     } else {
         _node_pileups[pileup->node_id()] = pileup;
+        _node_pileup_bases += pileup->size();
     }
     return existing == NULL;
 }
@@ -172,7 +460,9 @@ void Pileups::compute_from_alignment(Alignment& alignment) {
         int rank = mapping.rank() <= 0 ? i + 1 : mapping.rank(); 
         if (_graph->has_node(mapping.position().node_id())) {
             const Node* node = _graph->get_node(mapping.position().node_id());
-            NodePileup* pileup = get_create_node_pileup(node);
+            // we still walk through nodes we don't record pileups on, to
+            // find the indels and edges that start or end on ours
+            CompactNodePileup* pileup = owns_node(node->id()) ? get_create_node_pileup(node) : NULL;
             int64_t node_offset = mapping.position().offset();
             // utilize forward-relative node offset (old way), which
             // is not consistent with current protobuf.  conversion here.  
@@ -192,7 +482,7 @@ void Pileups::compute_from_alignment(Alignment& alignment) {
                 }
                 // process all pileups in edit.
                 // update the offsets as we go
-                compute_from_edit(*pileup, node_offset, read_offset, *node,
+                compute_from_edit(pileup, node_offset, read_offset, *node,
                                   alignment, mapping, edit, next_edit, mismatch_counts,
                                   last_match, last_del, open_del);
             }
@@ -235,7 +525,7 @@ void Pileups::compute_from_alignment(Alignment& alignment) {
                     char to_qual = alignment.quality()[in_read_offsets[rank2_idx]];
                     edge_qual = combined_quality(min(from_qual, to_qual), alignment.mapping_quality());
                 }
-                if (edge_qual >= _min_quality) {
+                if (edge_qual >= _min_quality && owns_node(min(s1, s2).node)) {
                     EdgePileup* edge_pileup = get_create_edge_pileup(pair<NodeSide, NodeSide>(s1, s2));
                     if (edge_pileup->num_reads() < _max_depth) {
                         edge_pileup->set_num_reads(edge_pileup->num_reads() + 1);
@@ -257,7 +547,7 @@ void Pileups::compute_from_alignment(Alignment& alignment) {
 
 }
 
-void Pileups::compute_from_edit(NodePileup& pileup, int64_t& node_offset,
+void Pileups::compute_from_edit(CompactNodePileup* pileup, int64_t& node_offset,
                                 int64_t& read_offset,
                                 const Node& node, const Alignment& alignment,
                                 const Mapping& mapping, const Edit& edit,
@@ -273,39 +563,36 @@ void Pileups::compute_from_edit(NodePileup& pileup, int64_t& node_offset,
     // ***** MATCH *****
     if (edit.from_length() == edit.to_length()) {
         assert (edit.from_length() > 0);
-        make_match(seq, edit.from_length(), map_reverse);
-        assert(seq.length() == edit.from_length());            
+        assert(seq.empty() || seq.length() == edit.from_length());
         int64_t delta = map_reverse ? -1 : 1;
         for (int64_t i = 0; i < edit.from_length(); ++i) {
             if (pass_filter(alignment, read_offset, 1, mismatch_counts)) {
                 // Don't go outside the node
-                if (node_offset >= _graph->get_node(pileup.node_id())->sequence().size()) {
-                    cerr << "error [vg::Pileups] node_offset of " << node_offset << " on " << pileup.node_id() << " is too big for node of size " << _graph->get_node(pileup.node_id())->sequence().size() << endl;
+                if (node_offset >= node.sequence().size()) {
+                    cerr << "error [vg::Pileups] node_offset of " << node_offset << " on " << node.id() << " is too big for node of size " << node.sequence().size() << endl;
                     cerr << "Alignment: " << pb2json(alignment) << endl;
                     throw runtime_error("Node offset too large in alignment");
                 }
-                BasePileup* base_pileup = get_create_base_pileup(pileup, node_offset);
-                if (base_pileup->num_bases() < _max_depth) {
-                    // reference_base if empty
-                    if (base_pileup->num_bases() == 0) {
-                        base_pileup->set_ref_base(node.sequence()[node_offset]);
+                if (pileup != NULL) {
+                    // count the read base on the forward strand
+                    char base;
+                    if (seq.empty()) {
+                        base = node.sequence()[node_offset];
                     } else {
-                        assert(base_pileup->ref_base() == node.sequence()[node_offset]);
-                    }
-                    // add base to bases field (converting to ,. if match)
-                    char base = seq[i];
-                    *base_pileup->mutable_bases() += base;
-                    // add quality if there
-                    if (!alignment.quality().empty()) {
-                        *base_pileup->mutable_qualities() += alignment.quality()[read_offset];
+                        base = ::toupper(seq[i]);
+                        if (map_reverse) {
+                            base = reverse_complement(base);
+                        }
                     }
-                    // pileup size increases by 1
-                    base_pileup->set_num_bases(base_pileup->num_bases() + 1);
+                    pileup->add_base(node_offset, base, map_reverse,
+                                     alignment.quality().empty() ? -1 : alignment.quality()[read_offset],
+                                     _max_depth);
                 }
                 // close off any open deletion
                 if (open_del.first != NULL) {
+                    // deletions are stored by the strand-independent token
                     string del_seq;
-                    make_delete(del_seq, map_reverse, last_match, mapping, node_offset);
+                    make_delete(del_seq, false, last_match, mapping, node_offset);
                     int64_t dp_node_id;
                     int64_t dp_node_offset;
                     // store in canonical position
@@ -319,25 +606,17 @@ void Pileups::compute_from_edit(NodePileup& pileup, int64_t& node_offset,
                         dp_node_id = open_del.first->position().node_id();
                         dp_node_offset = open_del.second;
                     }
-                    Node* dp_node = _graph->get_node(dp_node_id);
-                    // Don't go outside the node
-                    assert(dp_node_offset < dp_node->sequence().size());
-                    NodePileup* dp_node_pileup = get_create_node_pileup(dp_node);
-                    BasePileup* dp_base_pileup = get_create_base_pileup(*dp_node_pileup, dp_node_offset);
-                    if (dp_base_pileup->num_bases() < _max_depth) {
-                        // reference_base if empty
-                        if (dp_base_pileup->num_bases() == 0) {
-                            dp_base_pileup->set_ref_base(dp_node->sequence()[dp_node_offset]);
-                        } else {
-                            assert(dp_base_pileup->ref_base() == dp_node->sequence()[dp_node_offset]);
-                        }
-                        *dp_base_pileup->mutable_bases() += del_seq;
-                        if (!alignment.quality().empty()) {
-                            // we only use quality of one endpoint here.  should average
-                            *dp_base_pileup->mutable_qualities() += combined_quality(alignment.quality()[read_offset],
-                                                                                     alignment.mapping_quality());
-                        }
-                        dp_base_pileup->set_num_bases(dp_base_pileup->num_bases() + 1);
+                    if (owns_node(dp_node_id)) {
+                        Node* dp_node = _graph->get_node(dp_node_id);
+                        // Don't go outside the node
+                        assert(dp_node_offset < dp_node->sequence().size());
+                        CompactNodePileup* dp_node_pileup = get_create_node_pileup(dp_node);
+                        // we only use quality of one endpoint here.  should average
+                        dp_node_pileup->add_indel(dp_node_offset, del_seq, map_reverse,
+                                                  alignment.quality().empty() ? -1 :
+                                                  combined_quality(alignment.quality()[read_offset],
+                                                                   alignment.mapping_quality()),
+                                                  _max_depth);
                     }
                     open_del = make_pair((Mapping*)NULL, -1);
                     last_del = make_pair((Mapping*)NULL, -1);
@@ -353,7 +632,12 @@ void Pileups::compute_from_edit(NodePileup& pileup, int64_t& node_offset,
     // ***** INSERT *****
     else if (edit.from_length() < edit.to_length()) {
         if (pass_filter(alignment, read_offset, edit.to_length(), mismatch_counts)) {
-            make_insert(seq, map_reverse);
+            // store the insertion on the forward strand
+            casify(seq, false);
+            if (map_reverse) {
+                seq = reverse_complement(seq);
+            }
+            make_insert(seq, false);
             assert(edit.from_length() == 0);
             // we define insert (like sam) as insertion between current and next
             // position (on forward node coordinates). this means an insertion before
@@ -364,23 +648,13 @@ void Pileups::compute_from_edit(NodePileup& pileup, int64_t& node_offset,
                 next_edit != NULL && last_match.first != NULL &&
                 next_edit->from_length() == next_edit->to_length()) { 
                 // Don't go outside the node
-                assert(insert_offset < _graph->get_node(pileup.node_id())->sequence().size());       
-                BasePileup* base_pileup = get_create_base_pileup(pileup, insert_offset);
-                if (base_pileup->num_bases() < _max_depth) {
-                    // reference_base if empty
-                    if (base_pileup->num_bases() == 0) {
-                        base_pileup->set_ref_base(node.sequence()[insert_offset]);
-                    } else {
-                        assert(base_pileup->ref_base() == node.sequence()[insert_offset]);
-                    }
-                    // add insertion string to bases field
-                    base_pileup->mutable_bases()->append(seq);
-                    if (!alignment.quality().empty()) {
-                        *base_pileup->mutable_qualities() += combined_quality(alignment.quality()[read_offset],
-                                                                              alignment.mapping_quality());
-                    }
-                    // pileup size increases by 1
-                    base_pileup->set_num_bases(base_pileup->num_bases() + 1);
+                assert(insert_offset < node.sequence().size());
+                if (pileup != NULL) {
+                    pileup->add_indel(insert_offset, seq, map_reverse,
+                                      alignment.quality().empty() ? -1 :
+                                      combined_quality(alignment.quality()[read_offset],
+                                                       alignment.mapping_quality()),
+                                      _max_depth);
                 }
             }
             else {
@@ -560,6 +834,7 @@ Pileups& Pileups::merge(Pileups& other) {
         insert_node_pileup(p.second);
     }
     other._node_pileups.clear();
+    other._node_pileup_bases = 0;
     for (auto& p : other._edge_pileups) {
         insert_edge_pileup(p.second);
     }
@@ -573,43 +848,12 @@ Pileups& Pileups::merge(Pileups& other) {
     return *this;
 }
 
-BasePileup& Pileups::merge_base_pileups(BasePileup& p1, BasePileup& p2) {
-    assert(p1.num_bases() == 0 || p2.num_bases() == 0 ||
-           p1.ref_base() == p2.ref_base());
-    if (p1.num_bases() == 0) {
-        p1.set_ref_base(p2.ref_base());
-    }
-    int merge_size = min(p2.num_bases(), _max_depth - p1.num_bases());
-    p1.set_num_bases(p1.num_bases() + merge_size);
-    if (merge_size == p2.num_bases()) {    
-        p1.mutable_bases()->append(p2.bases());
-        p1.mutable_qualities()->append(p2.qualities());
-    } else if (merge_size > 0) {
-        vector<pair<int64_t, int64_t> > offsets;
-        parse_base_offsets(p2, offsets);
-        int merge_length = offsets[merge_size].first;
-        p1.mutable_bases()->append(p2.bases().substr(0, merge_length));
-        if (!p2.qualities().empty()) {
-            p1.mutable_qualities()->append(p2.qualities().substr(0, merge_size));
-        }
-    }
-    p2.set_num_bases(0);
-    p2.clear_bases();
-    p2.clear_qualities();
-    return p1;
-}
-
-NodePileup& Pileups::merge_node_pileups(NodePileup& p1, NodePileup& p2) {
+CompactNodePileup& Pileups::merge_node_pileups(CompactNodePileup& p1, CompactNodePileup& p2) {
     assert(p1.node_id() == p2.node_id());
     // Don't go outside the node
-    assert(p1.base_pileup_size() <= _graph->get_node(p1.node_id())->sequence().size());
-    assert(p2.base_pileup_size() <= _graph->get_node(p2.node_id())->sequence().size());
-    for (int i = 0; i < p2.base_pileup_size(); ++i) {
-        BasePileup* bp1 = get_create_base_pileup(p1, i);
-        BasePileup* bp2 = get_base_pileup(p2, i);
-        merge_base_pileups(*bp1, *bp2);
-    }
-    p2.clear_base_pileup();
+    assert(!_graph->has_node(p1.node_id()) || p1.size() <= _graph->get_node(p1.node_id())->sequence().size());
+    assert(!_graph->has_node(p2.node_id()) || p2.size() <= _graph->get_node(p2.node_id())->sequence().size());
+    p1.merge(p2, _max_depth);
     return p1;
 }
 
@@ -824,4 +1068,245 @@ string Pileups::extract(const BasePileup& bp, int64_t offset) {
     }
 }
 
+ShardedPileups::ShardedPileups(VG* graph, size_t shard_count, size_t max_shard_bases,
+                               int min_quality, int max_mismatches, int window_size,
+                               int max_depth, bool use_mapq) :
+    _graph(graph),
+    _spill_files(max(shard_count, (size_t)1)),
+    _max_shard_bases(max_shard_bases) {
+
+    shard_count = max(shard_count, (size_t)1);
+    int64_t min_id = graph->min_node_id();
+    int64_t max_id = graph->max_node_id();
+    // split the ID range evenly, which is close enough to even by sequence
+    // for constructed graphs
+    for (size_t i = 1; i < shard_count; ++i) {
+        _shard_starts.push_back(min_id + (int64_t)((max_id - min_id + 1) * i / shard_count));
+    }
+    for (size_t i = 0; i < shard_count; ++i) {
+        Pileups* shard = new Pileups(graph, min_quality, max_mismatches, window_size, max_depth, use_mapq);
+        shard->set_node_range(i == 0 ? numeric_limits<int64_t>::min() : _shard_starts[i - 1],
+                              i + 1 == shard_count ? numeric_limits<int64_t>::max() : _shard_starts[i] - 1);
+        _shards.push_back(shard);
+    }
+}
+
+ShardedPileups::~ShardedPileups() {
+    for (Pileups* shard : _shards) {
+        delete shard;
+    }
+    for (auto& files : _spill_files) {
+        for (auto& file : files) {
+            std::remove(file.c_str());
+        }
+    }
+}
+
+size_t ShardedPileups::shard_of(int64_t node_id) const {
+    return upper_bound(_shard_starts.begin(), _shard_starts.end(), node_id) - _shard_starts.begin();
+}
+
+void ShardedPileups::compute_from_stream(istream& alignment_stream) {
+
+    // Alignments are read in batches.  Each batch is routed to the shards,
+    // and each shard works through its part of the batch as a task while the
+    // next batch is read.
+    size_t batch_size = 1024 * _shards.size();
+    vector<Alignment> batches[2];
+    vector<vector<size_t> > routes[2];
+    routes[0].resize(_shards.size());
+    routes[1].resize(_shards.size());
+
+    stream::ProtobufIterator<Alignment> iter(alignment_stream);
+    auto read_batch = [&](vector<Alignment>& batch, vector<vector<size_t> >& route) {
+        batch.clear();
+        for (auto& shard_route : route) {
+            shard_route.clear();
+        }
+        vector<size_t> touched;
+        while (iter.has_next() && batch.size() < batch_size) {
+            batch.emplace_back(iter.take());
+            iter.get_next();
+            // send the alignment to every shard it visits
+            touched.clear();
+            for (auto& mapping : batch.back().path().mapping()) {
+                touched.push_back(shard_of(mapping.position().node_id()));
+            }
+            sort(touched.begin(), touched.end());
+            touched.erase(unique(touched.begin(), touched.end()), touched.end());
+            for (size_t shard : touched) {
+                route[shard].push_back(batch.size() - 1);
+            }
+        }
+    };
+
+    #pragma omp parallel shared(batches, routes, read_batch)
+    #pragma omp single
+    {
+        int cur = 0;
+        read_batch(batches[cur], routes[cur]);
+        while (!batches[cur].empty()) {
+            for (size_t i = 0; i < _shards.size(); ++i) {
+                if (routes[cur][i].empty()) {
+                    continue;
+                }
+                #pragma omp task firstprivate(i, cur) shared(batches, routes)
+                {
+                    for (size_t j : routes[cur][i]) {
+                        _shards[i]->compute_from_alignment(batches[cur][j]);
+                    }
+                    if (_max_shard_bases != 0 && _shards[i]->_node_pileup_bases > _max_shard_bases) {
+                        spill(i);
+                    }
+                }
+            }
+            read_batch(batches[1 - cur], routes[1 - cur]);
+            #pragma omp taskwait
+            cur = 1 - cur;
+        }
+    }
+}
+
+void ShardedPileups::spill(size_t shard) {
+    string spill_file = tmpfilename(find_temp_dir() + "/vg-pileup-shard");
+    ofstream out(spill_file);
+    if (!out) {
+        throw runtime_error("[vg::ShardedPileups] could not open temporary file " + spill_file);
+    }
+    Pileups* pileups = _shards[shard];
+    write_raw(out, (uint64_t)pileups->_node_pileups.size());
+    for (auto& p : pileups->_node_pileups) {
+        p.second->serialize(out);
+    }
+    write_raw(out, (uint64_t)pileups->_edge_pileups.size());
+    string edge_data;
+    for (auto& p : pileups->_edge_pileups) {
+        p.second->SerializeToString(&edge_data);
+        write_raw(out, (uint32_t)edge_data.size());
+        out.write(edge_data.data(), edge_data.size());
+    }
+    out.close();
+    if (!out) {
+        throw runtime_error("[vg::ShardedPileups] could not write temporary file " + spill_file);
+    }
+    _spill_files[shard].push_back(spill_file);
+
+    // keep the filter counts, which are reported over all alignments
+    uint64_t min_quality_count = pileups->_min_quality_count;
+    uint64_t max_mismatch_count = pileups->_max_mismatch_count;
+    uint64_t bases_count = pileups->_bases_count;
+    pileups->clear();
+    pileups->_min_quality_count = min_quality_count;
+    pileups->_max_mismatch_count = max_mismatch_count;
+    pileups->_bases_count = bases_count;
+}
+
+void ShardedPileups::load_spill(Pileups& shard, const string& spill_file) {
+    ifstream in(spill_file);
+    uint64_t node_count = 0;
+    read_raw(in, node_count);
+    for (uint64_t i = 0; i < node_count && in; ++i) {
+        shard.insert_node_pileup(new CompactNodePileup(in));
+    }
+    uint64_t edge_count = 0;
+    read_raw(in, edge_count);
+    string edge_data;
+    for (uint64_t i = 0; i < edge_count && in; ++i) {
+        uint32_t edge_size = 0;
+        read_raw(in, edge_size);
+        edge_data.resize(edge_size);
+        in.read(&edge_data[0], edge_size);
+        EdgePileup* edge_pileup = new EdgePileup();
+        if (in && !edge_pileup->ParseFromString(edge_data)) {
+            in.setstate(ios::failbit);
+        }
+        if (!in) {
+            delete edge_pileup;
+            break;
+        }
+        shard.insert_edge_pileup(edge_pileup);
+    }
+    if (!in) {
+        throw runtime_error("[vg::ShardedPileups] could not read temporary file " + spill_file);
+    }
+}
+
+void ShardedPileups::consume(const function<void(Pileups&)>& lambda, ostream* pileup_out,
+                             uint64_t chunk_size) {
+
+    // pileups waiting to be written.  nodes and edges are paired up into
+    // chunks in order, as in Pileups::write()
+    deque<NodePileup> node_queue;
+    deque<EdgePileup> edge_queue;
+    auto write_chunks = [&](bool flush) {
+        vector<Pileup> buffer;
+        while ((node_queue.size() >= chunk_size && edge_queue.size() >= chunk_size) ||
+               (flush && (!node_queue.empty() || !edge_queue.empty()))) {
+            buffer.emplace_back();
+            for (uint64_t i = 0; i < chunk_size && !node_queue.empty(); ++i) {
+                buffer.back().add_node_pileups()->Swap(&node_queue.front());
+                node_queue.pop_front();
+            }
+            for (uint64_t i = 0; i < chunk_size && !edge_queue.empty(); ++i) {
+                buffer.back().add_edge_pileups()->Swap(&edge_queue.front());
+                edge_queue.pop_front();
+            }
+        }
+        if (!buffer.empty()) {
+            stream::write_buffered(*pileup_out, buffer, 0);
+        }
+    };
+
+    for (size_t i = 0; i < _shards.size(); ++i) {
+        Pileups* shard = _shards[i];
+        if (shard == nullptr) {
+            throw runtime_error("[vg::ShardedPileups] pileups can only be consumed once");
+        }
+
+        // put back anything we spilled.  the rest of the shard goes out
+        // too, so that everything is merged back in the order it was
+        // computed, and edge qualities come out in the same order as if
+        // nothing had been spilled.
+        if (!_spill_files[i].empty()) {
+            spill(i);
+            for (auto& spill_file : _spill_files[i]) {
+                load_spill(*shard, spill_file);
+                std::remove(spill_file.c_str());
+            }
+            _spill_files[i].clear();
+        }
+
+        if (pileup_out != nullptr) {
+            vector<int64_t> node_ids;
+            for (auto& p : shard->_node_pileups) {
+                node_ids.push_back(p.first);
+            }
+            sort(node_ids.begin(), node_ids.end());
+            for (int64_t node_id : node_ids) {
+                node_queue.emplace_back();
+                shard->_node_pileups[node_id]->to_protobuf(node_queue.back());
+            }
+
+            vector<pair<NodeSide, NodeSide> > edge_sides;
+            for (auto& p : shard->_edge_pileups) {
+                edge_sides.push_back(p.first);
+            }
+            sort(edge_sides.begin(), edge_sides.end());
+            for (auto& sides : edge_sides) {
+                edge_queue.push_back(*shard->_edge_pileups[sides]);
+            }
+            write_chunks(false);
+        }
+
+        lambda(*shard);
+
+        delete shard;
+        _shards[i] = nullptr;
+    }
+
+    if (pileup_out != nullptr) {
+        write_chunks(true);
+    }
+}
+
 }
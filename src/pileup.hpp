@@ -4,6 +4,8 @@
 #include <iostream>
 #include <algorithm>
 #include <functional>
+#include <limits>
+#include <cstdint>
 #include "vg.pb.h"
 #include "vg.hpp"
 #include "hash_map.hpp"
@@ -13,10 +15,110 @@ namespace vg {
 
 using namespace std;
 
-/// This is a collection of protobuf NodePileup records that are indexed
-/// on their position, as well as EdgePileup records.
+/// The pileup of reads over a single node, stored as counts rather than as
+/// the token strings of the NodePileup protobuf.  Each base of the node gets a
+/// fixed-size column of per-strand counts and quality sums for each read base
+/// (on the forward strand), and the rarer insertions and deletions go in a
+/// side table sorted by offset.  Converts to and from NodePileup for I/O.
+///
+/// Counts are capped at 16 bits, so depths over 65535 aren't supported.
+class CompactNodePileup {
+public:
+
+    /// Read bases we count in each column, in order, on the forward strand.
+    /// Anything else is counted as N.
+    static const char ALLELES[];
+    static const int ALLELE_COUNT = 5;
+
+    /// Everything that piled up on one base of the node
+    struct Column {
+        /// reference base
+        char ref_base = 0;
+        /// number of reads counted here, including indels
+        uint16_t depth = 0;
+        /// number of reads with each base, on the forward and reverse strands
+        uint16_t counts[ALLELE_COUNT][2] = {};
+        /// number of those reads with base qualities
+        uint16_t qual_counts[ALLELE_COUNT] = {};
+        /// sum of their base qualities
+        uint32_t qual_sums[ALLELE_COUNT] = {};
+    };
+
+    /// Reads with the same insertion after, or deletion from, a base
+    struct Indel {
+        uint32_t offset = 0;
+        /// insertion or deletion token, as in the protobuf pileup format, on
+        /// the forward strand (upper case bases, 0 for the deletion strand)
+        string token;
+        uint16_t counts[2] = {};
+        uint16_t qual_count = 0;
+        uint32_t qual_sum = 0;
+    };
+
+    /// make an empty pileup over a node
+    CompactNodePileup(int64_t node_id, const string& ref_sequence);
+
+    /// convert from protobuf
+    CompactNodePileup(const NodePileup& pileup);
+
+    /// read back a pileup written by serialize()
+    CompactNodePileup(istream& in);
+
+    int64_t node_id() const {
+        return _node_id;
+    }
+
+    /// number of bases in the node
+    size_t size() const {
+        return _columns.size();
+    }
+
+    const Column& column(size_t offset) const {
+        return _columns.at(offset);
+    }
+
+    /// get the range of indels recorded at an offset
+    pair<vector<Indel>::const_iterator, vector<Indel>::const_iterator> indels_at(size_t offset) const;
+
+    /// count a read base (on the forward strand) at an offset, with quality
+    /// -1 if the read has none.  returns false if the column is already at
+    /// max_depth.
+    bool add_base(size_t offset, char base, bool is_reverse, int quality, int max_depth);
+
+    /// count a forward strand insertion or deletion token at an offset
+    bool add_indel(size_t offset, const string& token, bool is_reverse, int quality, int max_depth);
+
+    /// move all counts from other into this, keeping each column within
+    /// max_depth.  other is left empty.
+    void merge(CompactNodePileup& other, int max_depth);
+
+    /// convert to protobuf.  tokens come out grouped: reference matches, then
+    /// snps, then indels.  since only quality sums are stored, each token gets
+    /// the mean quality of its base.
+    void to_protobuf(NodePileup& pileup) const;
+
+    /// write in a binary form that keeps every count and quality sum, for
+    /// reading back on the same machine.  unlike the protobuf form, this
+    /// round trip is exact.
+    void serialize(ostream& out) const;
+
+    /// index of a base in ALLELES
+    static int allele_index(char base);
+
+private:
+
+    int64_t _node_id;
+    vector<Column> _columns;
+    /// sorted by offset then token
+    vector<Indel> _indels;
+
+    Indel& get_create_indel(size_t offset, const string& token);
+};
+
+/// This is a collection of compact node pileups that are indexed
+/// on their position, as well as protobuf EdgePileup records.
 /// Pileups can be merged and streamed, and computed
-/// from Alignments.  The pileup records themselves are essentially
+/// from Alignments.  On disk, the pileup records are
 /// protobuf versions of lines in Samtools pileup format, with deletions
 /// represented using a graph-based notation. 
 class Pileups {
@@ -28,19 +130,23 @@ public:
         _min_quality(min_quality),
         _max_mismatches(max_mismatches),
         _window_size(window_size),
-        _max_depth(max_depth),
+        _max_depth(min(max_depth, (int)numeric_limits<uint16_t>::max())),
         _min_quality_count(0),
         _max_mismatch_count(0),
         _bases_count(0),
-        _use_mapq(use_mapq)
+        _use_mapq(use_mapq),
+        _min_node_id(numeric_limits<int64_t>::min()),
+        _max_node_id(numeric_limits<int64_t>::max()),
+        _node_pileup_bases(0)
 {}
     
     /// copy constructor
     Pileups(const Pileups& other) {
         if (this != &other) {
             _graph = other._graph;
+            _node_pileup_bases = 0;
             for (auto& p : other._node_pileups) {
-                insert_node_pileup(new NodePileup(*p.second));
+                insert_node_pileup(new CompactNodePileup(*p.second));
             }
             _min_quality = other._min_quality;
             _max_mismatches = other._max_mismatches;
@@ -50,6 +156,8 @@ public:
             _max_mismatch_count = other._max_mismatch_count;
             _bases_count = other._bases_count;
             _use_mapq = other._use_mapq;
+            _min_node_id = other._min_node_id;
+            _max_node_id = other._max_node_id;
         }
     }
 
@@ -66,6 +174,10 @@ public:
         _max_mismatch_count = other._max_mismatch_count;
         _bases_count = other._bases_count;
         _use_mapq = other._use_mapq;
+        _min_node_id = other._min_node_id;
+        _max_node_id = other._max_node_id;
+        _node_pileup_bases = other._node_pileup_bases;
+        other._node_pileup_bases = 0;
     }
 
     /// copy assignment operator
@@ -88,6 +200,10 @@ public:
         _max_mismatch_count = other._max_mismatch_count;
         _bases_count = other._bases_count;
         _use_mapq = other._use_mapq;
+        _min_node_id = other._min_node_id;
+        _max_node_id = other._max_node_id;
+        swap(_node_pileup_bases, other._node_pileup_bases);
+        other._node_pileup_bases = 0;
         return *this;
     }
 
@@ -97,7 +213,7 @@ public:
     }
     void clear();
 
-    typedef hash_map<int64_t, NodePileup*> NodePileupHash;
+    typedef hash_map<int64_t, CompactNodePileup*> NodePileupHash;
     typedef pair_hash_map<pair<NodeSide, NodeSide>, EdgePileup*> EdgePileupHash;
 
     VG* _graph;
@@ -112,7 +228,7 @@ public:
     int _max_mismatches;
     /// number of bases to scan in each direction for mismatches
     int _window_size;
-    /// prevent giant protobufs
+    /// prevent giant pileups (at most 65535)
     int _max_depth;
     /// toggle whether we incorporate Alignment.mapping_quality
     bool _use_mapq;
@@ -122,6 +238,24 @@ public:
     mutable uint64_t _max_mismatch_count;
     /// overall count for perspective on above
     mutable uint64_t _bases_count;
+    /// only record pileups on nodes in this range of IDs (inclusive)
+    int64_t _min_node_id;
+    int64_t _max_node_id;
+    /// total length of the nodes with pileups in the table
+    size_t _node_pileup_bases;
+
+    /// only record pileups on nodes with IDs in the given range (inclusive),
+    /// and on edges whose lower side is on one of those nodes.  alignments
+    /// are still followed across other nodes, to find indels and edges.
+    void set_node_range(int64_t min_id, int64_t max_id) {
+        _min_node_id = min_id;
+        _max_node_id = max_id;
+    }
+
+    /// is the node in the range we record pileups for?
+    bool owns_node(int64_t node_id) const {
+        return node_id >= _min_node_id && node_id <= _max_node_id;
+    }
 
     /// write to JSON
     void to_json(ostream& out);
@@ -131,26 +265,21 @@ public:
     void write(ostream& out, uint64_t buffer_size = 5);
 
     /// apply function to each pileup in table
-    void for_each_node_pileup(const function<void(NodePileup&)>& lambda);
+    void for_each_node_pileup(const function<void(CompactNodePileup&)>& lambda);
 
     /// search hash table for node id
-    NodePileup* get_node_pileup(int64_t node_id) {
+    CompactNodePileup* get_node_pileup(int64_t node_id) {
         auto p = _node_pileups.find(node_id);
         return p != _node_pileups.end() ? p->second : NULL;
     }
         
     /// get a pileup.  if it's null, create a new one and insert it.
-    NodePileup* get_create_node_pileup(const Node* node) {
-      NodePileup* p = get_node_pileup(node->id());
+    CompactNodePileup* get_create_node_pileup(const Node* node) {
+        CompactNodePileup* p = get_node_pileup(node->id());
         if (p == NULL) {
-            p = new NodePileup();
-            p->set_node_id(node->id());
-            for (int i = 0; i < node->sequence().length(); ++i) {
-                BasePileup* b = p->add_base_pileup();
-                b->set_num_bases(0);
-                b->set_ref_base((int)node->sequence()[i]);
-            }
+            p = new CompactNodePileup(node->id(), node->sequence());
             _node_pileups[node->id()] = p;
+            _node_pileup_bases += p->size();
         }
         return p;
     }
@@ -167,7 +296,7 @@ public:
 
     /// insert a pileup into the table. it will be deleted by ~Pileups()!!!
     /// return true if new pileup inserted, false if merged into existing one
-    bool insert_node_pileup(NodePileup* pileup);
+    bool insert_node_pileup(CompactNodePileup* pileup);
     bool insert_edge_pileup(EdgePileup* edge_pileup);
     
     /// create / update all pileups from a single alignment
@@ -175,7 +304,8 @@ public:
 
     /// create / update all pileups from an edit (called by above).
     /// query stores the current position (and nothing else).  
-    void compute_from_edit(NodePileup& pileup, int64_t& node_offset, int64_t& read_offset,
+    /// pileup is null if the node isn't in our range.
+    void compute_from_edit(CompactNodePileup* pileup, int64_t& node_offset, int64_t& read_offset,
                            const Node& node, const Alignment& alignment,
                            const Mapping& mapping, const Edit& edit,
                            const Edit* next_edit,
@@ -200,11 +330,8 @@ public:
     /// other will be left empty. this is returned
     Pileups& merge(Pileups& other);
 
-    /// merge p2 into p1 and return 1. p2 is left an empty husk
-    BasePileup& merge_base_pileups(BasePileup& p1, BasePileup& p2);
-
     /// merge p2 into p1 and return 1. p2 is lef an empty husk
-    NodePileup& merge_node_pileups(NodePileup& p1, NodePileup& p2);
+    CompactNodePileup& merge_node_pileups(CompactNodePileup& p1, CompactNodePileup& p2);
     
     /// merge p2 into p1 and return 1. p2 is lef an empty husk
     EdgePileup& merge_edge_pileups(EdgePileup& p1, EdgePileup& p2);
@@ -224,24 +351,6 @@ public:
         }
     }        
 
-    /// get ith BasePileup record
-    static BasePileup* get_base_pileup(NodePileup& np, int64_t offset) {
-        assert(offset < np.base_pileup_size() && offset >= 0);
-        return np.mutable_base_pileup(offset);
-    }
-    static const BasePileup* get_base_pileup(const NodePileup& np, int64_t offset) {
-        assert(offset < np.base_pileup_size() && offset >= 0);
-        return &np.base_pileup(offset);
-    }
-
-    /// get ith BasePileup record, create if doesn't exist
-    static BasePileup* get_create_base_pileup(NodePileup& np, int64_t offset) {
-        for (int64_t i = np.base_pileup_size(); i <= offset; ++i) {
-            np.add_base_pileup();
-        }
-        return get_base_pileup(np, offset);
-    }
-
     /// the bases string in BasePileup doesn't allow random access.  This function
     /// will parse out all the offsets of snps, insertions, and deletions
     /// into one array, each offset is a pair of indexes in the bases and qualities arrays
@@ -276,6 +385,60 @@ public:
 };
 
 
+/// Pileups over a whole graph, split into shards by node ID range so that
+/// threads can build them from one stream of alignments without sharing or
+/// merging anything.  Each alignment goes to every shard owning a node it
+/// visits, and each shard only records pileups on its own nodes.  Shards
+/// that outgrow their share of memory are spilled to temporary files, and
+/// are only put back together one at a time, as the pileups are consumed.
+class ShardedPileups {
+public:
+
+    /// Split the graph's node ID range into shard_count shards, each of
+    /// which is spilled once its node pileups cover more than max_shard_bases
+    /// bases (0 for never).  Other parameters are as for Pileups.
+    ShardedPileups(VG* graph, size_t shard_count, size_t max_shard_bases = 0,
+                   int min_quality = 0, int max_mismatches = 1, int window_size = 0,
+                   int max_depth = 1000, bool use_mapq = false);
+
+    /// delete the shards and any spill files left
+    ~ShardedPileups();
+
+    /// add pileups from every alignment in a stream, using all the threads
+    void compute_from_stream(istream& alignment_stream);
+
+    /// call lambda on the complete pileups of each shard in node ID order,
+    /// deleting each shard afterward, so this can only be done once.  if
+    /// pileup_out is not null, the pileups are also written to it, sorted
+    /// by node and edge, in chunks of chunk_size.
+    void consume(const function<void(Pileups&)>& lambda, ostream* pileup_out = nullptr,
+                 uint64_t chunk_size = 5);
+
+    size_t shard_count() const {
+        return _shards.size();
+    }
+
+private:
+
+    VG* _graph;
+    /// first node ID of each shard after the first
+    vector<int64_t> _shard_starts;
+    vector<Pileups*> _shards;
+    /// temporary files holding the pileups spilled from each shard
+    vector<vector<string> > _spill_files;
+    size_t _max_shard_bases;
+
+    /// which shard owns a node?
+    size_t shard_of(int64_t node_id) const;
+
+    /// write a shard's pileups to a temporary file and clear it.  node
+    /// pileups are written with CompactNodePileup::serialize() so that
+    /// spilling doesn't change them.
+    void spill(size_t shard);
+
+    /// merge the pileups from a file written by spill() into a shard
+    void load_spill(Pileups& shard, const string& spill_file);
+};
 
 }
 
@@ -52,11 +52,11 @@ void PileupAugmenter::write_augmented_graph(ostream& out, bool json) {
     }
 }
 
-void PileupAugmenter::call_node_pileup(const NodePileup& pileup) {
+void PileupAugmenter::call_node_pileup(const CompactNodePileup& pileup) {
 
     _node = _graph->get_node(pileup.node_id());
     assert(_node != NULL);
-    assert(_node->sequence().length() == pileup.base_pileup_size());
+    assert(_node->sequence().length() == pileup.size());
     
     _node_calls.clear();
     _insert_calls.clear();
@@ -72,14 +72,15 @@ void PileupAugmenter::call_node_pileup(const NodePileup& pileup) {
 
     // process each base in pileup individually
     #pragma omp parallel for
-    for (int i = 0; i < pileup.base_pileup_size(); ++i) {
+    for (int i = 0; i < pileup.size(); ++i) {
         int num_inserts = 0;
-        for (auto b : pileup.base_pileup(i).bases()) {
-            if (b == '+') {
-                ++num_inserts;
+        auto indels = pileup.indels_at(i);
+        for (auto it = indels.first; it != indels.second; ++it) {
+            if (it->token[0] == '+') {
+                num_inserts += it->counts[0] + it->counts[1];
             }
         }
-        int pileup_depth = max(num_inserts, pileup.base_pileup(i).num_bases() - num_inserts);
+        int pileup_depth = max(num_inserts, pileup.column(i).depth - num_inserts);
         if (pileup_depth >= 1) {
             call_base_pileup(pileup, i, false);
             call_base_pileup(pileup, i, true);
@@ -452,12 +453,7 @@ void PileupAugmenter::create_augmented_edge(Node* node1, int from_offset, bool l
     }
 }
 
-void PileupAugmenter::call_base_pileup(const NodePileup& np, int64_t offset, bool insertion) {
-    const BasePileup& bp = np.base_pileup(offset);
-
-    // parse the pilueup structure
-    vector<pair<int64_t, int64_t> > base_offsets;
-    Pileups::parse_base_offsets(bp, base_offsets);
+void PileupAugmenter::call_base_pileup(const CompactNodePileup& np, int64_t offset, bool insertion) {
 
     // compute top two most frequent bases and their counts
     string top_base;
@@ -467,12 +463,12 @@ void PileupAugmenter::call_base_pileup(const NodePileup& np, int64_t offset, boo
     int second_count;
     int second_rev_count;
     int total_count;
-    compute_top_frequencies(bp, base_offsets, top_base, top_count, top_rev_count,
+    compute_top_frequencies(np, offset, top_base, top_count, top_rev_count,
                             second_base, second_count, second_rev_count, total_count,
                             insertion);
 
     // note first and second base will be upper case too
-    string ref_base = string(1, ::toupper(bp.ref_base()));
+    string ref_base = string(1, ::toupper(np.column(offset).ref_base));
 
     // get references to node-level members we want to update
     Genotype& base_call = insertion ? _insert_calls[offset] : _node_calls[offset];
@@ -482,18 +478,17 @@ void PileupAugmenter::call_base_pileup(const NodePileup& np, int64_t offset, boo
         base_call.first = top_base != ref_base ? top_base : ".";
         support.first.fs = top_count - top_rev_count;
         support.first.rs = top_rev_count;
-        support.first.qual = total_base_quality(bp, base_offsets, top_base);
+        support.first.qual = total_base_quality(np, offset, top_base);
     }
     if (second_count >= _min_aug_support || (second_base == ref_base && second_count > 0)) { 
         base_call.second = second_base != ref_base ? second_base : ".";
         support.second.fs = second_count - second_rev_count;
         support.second.rs = second_rev_count;
-        support.second.qual = total_base_quality(bp, base_offsets, second_base);
+        support.second.qual = total_base_quality(np, offset, second_base);
     }
 }
 
-void PileupAugmenter::compute_top_frequencies(const BasePileup& bp,
-                                     const vector<pair<int64_t, int64_t> >& base_offsets,
+void PileupAugmenter::compute_top_frequencies(const CompactNodePileup& np, int64_t offset,
                                      string& top_base, int& top_count, int& top_rev_count,
                                      string& second_base, int& second_count, int& second_rev_count,
                                      int& total_count, bool inserts) {
@@ -504,51 +499,33 @@ void PileupAugmenter::compute_top_frequencies(const BasePileup& bp,
     unordered_map<string, int> rev_hist;
 
     total_count = 0;
-    const string& bases = bp.bases();
-    string ref_base = string(1, ::toupper(bp.ref_base()));
-    
-    // compute histogram from pileup
-    for (auto i : base_offsets) {
-        string val = Pileups::extract(bp, i.first);
+    const CompactNodePileup::Column& column = np.column(offset);
+    string ref_base = string(1, ::toupper(column.ref_base));
 
-        if ((inserts && val[0] != '+') || (!inserts && val[0] == '+')) {
-            // toggle inserts
-            continue;
-        }
-        
+    // add an entry (always upper case / forward strand) to the histogram
+    auto add_to_hist = [&](const string& val, int count, int rev_count) {
         // We want to know if this pileup supports an N
-        if (is_all_n(val)) {
+        if (count == 0 || is_all_n(val)) {
             // N is not a real base, so we should never augment with it.
-            continue;
-        }
-        
-        ++total_count;
-        
-        // val will always be uppcase / forward strand.  we check
-        // the original pileup to see if reversed
-        bool reverse = bases[i.first] == ',' ||
-            (bases[i.first] == '+' && ::islower(bases[i.first + val.length() - 1])) ||
-            (bases[i.first] != '-' && ::islower(bases[i.first]));
-        if (bases[i.first] == '-') {
-            string tok = Pileups::extract(bp, i.first);
-            bool is_reverse, from_start, to_end;
-            int64_t from_id, from_offset, to_id, to_offset;
-            Pileups::parse_delete(tok, is_reverse, from_id, from_offset, from_start, to_id, to_offset, to_end);
-            reverse = is_reverse;
-            // reset reverse to forward
-            if (is_reverse) {
-                Pileups::make_delete(val, false, from_id, from_offset, from_start, to_id, to_offset, to_end);
-            }
+            return;
         }
+        total_count += count;
+        hist[val] += count;
+        rev_hist[val] += rev_count;
+    };
 
-        if (hist.find(val) == hist.end()) {
-            hist[val] = 0;
-            rev_hist[val] = 0;
+    // compute histogram from pileup
+    if (!inserts) {
+        for (int allele = 0; allele < CompactNodePileup::ALLELE_COUNT; ++allele) {
+            add_to_hist(string(1, CompactNodePileup::ALLELES[allele]),
+                        column.counts[allele][0] + column.counts[allele][1],
+                        column.counts[allele][1]);
         }
-        ++hist[val];
-
-        if (reverse) {
-            ++rev_hist[val];
+    }
+    auto indels = np.indels_at(offset);
+    for (auto it = indels.first; it != indels.second; ++it) {
+        if ((it->token[0] == '+') == inserts) {
+            add_to_hist(it->token, it->counts[0] + it->counts[1], it->counts[1]);
         }
     }
 
@@ -652,39 +629,30 @@ void PileupAugmenter::compute_top_frequencies(const BasePileup& bp,
     second_rev_count = rev_hist[second_base];
 }
 
-double PileupAugmenter::total_base_quality(const BasePileup& bp,
-                                  const vector<pair<int64_t, int64_t> >& base_offsets,
+double PileupAugmenter::total_base_quality(const CompactNodePileup& np, int64_t offset,
                                   const string& val) {
-    double qual_sum = 0;
-
-    const string& bases = bp.bases();
-    const string& quals = bp.qualities();
-
-    for (int i = 0; i < base_offsets.size(); ++i) {
-        string base = Pileups::extract(bp, base_offsets[i].first);
-
-        // make sure deletes always compared without is_reverse flag
-        if (base.length() > 1 && base[0] == '-') {
-            bool is_reverse, from_start, to_end;
-            int64_t from_id, from_offset, to_id, to_offset;
-            Pileups::parse_delete(base, is_reverse, from_id, from_offset, from_start, to_id, to_offset, to_end);
-            // reset reverse to forward
-            if (is_reverse) {
-                Pileups::make_delete(base, false, from_id, from_offset, from_start, to_id, to_offset, to_end);
-            }
-        }
+    // reads without qualities count as the default
+    if (val.length() == 1) {
+        const CompactNodePileup::Column& column = np.column(offset);
+        int allele = CompactNodePileup::allele_index(val[0]);
+        int count = column.counts[allele][0] + column.counts[allele][1];
+        return (double)column.qual_sums[allele] +
+            (double)(count - column.qual_counts[allele]) * _default_quality;
+    }
 
-        if (base == val) {
-            char qual = base_offsets[i].second >= 0 ? quals[base_offsets[i].second] : _default_quality;
-            qual_sum += (double)qual;
+    auto indels = np.indels_at(offset);
+    for (auto it = indels.first; it != indels.second; ++it) {
+        if (it->token == val) {
+            int count = it->counts[0] + it->counts[1];
+            return (double)it->qual_sum + (double)(count - it->qual_count) * _default_quality;
         }
     }
     
-    return qual_sum;
+    return 0;
 }
 
 // please refactor me! 
-void PileupAugmenter::create_node_calls(const NodePileup& np) {
+void PileupAugmenter::create_node_calls(const CompactNodePileup& np) {
     
     int n = _node->sequence().length();
     const string& seq = _node->sequence();
@@ -231,7 +231,7 @@ public:
     void write_augmented_graph(ostream& out, bool json);
 
     // call every position in the node pileup
-    void call_node_pileup(const NodePileup& pileup);
+    void call_node_pileup(const CompactNodePileup& pileup);
 
     // call an edge.  remembering it in a table for the whole graph
     void call_edge_pileup(const EdgePileup& pileup);
@@ -259,25 +259,23 @@ public:
     
     // call position at given base
     // if insertion flag set to true, call insertion between base and next base
-    void call_base_pileup(const NodePileup& np, int64_t offset, bool insertions);
+    void call_base_pileup(const CompactNodePileup& np, int64_t offset, bool insertions);
     
     // Find the top-two bases in a pileup, along with their counts
     // Last param toggles whether we consider only inserts or everything else
     // (do not compare all at once since inserts do not have reference coordinates)
-    void compute_top_frequencies(const BasePileup& bp,
-                                 const vector<pair<int64_t, int64_t> >& base_offsets,
+    void compute_top_frequencies(const CompactNodePileup& np, int64_t offset,
                                  string& top_base, int& top_count, int& top_rev_count,
                                  string& second_base, int& second_count, int& second_rev_count,
                                  int& total_count, bool inserts);
 
     // Sum up the qualities of a given symbol in a pileup
-    double total_base_quality(const BasePileup& pb,
-                              const vector<pair<int64_t, int64_t> >& base_offsets,
+    double total_base_quality(const CompactNodePileup& np, int64_t offset,
                               const string& val);
 
     // write graph structure corresponding to all the calls for the current
     // node.  
-    void create_node_calls(const NodePileup& np);
+    void create_node_calls(const CompactNodePileup& np);
 
     void create_augmented_edge(Node* node1, int from_offset, bool left_side1, bool aug1,
                                Node* node2, int to_offset, bool left_side2, bool aug2, char cat,
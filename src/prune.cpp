@@ -1,4 +1,9 @@
 #include "prune.hpp"
+#include "algorithms/topological_sort.hpp"
+
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace vg {
 
@@ -97,4 +102,128 @@ vector<edge_t> find_edges_to_prune(const HandleGraph& graph, size_t k, size_t ed
 }
 
 
+void prune_complex_with_head_tail(MutableHandleGraph& graph, size_t k, size_t edge_max) {
+
+    // Find the heads and tails before the markers exist
+    vector<handle_t> heads = algorithms::head_nodes(&graph);
+    vector<handle_t> tails = algorithms::tail_nodes(&graph);
+
+    id_t min_id = numeric_limits<id_t>::max();
+    id_t max_id = numeric_limits<id_t>::min();
+    graph.for_each_handle([&](const handle_t& handle) {
+        min_id = min(min_id, graph.get_id(handle));
+        max_id = max(max_id, graph.get_id(handle));
+    });
+    if (min_id > max_id) {
+        // Nothing to prune
+        return;
+    }
+
+    // Mark the components that have a head or a tail, and find a node to
+    // start from in each one that has neither
+    vector<bool> attached(max_id - min_id + 1, false);
+    auto attach_component = [&](const handle_t& start) {
+        vector<handle_t> to_visit {start};
+        attached[graph.get_id(start) - min_id] = true;
+        while (!to_visit.empty()) {
+            handle_t here = to_visit.back();
+            to_visit.pop_back();
+            for (bool go_left : {false, true}) {
+                graph.follow_edges(here, go_left, [&](const handle_t& next) {
+                    size_t index = graph.get_id(next) - min_id;
+                    if (!attached[index]) {
+                        attached[index] = true;
+                        to_visit.push_back(next);
+                    }
+                });
+            }
+        }
+    };
+    for (auto& handle : heads) {
+        if (!attached[graph.get_id(handle) - min_id]) {
+            attach_component(handle);
+        }
+    }
+    for (auto& handle : tails) {
+        if (!attached[graph.get_id(handle) - min_id]) {
+            attach_component(handle);
+        }
+    }
+    vector<handle_t> headless;
+    graph.for_each_handle([&](const handle_t& handle) {
+        if (!attached[graph.get_id(handle) - min_id]) {
+            attach_component(handle);
+            headless.push_back(handle);
+        }
+    });
+
+    // Tie everything to the markers
+    handle_t head_marker = graph.create_handle(string(k, '#'));
+    handle_t tail_marker = graph.create_handle(string(k, '$'));
+    for (auto& handle : heads) {
+        graph.create_edge(head_marker, handle);
+    }
+    for (auto& handle : tails) {
+        graph.create_edge(handle, tail_marker);
+    }
+    for (auto& handle : headless) {
+        // Enter the component here, and let whatever led here lead to the
+        // tail marker too
+        graph.create_edge(head_marker, handle);
+        vector<handle_t> previous;
+        graph.follow_edges(handle, true, [&](const handle_t& prev) {
+            previous.push_back(prev);
+        });
+        for (auto& prev : previous) {
+            graph.create_edge(prev, tail_marker);
+        }
+    }
+
+    for (auto& edge : find_edges_to_prune(graph, k, edge_max)) {
+        graph.destroy_edge(edge.first, edge.second);
+    }
+
+    graph.destroy_handle(head_marker);
+    graph.destroy_handle(tail_marker);
+}
+
+void prune_short_subgraphs(MutableHandleGraph& graph, size_t min_size) {
+
+    vector<handle_t> heads = algorithms::head_nodes(&graph);
+    unordered_set<id_t> destroyed;
+
+    for (auto& head : heads) {
+        if (destroyed.count(graph.get_id(head))) {
+            continue;   // Already pruned.
+        }
+
+        // Explore the neighborhood until the component is too large.
+        size_t subgraph_size = graph.get_length(head);
+        vector<handle_t> to_check {head};
+        unordered_map<id_t, handle_t> subgraph {{graph.get_id(head), head}};
+        while (subgraph_size < min_size && !to_check.empty()) {
+            handle_t curr = to_check.back();
+            to_check.pop_back();
+            for (bool go_left : {false, true}) {
+                graph.follow_edges(curr, go_left, [&](const handle_t& next) {
+                    id_t next_id = graph.get_id(next);
+                    if (!subgraph.count(next_id)) {
+                        subgraph_size += graph.get_length(next);
+                        subgraph.emplace(next_id, graph.forward(next));
+                        to_check.push_back(next);
+                    }
+                });
+            }
+        }
+
+        // Destroy the component if it was small enough.
+        if (subgraph_size < min_size) {
+            for (auto& node : subgraph) {
+                graph.destroy_handle(node.second);
+                destroyed.insert(node.first);
+            }
+        }
+    }
+}
+
 }
@@ -34,6 +34,17 @@ struct walk_t {
 /// Iterate over all the walks up to length k, adding edges which 
 vector<edge_t> find_edges_to_prune(const HandleGraph& graph, size_t k, size_t edge_max);
 
+/// Remove the edges on walks of up to k bases that make more than edge_max
+/// edge choices. Heads, tails, and components without heads or tails are tied
+/// to temporary marker nodes of k bases first, so that walks running off the
+/// ends of the graph count the same way they do in
+/// VG::prune_complex_with_head_tail().
+void prune_complex_with_head_tail(MutableHandleGraph& graph, size_t k, size_t edge_max);
+
+/// Remove the components reachable from head nodes that have fewer than
+/// min_size bases, like VG::prune_short_subgraphs().
+void prune_short_subgraphs(MutableHandleGraph& graph, size_t min_size);
+
 }
 
 #endif
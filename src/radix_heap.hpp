@@ -0,0 +1,119 @@
+#ifndef VG_RADIX_HEAP_HPP_INCLUDED
+#define VG_RADIX_HEAP_HPP_INCLUDED
+
+/**
+ * \file radix_heap.hpp
+ *
+ * A monotone priority queue for small integer keys, for Dijkstra-style
+ * searches over sequence lengths.
+ */
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <limits>
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * A min-priority queue on unsigned integer keys, which requires that nothing
+ * is pushed with a key smaller than the last key popped. Items live in 65
+ * buckets by the highest bit in which their key differs from the last key
+ * popped, so each item moves at most 64 times over its life, and pushes are
+ * constant time. Items with equal keys come out in no particular order.
+ *
+ * Clearing keeps the buckets' memory, so one heap can be reused for many
+ * searches.
+ */
+template<typename T>
+class RadixHeap {
+public:
+
+    /// Add an item. The key must be at least the last key popped, unless
+    /// the heap has been emptied since then.
+    inline void push(uint64_t key, const T& value) {
+        buckets[bucket_of(key)].emplace_back(key, value);
+        count++;
+    }
+
+    /// Get the item with the smallest key, and its key. The heap must not be
+    /// empty.
+    inline const pair<uint64_t, T>& top() {
+        if (buckets[0].empty()) {
+            refill();
+        }
+        return buckets[0].back();
+    }
+
+    /// Remove the item with the smallest key. The heap must not be empty.
+    inline void pop() {
+        if (buckets[0].empty()) {
+            refill();
+        }
+        buckets[0].pop_back();
+        count--;
+        if (count == 0) {
+            // Anything can come next
+            last = 0;
+        }
+    }
+
+    /// Return true if there are no items
+    inline bool empty() const {
+        return count == 0;
+    }
+
+    /// Return the number of items
+    inline size_t size() const {
+        return count;
+    }
+
+    /// Remove all the items
+    void clear() {
+        for (auto& bucket : buckets) {
+            bucket.clear();
+        }
+        count = 0;
+        last = 0;
+    }
+
+private:
+
+    /// Get the bucket for a key, relative to the last key popped
+    inline size_t bucket_of(uint64_t key) const {
+        return key == last ? 0 : 64 - __builtin_clzll(key ^ last);
+    }
+
+    /// Move the smallest keys into bucket 0, when it is empty
+    void refill() {
+        size_t i = 1;
+        while (buckets[i].empty()) {
+            i++;
+        }
+        // Everything in this bucket is closer to the new minimum than to the
+        // old one, so it all lands in lower buckets
+        last = numeric_limits<uint64_t>::max();
+        for (auto& item : buckets[i]) {
+            last = min(last, item.first);
+        }
+        for (auto& item : buckets[i]) {
+            buckets[bucket_of(item.first)].push_back(item);
+        }
+        buckets[i].clear();
+    }
+
+    /// The items, by the highest differing bit from the last key popped
+    vector<pair<uint64_t, T>> buckets[65];
+
+    /// The last key popped, which no item can be below
+    uint64_t last = 0;
+
+    /// The number of items
+    size_t count = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include "read_cache.hpp"
+
+#include <algorithm>
+#include <functional>
+
+namespace vg {
+
+using namespace std;
+
+ReadAlignmentCache::ReadAlignmentCache(size_t max_entries, bool key_on_quality, size_t num_shards) :
+    key_on_quality(key_on_quality),
+    // Never use more shards than entries, so that rounding each shard's
+    // capacity down keeps the total within max_entries
+    max_entries_per_shard(max_entries / max<size_t>(1, min(num_shards, max_entries))),
+    shards(max<size_t>(1, min(num_shards, max_entries))),
+    hit_count(0),
+    miss_count(0) {
+    // Nothing to do
+}
+
+void ReadAlignmentCache::append_key(const Alignment& read, string& key) const {
+    key.append(read.sequence());
+    if (key_on_quality && !read.quality().empty()) {
+        // Distinguish reads by a hash of their qualities rather than storing them
+        size_t quality_hash = std::hash<string>()(read.quality());
+        key.push_back('\t');
+        key.append((const char*) &quality_hash, sizeof(quality_hash));
+    }
+}
+
+ReadAlignmentCache::Shard& ReadAlignmentCache::shard_for(const string& key) {
+    return shards[std::hash<string>()(key) % shards.size()];
+}
+
+bool ReadAlignmentCache::retrieve(const string& key, pair<vector<Alignment>, vector<Alignment>>& alns_out) {
+    Shard& shard = shard_for(key);
+    {
+        lock_guard<mutex> guard(shard.shard_mutex);
+        auto found = shard.index.find(key);
+        if (found != shard.index.end()) {
+            // Mark the entry as most recently used and copy out the alignments
+            shard.entries.splice(shard.entries.begin(), shard.entries, found->second);
+            alns_out = found->second->alns;
+            hit_count++;
+            return true;
+        }
+    }
+    miss_count++;
+    return false;
+}
+
+void ReadAlignmentCache::insert(string&& key, pair<vector<Alignment>, vector<Alignment>>&& alns) {
+    Shard& shard = shard_for(key);
+    lock_guard<mutex> guard(shard.shard_mutex);
+    if (max_entries_per_shard == 0 || shard.index.count(key)) {
+        // The cache holds nothing, or another thread got here first with the
+        // same read
+        return;
+    }
+    if (shard.entries.size() >= max_entries_per_shard) {
+        // Evict the least recently used entry
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.emplace_front();
+    shard.entries.front().key = std::move(key);
+    shard.entries.front().alns = std::move(alns);
+    shard.index[shard.entries.front().key] = shard.entries.begin();
+}
+
+void ReadAlignmentCache::relabel(vector<Alignment>& alns, const Alignment& read,
+                                 const string& prev_name, const string& next_name) {
+    // The qualities may differ from those of the read that was aligned, so
+    // they have to come from this read. The mapper hands back alignments of
+    // the read as given, never of its reverse complement, so they can be
+    // copied straight over.
+    for (auto& aln : alns) {
+        aln.set_name(read.name());
+        aln.set_quality(read.quality());
+        aln.set_sample_name(read.sample_name());
+        aln.set_read_group(read.read_group());
+        if (!prev_name.empty()) {
+            aln.mutable_fragment_prev()->set_name(prev_name);
+        }
+        if (!next_name.empty()) {
+            aln.mutable_fragment_next()->set_name(next_name);
+        }
+    }
+}
+
+bool ReadAlignmentCache::lookup(const Alignment& read, vector<Alignment>& alns_out) {
+    string key;
+    append_key(read, key);
+    pair<vector<Alignment>, vector<Alignment>> cached;
+    if (!retrieve(key, cached)) {
+        return false;
+    }
+    alns_out = std::move(cached.first);
+    relabel(alns_out, read, "", "");
+    return true;
+}
+
+void ReadAlignmentCache::store(const Alignment& read, const vector<Alignment>& alns) {
+    string key;
+    append_key(read, key);
+    insert(std::move(key), make_pair(alns, vector<Alignment>()));
+}
+
+bool ReadAlignmentCache::lookup_pair(const Alignment& read1, const Alignment& read2,
+                                     pair<vector<Alignment>, vector<Alignment>>& alns_out) {
+    string key;
+    append_key(read1, key);
+    key.push_back('\n');
+    append_key(read2, key);
+    if (!retrieve(key, alns_out)) {
+        return false;
+    }
+    relabel(alns_out.first, read1, "", read2.name());
+    relabel(alns_out.second, read2, read1.name(), "");
+    return true;
+}
+
+void ReadAlignmentCache::store_pair(const Alignment& read1, const Alignment& read2,
+                                    const pair<vector<Alignment>, vector<Alignment>>& alns) {
+    string key;
+    append_key(read1, key);
+    key.push_back('\n');
+    append_key(read2, key);
+    insert(std::move(key), pair<vector<Alignment>, vector<Alignment>>(alns));
+}
+
+size_t ReadAlignmentCache::hits() const {
+    return hit_count.load();
+}
+
+size_t ReadAlignmentCache::misses() const {
+    return miss_count.load();
+}
+
+double ReadAlignmentCache::hit_rate() const {
+    size_t total = hits() + misses();
+    return total ? double(hits()) / total : 0.0;
+}
+
+void ReadAlignmentCache::report(ostream& out) const {
+    out << "read cache: " << hits() << " hits, " << misses() << " misses ("
+        << hit_rate() * 100.0 << "% hit rate)" << endl;
+}
+
+}
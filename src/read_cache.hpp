@@ -0,0 +1,113 @@
+#ifndef VG_READ_CACHE_HPP_INCLUDED
+#define VG_READ_CACHE_HPP_INCLUDED
+
+#include <vector>
+#include <list>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <iostream>
+#include <unordered_map>
+#include "vg.pb.h"
+
+/** \file
+ * A bounded, thread-safe cache of mapping results keyed by read content, so
+ * that byte-identical reads (common in amplicon and deep targeted panels) are
+ * only seeded, clustered and aligned once.
+ */
+
+namespace vg {
+
+using namespace std;
+
+/**
+ * Caches the alignments produced for a read (or read pair) under the read's
+ * sequence and, optionally, a hash of its base qualities. Lookups hand back
+ * copies of the cached alignments with the read name, mate names, base
+ * qualities, sample and read group rewritten for the query read. The cache
+ * is split into independently locked shards, each of which evicts its least
+ * recently used entries once its share of the total capacity is reached.
+ */
+class ReadAlignmentCache {
+public:
+
+    /// Make a cache holding at most max_entries reads or pairs. If
+    /// key_on_quality is set, reads with identical sequences but different
+    /// base qualities are cached separately.
+    ReadAlignmentCache(size_t max_entries, bool key_on_quality, size_t num_shards = 64);
+    ~ReadAlignmentCache() = default;
+
+    /// If the read has been seen before, fill alns_out with its alignments
+    /// relabeled for this read and return true. Otherwise return false.
+    bool lookup(const Alignment& read, vector<Alignment>& alns_out);
+
+    /// Remember the alignments produced for the read.
+    void store(const Alignment& read, const vector<Alignment>& alns);
+
+    /// If the pair has been seen before, fill alns_out with its alignments
+    /// relabeled for these mates and return true. Otherwise return false.
+    bool lookup_pair(const Alignment& read1, const Alignment& read2,
+                     pair<vector<Alignment>, vector<Alignment>>& alns_out);
+
+    /// Remember the alignments produced for the read pair.
+    void store_pair(const Alignment& read1, const Alignment& read2,
+                    const pair<vector<Alignment>, vector<Alignment>>& alns);
+
+    /// Number of lookups that found a cached result
+    size_t hits() const;
+
+    /// Number of lookups that did not find a cached result
+    size_t misses() const;
+
+    /// Fraction of lookups that found a cached result
+    double hit_rate() const;
+
+    /// Write a one-line summary of the cache's performance
+    void report(ostream& out) const;
+
+private:
+
+    /// A cached result. Single-end results only use the first vector.
+    struct Entry {
+        string key;
+        pair<vector<Alignment>, vector<Alignment>> alns;
+    };
+
+    struct Shard {
+        mutex shard_mutex;
+        /// Most recently used entries at the front
+        list<Entry> entries;
+        unordered_map<string, list<Entry>::iterator> index;
+    };
+
+    /// Append the content key of a read to a key string
+    void append_key(const Alignment& read, string& key) const;
+
+    /// Pick the shard responsible for a key
+    Shard& shard_for(const string& key);
+
+    /// Find the key in its shard and copy out the result, or return false
+    bool retrieve(const string& key, pair<vector<Alignment>, vector<Alignment>>& alns_out);
+
+    /// Add the result to its shard, evicting if the shard is full
+    void insert(string&& key, pair<vector<Alignment>, vector<Alignment>>&& alns);
+
+    /// Give the alignments the per-read fields of the given read, which has
+    /// the same sequence as the read they were made for, and point them at
+    /// the given mate names. The alignments must be of the read in its given
+    /// orientation.
+    static void relabel(vector<Alignment>& alns, const Alignment& read,
+                        const string& prev_name, const string& next_name);
+
+    bool key_on_quality;
+    size_t max_entries_per_shard;
+    vector<Shard> shards;
+
+    atomic<size_t> hit_count;
+    atomic<size_t> miss_count;
+};
+
+}
+
+#endif
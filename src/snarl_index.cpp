@@ -0,0 +1,365 @@
+/**
+ * \file snarl_index.cpp
+ * Implementation of the memory-mappable snarl tree index.
+ */
+
+#include "snarl_index.hpp"
+#include "snarls.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace vg {
+
+using namespace std;
+
+const size_t SnarlIndex::NONE = numeric_limits<size_t>::max();
+
+namespace {
+    /// First word of every snarl index file ("vgsnarlX" read little-endian)
+    const uint64_t MAGIC = 0x586c72616e736776ull;
+    /// Bumped whenever the layout changes
+    const uint64_t VERSION = 1;
+
+    // Header words
+    enum : size_t {
+        HEADER_MAGIC, HEADER_VERSION, HEADER_SNARLS, HEADER_CHAINS, HEADER_MEMBERS,
+        HEADER_MIN_ID, HEADER_BIT_WORDS, HEADER_BOUNDARIES, HEADER_WORDS
+    };
+
+    // Words of each snarl record
+    enum : size_t {
+        RECORD_START, RECORD_END, RECORD_FLAGS, RECORD_PARENT, RECORD_CHAIN, RECORD_WORDS
+    };
+
+    // Bits of the flags word. The type goes above them.
+    enum : uint64_t {
+        FLAG_START_BACKWARD = 1,
+        FLAG_END_BACKWARD = 2,
+        FLAG_START_SELF_REACHABLE = 4,
+        FLAG_END_SELF_REACHABLE = 8,
+        FLAG_START_END_REACHABLE = 16,
+        FLAG_DIRECTED_ACYCLIC = 32,
+        TYPE_SHIFT = 8
+    };
+
+    /// Bit vector words per rank sample
+    const size_t RANK_BLOCK_WORDS = 8;
+
+    /// Get the number of words after the header for the given header
+    size_t body_words(const uint64_t* header) {
+        return header[HEADER_SNARLS] * RECORD_WORDS
+            + header[HEADER_SNARLS] + 2
+            + header[HEADER_CHAINS] + 1
+            + header[HEADER_MEMBERS]
+            + header[HEADER_BIT_WORDS]
+            + header[HEADER_BIT_WORDS] / RANK_BLOCK_WORDS + 1
+            + header[HEADER_BOUNDARIES] * 2;
+    }
+}
+
+SnarlIndex::SnarlIndex(const SnarlManager& manager) {
+    // Number the snarls in preorder
+    vector<const Snarl*> order;
+    unordered_map<const Snarl*, size_t> number;
+    manager.for_each_snarl_preorder([&](const Snarl* snarl) {
+        number[snarl] = order.size();
+        order.push_back(snarl);
+    });
+
+    // Number the chains, grouped by parent with the root chains first
+    vector<const Chain*> chains;
+    vector<uint64_t> groups{0};
+    for (size_t i = 0; i <= order.size(); i++) {
+        for (const Chain& chain : manager.chains_of(i == 0 ? nullptr : order[i - 1])) {
+            chains.push_back(&chain);
+        }
+        groups.push_back(chains.size());
+    }
+    size_t member_count = 0;
+    for (const Chain* chain : chains) {
+        member_count += chain->size();
+    }
+
+    // Find the range of boundary node IDs
+    id_t min_id = numeric_limits<id_t>::max();
+    id_t max_id = numeric_limits<id_t>::min();
+    for (const Snarl* snarl : order) {
+        min_id = min(min_id, min(snarl->start().node_id(), snarl->end().node_id()));
+        max_id = max(max_id, max(snarl->start().node_id(), snarl->end().node_id()));
+    }
+    size_t id_range = order.empty() ? 0 : max_id - min_id + 1;
+    size_t bit_words = (id_range + 63) / 64;
+
+    // Mark the boundary nodes
+    vector<uint64_t> bits(bit_words, 0);
+    for (const Snarl* snarl : order) {
+        for (id_t id : {snarl->start().node_id(), snarl->end().node_id()}) {
+            size_t offset = id - min_id;
+            bits[offset / 64] |= uint64_t(1) << (offset % 64);
+        }
+    }
+    vector<uint64_t> ranks(bit_words / RANK_BLOCK_WORDS + 1, 0);
+    size_t boundary_count = 0;
+    for (size_t i = 0; i < bit_words; i++) {
+        if (i % RANK_BLOCK_WORDS == 0) {
+            ranks[i / RANK_BLOCK_WORDS] = boundary_count;
+        }
+        boundary_count += __builtin_popcountll(bits[i]);
+    }
+
+    owned.resize(HEADER_WORDS, 0);
+    owned[HEADER_MAGIC] = MAGIC;
+    owned[HEADER_VERSION] = VERSION;
+    owned[HEADER_SNARLS] = order.size();
+    owned[HEADER_CHAINS] = chains.size();
+    owned[HEADER_MEMBERS] = member_count;
+    owned[HEADER_MIN_ID] = order.empty() ? 0 : min_id;
+    owned[HEADER_BIT_WORDS] = bit_words;
+    owned[HEADER_BOUNDARIES] = boundary_count;
+    owned.resize(HEADER_WORDS + body_words(owned.data()), 0);
+    find_sections(owned.data(), owned.size());
+
+    // Now fill in the sections, through non-const pointers to the same places
+    uint64_t* records = owned.data() + (snarl_records - owned.data());
+    for (size_t i = 0; i < order.size(); i++) {
+        const Snarl& snarl = *order[i];
+        uint64_t* record = records + i * RECORD_WORDS;
+        record[RECORD_START] = snarl.start().node_id();
+        record[RECORD_END] = snarl.end().node_id();
+        record[RECORD_FLAGS] = (snarl.start().backward() ? FLAG_START_BACKWARD : 0)
+            | (snarl.end().backward() ? FLAG_END_BACKWARD : 0)
+            | (snarl.start_self_reachable() ? FLAG_START_SELF_REACHABLE : 0)
+            | (snarl.end_self_reachable() ? FLAG_END_SELF_REACHABLE : 0)
+            | (snarl.start_end_reachable() ? FLAG_START_END_REACHABLE : 0)
+            | (snarl.directed_acyclic_net_graph() ? FLAG_DIRECTED_ACYCLIC : 0)
+            | (uint64_t(snarl.type()) << TYPE_SHIFT);
+        const Snarl* parent = manager.parent_of(&snarl);
+        record[RECORD_PARENT] = parent == nullptr ? NONE : number.at(parent);
+    }
+
+    copy(groups.begin(), groups.end(), owned.data() + (chain_groups - owned.data()));
+
+    uint64_t* offsets = owned.data() + (chain_offsets - owned.data());
+    uint64_t* members = owned.data() + (chain_members - owned.data());
+    size_t filled = 0;
+    for (size_t i = 0; i < chains.size(); i++) {
+        offsets[i] = filled;
+        for (const Snarl* snarl : *chains[i]) {
+            members[filled++] = number.at(snarl);
+            records[number.at(snarl) * RECORD_WORDS + RECORD_CHAIN] = i;
+        }
+    }
+    offsets[chains.size()] = filled;
+
+    copy(bits.begin(), bits.end(), owned.data() + (boundary_bits - owned.data()));
+    copy(ranks.begin(), ranks.end(), owned.data() + (boundary_ranks - owned.data()));
+
+    // Record which snarl each boundary orientation reads into, as number + 1
+    // so that 0 can mean none
+    uint64_t* into = owned.data() + (boundary_into - owned.data());
+    auto rank_of = [&](id_t id) {
+        size_t offset = id - min_id;
+        size_t word = offset / 64;
+        size_t rank = ranks[word / RANK_BLOCK_WORDS];
+        for (size_t i = word - word % RANK_BLOCK_WORDS; i < word; i++) {
+            rank += __builtin_popcountll(bits[i]);
+        }
+        return rank + __builtin_popcountll(bits[word] & ((uint64_t(1) << (offset % 64)) - 1));
+    };
+    for (size_t i = 0; i < order.size(); i++) {
+        const Snarl& snarl = *order[i];
+        into[2 * rank_of(snarl.start().node_id()) + snarl.start().backward()] = i + 1;
+        into[2 * rank_of(snarl.end().node_id()) + !snarl.end().backward()] = i + 1;
+    }
+}
+
+SnarlIndex::SnarlIndex(const string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw runtime_error("[vg::SnarlIndex] could not open " + filename + ": " + strerror(errno));
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+        close(fd);
+        throw runtime_error("[vg::SnarlIndex] could not stat " + filename + ": " + strerror(errno));
+    }
+    mapped_bytes = file_stat.st_size;
+    if (mapped_bytes < HEADER_WORDS * sizeof(uint64_t) || mapped_bytes % sizeof(uint64_t) != 0) {
+        close(fd);
+        throw runtime_error("[vg::SnarlIndex] " + filename + " is not a snarl index");
+    }
+    mapped = mmap(nullptr, mapped_bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        mapped = nullptr;
+        throw runtime_error("[vg::SnarlIndex] could not map " + filename + ": " + strerror(errno));
+    }
+    try {
+        find_sections((const uint64_t*) mapped, mapped_bytes / sizeof(uint64_t));
+    } catch (...) {
+        munmap(mapped, mapped_bytes);
+        mapped = nullptr;
+        throw;
+    }
+}
+
+SnarlIndex::SnarlIndex(istream& in) {
+    owned.resize(HEADER_WORDS);
+    if (!in.read((char*) owned.data(), HEADER_WORDS * sizeof(uint64_t))) {
+        throw runtime_error("[vg::SnarlIndex] input is too short to be a snarl index");
+    }
+    if (owned[HEADER_MAGIC] != MAGIC) {
+        throw runtime_error("[vg::SnarlIndex] input is not a snarl index");
+    }
+    size_t body = body_words(owned.data());
+    owned.resize(HEADER_WORDS + body);
+    if (!in.read((char*) (owned.data() + HEADER_WORDS), body * sizeof(uint64_t))) {
+        throw runtime_error("[vg::SnarlIndex] snarl index is truncated");
+    }
+    find_sections(owned.data(), owned.size());
+}
+
+SnarlIndex::~SnarlIndex() {
+    if (mapped != nullptr) {
+        munmap(mapped, mapped_bytes);
+    }
+}
+
+void SnarlIndex::find_sections(const uint64_t* words, size_t word_count) {
+    if (word_count < HEADER_WORDS || words[HEADER_MAGIC] != MAGIC) {
+        throw runtime_error("[vg::SnarlIndex] not a snarl index");
+    }
+    if (words[HEADER_VERSION] != VERSION) {
+        throw runtime_error("[vg::SnarlIndex] snarl index is version " + to_string(words[HEADER_VERSION])
+                            + " but only version " + to_string(VERSION) + " can be read");
+    }
+    if (word_count != HEADER_WORDS + body_words(words)) {
+        throw runtime_error("[vg::SnarlIndex] snarl index is the wrong size for its header");
+    }
+    header = words;
+    snarl_records = header + HEADER_WORDS;
+    chain_groups = snarl_records + header[HEADER_SNARLS] * RECORD_WORDS;
+    chain_offsets = chain_groups + header[HEADER_SNARLS] + 2;
+    chain_members = chain_offsets + header[HEADER_CHAINS] + 1;
+    boundary_bits = chain_members + header[HEADER_MEMBERS];
+    boundary_ranks = boundary_bits + header[HEADER_BIT_WORDS];
+    boundary_into = boundary_ranks + header[HEADER_BIT_WORDS] / RANK_BLOCK_WORDS + 1;
+    total_words = word_count;
+}
+
+void SnarlIndex::serialize(ostream& out) const {
+    out.write((const char*) header, total_words * sizeof(uint64_t));
+}
+
+bool SnarlIndex::is_snarl_index(const string& filename) {
+    ifstream in(filename, ios::binary);
+    uint64_t magic = 0;
+    return in.read((char*) &magic, sizeof(magic)) && magic == MAGIC;
+}
+
+size_t SnarlIndex::snarl_count() const {
+    return header[HEADER_SNARLS];
+}
+
+size_t SnarlIndex::chain_count() const {
+    return header[HEADER_CHAINS];
+}
+
+Snarl SnarlIndex::get_snarl(size_t snarl) const {
+    const uint64_t* record = snarl_records + snarl * RECORD_WORDS;
+    uint64_t flags = record[RECORD_FLAGS];
+
+    Snarl to_return;
+    *to_return.mutable_start() = get_start(snarl);
+    *to_return.mutable_end() = get_end(snarl);
+    to_return.set_type((SnarlType) (flags >> TYPE_SHIFT));
+    to_return.set_start_self_reachable(flags & FLAG_START_SELF_REACHABLE);
+    to_return.set_end_self_reachable(flags & FLAG_END_SELF_REACHABLE);
+    to_return.set_start_end_reachable(flags & FLAG_START_END_REACHABLE);
+    to_return.set_directed_acyclic_net_graph(flags & FLAG_DIRECTED_ACYCLIC);
+
+    size_t parent = record[RECORD_PARENT];
+    if (parent != NONE) {
+        *to_return.mutable_parent()->mutable_start() = get_start(parent);
+        *to_return.mutable_parent()->mutable_end() = get_end(parent);
+    }
+    return to_return;
+}
+
+Visit SnarlIndex::get_start(size_t snarl) const {
+    const uint64_t* record = snarl_records + snarl * RECORD_WORDS;
+    Visit to_return;
+    to_return.set_node_id(record[RECORD_START]);
+    to_return.set_backward(record[RECORD_FLAGS] & FLAG_START_BACKWARD);
+    return to_return;
+}
+
+Visit SnarlIndex::get_end(size_t snarl) const {
+    const uint64_t* record = snarl_records + snarl * RECORD_WORDS;
+    Visit to_return;
+    to_return.set_node_id(record[RECORD_END]);
+    to_return.set_backward(record[RECORD_FLAGS] & FLAG_END_BACKWARD);
+    return to_return;
+}
+
+size_t SnarlIndex::parent_of(size_t snarl) const {
+    return snarl_records[snarl * RECORD_WORDS + RECORD_PARENT];
+}
+
+size_t SnarlIndex::chain_of(size_t snarl) const {
+    return snarl_records[snarl * RECORD_WORDS + RECORD_CHAIN];
+}
+
+pair<size_t, size_t> SnarlIndex::chains_of(size_t snarl) const {
+    // Group 0 is the root chains, and each snarl's group comes after that
+    size_t group = snarl == NONE ? 0 : snarl + 1;
+    return make_pair(chain_groups[group], chain_groups[group + 1]);
+}
+
+size_t SnarlIndex::chain_size(size_t chain) const {
+    return chain_offsets[chain + 1] - chain_offsets[chain];
+}
+
+size_t SnarlIndex::chain_member(size_t chain, size_t position) const {
+    return chain_members[chain_offsets[chain] + position];
+}
+
+size_t SnarlIndex::into_which_snarl(id_t id, bool reverse) const {
+    if (id < (id_t) header[HEADER_MIN_ID]) {
+        return NONE;
+    }
+    size_t offset = id - (id_t) header[HEADER_MIN_ID];
+    size_t word = offset / 64;
+    if (word >= header[HEADER_BIT_WORDS]) {
+        return NONE;
+    }
+    uint64_t bit = uint64_t(1) << (offset % 64);
+    if (!(boundary_bits[word] & bit)) {
+        return NONE;
+    }
+
+    // Count the boundary nodes before this one, from the last sample
+    size_t rank = boundary_ranks[word / RANK_BLOCK_WORDS];
+    for (size_t i = word - word % RANK_BLOCK_WORDS; i < word; i++) {
+        rank += __builtin_popcountll(boundary_bits[i]);
+    }
+    rank += __builtin_popcountll(boundary_bits[word] & (bit - 1));
+
+    return boundary_into[2 * rank + reverse] - 1;
+}
+
+size_t SnarlIndex::size_in_bytes() const {
+    return total_words * sizeof(uint64_t);
+}
+
+}
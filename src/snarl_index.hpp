@@ -0,0 +1,146 @@
+#ifndef VG_SNARL_INDEX_HPP_INCLUDED
+#define VG_SNARL_INDEX_HPP_INCLUDED
+
+/**
+ * \file snarl_index.hpp
+ * A compact, memory-mappable serialization of a snarl tree. Loading one is a
+ * single mmap, and boundary lookups are answered straight out of the mapped
+ * file, so tools that only ask which snarl a node traversal enters don't have
+ * to parse Snarl Protobufs or build hash tables on startup.
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vg.pb.h"
+#include "types.hpp"
+
+namespace vg {
+
+using namespace std;
+
+class SnarlManager;
+
+/**
+ * A read-only snarl tree laid out as flat arrays of 64-bit words, either in
+ * memory or mapped from a file. Snarls and chains have dense numbers, with
+ * snarls numbered in preorder.
+ *
+ * - Each snarl has a fixed-size record with its boundary visits, flags and
+ *   type, its parent's number, and the number of the chain it is in.
+ * - Chains are stored grouped by parent, root chains first, so the chains
+ *   under a snarl are a contiguous range of chain numbers. Each chain is a
+ *   range of the member array.
+ * - Boundary lookups go through a bit vector over the node ID range of the
+ *   boundary nodes, with a rank sample every 512 bits. The rank of a
+ *   boundary node picks its pair of slots in an array of the snarls each of
+ *   its orientations reads into. That makes into_which_snarl() constant time
+ *   at a bit per node ID plus two words per boundary node.
+ *
+ * The file is in host byte order and starts with a magic number and format
+ * version, which loading checks. Snarl names are not stored.
+ */
+class SnarlIndex {
+public:
+
+    /// Number used for "no snarl" and "no chain"
+    static const size_t NONE;
+
+    /// Build an index of all the snarls and chains in a SnarlManager
+    SnarlIndex(const SnarlManager& manager);
+
+    /// Map an index saved with serialize() from the given file. The file
+    /// stays mapped for as long as the index exists.
+    SnarlIndex(const string& filename);
+
+    /// Read an index saved with serialize() from a stream into memory, for
+    /// input that can't be mapped
+    SnarlIndex(istream& in);
+
+    ~SnarlIndex();
+
+    /// Cannot be copied or moved, because the section pointers point into
+    /// the storage
+    SnarlIndex(const SnarlIndex& other) = delete;
+    SnarlIndex& operator=(const SnarlIndex& other) = delete;
+
+    /// Write the index out in the format the constructors load
+    void serialize(ostream& out) const;
+
+    /// Returns true if the given file starts like a snarl index, as opposed
+    /// to a stream of Snarl Protobufs
+    static bool is_snarl_index(const string& filename);
+
+    /// Get the number of snarls
+    size_t snarl_count() const;
+
+    /// Get the number of chains
+    size_t chain_count() const;
+
+    /// Make a Snarl Protobuf for the snarl with the given number, with its
+    /// parent's boundaries filled in if it has one
+    Snarl get_snarl(size_t snarl) const;
+
+    /// Get the visit into the given snarl at its start
+    Visit get_start(size_t snarl) const;
+
+    /// Get the visit out of the given snarl at its end
+    Visit get_end(size_t snarl) const;
+
+    /// Get the number of the parent of the given snarl, or NONE if it is a
+    /// top-level snarl
+    size_t parent_of(size_t snarl) const;
+
+    /// Get the number of the chain the given snarl is in
+    size_t chain_of(size_t snarl) const;
+
+    /// Get the range of numbers of the chains in the given snarl, or the
+    /// top-level chains if given NONE, as a past-the-end pair
+    pair<size_t, size_t> chains_of(size_t snarl) const;
+
+    /// Get the number of snarls in the given chain
+    size_t chain_size(size_t chain) const;
+
+    /// Get the number of the snarl at the given position in the given chain
+    size_t chain_member(size_t chain, size_t position) const;
+
+    /// Get the number of the snarl that a traversal of the given node in the
+    /// given orientation reads into, at its start or at its reversed end, or
+    /// NONE if there isn't one
+    size_t into_which_snarl(id_t id, bool reverse) const;
+
+    /// Get the number of bytes the index takes up
+    size_t size_in_bytes() const;
+
+private:
+
+    /// Fill in the section pointers from the header at the given words,
+    /// after checking that they make sense for the given number of words
+    void find_sections(const uint64_t* words, size_t word_count);
+
+    /// Words of an index built or read into memory
+    vector<uint64_t> owned;
+
+    /// Mapped file, if any, and its length in bytes
+    void* mapped = nullptr;
+    size_t mapped_bytes = 0;
+
+    /// Where the sections are, in whichever storage is in use
+    const uint64_t* header = nullptr;
+    const uint64_t* snarl_records = nullptr;
+    const uint64_t* chain_groups = nullptr;
+    const uint64_t* chain_offsets = nullptr;
+    const uint64_t* chain_members = nullptr;
+    const uint64_t* boundary_bits = nullptr;
+    const uint64_t* boundary_ranks = nullptr;
+    const uint64_t* boundary_into = nullptr;
+    size_t total_words = 0;
+};
+
+}
+
+#endif
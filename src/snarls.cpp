@@ -6,9 +6,17 @@
 //#define debug
 
 #include "snarls.hpp"
+#include "snarl_index.hpp"
 #include "json2pb.h"
 #include "algorithms/topological_sort.hpp"
 #include "algorithms/is_directed_acyclic.hpp"
+#include "algorithms/weakly_connected_components.hpp"
+#include "algorithms/three_edge_connected_components.hpp"
+#include "algorithms/strongly_connected_components.hpp"
+#include "algorithms/find_shortest_paths.hpp"
+
+#include <memory>
+#include <numeric>
 
 namespace vg {
 
@@ -29,6 +37,118 @@ CactusSnarlFinder::CactusSnarlFinder(VG& graph, const string& hint_path) :
 
 SnarlManager CactusSnarlFinder::find_snarls() {
     
+    // We'll fill this with all the snarls
+    SnarlManager snarl_manager;
+    
+    for_each_component_snarls([&](SnarlManager& component_snarl_manager) {
+        // Tack each component's snarls on after the ones before it
+        snarl_manager.extend(std::move(component_snarl_manager));
+    });
+    
+    return snarl_manager;
+}
+
+void CactusSnarlFinder::for_each_component_snarls(const function<void(SnarlManager&)>& lambda) {
+    
+    if (graph.size() == 0) {
+        // No snarls here!
+        return;
+    }
+    
+    vector<id_t> node_ids;
+    vector<size_t> component_of_node;
+    size_t component_count = algorithms::weakly_connected_component_labels(&graph, node_ids, component_of_node);
+    
+    if (component_count == 1) {
+        // Nothing to split up, so decompose the graph as it is
+        SnarlManager snarl_manager = decompose();
+        lambda(snarl_manager);
+        return;
+    }
+    
+    // Work out which nodes go in each component
+    vector<vector<id_t>> component_nodes(component_count);
+    for (size_t i = 0; i < node_ids.size(); i++) {
+        component_nodes[component_of_node[i]].push_back(node_ids[i]);
+    }
+    for (auto& nodes : component_nodes) {
+        if (nodes.size() == 1) {
+            // If we feed this through to Cactus it will crash.
+            throw runtime_error("Cactus does not currently support finding snarls in a single-node connected component");
+        }
+    }
+    
+    // And which paths go with them, so each component can still pick its
+    // telomeres from its paths
+    auto component_of = [&](id_t node_id) {
+        return component_of_node[lower_bound(node_ids.begin(), node_ids.end(), node_id) - node_ids.begin()];
+    };
+    vector<vector<string>> component_paths(component_count);
+    graph.paths.for_each_name([&](const string& name) {
+        auto& path_mappings = graph.paths.get_path(name);
+        if (path_mappings.empty()) {
+            // Cactus doesn't use empty paths
+            return;
+        }
+        size_t component = component_of(path_mappings.front().position().node_id());
+        for (auto& mapping : path_mappings) {
+            if (component_of(mapping.position().node_id()) != component) {
+                // If we use a path like this to pick telomeres we will segfault Cactus.
+                throw runtime_error("Path " + name + " spans multiple connected components!");
+            }
+        }
+        component_paths[component].push_back(name);
+    });
+    
+    // Start on the biggest components first, so one big chromosome doesn't
+    // end up running by itself at the end
+    vector<size_t> schedule(component_count);
+    iota(schedule.begin(), schedule.end(), 0);
+    stable_sort(schedule.begin(), schedule.end(), [&](size_t a, size_t b) {
+        return component_nodes[a].size() > component_nodes[b].size();
+    });
+    
+    // Finished components wait here until everything before them is reported
+    vector<unique_ptr<SnarlManager>> finished(component_count);
+    size_t next_to_report = 0;
+    
+#pragma omp parallel for schedule(dynamic, 1)
+    for (size_t i = 0; i < component_count; i++) {
+        size_t component = schedule[i];
+        
+        // Copy out the component as its own graph
+        set<Node*> nodes;
+        for (id_t node_id : component_nodes[component]) {
+            nodes.insert(graph.get_node(node_id));
+        }
+        set<Edge*> edges;
+        graph.edges_of_nodes(nodes, edges);
+        VG component_graph;
+        component_graph.add_nodes(nodes);
+        component_graph.add_edges(edges);
+        for (auto& name : component_paths[component]) {
+            component_graph.paths.extend(graph.paths.path(name));
+        }
+        
+        CactusSnarlFinder component_finder(component_graph);
+        component_finder.hint_paths = hint_paths;
+        unique_ptr<SnarlManager> snarl_manager(new SnarlManager(component_finder.decompose()));
+        
+#pragma omp critical (cactus_component_snarls)
+        {
+            finished[component] = std::move(snarl_manager);
+            while (next_to_report < component_count && finished[next_to_report]) {
+                // Report everything that is now next in line
+                lambda(*finished[next_to_report]);
+                finished[next_to_report].reset();
+                next_to_report++;
+            }
+        }
+    }
+}
+
+SnarlManager CactusSnarlFinder::decompose() {
+    
     if (graph.size() == 0) {
         // No snarls here!
         return SnarlManager();
@@ -75,28 +195,6 @@ const Snarl* CactusSnarlFinder::recursively_emit_snarls(const Visit& start, cons
 #ifdef debug    
     cerr << "Explore snarl " << start << " -> " << end << endl;
 #endif
-           
-    // This is the snarl we are filling in to add to the SnarlManger, or an
-    // empty snarl if we're a fake root snarl.
-    Snarl snarl;
-        
-    if (start.node_id() != 0 && end.node_id() != 0) {
-        // This is a real snarl
-                
-        // Set up the start and end
-        *snarl.mutable_start() = start;
-        *snarl.mutable_end() = end;
-        
-        if (parent_start.node_id() != 0 && parent_end.node_id() != 0) {
-            // We have a parent that isn't the fake root, so fill in its ends
-            *snarl.mutable_parent()->mutable_start() = parent_start;
-            *snarl.mutable_parent()->mutable_end() = parent_end;
-        }
-    } 
-    
-    // This will hold the pointer to the copy of the snarl in the SnarlManager,
-    // or null if the snarl is a fake root and we don't add it.
-    const Snarl* managed = nullptr;
     
     // Before we can pass our snarl to the snarl manager, we need to look at all
     // its children so we can get connectivity info.
@@ -181,6 +279,36 @@ const Snarl* CactusSnarlFinder::recursively_emit_snarls(const Visit& start, cons
                                                 child_snarl->chains, child_snarl->unarySnarls, destination));
     }
 
+    // Now we have all the children, so we can finish the snarl itself
+    return emit_snarl(start, end, parent_start, parent_end, child_chains, &graph, destination);
+}
+
+const Snarl* SnarlFinder::emit_snarl(const Visit& start, const Visit& end,
+                                     const Visit& parent_start, const Visit& parent_end,
+                                     vector<Chain>& child_chains, const HandleGraph* graph, SnarlManager& destination) {
+    
+    // This is the snarl we are filling in to add to the SnarlManger, or an
+    // empty snarl if we're a fake root snarl.
+    Snarl snarl;
+        
+    if (start.node_id() != 0 && end.node_id() != 0) {
+        // This is a real snarl
+                
+        // Set up the start and end
+        *snarl.mutable_start() = start;
+        *snarl.mutable_end() = end;
+        
+        if (parent_start.node_id() != 0 && parent_end.node_id() != 0) {
+            // We have a parent that isn't the fake root, so fill in its ends
+            *snarl.mutable_parent()->mutable_start() = parent_start;
+            *snarl.mutable_parent()->mutable_end() = parent_end;
+        }
+    } 
+    
+    // This will hold the pointer to the copy of the snarl in the SnarlManager,
+    // or null if the snarl is a fake root and we don't add it.
+    const Snarl* managed = nullptr;
+    
     if (snarl.start().node_id() != 0 || snarl.end().node_id() != 0) {
         // This snarl is real, we care about type and connectivity.
 
@@ -188,7 +316,7 @@ const Snarl* CactusSnarlFinder::recursively_emit_snarls(const Visit& start, cons
         {
 
             // Make a net graph for the snarl that uses internal connectivity
-            NetGraph connectivity_net_graph(start, end, child_chains, &graph, true);
+            NetGraph connectivity_net_graph(start, end, child_chains, graph, true);
             
             // Evaluate connectivity
             // A snarl is minimal, so we know out start and end will be normal nodes.
@@ -292,7 +420,7 @@ const Snarl* CactusSnarlFinder::recursively_emit_snarls(const Visit& start, cons
             // Determine cyclicity/acyclicity
         
             // Make a net graph that just pretends child snarls/chains are ordinary nodes
-            NetGraph flat_net_graph(start, end, child_chains, &graph);
+            NetGraph flat_net_graph(start, end, child_chains, graph);
             
             // This definitely should be calculated based on the internal-connectivity-ignoring net graph.
             snarl.set_directed_acyclic_net_graph(algorithms::is_directed_acyclic(&flat_net_graph));
@@ -374,6 +502,623 @@ const Snarl* CactusSnarlFinder::recursively_emit_snarls(const Visit& start, cons
     return managed;
 }
 
+HandleGraphSnarlFinder::HandleGraphSnarlFinder(const HandleGraph* graph, const vector<vector<handle_t>>& paths) :
+    graph(graph) {
+    
+    for (auto& path : paths) {
+        if (path.empty()) {
+            // Not a real useful path
+            continue;
+        }
+        size_t length = 0;
+        for (auto& visit : path) {
+            length += graph->get_length(visit);
+        }
+        // Face both ends inward
+        path_ends.emplace_back(path.front(), graph->flip(path.back()), length);
+    }
+}
+
+HandleGraphSnarlFinder::HandleGraphSnarlFinder(VG& graph) :
+    graph(&graph) {
+    
+    graph.paths.for_each_name([&](const string& name) {
+        auto& path_mappings = graph.paths.get_path(name);
+        if (path_mappings.empty()) {
+            // Not a real useful path
+            return;
+        }
+        size_t length = 0;
+        for (auto& mapping : path_mappings) {
+            length += graph.get_length(graph.get_handle(mapping.position().node_id(), false));
+        }
+        // Face both ends inward
+        path_ends.emplace_back(graph.get_handle(path_mappings.front().position().node_id(),
+                                                path_mappings.front().position().is_reverse()),
+                               graph.get_handle(path_mappings.back().position().node_id(),
+                                                !path_mappings.back().position().is_reverse()),
+                               length);
+    });
+}
+
+SnarlManager HandleGraphSnarlFinder::find_snarls() {
+    
+    const size_t NONE = numeric_limits<size_t>::max();
+    
+    // We'll fill this with all the snarls
+    SnarlManager snarl_manager;
+    
+    // Rank the nodes by ID and find the weakly connected components
+    vector<id_t> node_ids;
+    vector<size_t> component_of_node;
+    size_t component_count = algorithms::weakly_connected_component_labels(graph, node_ids, component_of_node);
+    size_t node_count = node_ids.size();
+    if (node_count == 0) {
+        // No snarls here!
+        return snarl_manager;
+    }
+    
+    bool dense_ids = (size_t) (node_ids.back() - node_ids.front()) + 1 == node_count;
+    auto rank_of = [&](id_t id) -> size_t {
+        if (dense_ids) {
+            return id - node_ids.front();
+        }
+        return lower_bound(node_ids.begin(), node_ids.end(), id) - node_ids.begin();
+    };
+    auto component_of = [&](const handle_t& handle) {
+        return component_of_node[rank_of(graph->get_id(handle))];
+    };
+    
+    // Each node has a left side, numbered 2 * rank, and a right side, numbered
+    // 2 * rank + 1. This gets the side we leave a handle by.
+    auto exit_side = [&](const handle_t& handle) -> size_t {
+        return 2 * rank_of(graph->get_id(handle)) + (graph->get_is_reverse(handle) ? 0 : 1);
+    };
+    
+    // Merge the sides that are joined by edges, with a union-find where each
+    // side hangs under a lower one
+    vector<size_t> vertex_of_side(2 * node_count);
+    iota(vertex_of_side.begin(), vertex_of_side.end(), 0);
+    auto find_root = [&](size_t side) {
+        while (vertex_of_side[side] != side) {
+            vertex_of_side[side] = vertex_of_side[vertex_of_side[side]];
+            side = vertex_of_side[side];
+        }
+        return side;
+    };
+    graph->for_each_handle([&](const handle_t& handle) {
+        for (const handle_t& oriented : {handle, graph->flip(handle)}) {
+            size_t from = exit_side(oriented);
+            graph->follow_edges(oriented, false, [&](const handle_t& next) {
+                // We reach the other node at the side we would leave its
+                // reverse strand by
+                size_t a = find_root(from);
+                size_t b = find_root(exit_side(graph->flip(next)));
+                vertex_of_side[max(a, b)] = min(a, b);
+            });
+        }
+    });
+    // Number the merged sides. Each root comes before the rest of its tree,
+    // so everything else can just copy its root's number.
+    for (size_t i = 0; i < vertex_of_side.size(); i++) {
+        vertex_of_side[i] = find_root(i);
+    }
+    size_t adjacency_count = 0;
+    for (size_t i = 0; i < vertex_of_side.size(); i++) {
+        vertex_of_side[i] = vertex_of_side[i] == i ? adjacency_count++ : vertex_of_side[vertex_of_side[i]];
+    }
+    
+    // The nodes are edges between the merged sides, and merging the
+    // 3-edge-connected components of that graph gives the cactus graph
+    size_t vertex_count;
+    {
+        vector<size_t> cactus_vertex;
+        vertex_count = algorithms::three_edge_connected_component_labels(adjacency_count,
+            [&](const function<void(size_t, size_t)>& edge) {
+                for (size_t i = 0; i < node_count; i++) {
+                    edge(vertex_of_side[2 * i], vertex_of_side[2 * i + 1]);
+                }
+            }, cactus_vertex);
+        for (auto& vertex : vertex_of_side) {
+            vertex = cactus_vertex[vertex];
+        }
+    }
+    
+#ifdef debug
+    cerr << "Cactus graph has " << vertex_count << " vertices and " << node_count << " edges" << endl;
+#endif
+    
+    // Now pick telomeres for each component the way vg_to_cactus does, as a
+    // pair of sides facing into the graph, or NONE for components we skip.
+    vector<pair<size_t, size_t>> telomeres(component_count, make_pair(NONE, NONE));
+    {
+        vector<size_t> component_size(component_count, 0);
+        for (size_t component : component_of_node) {
+            component_size[component]++;
+        }
+        
+        // We store tips in an inward-facing direction
+        vector<unordered_set<handle_t>> component_tips(component_count);
+        for (auto& head : algorithms::head_nodes(graph)) {
+            component_tips[component_of(head)].insert(head);
+        }
+        for (auto& tail : algorithms::tail_nodes(graph)) {
+            component_tips[component_of(tail)].insert(graph->flip(tail));
+        }
+        
+        vector<vector<size_t>> component_paths(component_count);
+        for (size_t i = 0; i < path_ends.size(); i++) {
+            component_paths[component_of(get<0>(path_ends[i]))].push_back(i);
+        }
+        
+        // We only find the strongly connected components if we need them
+        vector<vector<vector<id_t>>> component_strong_components;
+        
+        auto add_telomeres = [&](size_t component, const handle_t& left, const handle_t& right) {
+#ifdef debug
+            cerr << "Selected " << graph->get_id(left) << " " << graph->get_is_reverse(left) << " and "
+                << graph->get_id(right) << " " << graph->get_is_reverse(right) << " as tips" << endl;
+#endif
+            // The handles read inward, so they leave by the interior sides
+            telomeres[component] = make_pair(exit_side(left), exit_side(right));
+        };
+        
+        for (size_t i = 0; i < component_count; i++) {
+            if (component_size[i] == 1) {
+                // Cactus can't handle these, and there is nothing in them
+                continue;
+            }
+            auto& tips = component_tips[i];
+            
+            // First priority is the longest path that starts and ends at tips
+            {
+                size_t longest_path = NONE;
+                size_t longest_path_length = 0;
+                for (size_t path : component_paths[i]) {
+                    if (tips.count(get<0>(path_ends[path])) && tips.count(get<1>(path_ends[path])) &&
+                        get<2>(path_ends[path]) > longest_path_length) {
+                        longest_path = path;
+                        longest_path_length = get<2>(path_ends[path]);
+                    }
+                }
+                if (longest_path != NONE) {
+                    add_telomeres(i, get<0>(path_ends[longest_path]), get<1>(path_ends[longest_path]));
+                    continue;
+                }
+            }
+            
+            // Otherwise, pick the pair of reachable tips with the longest
+            // shortest path, or failing that the tip with the longest path
+            // back to itself
+            {
+                // Distances between pairs of tips, lowest node and orientation
+                // first, or numeric_limits<size_t>::max() for unreachable
+                unordered_map<pair<handle_t, handle_t>, size_t> tip_distances;
+                
+                auto key_for = [&](const handle_t& a, const handle_t& b) {
+                    if (graph->get_id(b) < graph->get_id(a) ||
+                        (graph->get_id(b) == graph->get_id(a) && graph->get_is_reverse(b) < graph->get_is_reverse(a))) {
+                        return make_pair(b, a);
+                    }
+                    return make_pair(a, b);
+                };
+                
+                auto get_or_compute_distance = [&](const pair<handle_t, handle_t>& key) {
+                    if (!tip_distances.count(key)) {
+                        // Search out from one tip and save the distances to all of them
+                        unordered_map<handle_t, size_t> distances = algorithms::find_shortest_paths(graph, key.first);
+                        for (auto& other_tip : tips) {
+                            // Dijkstra reads out of the graph and into the tip
+                            auto found = distances.find(graph->flip(other_tip));
+                            tip_distances[key_for(key.first, other_tip)] = (found == distances.end() ?
+                                                                            numeric_limits<size_t>::max() :
+                                                                            found->second);
+                        }
+                    }
+                    return tip_distances.at(key);
+                };
+                
+                pair<handle_t, handle_t> furthest;
+                size_t furthest_distance = numeric_limits<size_t>::max();
+                auto consider = [&](const pair<handle_t, handle_t>& key) {
+                    size_t tip_distance = get_or_compute_distance(key);
+                    if (tip_distance != numeric_limits<size_t>::max() &&
+                        (tip_distance > furthest_distance || furthest_distance == numeric_limits<size_t>::max())) {
+                        furthest_distance = tip_distance;
+                        furthest = key;
+                    }
+                };
+                
+                for (auto& tip1 : tips) {
+                    for (auto& tip2 : tips) {
+                        if (tip1 != tip2) {
+                            consider(key_for(tip1, tip2));
+                        }
+                    }
+                }
+                if (furthest_distance == numeric_limits<size_t>::max()) {
+                    for (auto& tip : tips) {
+                        consider(make_pair(tip, tip));
+                    }
+                }
+                
+                if (furthest_distance != numeric_limits<size_t>::max()) {
+                    add_telomeres(i, furthest.first, furthest.second);
+                    continue;
+                }
+            }
+            
+            // Then any two tips, even if they can't reach each other
+            if (tips.size() >= 2) {
+                vector<handle_t> tip_list{tips.begin(), tips.end()};
+                add_telomeres(i, tip_list.front(), tip_list.back());
+                continue;
+            }
+            
+            // Otherwise, we have to be cyclic, so break at the lowest node in
+            // the biggest strongly connected component, breaking ties the way
+            // a set of sets of IDs would be ordered
+            if (component_strong_components.empty()) {
+                component_strong_components.resize(component_count);
+                for (auto& strong_component : algorithms::strongly_connected_components(graph)) {
+                    vector<id_t> members(strong_component.begin(), strong_component.end());
+                    std::sort(members.begin(), members.end());
+                    component_strong_components[component_of_node[rank_of(members.front())]].push_back(move(members));
+                }
+                for (auto& strong_components : component_strong_components) {
+                    std::sort(strong_components.begin(), strong_components.end());
+                }
+            }
+            const vector<id_t>* largest_component = nullptr;
+            for (auto& strong_component : component_strong_components[i]) {
+                if (largest_component != nullptr && strong_component.size() <= largest_component->size()) {
+                    continue;
+                }
+                if (strong_component.size() == 1) {
+                    // Nodes not in any cycle get components of their own, so
+                    // make sure this is a real 1-node cycle
+                    handle_t member = graph->get_handle(strong_component.front(), false);
+                    bool saw_self = !graph->follow_edges(member, false, [&](const handle_t& next) {
+                        return next != member;
+                    });
+                    if (!saw_self) {
+                        continue;
+                    }
+                }
+                largest_component = &strong_component;
+            }
+            assert(largest_component != nullptr);
+            id_t break_node = largest_component->front();
+            
+            // Make sure to feed in telomeres facing out
+            add_telomeres(i, graph->get_handle(break_node, true), graph->get_handle(break_node, false));
+        }
+    }
+    
+    // The nodes the telomeres are on are left out of the cactus graph, so the
+    // rest of it hangs between them. At a tip that just cuts off a dead end,
+    // and at a node that was broken to make telomeres it opens a cycle.
+    vector<bool> cut(node_count, false);
+    for (auto& telomere_pair : telomeres) {
+        if (telomere_pair.first != NONE) {
+            cut[telomere_pair.first / 2] = true;
+            cut[telomere_pair.second / 2] = true;
+        }
+    }
+    
+    // Get the side of a node that is at a cactus vertex, for nodes that aren't
+    // self loops in the cactus graph
+    auto side_at = [&](size_t rank, size_t vertex) {
+        return vertex_of_side[2 * rank] == vertex ? 2 * rank : 2 * rank + 1;
+    };
+    
+    // DFS the cactus graph from a telomere in each component. Each tree edge
+    // is either a bridge or in exactly one cycle, which is closed by a back
+    // edge up to the highest vertex in it.
+    
+    // The node each vertex was reached by, or NONE for the roots
+    vector<size_t> parent_edge(vertex_count, NONE);
+    vector<size_t> parent_vertex(vertex_count, NONE);
+    // The cycle that each vertex's parent edge is in, or NONE for a bridge
+    vector<size_t> cycle_of_vertex(vertex_count, NONE);
+    // Where each vertex is in that cycle's member list
+    vector<size_t> position_in_cycle(vertex_count);
+    // The vertices visited, in preorder
+    vector<size_t> preorder;
+    preorder.reserve(vertex_count);
+    // The highest vertex in each cycle, and the node that closes it
+    vector<size_t> cycle_top;
+    vector<size_t> cycle_back_edge;
+    // The other vertices in each cycle, in order down from the top, back to
+    // back
+    vector<size_t> cycle_members;
+    vector<size_t> cycle_start{0};
+    {
+        // Lay out the cactus graph's adjacency lists, leaving out cut nodes
+        // and self loops
+        vector<size_t> adjacency_start(vertex_count + 1, 0);
+        for (size_t i = 0; i < node_count; i++) {
+            if (!cut[i] && vertex_of_side[2 * i] != vertex_of_side[2 * i + 1]) {
+                adjacency_start[vertex_of_side[2 * i] + 1]++;
+                adjacency_start[vertex_of_side[2 * i + 1] + 1]++;
+            }
+        }
+        for (size_t i = 0; i < vertex_count; i++) {
+            adjacency_start[i + 1] += adjacency_start[i];
+        }
+        vector<size_t> adjacency(adjacency_start.back());
+        {
+            vector<size_t> filled(adjacency_start.begin(), adjacency_start.end() - 1);
+            for (size_t i = 0; i < node_count; i++) {
+                if (!cut[i] && vertex_of_side[2 * i] != vertex_of_side[2 * i + 1]) {
+                    adjacency[filled[vertex_of_side[2 * i]]++] = i;
+                    adjacency[filled[vertex_of_side[2 * i + 1]]++] = i;
+                }
+            }
+        }
+        
+        vector<size_t> preorder_number(vertex_count, NONE);
+        // The vertices on the DFS path, and the next adjacency entry to look
+        // at for each
+        vector<pair<size_t, size_t>> stack;
+        auto visit = [&](size_t vertex) {
+            preorder_number[vertex] = preorder.size();
+            preorder.push_back(vertex);
+            stack.emplace_back(vertex, adjacency_start[vertex]);
+        };
+        
+        for (auto& telomere_pair : telomeres) {
+            if (telomere_pair.first == NONE) {
+                continue;
+            }
+            visit(vertex_of_side[telomere_pair.first]);
+            while (!stack.empty()) {
+                size_t here = stack.back().first;
+                size_t& next_entry = stack.back().second;
+                if (next_entry == adjacency_start[here + 1]) {
+                    stack.pop_back();
+                    continue;
+                }
+                size_t edge = adjacency[next_entry];
+                next_entry++;
+                if (edge == parent_edge[here]) {
+                    continue;
+                }
+                size_t there = vertex_of_side[2 * edge] == here ? vertex_of_side[2 * edge + 1] : vertex_of_side[2 * edge];
+                if (preorder_number[there] == NONE) {
+                    parent_edge[there] = edge;
+                    parent_vertex[there] = here;
+                    visit(there);
+                } else if (preorder_number[there] < preorder_number[here]) {
+                    // A back edge, which closes a cycle from there down to
+                    // here. We will see it again from the top, and ignore it.
+                    size_t cycle = cycle_top.size();
+                    cycle_top.push_back(there);
+                    cycle_back_edge.push_back(edge);
+                    for (size_t member = here; member != there; member = parent_vertex[member]) {
+                        cycle_members.push_back(member);
+                        cycle_of_vertex[member] = cycle;
+                    }
+                    reverse(cycle_members.begin() + cycle_start.back(), cycle_members.end());
+                    for (size_t j = cycle_start.back(); j < cycle_members.size(); j++) {
+                        position_in_cycle[cycle_members[j]] = j - cycle_start.back();
+                    }
+                    cycle_start.push_back(cycle_members.size());
+                }
+            }
+        }
+    }
+    
+    // Index the cycles and bridges that hang down from each vertex
+    vector<size_t> child_cycle_start(vertex_count + 1, 0);
+    vector<size_t> child_cycles(cycle_top.size());
+    vector<size_t> child_bridge_start(vertex_count + 1, 0);
+    // Bridges are named by the vertex at their lower end
+    vector<size_t> child_bridges;
+    {
+        for (size_t top : cycle_top) {
+            child_cycle_start[top + 1]++;
+        }
+        for (size_t vertex : preorder) {
+            if (parent_vertex[vertex] != NONE && cycle_of_vertex[vertex] == NONE) {
+                child_bridge_start[parent_vertex[vertex] + 1]++;
+            }
+        }
+        for (size_t i = 0; i < vertex_count; i++) {
+            child_cycle_start[i + 1] += child_cycle_start[i];
+            child_bridge_start[i + 1] += child_bridge_start[i];
+        }
+        child_bridges.resize(child_bridge_start.back());
+        vector<size_t> filled(child_cycle_start.begin(), child_cycle_start.end() - 1);
+        for (size_t i = 0; i < cycle_top.size(); i++) {
+            child_cycles[filled[cycle_top[i]]++] = i;
+        }
+        filled.assign(child_bridge_start.begin(), child_bridge_start.end() - 1);
+        for (size_t vertex : preorder) {
+            if (parent_vertex[vertex] != NONE && cycle_of_vertex[vertex] == NONE) {
+                child_bridges[filled[parent_vertex[vertex]]++] = vertex;
+            }
+        }
+    }
+    
+    // A bridge that hangs below a chain of snarls continues the chain along
+    // whichever bridge below it leads to the longest chain. Find that bridge
+    // for the 2-edge-connected component hanging from each vertex, bottom up.
+    vector<size_t> best_bridge(vertex_count, NONE);
+    vector<size_t> best_depth(vertex_count, 0);
+    for (auto it = preorder.rbegin(); it != preorder.rend(); ++it) {
+        size_t vertex = *it;
+        for (size_t i = child_bridge_start[vertex]; i < child_bridge_start[vertex + 1]; i++) {
+            size_t bridge = child_bridges[i];
+            if (best_depth[bridge] + 1 > best_depth[vertex]) {
+                best_depth[vertex] = best_depth[bridge] + 1;
+                best_bridge[vertex] = bridge;
+            }
+        }
+        for (size_t i = child_cycle_start[vertex]; i < child_cycle_start[vertex + 1]; i++) {
+            size_t cycle = child_cycles[i];
+            for (size_t j = cycle_start[cycle]; j < cycle_start[cycle + 1]; j++) {
+                if (best_depth[cycle_members[j]] > best_depth[vertex]) {
+                    best_depth[vertex] = best_depth[cycle_members[j]];
+                    best_bridge[vertex] = best_bridge[cycle_members[j]];
+                }
+            }
+        }
+    }
+    
+    // Convert from sides (the interior endpoint of each node) to Visits
+    // (inward at start, outward at end)
+    auto start_visit = [&](size_t side) {
+        Visit visit;
+        visit.set_node_id(node_ids[side / 2]);
+        // Start is backward if the interior is not an end
+        visit.set_backward(!(side & 1));
+        return visit;
+    };
+    auto end_visit = [&](size_t side) {
+        Visit visit;
+        visit.set_node_id(node_ids[side / 2]);
+        // End is backward if the interior is an end
+        visit.set_backward(side & 1);
+        return visit;
+    };
+    
+    // Now we can emit snarls, children first, like CactusSnarlFinder does.
+    
+    // Emit the snarl at the given position in a cycle, between the cycle's
+    // two nodes at that vertex
+    function<const Snarl*(size_t, size_t, const Visit&, const Visit&)> emit_cycle_snarl;
+    // Emit the chains of snarls hanging below a vertex, except for the given
+    // cycle and bridge, into the given list of chains
+    function<void(size_t, size_t, size_t, const Visit&, const Visit&, vector<Chain>&)> emit_hanging_chains;
+    // Emit the snarl between two sides at vertices in the same
+    // 2-edge-connected component, where the first vertex is above the
+    // second, and the second side is on the given bridge or a telomere
+    function<const Snarl*(size_t, size_t, size_t, size_t, size_t, const Visit&, const Visit&)> emit_bridge_snarl;
+    
+    emit_cycle_snarl = [&](size_t cycle, size_t position, const Visit& parent_start, const Visit& parent_end) {
+        size_t vertex = cycle_members[cycle_start[cycle] + position];
+        size_t next_edge = (cycle_start[cycle] + position + 1 == cycle_start[cycle + 1] ?
+                            cycle_back_edge[cycle] :
+                            parent_edge[cycle_members[cycle_start[cycle] + position + 1]]);
+        Visit start = start_visit(side_at(parent_edge[vertex], vertex));
+        Visit end = end_visit(side_at(next_edge, vertex));
+        
+        vector<Chain> child_chains;
+        emit_hanging_chains(vertex, NONE, NONE, start, end, child_chains);
+        return emit_snarl(start, end, parent_start, parent_end, child_chains, graph, snarl_manager);
+    };
+    
+    emit_hanging_chains = [&](size_t vertex, size_t skip_cycle, size_t skip_bridge,
+                              const Visit& parent_start, const Visit& parent_end, vector<Chain>& chains) {
+        for (size_t i = child_cycle_start[vertex]; i < child_cycle_start[vertex + 1]; i++) {
+            size_t cycle = child_cycles[i];
+            if (cycle == skip_cycle) {
+                continue;
+            }
+            // Each other vertex around the cycle gets a snarl
+            chains.emplace_back();
+            for (size_t j = 0; j < cycle_start[cycle + 1] - cycle_start[cycle]; j++) {
+                const Snarl* snarl = emit_cycle_snarl(cycle, j, parent_start, parent_end);
+                chains.back().push_back(snarl);
+            }
+        }
+        for (size_t i = child_bridge_start[vertex]; i < child_bridge_start[vertex + 1]; i++) {
+            size_t bridge = child_bridges[i];
+            if (bridge == skip_bridge) {
+                continue;
+            }
+            // Follow bridges down for as long as we can, making a snarl
+            // between each pair. Whatever hangs below the last one is part of
+            // the parent snarl.
+            Chain chain;
+            while (best_bridge[bridge] != NONE) {
+                size_t next_bridge = best_bridge[bridge];
+                chain.push_back(emit_bridge_snarl(side_at(parent_edge[bridge], bridge), bridge,
+                                                  side_at(parent_edge[next_bridge], parent_vertex[next_bridge]),
+                                                  parent_vertex[next_bridge], next_bridge, parent_start, parent_end));
+                bridge = next_bridge;
+            }
+            if (!chain.empty()) {
+                chains.push_back(move(chain));
+            }
+            emit_hanging_chains(bridge, NONE, NONE, parent_start, parent_end, chains);
+        }
+    };
+    
+    emit_bridge_snarl = [&](size_t start_side, size_t top, size_t end_side, size_t bottom, size_t end_bridge,
+                            const Visit& parent_start, const Visit& parent_end) {
+        Visit start = start_visit(start_side);
+        Visit end = end_visit(end_side);
+        
+        // Walk up the cycles from the bottom to the top. Each is split into
+        // two chains of snarls on either side of the path, and everything else
+        // hangs off of the vertices on the path.
+        vector<Chain> child_chains;
+        size_t vertex = bottom;
+        emit_hanging_chains(vertex, NONE, end_bridge, start, end, child_chains);
+        while (vertex != top) {
+            size_t cycle = cycle_of_vertex[vertex];
+            assert(cycle != NONE);
+            size_t length = cycle_start[cycle + 1] - cycle_start[cycle];
+            for (auto& range : {make_pair((size_t) 0, position_in_cycle[vertex]),
+                                make_pair(position_in_cycle[vertex] + 1, length)}) {
+                if (range.first == range.second) {
+                    continue;
+                }
+                child_chains.emplace_back();
+                for (size_t j = range.first; j < range.second; j++) {
+                    const Snarl* snarl = emit_cycle_snarl(cycle, j, start, end);
+                    child_chains.back().push_back(snarl);
+                }
+            }
+            vertex = cycle_top[cycle];
+            emit_hanging_chains(vertex, cycle, NONE, start, end, child_chains);
+        }
+        
+        return emit_snarl(start, end, parent_start, parent_end, child_chains, graph, snarl_manager);
+    };
+    
+    for (auto& telomere_pair : telomeres) {
+        if (telomere_pair.first == NONE) {
+            continue;
+        }
+        // The top-level chain runs between the telomeres, with a snarl
+        // between each pair of bridges on the way
+        size_t root = vertex_of_side[telomere_pair.first];
+        size_t target = vertex_of_side[telomere_pair.second];
+        vector<size_t> bridges;
+        for (size_t vertex = target; vertex != root;) {
+            if (cycle_of_vertex[vertex] == NONE) {
+                // The telomeres are in one component, so the DFS from the
+                // root has to have reached the target
+                assert(parent_vertex[vertex] != NONE);
+                bridges.push_back(vertex);
+                vertex = parent_vertex[vertex];
+            } else {
+                vertex = cycle_top[cycle_of_vertex[vertex]];
+            }
+        }
+        
+        vector<Chain> top_chains(1);
+        size_t start_side = telomere_pair.first;
+        size_t top = root;
+        for (auto it = bridges.rbegin(); it != bridges.rend(); ++it) {
+            top_chains.back().push_back(emit_bridge_snarl(start_side, top, side_at(parent_edge[*it], parent_vertex[*it]),
+                                                          parent_vertex[*it], *it, Visit(), Visit()));
+            start_side = side_at(parent_edge[*it], *it);
+            top = *it;
+        }
+        top_chains.back().push_back(emit_bridge_snarl(start_side, top, telomere_pair.second, target, NONE,
+                                                      Visit(), Visit()));
+        
+        // Add it as a root chain
+        emit_snarl(Visit(), Visit(), Visit(), Visit(), top_chains, graph, snarl_manager);
+    }
+    
+    return snarl_manager;
+}
+
 bool start_backward(const Chain& chain) {
     // The start snarl is backward if it shares its start node with the second snarl.
     return (chain.size() > 1 &&
@@ -577,8 +1322,24 @@ SnarlManager::SnarlManager(istream& in) {
     // record the tree structure and build the other indexes
     build_indexes();
 }
+
+SnarlManager::SnarlManager(const shared_ptr<const SnarlIndex>& snarl_index) : snarl_index(snarl_index) {
+    // Snarls go in the master list in index order, so we can find them by
+    // number, but are left empty until something asks for them
+    size_t snarl_count = snarl_index->snarl_count();
+    snarls.resize(snarl_count);
+    snarl_filled.reset(new once_flag[snarl_count]);
+    children_filled.reset(new once_flag[snarl_count + 1]);
+    indexed_children.resize(snarl_count);
+    indexed_chains.resize(snarl_count);
+}
     
 const vector<const Snarl*>& SnarlManager::children_of(const Snarl* snarl) const {
+    if (snarl_index) {
+        size_t number = snarl == nullptr ? SnarlIndex::NONE : index_number(snarl);
+        fill_indexed_tree(number);
+        return number == SnarlIndex::NONE ? roots : indexed_children[number];
+    }
     if (snarl == nullptr) {
         // Looking for top level snarls
         return roots;
@@ -587,6 +1348,10 @@ const vector<const Snarl*>& SnarlManager::children_of(const Snarl* snarl) const
 }
     
 const Snarl* SnarlManager::parent_of(const Snarl* snarl) const {
+    if (snarl_index) {
+        size_t parent_number = snarl_index->parent_of(index_number(snarl));
+        return parent_number == SnarlIndex::NONE ? nullptr : indexed_snarl(parent_number);
+    }
     return parent.at(key_form(snarl));
 }
     
@@ -608,10 +1373,21 @@ const Snarl* SnarlManager::snarl_sharing_end(const Snarl* here) const {
 }
     
 const Chain* SnarlManager::chain_of(const Snarl* snarl) const {
+    if (snarl_index) {
+        // The chain is stored with the other chains under the snarl's parent
+        size_t number = index_number(snarl);
+        size_t parent_number = snarl_index->parent_of(number);
+        fill_indexed_tree(parent_number);
+        const deque<Chain>& siblings = parent_number == SnarlIndex::NONE ? root_chains : *indexed_chains[parent_number];
+        return &siblings[snarl_index->chain_of(number) - snarl_index->chains_of(parent_number).first];
+    }
     return parent_chain.at(key_form(snarl));
 }
     
 bool SnarlManager::in_nontrivial_chain(const Snarl* here) const {
+    if (snarl_index) {
+        return snarl_index->chain_size(snarl_index->chain_of(index_number(here))) > 1;
+    }
     return chain_of(here)->size() > 1;
 }
     
@@ -649,6 +1425,11 @@ Visit SnarlManager::prev_snarl(const Visit& here) const {
 }
     
 const deque<Chain>& SnarlManager::chains_of(const Snarl* snarl) const {
+    if (snarl_index) {
+        size_t number = snarl == nullptr ? SnarlIndex::NONE : index_number(snarl);
+        fill_indexed_tree(number);
+        return number == SnarlIndex::NONE ? root_chains : *indexed_chains[number];
+    }
     if (snarl == nullptr) {
         // We want the root chains
         return root_chains;
@@ -665,26 +1446,38 @@ NetGraph SnarlManager::net_graph_of(const Snarl* snarl, const HandleGraph* graph
 }
     
 bool SnarlManager::is_leaf(const Snarl* snarl) const {
+    if (snarl_index) {
+        // Every child is in a chain
+        auto range = snarl_index->chains_of(index_number(snarl));
+        return range.first == range.second;
+    }
     return children.at(key_form(snarl)).size() == 0;
 }
     
 bool SnarlManager::is_root(const Snarl* snarl) const {
+    if (snarl_index) {
+        return snarl_index->parent_of(index_number(snarl)) == SnarlIndex::NONE;
+    }
     return parent.at(key_form(snarl)) == nullptr;
 }
     
 const vector<const Snarl*>& SnarlManager::top_level_snarls() const {
+    if (snarl_index) {
+        fill_indexed_tree(SnarlIndex::NONE);
+    }
     return roots;
 }
     
 void SnarlManager::for_each_top_level_snarl_parallel(const function<void(const Snarl*)>& lambda) const {
+    const vector<const Snarl*>& top = top_level_snarls();
 #pragma omp parallel for
-    for (int i = 0; i < roots.size(); i++) {
-        lambda(roots[i]);
+    for (int i = 0; i < top.size(); i++) {
+        lambda(top[i]);
     }
 }
     
 void SnarlManager::for_each_top_level_snarl(const function<void(const Snarl*)>& lambda) const {
-    for (const Snarl* snarl : roots) {
+    for (const Snarl* snarl : top_level_snarls()) {
         lambda(snarl);
     }
 }
@@ -723,6 +1516,8 @@ void SnarlManager::for_each_snarl_parallel(const function<void(const Snarl*)>& l
 }
     
 void SnarlManager::flip(const Snarl* snarl) {
+    // The index only knows the snarl the way around it was saved
+    drop_snarl_index();
         
     // save the key used in the indices before editing the snarl
     auto old_key = key_form(snarl);
@@ -765,6 +1560,9 @@ void SnarlManager::flip(const Snarl* snarl) {
 }
     
 const Snarl* SnarlManager::add_snarl(const Snarl& new_snarl) {
+    // The index can't find the new snarl
+    drop_snarl_index();
+    
     // Store the snarl
     snarls.push_back(new_snarl);
     Snarl* snarl = &snarls.back();
@@ -793,6 +1591,9 @@ const Snarl* SnarlManager::add_snarl(const Snarl& new_snarl) {
 }
     
 void SnarlManager::add_chain(const Chain& new_chain, const Snarl* chain_parent) {
+    // The index can't hold the new chain
+    drop_snarl_index();
+    
     if (chain_parent == nullptr) {
         // This is a root chain
             
@@ -854,7 +1655,43 @@ void SnarlManager::add_chain(const Chain& new_chain, const Snarl* chain_parent)
 #endif
 }
     
+void SnarlManager::extend(SnarlManager&& other) {
+    if (snarls.empty()) {
+        // We can just take everything, since moving the deques keeps the snarls where they are
+        *this = std::move(other);
+        other = SnarlManager();
+        return;
+    }
+        
+    // Otherwise copy each snarl tree over, adding each snarl before the chains it parents
+    function<const Snarl*(const Snarl*)> copy_tree = [&](const Snarl* snarl) {
+        const Snarl* copied = add_snarl(*snarl);
+        for (const Chain& chain : other.chains_of(snarl)) {
+            Chain copied_chain;
+            for (const Snarl* child : chain) {
+                copied_chain.push_back(copy_tree(child));
+            }
+            add_chain(copied_chain, copied);
+        }
+        return copied;
+    };
+        
+    for (const Chain& chain : other.chains_of(nullptr)) {
+        Chain copied_chain;
+        for (const Snarl* root : chain) {
+            copied_chain.push_back(copy_tree(root));
+        }
+        add_chain(copied_chain, nullptr);
+    }
+        
+    other = SnarlManager();
+}
+    
 const Snarl* SnarlManager::into_which_snarl(int64_t id, bool reverse) const {
+    if (snarl_index) {
+        size_t number = snarl_index->into_which_snarl(id, reverse);
+        return number == SnarlIndex::NONE ? nullptr : indexed_snarl(number);
+    }
     return snarl_into.count(make_pair(id, reverse)) ? snarl_into.at(make_pair(id, reverse)) : nullptr;
 }
     
@@ -863,6 +1700,7 @@ const Snarl* SnarlManager::into_which_snarl(const Visit& visit) const {
 }
     
 unordered_map<pair<int64_t, bool>, const Snarl*> SnarlManager::snarl_boundary_index() const {
+    fill_indexed_snarls();
     unordered_map<pair<int64_t, bool>, const Snarl*> index;
     for (const Snarl& snarl : snarls) {
         index[make_pair(snarl.start().node_id(), snarl.start().backward())] = &snarl;
@@ -872,6 +1710,7 @@ unordered_map<pair<int64_t, bool>, const Snarl*> SnarlManager::snarl_boundary_in
 }
     
 unordered_map<pair<int64_t, bool>, const Snarl*> SnarlManager::snarl_end_index() const {
+    fill_indexed_snarls();
     unordered_map<pair<int64_t, bool>, const Snarl*> index;
     for (const Snarl& snarl : snarls) {
         index[make_pair(snarl.end().node_id(), !snarl.end().backward())] = &snarl;
@@ -880,6 +1719,7 @@ unordered_map<pair<int64_t, bool>, const Snarl*> SnarlManager::snarl_end_index()
 }
     
 unordered_map<pair<int64_t, bool>, const Snarl*> SnarlManager::snarl_start_index() const {
+    fill_indexed_snarls();
     unordered_map<pair<int64_t, bool>, const Snarl*> index;
     for (const Snarl& snarl : snarls) {
         index[make_pair(snarl.start().node_id(), snarl.start().backward())] = &snarl;
@@ -894,6 +1734,91 @@ inline SnarlManager::key_t SnarlManager::key_form(const Snarl* snarl) const {
 }
     
 
+size_t SnarlManager::index_number(const Snarl* snarl) const {
+    // A snarl's start reads into it, and the index was saved with the snarls the same way around
+    return snarl_index->into_which_snarl(snarl->start().node_id(), snarl->start().backward());
+}
+    
+Snarl* SnarlManager::indexed_snarl(size_t number) const {
+    call_once(snarl_filled[number], [&]() {
+        snarls[number] = snarl_index->get_snarl(number);
+    });
+    return &snarls[number];
+}
+    
+void SnarlManager::fill_indexed_tree(size_t number) const {
+    bool is_root = (number == SnarlIndex::NONE);
+    call_once(children_filled[is_root ? snarls.size() : number], [&]() {
+        // The chains are stored already, so we don't have to walk them
+        deque<Chain> chains;
+        vector<const Snarl*> snarl_children;
+        auto range = snarl_index->chains_of(number);
+        for (size_t chain_number = range.first; chain_number < range.second; chain_number++) {
+            chains.emplace_back();
+            for (size_t i = 0; i < snarl_index->chain_size(chain_number); i++) {
+                const Snarl* child = indexed_snarl(snarl_index->chain_member(chain_number, i));
+                chains.back().push_back(child);
+                snarl_children.push_back(child);
+            }
+        }
+        if (is_root) {
+            root_chains = std::move(chains);
+            roots = std::move(snarl_children);
+        } else {
+            indexed_chains[number].reset(new deque<Chain>(std::move(chains)));
+            indexed_children[number] = std::move(snarl_children);
+        }
+    });
+}
+    
+void SnarlManager::fill_indexed_snarls() const {
+    if (!snarl_index) {
+        return;
+    }
+    for (size_t i = 0; i < snarls.size(); i++) {
+        indexed_snarl(i);
+    }
+}
+
+void SnarlManager::drop_snarl_index() {
+    if (!snarl_index) {
+        return;
+    }
+    
+    fill_indexed_tree(SnarlIndex::NONE);
+    for (size_t i = 0; i < snarls.size(); i++) {
+        Snarl* snarl = indexed_snarl(i);
+        fill_indexed_tree(i);
+        
+        self[key_form(snarl)] = snarl;
+        size_t parent_number = snarl_index->parent_of(i);
+        parent[key_form(snarl)] = parent_number == SnarlIndex::NONE ? nullptr : &snarls[parent_number];
+        snarl_into[make_pair(snarl->start().node_id(), snarl->start().backward())] = snarl;
+        snarl_into[make_pair(snarl->end().node_id(), !snarl->end().backward())] = snarl;
+        
+        // Copy rather than move the children and chains, so that references
+        // already handed out stay good until we are destroyed
+        children[key_form(snarl)] = indexed_children[i];
+        child_chains[key_form(snarl)] = *indexed_chains[i];
+    }
+    
+    // The root chains stay where they are, but the child chains were copied
+    for (auto& chain : root_chains) {
+        for (const Snarl* snarl : chain) {
+            parent_chain[key_form(snarl)] = &chain;
+        }
+    }
+    for (auto& kv : child_chains) {
+        for (auto& chain : kv.second) {
+            for (const Snarl* snarl : chain) {
+                parent_chain[key_form(snarl)] = &chain;
+            }
+        }
+    }
+    
+    snarl_index.reset();
+}
+
 void SnarlManager::build_indexes() {
         
 #ifdef debug
@@ -1325,6 +2250,18 @@ const Snarl* SnarlManager::manage(const Snarl& not_owned) const {
     // efficient. We could also have a map<Snarl, Snarl*> but that would be
     // a tremendous waste of space.
         
+    if (snarl_index) {
+        // Look the snarl up by its start, and make sure it ends in the same place
+        size_t number = index_number(&not_owned);
+        if (number != SnarlIndex::NONE) {
+            const Snarl* owned = indexed_snarl(number);
+            if (key_form(owned) == key_form(&not_owned)) {
+                return owned;
+            }
+        }
+        throw runtime_error("Unable to find snarl " +  pb2json(not_owned) + " in SnarlManager");
+    }
+        
     // Work out the key for the snarl
     key_t key = key_form(&not_owned);
         
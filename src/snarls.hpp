@@ -14,6 +14,9 @@
 #include <unordered_set>
 #include <fstream>
 #include <deque>
+#include <memory>
+#include <mutex>
+#include <tuple>
 #include "stream.hpp"
 #include "vg.hpp"
 #include "handle.hpp"
@@ -26,6 +29,7 @@ using namespace std;
 namespace vg {
 
 class SnarlManager;
+class SnarlIndex;
 
 /**
  * Represents a strategy for finding (nested) sites in a vg graph that can be described
@@ -41,6 +45,20 @@ public:
      * operations.
      */
     virtual SnarlManager find_snarls() = 0;
+    
+protected:
+    
+    /// Work out the connectivity and type of the snarl with the given start
+    /// and end in the given graph, add it to the given SnarlManager with the
+    /// given parent, and then add the given chains of its children, which must
+    /// already be in the SnarlManager, under it. Returns a pointer to the
+    /// finished snarl in the SnarlManager. Start and end may be empty visits,
+    /// in which case no snarl is created, all the child chains are added as
+    /// root chains, and null is returned. If parent_start and parent_end are
+    /// empty Visits, no parent() is added to the produced snarl.
+    static const Snarl* emit_snarl(const Visit& start, const Visit& end,
+        const Visit& parent_start, const Visit& parent_end,
+        vector<vector<const Snarl*>>& child_chains, const HandleGraph* graph, SnarlManager& destination);
 };
 
 /**
@@ -67,6 +85,10 @@ class CactusSnarlFinder : public SnarlFinder {
         const Visit& parent_start, const Visit& parent_end,
         stList* chains_list, stList* unary_snarls_list, SnarlManager& destination);
     
+    /// Find all the snarls in the whole graph with a single Cactus
+    /// decomposition, and put them into a SnarlManager.
+    SnarlManager decompose();
+    
 public:
     /**
      * Make a new CactusSnarlFinder to find snarls in the given graph.
@@ -84,9 +106,65 @@ public:
     
     /**
      * Find all the snarls with Cactus, and put them into a SnarlManager.
+     * Each weakly connected component is decomposed separately, in parallel,
+     * and their snarls are merged in order of the components' lowest node
+     * IDs.
      */
     virtual SnarlManager find_snarls();
     
+    /**
+     * Find the snarls in each weakly connected component of the graph
+     * separately and in parallel, and pass each component's SnarlManager to
+     * the given function as soon as it and all the components before it are
+     * done. Components come in order of their lowest node IDs, and the
+     * function is only ever running on one thread at a time.
+     */
+    void for_each_component_snarls(const function<void(SnarlManager&)>& lambda);
+    
+};
+
+/**
+ * Class for finding all snarls directly in any HandleGraph, without copying it
+ * into a Cactus graph. Node sides joined by edges are merged into vertices,
+ * with the nodes as edges between them, and that multigraph is reduced to its
+ * 3-edge-connected components to get the cactus graph. The snarls and chains
+ * are then read off of its cycles and bridges.
+ *
+ * Telomeres are picked the same way CactusSnarlFinder picks them, so the
+ * top-level snarls and chains are the same, but no unary snarls are made for
+ * dead ends below the top level, and single-node connected components are
+ * skipped instead of rejected. Everything but picking telomeres between tips
+ * that aren't on a path takes time linear in the size of the graph.
+ */
+class HandleGraphSnarlFinder : public SnarlFinder {
+    
+    /// Holds the graph we are looking for sites in.
+    const HandleGraph* graph;
+    
+    /// Holds the inward-facing start and end handles, and the length in
+    /// bases, of each path we can base the decomposition on
+    vector<tuple<handle_t, handle_t, size_t>> path_ends;
+    
+public:
+    /**
+     * Make a new HandleGraphSnarlFinder to find snarls in the given graph.
+     * Optionally takes paths, as oriented node visits, to base the
+     * decomposition on. As with a VG's paths in CactusSnarlFinder, the
+     * longest one that starts and ends at tips is used in each component.
+     */
+    HandleGraphSnarlFinder(const HandleGraph* graph, const vector<vector<handle_t>>& paths = {});
+    
+    /**
+     * Make a new HandleGraphSnarlFinder to find snarls in the given VG,
+     * basing the decomposition on its paths.
+     */
+    HandleGraphSnarlFinder(VG& graph);
+    
+    /**
+     * Find all the snarls, and put them into a SnarlManager. Weakly connected
+     * components come in order of their lowest node IDs.
+     */
+    virtual SnarlManager find_snarls();
 };
 
 /**
@@ -389,6 +467,13 @@ public:
         
     /// Construct a SnarlManager for the snarls contained in an input stream
     SnarlManager(istream& in);
+    
+    /// Construct a SnarlManager for the snarls and chains in a SnarlIndex.
+    /// The index answers tree and boundary queries in place of the hash
+    /// tables, and each snarl and each snarl's children and chains are only
+    /// filled in the first time they are asked for. Adding or flipping
+    /// snarls fills in everything and stops using the index.
+    SnarlManager(const shared_ptr<const SnarlIndex>& snarl_index);
         
     /// Default constructor
     SnarlManager() = default;
@@ -472,6 +557,10 @@ public:
     /// added.
     void add_chain(const Chain& new_chain, const Snarl* chain_parent);
         
+    /// Add all the snarl trees from another SnarlManager, with their chains,
+    /// after the ones already here. The other SnarlManager is left empty.
+    void extend(SnarlManager&& other);
+        
     /// Returns the Nodes and Edges contained in this Snarl but not in any child Snarls (always includes the
     /// Nodes that form the boundaries of child Snarls, optionally includes this Snarl's own boundary Nodes)
     pair<unordered_set<Node*>, unordered_set<Edge*> > shallow_contents(const Snarl* snarl, VG& graph,
@@ -524,12 +613,13 @@ private:
         
     /// Master list of the snarls in the graph.
     /// Use a deque so pointers never get invalidated but we still have some locality.
-    deque<Snarl> snarls;
+    /// Mutable because snarls from a SnarlIndex are filled in when first asked for.
+    mutable deque<Snarl> snarls;
         
     /// Roots of snarl trees
-    vector<const Snarl*> roots;
+    mutable vector<const Snarl*> roots;
     /// Chains of root-level snarls. Uses a deque so Chain* pointers don't get invalidated.
-    deque<Chain> root_chains;
+    mutable deque<Chain> root_chains;
         
     /// Map of snarls to the child snarls they contain
     unordered_map<key_t, vector<const Snarl*>> children;
@@ -547,12 +637,45 @@ private:
         
     /// Map of node traversals to the snarls they point into
     unordered_map<pair<int64_t, bool>, const Snarl*> snarl_into;
+    
+    /// Index the snarls were loaded from, in the same order, which stands
+    /// in for all of the maps above while it is set
+    shared_ptr<const SnarlIndex> snarl_index;
+    
+    /// While there is an index, whether each snarl has been filled in from
+    /// it, and whether each snarl's children and chains have been, with one
+    /// more flag at the end for the roots and root chains
+    mutable unique_ptr<once_flag[]> snarl_filled;
+    mutable unique_ptr<once_flag[]> children_filled;
+    
+    /// The children and child chains of each snarl, by number in the index
+    mutable vector<vector<const Snarl*>> indexed_children;
+    mutable vector<unique_ptr<deque<Chain>>> indexed_chains;
         
     /// Converts Snarl to the form used as keys in internal data structures
     inline key_t key_form(const Snarl* snarl) const;
         
     /// Builds tree indexes after Snarls have been added to the snarls vector
     void build_indexes();
+    
+    /// Get the number in the index of a snarl that came from it
+    size_t index_number(const Snarl* snarl) const;
+    
+    /// Get the snarl with the given number in the index, filling it in if
+    /// it hasn't been yet. Safe to call from multiple threads.
+    Snarl* indexed_snarl(size_t number) const;
+    
+    /// Fill in the children and chains of the snarl with the given number in
+    /// the index, or the roots and root chains for SnarlIndex::NONE, if they
+    /// haven't been yet. Safe to call from multiple threads.
+    void fill_indexed_tree(size_t number) const;
+    
+    /// Fill in every snarl from the index, if there is one
+    void fill_indexed_snarls() const;
+    
+    /// Fill in all the maps and stop using the SnarlIndex, if there is one,
+    /// so that the snarls can be changed or added to
+    void drop_snarl_index();
         
     /// Actually compute chains for a set of already indexed snarls, which
     /// is important when chains were not provided. Returns the chains.
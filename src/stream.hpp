@@ -5,12 +5,15 @@
 // from http://www.mail-archive.com/protobuf@googlegroups.com/msg03417.html
 
 #include <cassert>
+#include <exception>
 #include <iostream>
 #include <istream>
 #include <fstream>
 #include <functional>
 #include <vector>
 #include <list>
+#include <string>
+#include <utility>
 #include "google/protobuf/stubs/common.h"
 #include "google/protobuf/io/zero_copy_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
@@ -92,17 +95,112 @@ bool write(std::ostream& out, uint64_t element_count, uint64_t chunk_elements,
             }
         }
     }
-    
-    
 
+    return true;
+}
+
+/// Write objects using adaptive chunking, like write(), but build and
+/// serialize up to batch_chunks chunks at a time on worker threads. The lambda
+/// must be safe to call from several threads at once. Chunks are still written
+/// in element order. Chunk sizes adapt between batches, and a batch is cut
+/// short and redone with smaller chunks if any of its chunks is too large.
+template <typename T>
+bool write_parallel(std::ostream& out, uint64_t element_count, uint64_t chunk_elements,
+    const std::function<T(uint64_t, uint64_t)>& lambda, size_t batch_chunks) {
+
+    // How many elements have we serialized so far
+    size_t serialized = 0;
+    chunk_elements = std::max<uint64_t>(chunk_elements, 1);
+    batch_chunks = std::max<size_t>(batch_chunks, 1);
+
+    ::google::protobuf::io::OstreamOutputStream raw_out(&out);
+    ::google::protobuf::io::GzipOutputStream gzip_out(&raw_out);
+    ::google::protobuf::io::CodedOutputStream coded_out(&gzip_out);
+
+    auto handle = [](bool ok) {
+        if (!ok) throw std::runtime_error("stream::write_parallel: I/O error writing protobuf");
+    };
+
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    std::vector<std::string> chunk_data;
+    while (serialized < element_count) {
+
+        // Plan a batch of chunks of the current size
+        ranges.clear();
+        for (uint64_t start = serialized; start < element_count && ranges.size() < batch_chunks; start += chunk_elements) {
+            ranges.emplace_back(start, std::min(chunk_elements, element_count - start));
+        }
+
+        // Serialize them all at once
+        size_t chunk_count = ranges.size();
+        chunk_data.clear();
+        chunk_data.resize(chunk_count);
+        std::exception_ptr failure;
+#pragma omp parallel for schedule(dynamic, 1) default(none) shared(ranges, chunk_data, chunk_count, lambda, failure)
+        for (size_t i = 0; i < chunk_count; i++) {
+            try {
+                if (!lambda(ranges[i].first, ranges[i].second).SerializeToString(&chunk_data[i])) {
+                    throw std::runtime_error("stream::write_parallel: I/O error writing protobuf");
+                }
+            } catch (...) {
+#pragma omp critical (stream_write_parallel)
+                failure = std::current_exception();
+            }
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+
+        // Then send them in order
+        for (size_t i = 0; i < chunk_count; i++) {
+            uint64_t length = ranges[i].second;
+            if (chunk_data[i].size() > MAX_PROTOBUF_SIZE) {
+                // This is too big!
+                if (length > 1) {
+                    // But we can make it smaller. Redo the rest of the batch at half this size.
+                    chunk_elements = length / 2;
+                    break;
+                } else {
+                    // This single element is too large
+                    throw std::runtime_error("stream::write_parallel: message for element " +
+                        std::to_string(serialized) + " too large error writing protobuf");
+                }
+            }
+
+            // Say we have a group of a single message
+            coded_out.WriteVarint64(1);
+            handle(!coded_out.HadError());
+            // and prefix each object with its size
+            coded_out.WriteVarint32(chunk_data[i].size());
+            handle(!coded_out.HadError());
+            coded_out.WriteRaw(chunk_data[i].data(), chunk_data[i].size());
+            handle(!coded_out.HadError());
+
+            // Remember how far we've serialized now
+            serialized += length;
+
+            chunk_elements = length;
+            if (chunk_data[i].size() < TARGET_PROTOBUF_SIZE/2) {
+                // We were less than half the target size, so try being twice as
+                // big next time.
+                chunk_elements *= 2;
+            } else if (chunk_data[i].size() > TARGET_PROTOBUF_SIZE && length > 1) {
+                // We were larger than the target size and we can be smaller
+                chunk_elements /= 2;
+            }
+        }
+    }
+
+    return true;
 }
 
 // write objects
 // count should be equal to the number of objects to write
 // count is written before the objects, but if it is 0, it is not written
 // if not all objects are written, return false, otherwise true
-template <typename T>
-bool write(std::ostream& out, uint64_t count, const std::function<T(uint64_t)>& lambda) {
+// get_object may return the objects by value or by const reference
+template <typename T, typename Getter>
+bool write_objects(std::ostream& out, uint64_t count, const Getter& get_object) {
 
     // Make all our streams on the stack, in case of error.
     ::google::protobuf::io::OstreamOutputStream raw_out(&out);
@@ -124,7 +222,8 @@ bool write(std::ostream& out, uint64_t count, const std::function<T(uint64_t)>&
     std::string s;
     uint64_t written = 0;
     for (uint64_t n = 0; n < count; ++n, ++written) {
-        handle(lambda(n).SerializeToString(&s));
+        const T& object = get_object(n);
+        handle(object.SerializeToString(&s));
         if (s.size() > MAX_PROTOBUF_SIZE) {
             throw std::runtime_error("stream::write: message too large error writing protobuf");
         }
@@ -138,13 +237,19 @@ bool write(std::ostream& out, uint64_t count, const std::function<T(uint64_t)>&
     return !count || written == count;
 }
 
+template <typename T>
+bool write(std::ostream& out, uint64_t count, const std::function<T(uint64_t)>& lambda) {
+    return write_objects<T>(out, count, lambda);
+}
+
 template <typename T>
 bool write_buffered(std::ostream& out, std::vector<T>& buffer, uint64_t buffer_limit) {
     bool wrote = false;
     if (buffer.size() >= buffer_limit) {
-        std::function<T(uint64_t)> lambda = [&buffer](uint64_t n) { return buffer.at(n); };
+        // serialize straight out of the buffer instead of copying each object
+        auto lambda = [&buffer](uint64_t n) -> const T& { return buffer.at(n); };
 #pragma omp critical (stream_out)
-        wrote = write(out, buffer.size(), lambda);
+        wrote = write_objects<T>(out, buffer.size(), lambda);
         buffer.clear();
     }
     return wrote;
@@ -155,11 +260,10 @@ bool write_buffered(std::ostream& out, std::vector<T>& buffer, uint64_t buffer_l
 // takes a callback function to be called on the objects, and another to be called per object group.
 
 template <typename T>
-void for_each(std::istream& in,
+void for_each(::google::protobuf::io::ZeroCopyInputStream& raw_in,
               const std::function<void(T&)>& lambda,
               const std::function<void(uint64_t)>& handle_count) {
 
-    ::google::protobuf::io::IstreamInputStream raw_in(&in);
     ::google::protobuf::io::GzipInputStream gzip_in(&raw_in);
     ::google::protobuf::io::CodedInputStream coded_in(&gzip_in);
 
@@ -204,8 +308,14 @@ void for_each(std::istream& in,
         }
     }
 }
-    
-    
+
+template <typename T>
+void for_each(std::istream& in,
+              const std::function<void(T&)>& lambda,
+              const std::function<void(uint64_t)>& handle_count) {
+    ::google::protobuf::io::IstreamInputStream raw_in(&in);
+    for_each(raw_in, lambda, handle_count);
+}
 
 template <typename T>
 void for_each(std::istream& in,
@@ -214,6 +324,23 @@ void for_each(std::istream& in,
     for_each(in, lambda, noop);
 }
 
+/// Like for_each(), but stop after reading byte_limit bytes of the
+/// compressed input, which must end on a chunk boundary. Use this to read a
+/// range of chunks from a seekable stream without buffering them. Throws if
+/// the input ends before byte_limit bytes.
+template <typename T>
+void for_each_limited(std::istream& in, int64_t byte_limit,
+                      const std::function<void(T&)>& lambda) {
+    ::google::protobuf::io::IstreamInputStream raw_in(&in);
+    ::google::protobuf::io::LimitingInputStream limited_in(&raw_in, byte_limit);
+    std::function<void(uint64_t)> noop = [](uint64_t) { };
+    for_each(limited_in, lambda, noop);
+    if (limited_in.ByteCount() < byte_limit) {
+        throw std::runtime_error("[stream::for_each] input ended " + std::to_string(byte_limit - limited_in.ByteCount()) +
+                                 " bytes before the end of the requested range");
+    }
+}
+
 // Parallelized versions of for_each
 
 // First, an internal implementation underlying several variants below.
@@ -395,6 +522,143 @@ void for_each_parallel(std::istream& in,
     for_each_parallel(in, lambda, noop);
 }
 
+
+/// Deserialize the input stream in order, but parse the objects on worker
+/// threads. The objects are handed to the lambda on the calling thread, in
+/// stream order, in batches of up to batch_size objects or about batch_bytes
+/// of serialized data. While one batch is in the lambda, the next one is being
+/// parsed, and the one after that is being read. Use this when the objects
+/// have to be consumed in order but parsing them is expensive, as it is for
+/// large Graph chunks.
+template <typename T>
+void for_each_batch_parallel(std::istream& in,
+                             const std::function<void(std::vector<T>&)>& lambda,
+                             const std::function<void(uint64_t)>& handle_count,
+                             size_t batch_size = 256,
+                             size_t batch_bytes = MAX_PROTOBUF_SIZE * 4) {
+
+    std::exception_ptr failure;
+
+    #pragma omp parallel default(none) shared(in, lambda, handle_count, batch_size, batch_bytes, failure)
+    #pragma omp single
+    {
+        ::google::protobuf::io::IstreamInputStream raw_in(&in);
+        ::google::protobuf::io::GzipInputStream gzip_in(&raw_in);
+        ::google::protobuf::io::CodedInputStream coded_in(&gzip_in);
+
+        auto handle = [](bool ok) {
+            if (!ok) {
+                throw std::runtime_error("[stream::for_each_batch_parallel] obsolete, invalid, or corrupt protobuf input");
+            }
+        };
+
+        // Objects left to read in the current group
+        uint64_t remaining = 0;
+
+        // Read the next batch of serialized objects, and return false if there are none
+        auto read_batch = [&](std::vector<std::string>& batch) {
+            batch.clear();
+            size_t bytes = 0;
+            while (batch.size() < batch_size && bytes < batch_bytes) {
+                if (remaining == 0) {
+                    // this loop handles a chunked file with many pieces
+                    // such as we might write in a multithreaded process
+                    if (!coded_in.ReadVarint64((::google::protobuf::uint64*) &remaining)) {
+                        break;
+                    }
+                    handle_count(remaining);
+                    continue;
+                }
+                remaining--;
+
+                // Reconstruct the CodedInputStream in place to reset its maximum-
+                // bytes-ever-read counter, because it thinks it's reading a single
+                // message.
+                coded_in.~CodedInputStream();
+                new (&coded_in) ::google::protobuf::io::CodedInputStream(&gzip_in);
+                // Alot space for size, and for reading next chunk's length
+                coded_in.SetTotalBytesLimit(MAX_PROTOBUF_SIZE * 2, MAX_PROTOBUF_SIZE * 2);
+
+                // the messages are prefixed by their size
+                uint32_t msgSize = 0;
+                handle(coded_in.ReadVarint32(&msgSize));
+
+                if (msgSize > MAX_PROTOBUF_SIZE) {
+                    throw std::runtime_error("[stream::for_each_batch_parallel] protobuf message of " +
+                        std::to_string(msgSize) + " bytes is too long");
+                }
+
+                if (msgSize) {
+                    batch.emplace_back();
+                    handle(coded_in.ReadString(&batch.back(), msgSize));
+                    bytes += msgSize;
+                }
+            }
+            return !batch.empty();
+        };
+
+        // Two sets of buffers: one for the batch being parsed and one for the
+        // batch being read or consumed
+        std::vector<std::string> raw[2];
+        std::vector<T> parsed[2];
+        bool have_previous = false;
+
+        try {
+            for (size_t current = 0; ; current = 1 - current) {
+                // Read a batch while the previous one is parsed
+                bool have_current = read_batch(raw[current]);
+
+                #pragma omp taskwait
+                if (failure) {
+                    break;
+                }
+
+                if (have_current) {
+                    parsed[current].clear();
+                    parsed[current].resize(raw[current].size());
+                    for (size_t i = 0; i < raw[current].size(); i++) {
+                        #pragma omp task default(none) firstprivate(current, i) shared(raw, parsed, failure)
+                        {
+                            if (!parsed[current][i].ParseFromString(raw[current][i])) {
+                                #pragma omp critical (stream_for_each_batch_parallel)
+                                failure = std::make_exception_ptr(std::runtime_error(
+                                    "[stream::for_each_batch_parallel] obsolete, invalid, or corrupt protobuf input"));
+                            }
+                            // Don't hold on to the serialized copy
+                            std::string().swap(raw[current][i]);
+                        }
+                    }
+                }
+
+                // Consume the previous batch while this one is parsed
+                if (have_previous) {
+                    lambda(parsed[1 - current]);
+                    parsed[1 - current].clear();
+                }
+
+                if (!have_current) {
+                    break;
+                }
+                have_previous = true;
+            }
+        } catch (...) {
+            // Let the parsing finish before the buffers go away
+            #pragma omp taskwait
+            failure = std::current_exception();
+        }
+    }
+
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+template <typename T>
+void for_each_batch_parallel(std::istream& in,
+                             const std::function<void(std::vector<T>&)>& lambda) {
+    std::function<void(uint64_t)> noop = [](uint64_t) { };
+    for_each_batch_parallel(in, lambda, noop);
+}
     
 /*
  * Refactored stream::for_each function that follows the unidirectional iterator interface
@@ -484,6 +748,12 @@ public:
         return value;
     }
     
+    /// Move the current value out of the iterator. It is left empty until
+    /// get_next() is called.
+    inline T take() {
+        return std::move(value);
+    }
+    
 private:
     
     T value;
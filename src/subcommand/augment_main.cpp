@@ -33,12 +33,14 @@ using namespace vg;
 using namespace vg::subcommand;
 
 // this used to be pileup_main()
-static Pileups* compute_pileups(VG* graph, const string& gam_file_name, int thread_count, int min_quality,
-                                int max_mismatches, int window_size, int max_depth, bool use_mapq,
-                                bool show_progress);
-
-// this used to be the first half of call_main()
-static void augment_with_pileups(PileupAugmenter& augmenter, Pileups& pileups, bool expect_subgraph,
+static ShardedPileups* compute_pileups(VG* graph, const string& gam_file_name, int thread_count,
+                                       size_t max_pileup_mb, int min_quality, int max_mismatches,
+                                       int window_size, int max_depth, bool use_mapq, bool show_progress);
+
+// this used to be the first half of call_main().  writes the pileups to
+// pileup_file_name if not empty, and augments the graph if augmenter isn't null.
+static void augment_with_pileups(PileupAugmenter* augmenter, ShardedPileups& pileups,
+                                 const string& pileup_file_name, bool expect_subgraph,
                                  bool show_progress);
 
 // the pileup augmenter assumes even trivial from/to lengths set for each mappings
@@ -66,7 +68,8 @@ void help_augment(char** argv, ConfigurableParser& parser) {
          << "    -q, --min-quality N         ignore bases with PHRED quality < N (default=10)" << endl
          << "    -m, --max-mismatches N      ignore bases with > N mismatches within window centered on read (default=1)" << endl
          << "    -w, --window-size N         size of window to apply -m option (default=0)" << endl
-         << "    -M, --ignore-mapq           do not combine mapping qualities with base qualities in pileup" << endl;
+         << "    -M, --ignore-mapq           do not combine mapping qualities with base qualities in pileup" << endl
+         << "    -B, --pileup-memory N       spill pileups to temporary files beyond about N MB [unlimited]" << endl;
     
      // Then report more options
      parser.print_help(cerr);
@@ -124,6 +127,9 @@ int main_augment(int argc, char** argv) {
     // If false, only PHRED base quality will be used. 
     bool use_mapq = true;
 
+    // Spill pileups to disk when they take more than this many MB (0 for never)
+    size_t max_pileup_mb = 0;
+
 
     static const struct option long_options[] = {
         // General Options
@@ -141,11 +147,12 @@ int main_augment(int argc, char** argv) {
         {"max-mismatches", required_argument, 0, 'm'},
         {"window-size", required_argument, 0, 'w'},
         {"ignore-mapq", no_argument, 0, 'M'},
+        {"pileup-memory", required_argument, 0, 'B'},
         {"min-aug-support", required_argument, 0, 'g'},
         {"subgraph", no_argument, 0, 'U'},
         {0, 0, 0, 0}
     };
-    static const char* short_options = "a:Z:A:hpvt:P:S:q:m:w:Mg:U";
+    static const char* short_options = "a:Z:A:hpvt:P:S:q:m:w:MB:g:U";
     optind = 2; // force optind past command positional arguments
 
     // This is our command-line parser
@@ -198,6 +205,9 @@ int main_augment(int argc, char** argv) {
         case 'M':
             use_mapq = false;
             break;            
+        case 'B':
+            max_pileup_mb = atoll(optarg);
+            break;
         case 'g':
             min_aug_support = atoi(optarg);
             break;            
@@ -257,27 +267,14 @@ int main_augment(int argc, char** argv) {
     });
     
     
-    Pileups* pileups = nullptr;
+    ShardedPileups* pileups = nullptr;
     
     if (!pileup_file_name.empty() || augmentation_mode == "pileup") {
         // We will need the computed pileups
         
         // compute the pileups from the graph and gam
-        pileups = compute_pileups(graph, gam_in_file_name, thread_count, min_quality, max_mismatches,
-                                  window_size, max_depth, use_mapq, show_progress);
-    }
-        
-    if (!pileup_file_name.empty()) {
-        // We want to write out pileups.
-        if (show_progress) {
-            cerr << "Writing pileups" << endl;
-        }
-        ofstream pileup_file(pileup_file_name);
-        if (!pileup_file) {
-            cerr << "[vg augment] error: unable to open output pileup file: " << pileup_file_name << endl;
-            exit(1);
-        }
-        pileups->write(pileup_file);
+        pileups = compute_pileups(graph, gam_in_file_name, thread_count, max_pileup_mb, min_quality,
+                                  max_mismatches, window_size, max_depth, use_mapq, show_progress);
     }
 
     if (augmentation_mode == "direct") {
@@ -288,8 +285,9 @@ int main_augment(int argc, char** argv) {
             exit(1);
         }
         
-        // We don't need any pileups
+        // We don't need any pileups, except to write them out
         if (pileups != nullptr) {
+            augment_with_pileups(nullptr, *pileups, pileup_file_name, expect_subgraph, show_progress);
             delete pileups;
             pileups = nullptr;
         }
@@ -377,10 +375,8 @@ int main_augment(int argc, char** argv) {
         // The PileupAugmenter object will take care of all augmentation
         PileupAugmenter augmenter(graph, PileupAugmenter::Default_default_quality, min_aug_support);    
 
-        // compute the augmented graph from the pileup
-        // Note: we can save a fair bit of memory by clearing pileups, and re-reading off of
-        //       pileup_file_name
-        augment_with_pileups(augmenter, *pileups, expect_subgraph, show_progress);
+        // compute the augmented graph from the pileup, writing it out as we go
+        augment_with_pileups(&augmenter, *pileups, pileup_file_name, expect_subgraph, show_progress);
         delete pileups;
         pileups = nullptr;
 
@@ -458,86 +454,101 @@ int main_augment(int argc, char** argv) {
     return 0;
 }
 
-Pileups* compute_pileups(VG* graph, const string& gam_file_name, int thread_count, int min_quality,
-                         int max_mismatches, int window_size, int max_depth, bool use_mapq,
-                         bool show_progress) {
-
-    // Make Pileups makers for each thread.
-    vector<Pileups*> pileups;
-    for (int i = 0; i < thread_count; ++i) {
-        pileups.push_back(new Pileups(graph, min_quality, max_mismatches, window_size, max_depth, use_mapq));
-    }
+ShardedPileups* compute_pileups(VG* graph, const string& gam_file_name, int thread_count,
+                                size_t max_pileup_mb, int min_quality, int max_mismatches,
+                                int window_size, int max_depth, bool use_mapq, bool show_progress) {
+
+    // Split the graph into a few shards per thread, so threads stay busy
+    // when coverage is uneven.  Each thread only ever works on one shard at a
+    // time, so there's nothing to merge at the end.
+    size_t shard_count = thread_count * 4;
+    size_t max_shard_bases = max_pileup_mb * 1024 * 1024 / sizeof(CompactNodePileup::Column) / shard_count;
+    ShardedPileups* pileups = new ShardedPileups(graph, shard_count, max_shard_bases, min_quality,
+                                                 max_mismatches, window_size, max_depth, use_mapq);
     
     // setup alignment stream
     get_input_file(gam_file_name, [&](istream& alignment_stream) {
         // compute the pileups.
         if (show_progress) {
-            cerr << "Computing pileups" << endl;
+            cerr << "Computing pileups in " << shard_count << " shards" << endl;
         }
-        
-        function<void(Alignment&)> lambda = [&pileups, &graph](Alignment& aln) {
-            int tid = omp_get_thread_num();
-            pileups[tid]->compute_from_alignment(aln);
-        };
-        stream::for_each_parallel(alignment_stream, lambda);
+        pileups->compute_from_stream(alignment_stream);
     });
 
-    // single-threaded (!) merge
-    if (show_progress && pileups.size() > 1) {
-        cerr << "Merging pileups" << endl;
-    }
-    for (int i = 1; i < pileups.size(); ++i) {
-        pileups[0]->merge(*pileups[i]);
-        delete pileups[i];
-    }
-    return pileups[0];
+    return pileups;
 }
 
-void augment_with_pileups(PileupAugmenter& augmenter, Pileups& pileups, bool expect_subgraph,
+void augment_with_pileups(PileupAugmenter* augmenter, ShardedPileups& pileups,
+                          const string& pileup_file_name, bool expect_subgraph,
                           bool show_progress) {
+
+    ofstream pileup_file;
+    if (!pileup_file_name.empty()) {
+        pileup_file.open(pileup_file_name);
+        if (!pileup_file) {
+            cerr << "[vg augment] error: unable to open output pileup file: " << pileup_file_name << endl;
+            exit(1);
+        }
+    }
     
     if (show_progress) {
-        cerr << "Computing augmented graph from the pileup" << endl;
+        if (!pileup_file_name.empty()) {
+            cerr << "Writing pileups" << endl;
+        }
+        if (augmenter != nullptr) {
+            cerr << "Computing augmented graph from the pileup" << endl;
+        }
     }
 
-    pileups.for_each_node_pileup([&](const NodePileup& node_pileup) {
-            if (!augmenter._graph->has_node(node_pileup.node_id())) {
-                // This pileup doesn't belong in this graph
-                if(!expect_subgraph) {
-                    throw runtime_error("Found pileup for nonexistent node " + to_string(node_pileup.node_id()));
-                }
-                // If that's expected, just skip it
+    // The shards come through one at a time, so only one needs to be in memory
+    pileups.consume([&](Pileups& shard) {
+            if (augmenter == nullptr) {
                 return;
             }
-            // Send approved pileups to the augmenter
-            augmenter.call_node_pileup(node_pileup);
             
-        });
+            shard.for_each_node_pileup([&](const CompactNodePileup& node_pileup) {
+                    if (!augmenter->_graph->has_node(node_pileup.node_id())) {
+                        // This pileup doesn't belong in this graph
+                        if(!expect_subgraph) {
+                            throw runtime_error("Found pileup for nonexistent node " + to_string(node_pileup.node_id()));
+                        }
+                        // If that's expected, just skip it
+                        return;
+                    }
+                    // Send approved pileups to the augmenter
+                    augmenter->call_node_pileup(node_pileup);
+            
+                });
 
-    pileups.for_each_edge_pileup([&](const EdgePileup& edge_pileup) {
-            if (!augmenter._graph->has_edge(edge_pileup.edge())) {
-                // This pileup doesn't belong in this graph
-                if(!expect_subgraph) {
-                    throw runtime_error("Found pileup for nonexistent edge " + pb2json(edge_pileup.edge()));
-                }
-                // If that's expected, just skip it
-                return;
-            }
-            // Send approved pileups to the augmenter
-            augmenter.call_edge_pileup(edge_pileup);            
-        });
+            shard.for_each_edge_pileup([&](const EdgePileup& edge_pileup) {
+                    if (!augmenter->_graph->has_edge(edge_pileup.edge())) {
+                        // This pileup doesn't belong in this graph
+                        if(!expect_subgraph) {
+                            throw runtime_error("Found pileup for nonexistent edge " + pb2json(edge_pileup.edge()));
+                        }
+                        // If that's expected, just skip it
+                        return;
+                    }
+                    // Send approved pileups to the augmenter
+                    augmenter->call_edge_pileup(edge_pileup);            
+                });
+        }, pileup_file_name.empty() ? nullptr : &pileup_file);
+
+    if (augmenter == nullptr) {
+        return;
+    }
 
     // map the edges from original graph
     if (show_progress) {
         cerr << "Mapping edges into augmented graph" << endl;
     }
-    augmenter.update_augmented_graph();
+    augmenter->update_augmented_graph();
 
     // map the paths from the original graph
     if (show_progress) {
         cerr << "Mapping paths into augmented graph" << endl;
     }
-    augmenter.map_paths();
+    augmenter->map_paths();
 }
 
 void add_trivial_edits(VG& graph) {
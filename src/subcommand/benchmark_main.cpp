@@ -8,6 +8,7 @@
 #include <getopt.h>
 
 #include <iostream>
+#include <sstream>
 
 #include "subcommand.hpp"
 
@@ -16,9 +17,19 @@
 
 #include "../vg.hpp"
 #include "../xg.hpp"
+#include "../packed_graph.hpp"
+#include "../gssw_aligner.hpp"
 #include "../algorithms/extract_connecting_graph.hpp"
 #include "../algorithms/topological_sort.hpp"
 #include "../algorithms/weakly_connected_components.hpp"
+#include "../algorithms/dijkstra.hpp"
+#include "../algorithms/find_shortest_paths.hpp"
+#include "../algorithms/distance_to_head.hpp"
+#include "../algorithms/distance_to_tail.hpp"
+#include "../xg_position.hpp"
+#include "../snarls.hpp"
+#include "../snarl_index.hpp"
+#include "../stream.hpp"
 
 
 
@@ -109,6 +120,70 @@ int main_benchmark(int argc, char** argv) {
     // And a test XG of it
     const xg::XG xg_index(vg_mut.graph);
     
+    // Generate a large graph for the whole-graph algorithms: a chain with
+    // bubbles, some inversions, and some back edges to make cycles
+    VG large_vg_mut;
+    size_t large_node_count = 100000;
+    for (size_t i = 1; i <= large_node_count; i++) {
+        large_vg_mut.create_node("ACGTACGT", i);
+    }
+    for (size_t i = 1; i < large_node_count; i++) {
+        large_vg_mut.create_edge(i, i + 1, false, false);
+        if (i % 10 == 0 && i + 2 <= large_node_count) {
+            // Skip a node
+            large_vg_mut.create_edge(i, i + 2, false, false);
+        }
+        if (i % 100 == 0 && i + 2 <= large_node_count) {
+            // Allow taking the next node backward
+            large_vg_mut.create_edge(i, i + 1, false, true);
+            large_vg_mut.create_edge(i + 1, i + 2, true, false);
+        }
+        if (i % 1000 == 0) {
+            // Loop back
+            large_vg_mut.create_edge(i, i - 50, false, false);
+        }
+    }
+    
+    const VG large_vg(large_vg_mut);
+    
+    // And a highly branched one, where every node reaches the next several,
+    // for comparing the shortest path searches against the chain
+    VG branched_vg;
+    size_t branched_node_count = 20000;
+    for (size_t i = 1; i <= branched_node_count; i++) {
+        branched_vg.create_node("ACGTACGT", i);
+    }
+    for (size_t i = 1; i <= branched_node_count; i++) {
+        for (size_t j = i + 1; j <= i + 8 && j <= branched_node_count; j++) {
+            branched_vg.create_edge(i, j, false, false);
+        }
+    }
+    
+    // And one made of several separate chromosomes, each a chain of simple
+    // bubbles, for finding snarls one component at a time
+    VG chromosomes_vg;
+    size_t chromosome_count = 8;
+    size_t bubbles_per_chromosome = 2000;
+    id_t next_id = 1;
+    for (size_t i = 0; i < chromosome_count; i++) {
+        id_t prev = next_id++;
+        chromosomes_vg.create_node("ACGT", prev);
+        for (size_t j = 0; j < bubbles_per_chromosome; j++) {
+            id_t ref = next_id++;
+            id_t alt = next_id++;
+            id_t join = next_id++;
+            chromosomes_vg.create_node("A", ref);
+            chromosomes_vg.create_node("C", alt);
+            chromosomes_vg.create_node("GATTACA", join);
+            chromosomes_vg.create_edge(prev, ref, false, false);
+            chromosomes_vg.create_edge(prev, alt, false, false);
+            chromosomes_vg.create_edge(ref, join, false, false);
+            chromosomes_vg.create_edge(alt, join, false, false);
+            prev = join;
+        }
+    }
+    VG chromosomes_vg_mut;
+    
     vector<BenchmarkResult> results;
     
     results.push_back(run_benchmark("vg::algorithms topological_sort", 1000, [&]() {
@@ -128,6 +203,28 @@ int main_benchmark(int argc, char** argv) {
         algorithms::orient_nodes_forward(&vg_mut);
     }));
     
+    results.push_back(run_benchmark("vg::algorithms topological_sort on large graph", 10, [&]() {
+        vector<handle_t> order = algorithms::topological_sort(&large_vg);
+        assert(order.size() == large_vg.node_size());
+    }));
+    
+    results.push_back(run_benchmark("vg::algorithms sort on large graph", 10, [&]() {
+        large_vg_mut = large_vg;
+    }, [&]() {
+        algorithms::sort(&large_vg_mut);
+    }));
+    
+    results.push_back(run_benchmark("vg::algorithms orient_nodes_forward on large graph", 10, [&]() {
+        large_vg_mut = large_vg;
+    }, [&]() {
+        algorithms::orient_nodes_forward(&large_vg_mut);
+    }));
+    
+    results.push_back(run_benchmark("vg::algorithms weakly_connected_components on large graph", 10, [&]() {
+        auto components = algorithms::weakly_connected_components(&large_vg);
+        assert(components.size() == 1);
+    }));
+    
     
     results.push_back(run_benchmark("vg::algorithms weakly_connected_components", 1000, [&]() {
         auto components = algorithms::weakly_connected_components(&vg);
@@ -135,6 +232,108 @@ int main_benchmark(int argc, char** argv) {
         assert(components.front().size() == vg.node_size());
     }));
     
+    results.push_back(run_benchmark("algorithms::find_shortest_paths on large graph", 10, [&]() {
+        auto distances = algorithms::find_shortest_paths(&large_vg, large_vg.get_handle(1, false));
+        assert(distances.size() >= large_vg.node_size());
+    }));
+    
+    results.push_back(run_benchmark("algorithms::find_shortest_paths on branched graph", 10, [&]() {
+        auto distances = algorithms::find_shortest_paths(&branched_vg, branched_vg.get_handle(1, false));
+        assert(distances.size() == branched_vg.node_size());
+    }));
+    
+    results.push_back(run_benchmark("algorithms::dijkstra within 1000 bp on large graph", 100, [&]() {
+        for (id_t start = 1; start <= 100000; start += 1000) {
+            algorithms::dijkstra(&large_vg, large_vg.get_handle(start, false), [&](const handle_t& here, size_t distance) {
+                return true;
+            }, 1000);
+        }
+    }));
+    
+    results.push_back(run_benchmark("algorithms::dijkstra within 1000 bp on branched graph", 100, [&]() {
+        for (id_t start = 1; start <= 20000; start += 200) {
+            algorithms::dijkstra(&branched_vg, branched_vg.get_handle(start, false), [&](const handle_t& here, size_t distance) {
+                return true;
+            }, 1000);
+        }
+    }));
+    
+    results.push_back(run_benchmark("algorithms::distance_to_head and distance_to_tail on branched graph", 100, [&]() {
+        for (id_t start = 1; start <= 20000; start += 200) {
+            algorithms::distance_to_head(branched_vg.get_handle(start, false), 1000, &branched_vg);
+            algorithms::distance_to_tail(branched_vg.get_handle(start, false), 1000, &branched_vg);
+        }
+    }));
+    
+    results.push_back(run_benchmark("xg_distance on xg", 1000, [&]() {
+        for (id_t i = 1; i < 101; i += 10) {
+            xg_distance(make_pos_t(i, false, 3), make_pos_t(101 - i, false, 5), 1000, const_cast<xg::XG*>(&xg_index));
+        }
+    }));
+    
+    results.push_back(run_benchmark("CactusSnarlFinder::find_snarls on 8 chromosomes", 10, [&]() {
+        chromosomes_vg_mut = chromosomes_vg;
+    }, [&]() {
+        SnarlManager snarl_manager = CactusSnarlFinder(chromosomes_vg_mut).find_snarls();
+        assert(snarl_manager.top_level_snarls().size() == chromosome_count * bubbles_per_chromosome);
+    }));
+    
+    results.push_back(run_benchmark("CactusSnarlFinder::find_snarls on 8 chromosomes with all threads", 10, [&]() {
+        chromosomes_vg_mut = chromosomes_vg;
+        omp_set_num_threads(omp_get_num_procs());
+    }, [&]() {
+        SnarlManager snarl_manager = CactusSnarlFinder(chromosomes_vg_mut).find_snarls();
+        assert(snarl_manager.top_level_snarls().size() == chromosome_count * bubbles_per_chromosome);
+    }));
+    omp_set_num_threads(1);
+    
+    results.push_back(run_benchmark("HandleGraphSnarlFinder::find_snarls on 8 chromosomes", 10, [&]() {
+        SnarlManager snarl_manager = HandleGraphSnarlFinder(&chromosomes_vg).find_snarls();
+        assert(snarl_manager.top_level_snarls().size() == chromosome_count * bubbles_per_chromosome);
+    }));
+    
+    // Save the chromosome snarls as Protobufs and as a SnarlIndex, to compare
+    // loading them
+    string snarl_protobufs;
+    string snarl_index_name = tmpfilename("vg-benchmark-snarls");
+    {
+        SnarlManager snarl_manager = HandleGraphSnarlFinder(&chromosomes_vg).find_snarls();
+        stringstream protobuf_stream;
+        vector<Snarl> buffer;
+        snarl_manager.for_each_snarl_preorder([&](const Snarl* snarl) {
+            buffer.push_back(*snarl);
+            stream::write_buffered(protobuf_stream, buffer, 100);
+        });
+        stream::write_buffered(protobuf_stream, buffer, 0);
+        snarl_protobufs = protobuf_stream.str();
+        
+        ofstream index_stream(snarl_index_name, ios::binary);
+        SnarlIndex(snarl_manager).serialize(index_stream);
+    }
+    
+    results.push_back(run_benchmark("SnarlManager load from Snarl stream", 10, [&]() {
+        stringstream protobuf_stream(snarl_protobufs);
+        SnarlManager snarl_manager(protobuf_stream);
+        assert(snarl_manager.top_level_snarls().size() == chromosome_count * bubbles_per_chromosome);
+    }));
+    
+    results.push_back(run_benchmark("SnarlManager load from mapped SnarlIndex", 10, [&]() {
+        SnarlManager snarl_manager(make_shared<const SnarlIndex>(snarl_index_name));
+        assert(snarl_manager.top_level_snarls().size() == chromosome_count * bubbles_per_chromosome);
+    }));
+    
+    results.push_back(run_benchmark("SnarlIndex map and into_which_snarl on every node", 10, [&]() {
+        SnarlIndex snarl_index(snarl_index_name);
+        size_t found = 0;
+        for (id_t i = 1; i < next_id; i++) {
+            found += (snarl_index.into_which_snarl(i, false) != SnarlIndex::NONE);
+            found += (snarl_index.into_which_snarl(i, true) != SnarlIndex::NONE);
+        }
+        assert(found == 2 * chromosome_count * bubbles_per_chromosome);
+    }));
+    
+    remove(snarl_index_name.c_str());
+    
     results.push_back(run_benchmark("VG::get_node", 1000, [&]() {
         for (size_t rep = 0; rep < 100; rep++) {
             for (size_t i = 1; i < 101; i++) {
@@ -167,6 +366,115 @@ int main_benchmark(int argc, char** argv) {
     
     }));
     
+    // The same extractions, but keeping the search state around between runs like the mapper does
+    algorithms::ConnectingGraphWorkspace workspace;
+    
+    results.push_back(run_benchmark("algorithms::extract_connecting_graph with workspace on xg", 1000, [&]() {
+        pos_t pos_1 = make_pos_t(55, false, 0);
+        pos_t pos_2 = make_pos_t(32, false, 0);
+        
+        int64_t max_len = 500;
+        
+        Graph g;
+        
+        auto trans = algorithms::extract_connecting_graph(&xg_index, g, max_len, pos_1, pos_2, workspace, false, false, true, true, true);
+    
+    }));
+    
+    results.push_back(run_benchmark("algorithms::extract_connecting_graph with workspace on vg", 1000, [&]() {
+        pos_t pos_1 = make_pos_t(55, false, 0);
+        pos_t pos_2 = make_pos_t(32, false, 0);
+        
+        int64_t max_len = 500;
+        
+        Graph g;
+        
+        auto trans = algorithms::extract_connecting_graph(&vg, g, max_len, pos_1, pos_2, workspace, false, false, true, true, true);
+    
+    }));
+    
+    // And extracting into a packed handle graph instead of a Protobuf Graph
+    results.push_back(run_benchmark("algorithms::extract_connecting_graph with workspace into packed graph on xg", 1000, [&]() {
+        pos_t pos_1 = make_pos_t(55, false, 0);
+        pos_t pos_2 = make_pos_t(32, false, 0);
+        
+        int64_t max_len = 500;
+        
+        PackedGraph g;
+        
+        auto trans = algorithms::extract_connecting_graph(&xg_index, &g, max_len, pos_1, pos_2, workspace, false, false, true, true, true);
+    
+    }));
+    
+    results.push_back(run_benchmark("algorithms::extract_connecting_graph with workspace into packed graph on vg", 1000, [&]() {
+        pos_t pos_1 = make_pos_t(55, false, 0);
+        pos_t pos_2 = make_pos_t(32, false, 0);
+        
+        int64_t max_len = 500;
+        
+        PackedGraph g;
+        
+        auto trans = algorithms::extract_connecting_graph(&vg, &g, max_len, pos_1, pos_2, workspace, false, false, true, true, true);
+    
+    }));
+    
+    // Make some candidate alignment scores like those of a read in a repeat
+    vector<double> candidate_scores;
+    for (size_t i = 0; i < 64; i++) {
+        candidate_scores.push_back(150.0 - (double) ((i * 37) % 23));
+    }
+    Aligner aligner;
+    
+    results.push_back(run_benchmark("BaseAligner::compute_mapping_quality exact", 1000, [&]() {
+        for (size_t rep = 0; rep < 100; rep++) {
+            aligner.compute_mapping_quality(candidate_scores, false);
+        }
+    }));
+    
+    aligner.fast_exp_mapping_quality = true;
+    results.push_back(run_benchmark("BaseAligner::compute_mapping_quality exact with fast exp", 1000, [&]() {
+        for (size_t rep = 0; rep < 100; rep++) {
+            aligner.compute_mapping_quality(candidate_scores, false);
+        }
+    }));
+    
+    results.push_back(run_benchmark("BaseAligner::compute_mapping_quality approx", 1000, [&]() {
+        for (size_t rep = 0; rep < 100; rep++) {
+            aligner.compute_mapping_quality(candidate_scores, true);
+        }
+    }));
+    
+    // Make a batch of mapped reads like vg map would hand to its output
+    // buffer, to time serializing them straight out of the buffer
+    vector<Alignment> mapped_reads;
+    for (size_t i = 0; i < 1024; i++) {
+        mapped_reads.emplace_back();
+        Alignment& aln = mapped_reads.back();
+        aln.set_name("read" + to_string(i));
+        aln.set_sequence(string(150, 'A'));
+        aln.set_quality(string(150, (char) 30));
+        for (size_t j = 0; j < 5; j++) {
+            Mapping* mapping = aln.mutable_path()->add_mapping();
+            mapping->mutable_position()->set_node_id(i * 5 + j + 1);
+            mapping->set_rank(j + 1);
+            Edit* edit = mapping->add_edit();
+            edit->set_from_length(30);
+            edit->set_to_length(30);
+        }
+    }
+    vector<Alignment> finished_reads;
+    vector<Alignment> output_buffer;
+    stringstream serialized;
+    
+    results.push_back(run_benchmark("stream::write_buffered of moved alignments", 100, [&]() {
+        finished_reads = mapped_reads;
+        serialized.str("");
+    }, [&]() {
+        move(finished_reads.begin(), finished_reads.end(), back_inserter(output_buffer));
+        finished_reads.clear();
+        stream::write_buffered(serialized, output_buffer, 512);
+    }));
+    
     // Do the control against itself
     results.push_back(run_benchmark("control", 1000, benchmark_control));
 
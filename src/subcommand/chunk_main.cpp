@@ -36,7 +36,8 @@ void help_chunk(char** argv) {
          << "options:" << endl
          << "    -x, --xg-name FILE       use this xg index to chunk subgraphs" << endl
          << "    -G, --gbwt-name FILE     use this GBWT haplotype index for haplotype extraction" << endl
-         << "    -a, --gam-index FILE     chunk this gam index (made with vg index -a) instead of the graph" << endl
+         << "    -a, --gam-index FILE     chunk this gam index instead of the graph: a gam sorted and indexed with" << endl
+         << "                             vg gamsort -i FILE.gai, or a rocksdb index made with vg index -a" << endl
          << "    -g, --gam-and-graph      when used in combination with -a, both gam and graph will be chunked" << endl 
          << "path chunking:" << endl
          << "    -p, --path TARGET        write the chunk in the specified (0-based inclusive)\n"
@@ -59,7 +60,7 @@ void help_chunk(char** argv) {
          << "    -T, --trace              trace haplotype threads in chunks (and only expand forward from input coordinates)." << endl
          << "                             Produces a .annotate.txt file with haplotype frequencies for each chunk." << endl 
          << "    -f, --fully-contained    only return GAM alignments that are fully contained within chunk" << endl
-         << "    -A, --search-all         search all nodes of alignment as opposed just the minimum (gam index must be made with -N)" << endl
+         << "    -A, --search-all         search all nodes of alignment as opposed just the minimum (rocksdb gam index must be made with -N)" << endl
          << "    -t, --threads N          for tasks that can be done in parallel, use this many threads [1]" << endl
          << "    -h, --help" << endl;
 }
@@ -296,9 +297,30 @@ int main_chunk(int argc, char** argv) {
         gbwt_index->load(in);
     }
 
-    // This holds the RocksDB index that has all our reads, indexed by the nodes they visit.
-    Index gam_index;
+    // A gam sorted by vg gamsort comes with a .gai index of the node ID
+    // ranges in each of its chunks, which lets us read it directly. Each
+    // thread needs its own stream to seek around in.
+    GAMIndex sorted_gam_index;
+    vector<unique_ptr<ifstream>> sorted_gam_streams;
+    bool use_sorted_gam = false;
     if (chunk_gam) {
+        ifstream index_stream(gam_file + ".gai");
+        if (index_stream) {
+            use_sorted_gam = true;
+            sorted_gam_index.load(index_stream);
+            for (int i = 0; i < threads; ++i) {
+                sorted_gam_streams.emplace_back(new ifstream(gam_file, ios::binary));
+                if (!*sorted_gam_streams.back()) {
+                    cerr << "error:[vg chunk] unable to open sorted gam " << gam_file << endl;
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // Otherwise, this holds the RocksDB index that has all our reads, indexed by the nodes they visit.
+    Index gam_index;
+    if (chunk_gam && !use_sorted_gam) {
         gam_index.open_read_only(gam_file);
     }
     
@@ -531,7 +553,17 @@ int main_chunk(int argc, char** argv) {
                 cerr << "error[vg chunk]: can't open output gam file " << gam_name << endl;
                 exit(1);
             }
-            if (subgraph != NULL) {
+            if (use_sorted_gam) {
+                istream& sorted_gam = *sorted_gam_streams[tid];
+                if (subgraph != NULL) {
+                    chunker.extract_gam_for_subgraph(*subgraph, sorted_gam_index, sorted_gam,
+                                                     &out_gam_file, fully_contained);
+                } else {
+                    vector<vg::id_t> region_id_range = {region.start, region.end};
+                    chunker.extract_gam_for_ids(region_id_range, sorted_gam_index, sorted_gam,
+                                                &out_gam_file, true, fully_contained);
+                }
+            } else if (subgraph != NULL) {
                 chunker.extract_gam_for_subgraph(*subgraph, gam_index, &out_gam_file,
                                                  fully_contained, search_all_positions);
             } else {
@@ -4,12 +4,14 @@
 #include <unistd.h>
 #include <getopt.h>
 #include <memory>
+#include <regex>
 
 #include "subcommand.hpp"
 
 #include "../stream.hpp"
 #include "../constructor.hpp"
 #include "../region.hpp"
+#include "../xg.hpp"
 
 using namespace std;
 using namespace vg;
@@ -34,7 +36,9 @@ void help_construct(char** argv) {
          << "    -S, --handle-sv       include SVs in construction of graph." << endl
          << "    -I, --insertions FILE a FASTA file containing insertion sequences "<< endl 
          << "                           (referred to in VCF) to add to graph." << endl
-         << "    -f, --flat-alts N     don't chop up alternate alleles from input vcf" << endl;
+         << "    -f, --flat-alts N     don't chop up alternate alleles from input vcf" << endl
+         << "    -x, --xg-name FILE    write an xg index of the graph to FILE instead of the graph to stdout" << endl
+         << "                          (alt paths are left out, as with vg index -x)" << endl;
 
 }
 
@@ -54,6 +58,7 @@ int main_construct(int argc, char** argv) {
     vector<string> insertion_filenames;
     string region;
     bool region_is_chrom = false;
+    string xg_name;
 
     int c;
     optind = 2; // force optind past command positional argument
@@ -75,11 +80,12 @@ int main_construct(int argc, char** argv) {
                 {"region-is-chrom", no_argument, 0, 'C'},
                 {"node-max", required_argument, 0, 'm'},\
                 {"flat-alts", no_argument, 0, 'f'},
+                {"xg-name", required_argument, 0, 'x'},
                 {0, 0, 0, 0}
             };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "v:r:n:ph?z:t:R:m:as:CfSI:",
+        c = getopt_long (argc, argv, "v:r:n:ph?z:t:R:m:as:CfSI:x:",
                          long_options, &option_index);
 
         /* Detect the end of the options. */
@@ -154,6 +160,10 @@ int main_construct(int argc, char** argv) {
             constructor.flat = true;
             break;
 
+        case 'x':
+            xg_name = optarg;
+            break;
+
         case 'h':
         case '?':
             /* getopt_long already printed an error message. */
@@ -282,6 +292,33 @@ int main_construct(int argc, char** argv) {
         exit(1);
     }
 
+    if (!xg_name.empty()) {
+        // Feed the chunks straight into an xg index as they are wired up,
+        // instead of writing them out to be read back by vg index -x.
+        ofstream xg_stream(xg_name);
+        if (!xg_stream) {
+            cerr << "error:[vg construct] could not open " << xg_name << " for writing" << endl;
+            return 1;
+        }
+        // Leave out the same alt paths vg index -x would
+        regex is_alt("_alt_.+_[0-9]+");
+        xg::XG index;
+        index.from_callback([&](function<void(Graph&)> xg_callback) {
+            constructor.construct_graph(fasta_pointers, vcf_pointers, ins_pointers, [&](Graph& chunk) {
+                auto* paths = chunk.mutable_path();
+                paths->erase(std::remove_if(paths->begin(), paths->end(), [&](const Path& path) {
+                    return regex_match(path.name(), is_alt);
+                }), paths->end());
+                xg_callback(chunk);
+            });
+        });
+        if (constructor.show_progress) {
+            cerr << "Built xg index of " << index.node_count << " nodes" << endl;
+        }
+        index.serialize(xg_stream);
+        return 0;
+    }
+
     // Construct the graph.
     constructor.construct_graph(fasta_pointers, vcf_pointers,
                                 ins_pointers, callback);
@@ -11,6 +11,7 @@
 #include "../vg.hpp"
 #include "../stream.hpp"
 #include "../utility.hpp"
+#include "../algorithms/weakly_connected_components.hpp"
 
 
 using namespace std;
@@ -85,70 +86,79 @@ int main_explode(int argc, char** argv) {
     
     // Now we explode the VG
     
+    // Find the components all at once
+    vector<id_t> node_ids;
+    vector<size_t> component_of_node;
+    size_t component_count = algorithms::weakly_connected_component_labels(graph, node_ids, component_of_node);
+    
+    // Group the nodes by component, and put the components in the order we
+    // come to them in the graph
+    vector<vector<Node*>> component_nodes(component_count);
+    vector<size_t> component_order;
+    graph->for_each_node([&](Node* n) {
+        size_t rank = lower_bound(node_ids.begin(), node_ids.end(), n->id()) - node_ids.begin();
+        auto& nodes = component_nodes[component_of_node[rank]];
+        if (nodes.empty()) {
+            component_order.push_back(component_of_node[rank]);
+        }
+        nodes.push_back(n);
+    });
+    
     // Count through the components we build
     size_t component_index = 0;
     
-    // Track all the nodes we've already assigned to subgraphs
-    set<Node*> used;
-    
-    graph->for_each_node([&](Node* start) {
-        if (!used.count(start)) {
-            // It's a new connected component!
-            VG component;
+    for (size_t found_component : component_order) {
+        VG component;
+        
+        // We want to track the path names in each component
+        set<string> path_names;
+        
+        for (Node* n : component_nodes[found_component]) {
+            // Copy node over
+            component.create_node(n->sequence(), n->id());
             
-            // We want to track the path names in each component
-            set<string> path_names;
+            // Copy over its edges
+            for (auto* e : graph->edges_of(n)) {
+                component.add_edge(*e);
+            }
             
-            graph->for_each_connected_node(start, [&](Node* n) {
-                // Mark this connected node as used in a component.
-                used.insert(n);
-                
-                // Copy node over
-                component.create_node(n->sequence(), n->id());
-                
-                // Copy over its edges
-                for (auto* e : graph->edges_of(n)) {
-                    component.add_edge(*e);
+            // Copy paths over
+            for (auto& path : graph->paths.get_node_mapping(n)) {
+                // Some paths might not actually touch this node at all.
+                bool nonempty = false;
+                for (auto& m : path.second) {
+                    component.paths.append_mapping(path.first, *m);
+                    nonempty = true;
                 }
-                
-                // Copy paths over
-                for (auto& path : graph->paths.get_node_mapping(n)) {
-                    // Some paths might not actually touch this node at all.
-                    bool nonempty = false;
-                    for (auto& m : path.second) {
-                        component.paths.append_mapping(path.first, *m);
-                        nonempty = true;
-                    }
-                    if (nonempty) {
-                        // This path had mappings, so it qualifies for the component
-                        path_names.insert(path.first);
-                    }
+                if (nonempty) {
+                    // This path had mappings, so it qualifies for the component
+                    path_names.insert(path.first);
                 }
-            });
-            
-            // We inserted mappings into the component in more or less arbitrary
-            // order, so sort them by rank.
-            component.paths.sort_by_mapping_rank();
-            // Then rebuild the other path indexes
-            component.paths.rebuild_mapping_aux();
-            
-            // Save the component
-            string filename = output_dir + "/component" + to_string(component_index) + ".vg";
-            
-            // Now report what paths went into the component in parseable TSV
-            cout << filename;
-            for (auto& path_name : path_names) {
-                cout << "\t" << path_name;
             }
-            cout << endl;
-            
-            component.serialize_to_file(filename);
-            
-            
-            
-            component_index++;
         }
-    });
+        // Free the node list as we go
+        vector<Node*>().swap(component_nodes[found_component]);
+        
+        // We inserted mappings into the component in more or less arbitrary
+        // order, so sort them by rank.
+        component.paths.sort_by_mapping_rank();
+        // Then rebuild the other path indexes
+        component.paths.rebuild_mapping_aux();
+        
+        // Save the component
+        string filename = output_dir + "/component" + to_string(component_index) + ".vg";
+        
+        // Now report what paths went into the component in parseable TSV
+        cout << filename;
+        for (auto& path_name : path_names) {
+            cout << "\t" << path_name;
+        }
+        cout << endl;
+        
+        component.serialize_to_file(filename);
+        
+        component_index++;
+    }
     
     if (graph != nullptr) {
         delete graph;
@@ -1,6 +1,8 @@
 #include "gamsorter.hpp"
 #include "stream.hpp"
 #include <getopt.h>
+#include <omp.h>
+#include <memory>
 #include "subcommand.hpp"
 #include "index.hpp"
 #include "stream.hpp"
@@ -15,12 +17,16 @@ using namespace vg::subcommand;
 void help_gamsort(char **argv)
 {
     cerr << "gamsort: sort a GAM file (or index it) without Rocksdb" << endl
-         << "Usage: " << argv[1] << " [Options] gamfile" << endl
+         << "Usage: " << argv[1] << " [Options] gamfile >sorted.gam" << endl
          << "Options:" << endl
-         << "  -p / --paired           Index a paired-end GAM." << endl
+         << "  -p / --paired           Input GAM is interleaved pairs; keep each pair together." << endl
          << "  -s / --sorted           Input GAM is already sorted." << endl
-         << "  -i / --index <INDEX>    produce a node-to-alignment index" << endl
+         << "  -i / --index FILE       write an index of the sorted GAM's node ID ranges to FILE (use <sorted.gam>.gai for vg chunk)" << endl
          << "  -d / --dumb-sort        use naive sorting algorithm (no tmp files, faster for small GAMs)" << endl
+         << "  -m / --memory INT       use about this many MB of memory for sorting [1024]" << endl
+         << "  -T / --temp-dir DIR     write temporary sorted runs to DIR [$TMPDIR or /tmp]" << endl
+         << "  -t / --threads INT      number of threads to sort with" << endl
+         << "  -P / --progress         report progress" << endl
          << "  -r / --rocks            Just use the old RocksDB-style indexing scheme for sorting." << endl
          << "  -a / --aln-index        Create the old RocksDB-style node-to-alignment index." << endl
          << endl;
@@ -29,12 +35,15 @@ void help_gamsort(char **argv)
 int main_gamsort(int argc, char **argv)
 {
     string gamfile;
-    bool do_index = false;
+    string index_filename;
     bool dumb_sort = false;
     bool is_paired = false;
     bool is_sorted = false;
     bool just_use_rocks = false;
     bool do_aln_index = false;
+    size_t memory_mb = 1024;
+    string temp_dir;
+    bool show_progress = false;
     int c;
     optind = 2; // force optind past command positional argument
     while (true)
@@ -47,9 +56,13 @@ int main_gamsort(int argc, char **argv)
                 {"rocks", no_argument, 0, 'r'},
                 {"aln-index", no_argument, 0, 'a'},
                 {"is-sorted", no_argument, 0, 's'},
+                {"memory", required_argument, 0, 'm'},
+                {"temp-dir", required_argument, 0, 'T'},
+                {"threads", required_argument, 0, 't'},
+                {"progress", no_argument, 0, 'P'},
                 {0, 0, 0, 0}};
         int option_index = 0;
-        c = getopt_long(argc, argv, "idhraps",
+        c = getopt_long(argc, argv, "i:dhrapsm:T:t:P",
                         long_options, &option_index);
 
         // Detect the end of the options.
@@ -59,7 +72,7 @@ int main_gamsort(int argc, char **argv)
         switch (c)
         {
         case 'i':
-            do_index = true;
+            index_filename = optarg;
             break;
         case 'd':
             dumb_sort = true;
@@ -76,6 +89,18 @@ int main_gamsort(int argc, char **argv)
         case 'p':
             is_paired = true;
             break;
+        case 'm':
+            memory_mb = std::stoull(optarg);
+            break;
+        case 'T':
+            temp_dir = optarg;
+            break;
+        case 't':
+            omp_set_num_threads(atoi(optarg));
+            break;
+        case 'P':
+            show_progress = true;
+            break;
         case 'h':
         case '?':
         default:
@@ -92,9 +117,15 @@ int main_gamsort(int argc, char **argv)
 
     gamfile = argv[optind];
 
-    GAMSorter gs;
+    GAMSorter gs(memory_mb * 1024 * 1024, temp_dir, show_progress);
 
-    if (just_use_rocks && !do_index)
+    if (just_use_rocks && !index_filename.empty())
+    {
+        cerr << "error:[vg gamsort] -i can't be used with -r" << endl;
+        exit(1);
+    }
+
+    if (just_use_rocks)
     {
         // Do the sort the old way - write a big ol'
         // RocksDB index of alignments, then dump them
@@ -103,7 +134,6 @@ int main_gamsort(int argc, char **argv)
         Index index;
 
         index.open_for_bulk_load(dbname);
-        int64_t aln_idx = 0;
         function<void(Alignment&)> lambda_reader = [&index](Alignment& aln) {
                 index.put_alignment(aln);
         };
@@ -117,56 +147,43 @@ int main_gamsort(int argc, char **argv)
                 stream::write_buffered(cout, output_buf, 100);
             };
         index.for_each_alignment(lambda_writer);
-        ofstream outstream;
-        outstream.open(dbname);
-        //stream::write_buffered(outstream, output_buf, 0);
+        stream::write_buffered(cout, output_buf, 0);
         index.flush();
         index.close();
     }
-
-    if (dumb_sort)
-    {
-        gs.dumb_sort(gamfile);
-    }
-    else if (!dumb_sort)
+    else
     {
-        gs.stream_sort(gamfile);
-    }
-
-    if (do_index && just_use_rocks)
-    {
-        string dbname = gamfile + ".grai";
-        Index index;
+        // Index the output as we write it, if asked
+        unique_ptr<GAMIndex> gam_index;
+        if (!index_filename.empty())
+        {
+            gam_index = unique_ptr<GAMIndex>(new GAMIndex());
+        }
 
-        index.open_for_bulk_load(dbname);
-        int64_t aln_idx = 0;
-        function<void(Alignment&)> lambda_reader = [&index](Alignment& aln) {
-                index.put_alignment(aln);
-        };
         get_input_file(gamfile, [&](istream& in) {
-            stream::for_each_parallel(in, lambda_reader);
+            if (dumb_sort)
+            {
+                gs.dumb_sort(in, cout, is_paired, gam_index.get());
+            }
+            else
+            {
+                gs.stream_sort(in, cout, is_paired, gam_index.get());
+            }
         });
 
-        vector<Alignment> output_buf;
-        auto lambda_writer = [&output_buf](const Alignment& aln) {
-                output_buf.push_back(aln);
-                stream::write_buffered(cout, output_buf, 100);
-            };
-        index.for_each_alignment(lambda_writer);
-        ofstream outstream;
-        outstream.open(dbname);
-        //stream::write_buffered(outstream, output_buf, 0);
-        index.flush();
-       
-    }
-    
-    else if (do_index){
-        // Write a super simple index file of format
-        // node_d \tab firstAlnLineNumber \tab secondAlnLineNumber ...
-        gs.write_index(gamfile, gamfile + ".gai", false);
+        if (gam_index)
+        {
+            ofstream index_out(index_filename);
+            if (!index_out)
+            {
+                cerr << "error:[vg gamsort] could not write index to " << index_filename << endl;
+                exit(1);
+            }
+            gam_index->save(index_out);
+        }
     }
 
-    return 1;
+    return 0;
 }
 
 static Subcommand vg_gamsort("gamsort", "Perform naive sorts and indexing on a GAM file.", main_gamsort);
@@ -14,6 +14,7 @@
 
 #include "../vg.hpp"
 #include "../vg_set.hpp"
+#include "../packed_graph.hpp"
 #include "../algorithms/topological_sort.hpp"
 
 #include <gcsa/support.h>
@@ -32,7 +33,8 @@ void help_ids(char** argv) {
         << "                         by iterating through the supplied graphs and incrementing" << endl
         << "                         their ids to be non-conflicting (modifies original files)" << endl
         << "    -m, --mapping FILE   create an empty node mapping for vg prune (use with -j)" << endl
-        << "    -s, --sort           assign new node IDs in (generalized) topological sort order" << endl;
+        << "    -s, --sort           assign new node IDs in (generalized) topological sort order" << endl
+        << "    -J, --packed         use the compact packed graph representation (lower memory; not with -j)" << endl;
 }
 
 int main_ids(int argc, char** argv) {
@@ -45,6 +47,7 @@ int main_ids(int argc, char** argv) {
     bool join = false;
     bool compact = false;
     bool sort = false;
+    bool packed = false;
     int64_t increment = 0;
     int64_t decrement = 0;
     std::string mapping_name;
@@ -60,12 +63,13 @@ int main_ids(int argc, char** argv) {
             {"join", no_argument, 0, 'j'},
             {"mapping", required_argument, 0, 'm'},
             {"sort", no_argument, 0, 's'},
+            {"packed", no_argument, 0, 'J'},
             {"help", no_argument, 0, 'h'},
             {0, 0, 0, 0}
         };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "hci:d:jm:s",
+        c = getopt_long (argc, argv, "hci:d:jm:sJ",
                 long_options, &option_index);
 
         // Detect the end of the options.
@@ -98,6 +102,10 @@ int main_ids(int argc, char** argv) {
                 sort = true;
                 break;
 
+            case 'J':
+                packed = true;
+                break;
+
             case 'h':
             case '?':
                 help_ids(argv);
@@ -109,7 +117,35 @@ int main_ids(int argc, char** argv) {
         }
     }
 
-    if (!join) {
+    if (join && packed) {
+        cerr << "error:[vg ids] --packed cannot be used with --join" << endl;
+        return 1;
+    }
+
+    if (packed) {
+        PackedGraph graph;
+        get_input_file(optind, argc, argv, [&](istream& in) {
+            graph.load(in);
+        });
+
+        if (sort) {
+            algorithms::sort(&graph);
+        }
+
+        if (compact || sort) {
+            graph.compact_ids();
+        }
+
+        if (increment != 0) {
+            graph.increment_node_ids(increment);
+        }
+
+        if (decrement != 0) {
+            graph.increment_node_ids(-decrement);
+        }
+
+        graph.serialize(std::cout);
+    } else if (!join) {
         VG* graph;
         get_input_file(optind, argc, argv, [&](istream& in) {
             graph = new VG(in);
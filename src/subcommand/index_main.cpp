@@ -47,7 +47,7 @@ void help_index(char** argv) {
          << "    -f, --mapping FILE     use this node mapping in GCSA2 construction" << endl
          << "    -k, --kmer-size N      index kmers of size N in the graph" << endl
          << "    -X, --doubling-steps N use this number of doubling steps for GCSA2 construction" << endl
-         << "    -Z, --size-limit N     limit of memory to use for GCSA2 construction in gigabytes" << endl
+         << "    -Z, --size-limit N     limit of disk space to use for temporary files, including kmers, in gigabytes" << endl
          << "    -O, --path-only        only index the kmers in paths embedded in the graph" << endl
          << "    -F, --forward-only     omit the reverse complement of the graph from indexing" << endl
          << "    -d, --db-name PATH     create rocksdb in PATH directory (default: <graph>.index/)" << endl
@@ -62,6 +62,9 @@ void help_index(char** argv) {
          << "    -a, --store-alignments input is .gam format, store the alignments by node" << endl
          << "    -A, --dump-alignments  graph contains alignments, output them in sorted order" << endl
          << "    -N, --node-alignments  input is (ideally, sorted) .gam format, cross reference nodes by alignment traversals" << endl
+         << "    -I, --ingest-sst       with -a or -N, sort keys externally and ingest them as SST files instead of" << endl
+         << "                           writing through the memtables" << endl
+         << "    -y, --prefix-filter    when creating the db, build bloom filters on node ID key prefixes" << endl
          << "    -e, --edge-max N       only consider paths which make edge choices at <= this many points" << endl
          << "    -j, --kmer-stride N    step distance between succesive kmers in paths (default 1)" << endl
          << "    -P, --prune KB         remove kmer entries which use more than KB kilobytes" << endl
@@ -146,6 +149,8 @@ int main_index(int argc, char** argv) {
     bool allow_negs = false;
     bool compact = false;
     bool dump_alignments = false;
+    bool ingest_sst = false;
+    bool prefix_filter = false;
     int doubling_steps = 3;
     bool verify_index = false;
     bool forward_only = false;
@@ -201,11 +206,13 @@ int main_index(int argc, char** argv) {
             {"gbwt-name", required_argument, 0, 'G'},
             {"write-haps", required_argument, 0, 'H'},
             {"tmp-db-base", required_argument, 0, 'b'},
+            {"ingest-sst", no_argument, 0, 'I'},
+            {"prefix-filter", no_argument, 0, 'y'},
             {0, 0, 0, 0}
         };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "d:k:j:pDshMt:b:e:SP:LmaCnAg:X:x:v:r:VFZ:Oi:f:TNoB:R:E:G:H:",
+        c = getopt_long (argc, argv, "d:k:j:pDshMt:b:e:SP:LmaCnAg:X:x:v:r:VFZ:Oi:f:TNoB:R:E:G:H:Iy",
                 long_options, &option_index);
 
         // Detect the end of the options.
@@ -335,6 +342,14 @@ int main_index(int argc, char** argv) {
             compact = true;
             break;
 
+        case 'I':
+            ingest_sst = true;
+            break;
+
+        case 'y':
+            prefix_filter = true;
+            break;
+
         case 't':
             omp_set_num_threads(atoi(optarg));
             break;
@@ -1111,11 +1126,22 @@ int main_index(int argc, char** argv) {
 
         // Load up the graphs
         vector<string> tmpfiles;
+        // GCSA2 gets whatever temporary space the kmers leave, in GB
+        size_t gcsa_limit = size_limit;
         if (dbg_names.empty()) {
             VGset graphs(file_names);
             graphs.show_progress = show_progress;
-            // Go get the kmers of the correct size
-            tmpfiles = graphs.write_gcsa_kmers_binary(kmer_size);
+            // Go get the kmers of the correct size, within the temporary space limit
+            size_t kmer_bytes = size_limit * 1024 * 1024 * 1024;
+            try {
+                tmpfiles = graphs.write_gcsa_kmers_binary(kmer_size, kmer_bytes);
+            } catch (SizeLimitExceededException& e) {
+                cerr << "error:[vg index] kmers exceeded the size limit of " << size_limit
+                     << " GB; prune the graph further or raise the limit with -Z" << endl;
+                return 1;
+            }
+            // GCSA2 counts its limit in whole GB, so round what is left up, and give it at least 1
+            gcsa_limit = max<size_t>((kmer_bytes + 1024 * 1024 * 1024 - 1) / (1024 * 1024 * 1024), 1);
         } else {
             tmpfiles = dbg_names;
         }
@@ -1123,7 +1149,7 @@ int main_index(int argc, char** argv) {
         gcsa::InputGraph input_graph(tmpfiles, true, gcsa::Alphabet(), mapping_name);
         gcsa::ConstructionParameters params;
         params.setSteps(doubling_steps);
-        params.setLimit(size_limit);
+        params.setLimit(gcsa_limit);
 
         // build the GCSA index
         gcsa::GCSA* gcsa_index = new gcsa::GCSA(input_graph, params);
@@ -1159,7 +1185,7 @@ int main_index(int argc, char** argv) {
     if (!rocksdb_name.empty()) {
 
         Index index;
-
+        index.node_prefix_filter = prefix_filter;
         if (compact) {
             index.open_for_write(rocksdb_name);
             index.compact();
@@ -1169,29 +1195,52 @@ int main_index(int argc, char** argv) {
 
         if (store_node_alignments && file_names.size() > 0) {
             index.open_for_bulk_load(rocksdb_name);
-            int64_t aln_idx = 0;
-            function<void(Alignment&)> lambda = [&index,&aln_idx](Alignment& aln) {
-                index.cross_alignment(aln_idx++, aln);
+            // the ingester finds a temp directory itself if none was given
+            unique_ptr<BulkIngester> ingester;
+            if (ingest_sst) {
+                ingester.reset(new BulkIngester(index, size_t(1) << 30, tmp_db_base));
+            }
+            std::atomic<int64_t> aln_idx(0);
+            function<void(Alignment&)> lambda = [&](Alignment& aln) {
+                if (ingest_sst) {
+                    index.cross_alignment(aln_idx++, aln, *ingester);
+                } else {
+                    index.cross_alignment(aln_idx++, aln);
+                }
             };
             for (auto& file_name : file_names) {
                 get_input_file(file_name, [&](istream& in) {
                     stream::for_each_parallel(in, lambda);
                 });
             }
+            if (ingester) {
+                ingester->finish();
+            }
             index.flush();
             index.close();
         }
 
         if (store_alignments && file_names.size() > 0) {
             index.open_for_bulk_load(rocksdb_name);
-            function<void(Alignment&)> lambda = [&index](Alignment& aln) {
-                index.put_alignment(aln);
+            unique_ptr<BulkIngester> ingester;
+            if (ingest_sst) {
+                ingester.reset(new BulkIngester(index, size_t(1) << 30, tmp_db_base));
+            }
+            function<void(Alignment&)> lambda = [&](Alignment& aln) {
+                if (ingest_sst) {
+                    index.put_alignment(aln, *ingester);
+                } else {
+                    index.put_alignment(aln);
+                }
             };
             for (auto& file_name : file_names) {
                 get_input_file(file_name, [&](istream& in) {
                     stream::for_each_parallel(in, lambda);
                 });
             }
+            if (ingester) {
+                ingester->finish();
+            }
             index.flush();
             index.close();
         }
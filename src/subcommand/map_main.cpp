@@ -30,6 +30,7 @@ void help_map(char** argv) {
          << "    -l, --try-at-least INT  attempt to align at least the INT best candidate chains of seeds [2]" << endl
          << "    -E, --approx-mq-cap INT weight MQ by suffix tree based estimate when estimate less than FLOAT [0]" << endl
          << "    --id-mq-weight N        scale mapping quality by the alignment score identity to this power [2]" << endl
+         << "    --fast-exp-mq           compute mapping qualities with a faster approximate exponential" << endl
          << "    -W, --min-chain INT     discard a chain if seeded bases shorter than INT [0]" << endl
          << "    -C, --drop-chain FLOAT  drop chains shorter than FLOAT fraction of the longest overlapping chain [0]" << endl
          << "    -n, --mq-overlap FLOAT  scale MQ by count of alignments with this overlap in the query with the primary [0]" << endl
@@ -46,6 +47,7 @@ void help_map(char** argv) {
          << "    -S, --fragment-x FLOAT  calculate max fragment size as frag_mean+frag_sd*FLOAT [10]" << endl
          << "    -O, --mate-rescues INT  attempt up to INT mate rescues per pair [64]" << endl
          << "    --patch-aln             patch banded alignments by attempting to align unaligned regions" << endl 
+         << "    --read-cache INT        reuse results for up to INT distinct identical reads (or pairs) and report hit rate [0]" << endl
          << "scoring:" << endl
          << "    -q, --match INT         use this match score [1]" << endl
          << "    -z, --mismatch INT      use this mismatch penalty [4]" << endl
@@ -131,6 +133,7 @@ int main_map(int argc, char** argv) {
     int max_mapping_quality = 60;
     double maybe_mq_threshold = 0;
     double identity_weight = 2;
+    bool fast_exp_mapping_quality = false;
     string gam_input;
     bool compare_gam = false;
     int fragment_max = 5000;
@@ -155,6 +158,7 @@ int main_map(int argc, char** argv) {
     bool refpos_table = false;
     bool patch_alignments = false;
     int surject_min_softclip = 4;
+    int read_cache_size = 0;
 
     int c;
     optind = 2; // force optind past command positional argument
@@ -217,15 +221,17 @@ int main_map(int argc, char** argv) {
                 {"print-frag-model", no_argument, 0, 'p'},
                 {"frag-calc", required_argument, 0, 'F'},
                 {"id-mq-weight", required_argument, 0, '7'},
+                {"fast-exp-mq", no_argument, 0, '3'},
                 {"refpos-table", no_argument, 0, 'v'},
                 {"surject-to", required_argument, 0, '5'},
                 {"patch-alns", no_argument, 0, '8'},
                 {"surj-min-softclip", required_argument, 0, '9'},
+                {"read-cache", required_argument, 0, '2'},
                 {0, 0, 0, 0}
             };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "s:J:Q:d:x:g:1:T:N:R:c:M:t:G:jb:Kf:iw:P:Dk:Y:r:W:6H:Z:q:z:o:y:Au:B:I:S:l:e:C:V:O:L:a:n:E:X:UpF:m7:v5:89:",
+        c = getopt_long (argc, argv, "s:J:Q:d:x:g:1:T:N:R:c:M:t:G:jb:Kf:iw:P:Dk:Y:r:W:6H:Z:q:z:o:y:Au:B:I:S:l:e:C:V:O:L:a:n:E:X:UpF:m7:3v5:89:2:",
                          long_options, &option_index);
 
 
@@ -271,6 +277,10 @@ int main_map(int argc, char** argv) {
             identity_weight = atof(optarg);
             break;
 
+        case '3':
+            fast_exp_mapping_quality = true;
+            break;
+
         case 'Q':
             max_mapping_quality = atoi(optarg);
             break;
@@ -438,6 +448,10 @@ int main_map(int argc, char** argv) {
             surject_min_softclip = atoi(optarg);
             break;
 
+        case '2':
+            read_cache_size = atoi(optarg);
+            break;
+
         case 'I':
         {
             vector<string> parts = split_delims(string(optarg), ":");
@@ -816,7 +830,7 @@ int main_map(int argc, char** argv) {
                               &buffer_size,
                               &refpos_table,
                               &write_json,
-                              &write_refpos](const vector<Alignment>& alns1, const vector<Alignment>& alns2) {
+                              &write_refpos](vector<Alignment>& alns1, vector<Alignment>& alns2) {
         if (output_json) {
             // If we want to convert to JSON, convert them all to JSON and dump them to cout.
 #pragma omp critical (cout)
@@ -839,14 +853,20 @@ int main_map(int argc, char** argv) {
             int tid = omp_get_thread_num();
             auto& output_buf = output_buffer[tid];
 
-            // Copy all the alignments over to the output buffer
-            copy(alns1.begin(), alns1.end(), back_inserter(output_buf));
-            copy(alns2.begin(), alns2.end(), back_inserter(output_buf));
+            // Move all the alignments over to the output buffer; the caller is done with them
+            move(alns1.begin(), alns1.end(), back_inserter(output_buf));
+            move(alns2.begin(), alns2.end(), back_inserter(output_buf));
 
             stream::write_buffered(cout, output_buf, buffer_size);
         }
     };
 
+    // Share one cache of results for identical reads between all the threads
+    ReadAlignmentCache* read_cache = nullptr;
+    if (read_cache_size > 0) {
+        read_cache = new ReadAlignmentCache(read_cache_size, qual_adjust_alignments);
+    }
+
     for (int i = 0; i < thread_count; ++i) {
         Mapper* m = nullptr;
         if(xgidx && gcsa && lcp) {
@@ -885,6 +905,13 @@ int main_map(int argc, char** argv) {
         m->frag_stats.fixed_fragment_model = fixed_fragment_model;
         m->frag_stats.fragment_max = fragment_max;
         m->frag_stats.fragment_sigma = fragment_sigma;
+        m->frag_stats.fragment_model_update_interval = fragment_model_update;
+        if (i == 0) {
+            // The first mapper's fragment length distribution is shared by all the threads
+            m->set_fragment_length_distr_params(0, max(fragment_model_update, 1), 0.95);
+        } else {
+            m->frag_stats.length_distr = &mapper[0]->fragment_length_distr;
+        }
         if (fragment_mean) {
             m->frag_stats.fragment_size = fragment_size;
             m->frag_stats.cached_fragment_length_mean = fragment_mean;
@@ -892,14 +919,15 @@ int main_map(int argc, char** argv) {
             m->frag_stats.cached_fragment_orientation_same = fragment_orientation;
             m->frag_stats.cached_fragment_direction = fragment_direction;
         }
-        m->frag_stats.fragment_model_update_interval = fragment_model_update;
         m->max_mapping_quality = max_mapping_quality;
         m->mate_rescues = mate_rescues;
         m->max_band_jump = max_band_jump > -1 ? max_band_jump : band_width;
         m->identity_weight = identity_weight;
+        m->set_fast_exp_mapping_quality(fast_exp_mapping_quality);
         m->assume_acyclic = acyclic_graph;
         m->context_depth = 3; // for surjection
         m->patch_alignments = patch_alignments;
+        m->read_cache = read_cache;
         mapper[i] = m;
     }
 
@@ -1039,6 +1067,8 @@ int main_map(int argc, char** argv) {
                 }
             };
             fastq_paired_interleaved_for_each_parallel(fastq1, lambda);
+            // Merge the fragment lengths that threads still had buffered
+            mapper[0]->fragment_length_distr.flush();
 #pragma omp parallel
             { // clean up buffered alignments that weren't perfect
                 auto our_mapper = mapper[omp_get_thread_num()];
@@ -1120,6 +1150,8 @@ int main_map(int argc, char** argv) {
                 }
             };
             fastq_paired_two_files_for_each_parallel(fastq1, fastq2, lambda);
+            // Merge the fragment lengths that threads still had buffered
+            mapper[0]->fragment_length_distr.flush();
 #pragma omp parallel
             {
                 auto our_mapper = mapper[omp_get_thread_num()];
@@ -1193,6 +1225,8 @@ int main_map(int argc, char** argv) {
                 }
             };
             stream::for_each_interleaved_pair_parallel(gam_in, lambda);
+            // Merge the fragment lengths that threads still had buffered
+            mapper[0]->fragment_length_distr.flush();
 #pragma omp parallel
             {
                 auto our_mapper = mapper[omp_get_thread_num()];
@@ -1237,6 +1271,10 @@ int main_map(int argc, char** argv) {
     }
 
     if (print_fragment_model) {
+        if (!mapper[0]->frag_stats.fixed_fragment_model) {
+            // Report the estimate from every thread's measurements
+            mapper[0]->frag_stats.update_cached_parameters();
+        }
         if (mapper[0]->frag_stats.fragment_size) {
             // we've calculated our fragment size, so print it and bail out
             cout << mapper[0]->frag_stats.fragment_model_str() << endl;
@@ -1254,6 +1292,12 @@ int main_map(int argc, char** argv) {
         }
     }
 
+    if (read_cache) {
+        read_cache->report(cerr);
+        delete read_cache;
+        read_cache = nullptr;
+    }
+
     // special cleanup for htslib outputs
     if (!surject_type.empty()) {
         if (hdr != nullptr) bam_hdr_destroy(hdr);
@@ -14,6 +14,8 @@
 #include "../cactus.hpp"
 #include "../stream.hpp"
 #include "../utility.hpp"
+#include "../packed_graph.hpp"
+#include "../prune.hpp"
 #include "../algorithms/topological_sort.hpp"
 #include "../algorithms/remove_high_degree.hpp"
 
@@ -81,6 +83,8 @@ void help_mod(char** argv) {
          << "    -a, --cactus            convert to cactus graph representation" << endl
          << "    -v, --sample-vcf FILE   for a graph with allele paths, compute the sample graph from the given VCF" << endl
          << "    -G, --sample-graph FILE subset an augmented graph to a sample graph using a Locus file" << endl
+         << "    -J, --packed            use the compact packed graph representation, which needs much less" << endl
+         << "                            memory; only -D, -O, -z, -c, -p, -M, -S, -X, -y and -t are supported" << endl
          << "    -t, --threads N         for tasks that can be done in parallel, use this many threads" << endl;
 }
 
@@ -118,7 +122,7 @@ int main_mod(int argc, char** argv) {
     bool retain_complement = false;
     vector<int64_t> root_nodes;
     int32_t context_steps;
-    bool remove_null;
+    bool remove_null = false;
     bool strong_connect = false;
     uint32_t unfold_to = 0;
     bool break_cycles = false;
@@ -135,6 +139,7 @@ int main_mod(int argc, char** argv) {
     string vcf_filename;
     string loci_filename;
     int max_degree = 0;
+    bool packed = false;
 
     int c;
     optind = 2; // force optind past command positional argument
@@ -188,11 +193,12 @@ int main_mod(int argc, char** argv) {
             {"sample-vcf", required_argument, 0, 'v'},
             {"sample-graph", required_argument, 0, 'G'},
             {"max-degree", required_argument, 0, 'M'},
+            {"packed", no_argument, 0, 'J'},
             {0, 0, 0, 0}
         };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "hk:oi:q:Q:cpl:e:mt:SX:KPsunzNAf:CDFr:Ig:x:RTU:Bbd:Ow:L:y:Z:Eav:G:M:",
+        c = getopt_long (argc, argv, "hk:oi:q:Q:cpl:e:mt:SX:KPsunzNAf:CDFr:Ig:x:RTU:Bbd:Ow:L:y:Z:Eav:G:M:J",
                 long_options, &option_index);
 
 
@@ -384,6 +390,10 @@ int main_mod(int argc, char** argv) {
             max_degree = atoi(optarg);
             break;
 
+        case 'J':
+            packed = true;
+            break;
+
         case 'h':
         case '?':
             help_mod(argv);
@@ -395,6 +405,84 @@ int main_mod(int argc, char** argv) {
         }
     }
 
+    if (packed) {
+        if (!aln_file.empty() || !loci_file.empty() || !translation_file.empty() || label_paths
+            || compact_ranks || !path_name.empty() || !paths_to_retain.empty() || retain_complement
+            || remove_orphans || add_start_and_end_markers || kill_labels || simplify_graph
+            || unchop || normalize_graph || until_normal_iter || remove_non_path || remove_path
+            || force_path_match || !root_nodes.empty() || remove_null || strong_connect || unfold_to
+            || break_cycles || dagify_steps || dagify_to || bluntify || flip_doubly_reversed_edges
+            || cactus || !vcf_filename.empty() || !loci_filename.empty()) {
+            cerr << "[vg mod]: --packed only supports -D, -O, -z, -c, -p, -M, -S, -X, -y, and -t" << endl;
+            return 1;
+        }
+
+        PackedGraph graph;
+        get_input_file(optind, argc, argv, [&](istream& in) {
+            graph.load(in);
+        });
+
+        // Apply the operations in the same order as for a VG
+        if (drop_paths) {
+            graph.clear_paths();
+        }
+
+        if (orient_forward) {
+            algorithms::orient_nodes_forward(&graph);
+        }
+
+        if (sort_graph) {
+            algorithms::sort(&graph);
+        }
+
+        if (compact_ids) {
+            algorithms::sort(&graph);
+            graph.compact_ids();
+        }
+
+        if (prune_complex) {
+            if (!(path_length > 0 && edge_max > 0)) {
+                cerr << "[vg mod]: when pruning complex regions you must specify a --path-length and --edge-max" << endl;
+                return 1;
+            }
+            prune_complex_with_head_tail(graph, path_length, edge_max);
+        }
+
+        if (max_degree) {
+            algorithms::remove_high_degree_nodes(graph, max_degree);
+        }
+
+        if (prune_subgraphs) {
+            prune_short_subgraphs(graph, path_length);
+        }
+
+        if (chop_to) {
+            // Divide all the nodes at once, so the paths are only rewritten once
+            vector<pair<handle_t, vector<size_t>>> to_chop;
+            graph.for_each_handle([&](const handle_t& handle) {
+                if (graph.get_length(handle) > (size_t) chop_to) {
+                    to_chop.emplace_back(handle, vector<size_t>());
+                    for (size_t offset = chop_to; offset < graph.get_length(handle); offset += chop_to) {
+                        to_chop.back().second.push_back(offset);
+                    }
+                }
+            });
+            graph.divide_handles(to_chop);
+        }
+
+        if (destroy_node_id > 0) {
+            if (!graph.has_node(destroy_node_id)) {
+                cerr << "[vg mod]: node " << destroy_node_id << " is not in the graph" << endl;
+                return 1;
+            }
+            graph.destroy_handle(graph.get_handle(destroy_node_id));
+        }
+
+        graph.serialize(std::cout);
+
+        return 0;
+    }
+
     VG* graph;
     get_input_file(optind, argc, argv, [&](istream& in) {
         graph = new VG(in);
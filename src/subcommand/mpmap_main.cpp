@@ -10,6 +10,7 @@
 
 #include "../multipath_mapper.hpp"
 #include "../path.hpp"
+#include "../snarl_index.hpp"
 
 //#define record_read_run_times
 
@@ -42,7 +43,7 @@ void help_mpmap(char** argv) {
     << "  -e, --same-strand         read pairs are from the same strand of the DNA molecule" << endl
     << "algorithm:" << endl
     << "  -S, --single-path-mode    produce single-path alignments (GAM) instead of multipath alignments (GAMP) (ignores -sua)" << endl
-    << "  -s, --snarls FILE         align to alternate paths in these snarls" << endl
+    << "  -s, --snarls FILE         align to alternate paths in these snarls (from vg snarls, or vg snarls -i)" << endl
     << "scoring:" << endl
     << "  -A, --no-qual-adjust      do not perform base quality adjusted alignments (required if input does not have base qualities)" << endl
     << endl
@@ -57,6 +58,7 @@ void help_mpmap(char** argv) {
     << "  -B, --no-calibrate        do not auto-calibrate mismapping dectection" << endl
     << "  -v, --mq-method OPT       mapping quality method: 0 - none, 1 - fast approximation, 2 - adaptive, 3 - exact [2]" << endl
     << "  -Q, --mq-max INT          cap mapping quality estimates at this much [60]" << endl
+    << "  --fast-exp-mq             compute mapping qualities with a faster approximate exponential" << endl
     << "  -p, --band-padding INT    pad dynamic programming bands in inter-MEM alignment by this much [2]" << endl
     << "  -u, --map-attempts INT    perform (up to) this many mappings per read (0 for no limit) [48]" << endl
     << "  -M, --max-multimaps INT   report (up to) this many mappings per read [1]" << endl
@@ -119,6 +121,7 @@ int main_mpmap(int argc, char** argv) {
     bool qual_adjusted = true;
     bool strip_full_length_bonus = false;
     MappingQualityMethod mapq_method = Adaptive;
+    bool fast_exp_mapping_quality = false;
     int band_padding = 2;
     int max_dist_error = 8;
     int num_alt_alns = 4;
@@ -171,6 +174,7 @@ int main_mpmap(int argc, char** argv) {
             {"no-calibrate", no_argument, 0, 'B'},
             {"mq-method", required_argument, 0, 'v'},
             {"mq-max", required_argument, 0, 'Q'},
+            {"fast-exp-mq", no_argument, 0, '3'},
             {"band-padding", required_argument, 0, 'p'},
             {"map-attempts", required_argument, 0, 'u'},
             {"max-multimaps", required_argument, 0, 'M'},
@@ -196,7 +200,7 @@ int main_mpmap(int argc, char** argv) {
         };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "hx:g:H:f:G:N:R:ieSs:u:a:nb:I:D:Bv:Q:p:M:r:W:k:K:c:d:w:C:R:q:z:o:y:L:mAt:Z:",
+        c = getopt_long (argc, argv, "hx:g:H:f:G:N:R:ieSs:u:a:nb:I:D:Bv:Q:3p:M:r:W:k:K:c:d:w:C:R:q:z:o:y:L:mAt:Z:",
                          long_options, &option_index);
 
 
@@ -436,6 +440,10 @@ int main_mpmap(int argc, char** argv) {
                 buffer_size = atoi(optarg);
                 break;
                 
+            case '3':
+                fast_exp_mapping_quality = true;
+                break;
+                
             case 'h':
             case '?':
             default:
@@ -653,7 +661,10 @@ int main_mpmap(int argc, char** argv) {
     }
     
     SnarlManager* snarl_manager = nullptr;
-    if (!snarls_name.empty()) {
+    if (!snarls_name.empty() && SnarlIndex::is_snarl_index(snarls_name)) {
+        // Map the index rather than parsing and indexing the snarls ourselves
+        snarl_manager = new SnarlManager(make_shared<const SnarlIndex>(snarls_name));
+    } else if (!snarls_name.empty()) {
         ifstream snarl_stream(snarls_name);
         if (!snarl_stream) {
             cerr << "error:[vg mpmap] Cannot open Snarls file " << snarls_name << endl;
@@ -693,6 +704,7 @@ int main_mpmap(int argc, char** argv) {
     // set mapping quality parameters
     multipath_mapper.mapping_quality_method = mapq_method;
     multipath_mapper.max_mapping_quality = max_mapq;
+    multipath_mapper.set_fast_exp_mapping_quality(fast_exp_mapping_quality);
     multipath_mapper.use_population_mapqs = (gbwt != nullptr);
     
     // set pruning and clustering parameters
@@ -968,6 +980,9 @@ int main_mpmap(int argc, char** argv) {
         get_input_file(gam_file_name, execute);
     }
 
+    // merge any fragment lengths that were still buffered when the threads ran out of reads
+    multipath_mapper.fragment_length_distr.flush();
+    
     // take care of any read pairs that we couldn't map unambiguously before the fragment length distribution
     // had been estimated
     if (!ambiguous_pair_buffer.empty()) {
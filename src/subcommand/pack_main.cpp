@@ -20,9 +20,63 @@ void help_pack(char** argv) {
          << "    -d, --as-table         write table on stdout representing packs" << endl
          << "    -n, --no-edits         don't record or write edits, just graph-matching coverage" << endl
          << "    -b, --bin-size N       number of sequence bases per CSA bin [default: inf]" << endl
+         << "    -R, --bed-in FILE      write the mean, min and max depth of each BED interval on a path in FILE" << endl
+         << "                           (could be '-' for stdin) to stdout, as path, start, end, mean, min, max" << endl
          << "    -t, --threads N        use N threads (defaults to numCPUs)" << endl;
 }
 
+/// A BED interval on a path
+struct PathInterval {
+    string path_name;
+    size_t start;
+    size_t end;
+};
+
+/// Stream BED intervals from in and write their depth statistics to out. The
+/// intervals are summarized in parallel in batches, and written in input order.
+static void write_bed_coverage(const Packer& packer, istream& in, ostream& out) {
+    const size_t batch_size = 10000;
+    vector<PathInterval> intervals;
+    vector<CoverageSummary> summaries;
+
+    auto flush_batch = [&]() {
+        summaries.resize(intervals.size());
+#pragma omp parallel for
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            summaries[i] = packer.path_coverage_summary(intervals[i].path_name, intervals[i].start, intervals[i].end);
+        }
+        for (size_t i = 0; i < intervals.size(); ++i) {
+            auto& summary = summaries[i];
+            out << intervals[i].path_name << "\t" << intervals[i].start << "\t" << intervals[i].end << "\t"
+                << summary.mean() << "\t" << (summary.length ? summary.min : 0) << "\t" << summary.max << "\n";
+        }
+        intervals.clear();
+    };
+
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#' || line.substr(0, 5) == "track" || line.substr(0, 7) == "browser") {
+            continue;
+        }
+        PathInterval interval;
+        stringstream fields(line);
+        if (!(fields >> interval.path_name >> interval.start >> interval.end)) {
+            cerr << "error:[vg pack] could not parse BED line: " << line << endl;
+            exit(1);
+        }
+        // check up front, since we can't report errors from the parallel loop
+        if (!packer.xgidx->path_rank(interval.path_name)) {
+            cerr << "error:[vg pack] BED path " << interval.path_name << " is not in the graph" << endl;
+            exit(1);
+        }
+        intervals.push_back(interval);
+        if (intervals.size() >= batch_size) {
+            flush_batch();
+        }
+    }
+    flush_batch();
+}
+
 int main_pack(int argc, char** argv) {
 
     string xg_name;
@@ -33,6 +87,7 @@ int main_pack(int argc, char** argv) {
     int thread_count = 1;
     bool record_edits = true;
     size_t bin_size = 0;
+    string bed_in;
 
     if (argc == 2) {
         help_pack(argv);
@@ -53,11 +108,12 @@ int main_pack(int argc, char** argv) {
             {"threads", required_argument, 0, 't'},
             {"no-edits", no_argument, 0, 'n'},
             {"bin-size", required_argument, 0, 'b'},
+            {"bed-in", required_argument, 0, 'R'},
             {0, 0, 0, 0}
 
         };
         int option_index = 0;
-        c = getopt_long (argc, argv, "hx:o:i:g:dt:nb:",
+        c = getopt_long (argc, argv, "hx:o:i:g:dt:nb:R:",
                 long_options, &option_index);
 
         // Detect the end of the options.
@@ -95,6 +151,9 @@ int main_pack(int argc, char** argv) {
         case 't':
             thread_count = atoi(optarg);
             break;
+        case 'R':
+            bed_in = optarg;
+            break;
 
         default:
             abort();
@@ -112,9 +171,8 @@ int main_pack(int argc, char** argv) {
         xgidx.load(in);
     }
 
-    // todo one packer per thread and merge
-
-    vg::Packer packer(&xgidx, bin_size);
+    // With more than one thread, all threads add reads to the one packer at once
+    vg::Packer packer(&xgidx, bin_size, thread_count > 1 && !gam_in.empty());
     if (packs_in.size() == 1) {
         packer.load_from_file(packs_in.front());
     } else if (packs_in.size() > 1) {
@@ -122,16 +180,8 @@ int main_pack(int argc, char** argv) {
     }
 
     if (!gam_in.empty()) {
-        vector<vg::Packer*> packers;
-        if (thread_count == 1) {
-            packers.push_back(&packer);
-        } else {
-            for (size_t i = 0; i < thread_count; ++i) {
-                packers.push_back(new Packer(&xgidx, bin_size));
-            }
-        }
-        std::function<void(Alignment&)> lambda = [&packer,&record_edits,&packers](Alignment& aln) {
-            packers[omp_get_thread_num()]->add(aln, record_edits);
+        std::function<void(Alignment&)> lambda = [&packer,&record_edits](Alignment& aln) {
+            packer.add(aln, record_edits);
         };
         if (gam_in == "-") {
             stream::for_each_parallel(std::cin, lambda);
@@ -140,15 +190,6 @@ int main_pack(int argc, char** argv) {
             stream::for_each_parallel(gam_stream, lambda);
             gam_stream.close();
         }
-        if (thread_count == 1) {
-            packers.clear();
-        } else {
-            packer.merge_from_dynamic(packers);
-            for (auto& p : packers) {
-                delete p;
-            }
-            packers.clear();
-        }
     }
 
     if (!packs_out.empty()) {
@@ -158,6 +199,12 @@ int main_pack(int argc, char** argv) {
         packer.make_compact();
         packer.as_table(cout, record_edits);
     }
+    if (!bed_in.empty()) {
+        packer.make_compact();
+        get_input_file(bed_in, [&](istream& in) {
+            write_bed_coverage(packer, in, cout);
+        });
+    }
 
     return 0;
 }
@@ -16,7 +16,9 @@
  * maps to the original graph.
  */
 
+#include "../packed_graph.hpp"
 #include "../phase_unfolder.hpp"
+#include "../prune.hpp"
 #include "subcommand.hpp"
 
 #include <gbwt/gbwt.h>
@@ -90,6 +92,7 @@ void help_prune(char** argv) {
     std::cerr << "    -p, --progress         show progress" << std::endl;
     std::cerr << "    -t, --threads N        use N threads (default: " << omp_get_max_threads() << ")" << std::endl;
     std::cerr << "    -d, --dry-run          determine the validity of the parameter combination" << std::endl;
+    std::cerr << "    -J, --packed           use the compact packed graph representation (default mode only)" << std::endl;
 }
 
 int main_prune(int argc, char** argv) {
@@ -105,7 +108,7 @@ int main_prune(int argc, char** argv) {
     size_t subgraph_min = PruningParameters::SUBGRAPH_MIN;
     PruningMode mode = mode_prune;
     int threads = omp_get_max_threads();
-    bool verify_paths = false, append_mapping = false, show_progress = false, dry_run = false;
+    bool verify_paths = false, append_mapping = false, show_progress = false, dry_run = false, packed = false;
     std::string vg_name, gbwt_name, xg_name, mapping_name;
 
     // Derived variables.
@@ -130,11 +133,12 @@ int main_prune(int argc, char** argv) {
             { "progress", no_argument, 0, 'p' },
             { "threads", required_argument, 0, 't' },
             { "dry-run", no_argument, 0, 'd' },
+            { "packed", no_argument, 0, 'J' },
             { 0, 0, 0, 0 }
         };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "k:e:s:Prux:vg:m:apt:d", long_options, &option_index);
+        c = getopt_long (argc, argv, "k:e:s:Prux:vg:m:apt:dJ", long_options, &option_index);
         if (c == -1) { break; } // End of options.
 
         switch (c)
@@ -187,6 +191,9 @@ int main_prune(int argc, char** argv) {
         case 'd':
             dry_run = true;
             break;
+        case 'J':
+            packed = true;
+            break;
 
         case 'h':
         case '?':
@@ -221,6 +228,10 @@ int main_prune(int argc, char** argv) {
             return 1;
         }
     }
+    if (packed && mode != mode_prune) {
+        std::cerr << "[vg prune]: mode " << mode_name(mode) << " does not support --packed" << std::endl;
+        return 1;
+    }
     if (mode == mode_preserve) {
         if (!(xg_name.empty() && gbwt_name.empty() && mapping_name.empty())) {
             std::cerr << "[vg prune]: mode " << mode_name(mode) << " does not use additional files" << std::endl;
@@ -269,6 +280,9 @@ int main_prune(int argc, char** argv) {
         if (dry_run) {
             std::cerr << " --dry-run";
         }
+        if (packed) {
+            std::cerr << " --packed";
+        }
         std::cerr << std::endl;
         if (!vg_name.empty()) {
             std::cerr << "VG:             " << vg_name << std::endl;
@@ -285,6 +299,37 @@ int main_prune(int argc, char** argv) {
         return 0;
     }
 
+    // The packed graph only supports plain pruning, which needs no paths.
+    if (packed) {
+        PackedGraph graph;
+        get_input_file(vg_name, [&](std::istream& in) {
+            graph.load(in);
+        });
+        if (show_progress) {
+            std::cerr << "Original graph " << vg_name << ": " << graph.node_size() << " nodes, " << graph.edge_count() << " edges" << std::endl;
+        }
+        graph.clear_paths();
+        if (show_progress) {
+            std::cerr << "Removed all paths" << std::endl;
+        }
+        prune_complex_with_head_tail(graph, kmer_length, edge_max);
+        if (show_progress) {
+            std::cerr << "Pruned complex regions: "
+                      << graph.node_size() << " nodes, " << graph.edge_count() << " edges" << std::endl;
+        }
+        prune_short_subgraphs(graph, subgraph_min);
+        if (show_progress) {
+            std::cerr << "Removed small subgraphs: "
+                      << graph.node_size() << " nodes, " << graph.edge_count() << " edges" << std::endl;
+        }
+        graph.serialize(std::cout);
+        if (show_progress) {
+            std::cerr << "Serialized the graph: "
+                      << graph.node_size() << " nodes, " << graph.edge_count() << " edges" << std::endl;
+        }
+        return 0;
+    }
+
     // Handle the input.
     VG* graph;
     get_input_file(vg_name, [&](std::istream& in) {
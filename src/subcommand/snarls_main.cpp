@@ -13,6 +13,7 @@
 #include "../vg.hpp"
 #include "vg.pb.h"
 #include "../traversal_finder.hpp"
+#include "../snarl_index.hpp"
 
 
 using namespace std;
@@ -29,7 +30,10 @@ void help_snarl(char** argv) {
          << "    -o, --top-level       restrict traversals to top level ultrabubbles" << endl
          << "    -m, --max-nodes N     only compute traversals for snarls with <= N nodes [10]" << endl
          << "    -t, --filter-trivial  don't report snarls that consist of a single edge" << endl
-         << "    -s, --sort-snarls     return snarls in sorted order by node ID (for topologically ordered graphs)" << endl;
+         << "    -s, --sort-snarls     return snarls in sorted order by node ID (for topologically ordered graphs)" << endl
+         << "    -T, --threads N       decompose up to N connected components at once" << endl
+         << "    -a, --algorithm NAME  find snarls with 'cactus' or 'handle' (3-edge-connected components, less memory) [cactus]" << endl
+         << "    -i, --index FILE      also write a memory-mappable snarl index to FILE" << endl;
 }
 
 int main_snarl(int argc, char** argv) {
@@ -48,6 +52,8 @@ int main_snarl(int argc, char** argv) {
     bool filter_trivial_snarls = false;
     bool sort_snarls = false;
     bool fill_path_names = false;
+    string algorithm = "cactus";
+    string index_file;
 
     int c;
     optind = 2; // force optind past command positional argument
@@ -61,12 +67,15 @@ int main_snarl(int argc, char** argv) {
                 {"max-nodes", required_argument, 0, 'm'},
                 {"filter-trivial", no_argument, 0, 't'},
                 {"sort-snarls", no_argument, 0, 's'},
+                {"threads", required_argument, 0, 'T'},
+                {"algorithm", required_argument, 0, 'a'},
+                {"index", required_argument, 0, 'i'},
                 {0, 0, 0, 0}
             };
 
         int option_index = 0;
 
-        c = getopt_long (argc, argv, "sr:ltopm:h?",
+        c = getopt_long (argc, argv, "sr:ltopm:T:a:i:h?",
                          long_options, &option_index);
 
         /* Detect the end of the options. */
@@ -103,6 +112,18 @@ int main_snarl(int argc, char** argv) {
             fill_path_names = true;
             break;
             
+        case 'T':
+            omp_set_num_threads(atoi(optarg));
+            break;
+
+        case 'a':
+            algorithm = optarg;
+            break;
+
+        case 'i':
+            index_file = optarg;
+            break;
+            
         case 'h':
         case '?':
             /* getopt_long already printed an error message. */
@@ -116,6 +137,11 @@ int main_snarl(int argc, char** argv) {
         }
     }
 
+    if (algorithm != "cactus" && algorithm != "handle") {
+        cerr << "error:[vg snarl]: Unknown snarl finding algorithm \"" << algorithm << "\"" << endl;
+        return 1;
+    }
+
     // Prepare traversal output stream
     ofstream trav_stream;
     if (!traversal_file.empty()) {
@@ -138,13 +164,20 @@ int main_snarl(int argc, char** argv) {
         exit(1);
     }
 
-    // The only implemented snarl finder:
-    SnarlFinder* snarl_finder = new CactusSnarlFinder(*graph);
+    // Only the Cactus snarl finder can hand out one component at a time
+    SnarlFinder* snarl_finder;
+    CactusSnarlFinder* cactus_finder = nullptr;
+    if (algorithm == "cactus") {
+        cactus_finder = new CactusSnarlFinder(*graph);
+        snarl_finder = cactus_finder;
+    } else {
+        snarl_finder = new HandleGraphSnarlFinder(*graph);
+    }
     
-    // Load up all the snarls
-    SnarlManager snarl_manager = snarl_finder->find_snarls();
-    vector<const Snarl*> snarl_roots = snarl_manager.top_level_snarls();
     if (fill_path_names){
+        // Load up all the snarls
+        SnarlManager snarl_manager = snarl_finder->find_snarls();
+        vector<const Snarl*> snarl_roots = snarl_manager.top_level_snarls();
         TraversalFinder* trav_finder = new PathBasedTraversalFinder(*graph, snarl_manager);
         for (const Snarl* snarl : snarl_roots ){
             if (filter_trivial_snarls && snarl->type() == ULTRABUBBLE) {
@@ -165,11 +198,96 @@ int main_snarl(int argc, char** argv) {
         exit(0);
     }
 
+    // Protobuf output buffers
+    vector<Snarl> snarl_buffer;
+    vector<SnarlTraversal> traversal_buffer;
+    
+    // Write out the snarl trees under the given roots, and their traversals
+    auto write_snarls = [&](SnarlManager& snarl_manager, const vector<const Snarl*>& snarl_roots) {
+    
+        TraversalFinder* trav_finder = new ExhaustiveTraversalFinder(*graph, snarl_manager);
+        
+        list<const Snarl*> stack;
 
-    TraversalFinder* trav_finder = new ExhaustiveTraversalFinder(*graph, snarl_manager);
+        for (const Snarl* root : snarl_roots) {
+            
+            stack.push_back(root);
+            
+            while (!stack.empty()) {
+                const Snarl* snarl = stack.back();
+                stack.pop_back();
+                
+                if (filter_trivial_snarls && snarl->type() == ULTRABUBBLE) {
+                    auto contents = snarl_manager.shallow_contents(snarl, *graph, false);
+                    if (contents.first.empty()) {
+                        // Nothing but the boundary nodes in this snarl
+                        continue;
+                    }
+                }
+                
+                // Write our snarl tree
+                snarl_buffer.push_back(*snarl);
+                stream::write_buffered(cout, snarl_buffer, buffer_size);
+                
+                // Optionally write our traversals
+                if (!traversal_file.empty() && snarl->type() == ULTRABUBBLE &&
+                    (!leaf_only || snarl_manager.is_leaf(snarl)) &&
+                    (!top_level_only || snarl_manager.is_root(snarl)) &&
+                    (snarl_manager.deep_contents(snarl, *graph, true).first.size() < max_nodes)) {
+                    
+#ifdef debug
+                    cerr << "Look for traversals of " << pb2json(*snarl) << endl;
+#endif
+                    vector<SnarlTraversal> travs = trav_finder->find_traversals(*snarl);
+#ifdef debug        
+                    cerr << "Found " << travs.size() << endl;
+#endif
+                    
+                    traversal_buffer.insert(traversal_buffer.end(), travs.begin(), travs.end());
+                    stream::write_buffered(trav_stream, traversal_buffer, buffer_size);
+                }
+                
+                // Sort the child snarls by node ID?
+                if (sort_snarls) {
+                    vector<const Snarl*> children = snarl_manager.children_of(snarl);
+                    std::sort(children.begin(), children.end(), [](const Snarl* snarl_1, const Snarl* snarl_2) {
+                        return snarl_1->start().node_id() < snarl_2->end().node_id();
+                    });
+                    
+                    for (const Snarl* child_snarl : children) {
+                        stack.push_back(child_snarl);
+                    }
+                }
+                else {
+                    for (const Snarl* child_snarl : snarl_manager.children_of(snarl)) {
+                        stack.push_back(child_snarl);
+                    }
+                }
+            }
+        }
+        
+        delete trav_finder;
+    };
+    
+    // Save the whole snarl tree in the index format, if we want it
+    auto write_index = [&](const SnarlManager& snarl_manager) {
+        if (index_file.empty()) {
+            return;
+        }
+        ofstream index_stream(index_file, ios::binary);
+        if (!index_stream) {
+            cerr << "error:[vg snarl]: Could not open \"" << index_file
+                 << "\" for writing" << endl;
+            exit(1);
+        }
+        SnarlIndex(snarl_manager).serialize(index_stream);
+    };
     
-    // Sort the top level Snarls
     if (sort_snarls) {
+        // Sorting has to see all the top level snarls at once, so load up all the snarls
+        SnarlManager snarl_manager = snarl_finder->find_snarls();
+        vector<const Snarl*> snarl_roots = snarl_manager.top_level_snarls();
+        
         // Ensure that all snarls are stored in sorted order
         list<const Snarl*> snarl_stack;
         for (const Snarl* root : snarl_roots) {
@@ -190,74 +308,26 @@ int main_snarl(int argc, char** argv) {
         std::sort(snarl_roots.begin(), snarl_roots.end(), [](const Snarl* snarl_1, const Snarl* snarl_2) {
             return snarl_1->start().node_id() < snarl_2->end().node_id();
         });
-    }
-
-  
-
-    // Protobuf output buffers
-    vector<Snarl> snarl_buffer;
-    vector<SnarlTraversal> traversal_buffer;
-    
-    list<const Snarl*> stack;
-
-    for (const Snarl* root : snarl_roots) {
         
-        stack.push_back(root);
-        
-        while (!stack.empty()) {
-            const Snarl* snarl = stack.back();
-            stack.pop_back();
-            
-            if (filter_trivial_snarls && snarl->type() == ULTRABUBBLE) {
-                auto contents = snarl_manager.shallow_contents(snarl, *graph, false);
-                if (contents.first.empty()) {
-                    // Nothing but the boundary nodes in this snarl
-                    continue;
-                }
+        write_snarls(snarl_manager, snarl_roots);
+        write_index(snarl_manager);
+    } else if (cactus_finder != nullptr) {
+        // Write out each connected component's snarls as soon as they are
+        // ready, and only hold on to them if we need them all for the index
+        SnarlManager all_snarls;
+        cactus_finder->for_each_component_snarls([&](SnarlManager& snarl_manager) {
+            write_snarls(snarl_manager, snarl_manager.top_level_snarls());
+            if (!index_file.empty()) {
+                all_snarls.extend(std::move(snarl_manager));
             }
-            
-            // Write our snarl tree
-            snarl_buffer.push_back(*snarl);
-            stream::write_buffered(cout, snarl_buffer, buffer_size);
-            
-            // Optionally write our traversals
-            if (!traversal_file.empty() && snarl->type() == ULTRABUBBLE &&
-                (!leaf_only || snarl_manager.is_leaf(snarl)) &&
-                (!top_level_only || snarl_manager.is_root(snarl)) &&
-                (snarl_manager.deep_contents(snarl, *graph, true).first.size() < max_nodes)) {
-                
-#ifdef debug
-                cerr << "Look for traversals of " << pb2json(*snarl) << endl;
-#endif
-                vector<SnarlTraversal> travs = trav_finder->find_traversals(*snarl);
-#ifdef debug        
-                cerr << "Found " << travs.size() << endl;
-#endif
-                
-                traversal_buffer.insert(traversal_buffer.end(), travs.begin(), travs.end());
-                stream::write_buffered(trav_stream, traversal_buffer, buffer_size);
-            }
-            
-            // Sort the child snarls by node ID?
-            if (sort_snarls) {
-                vector<const Snarl*> children = snarl_manager.children_of(snarl);
-                std::sort(children.begin(), children.end(), [](const Snarl* snarl_1, const Snarl* snarl_2) {
-                    return snarl_1->start().node_id() < snarl_2->end().node_id();
-                });
-                
-                for (const Snarl* child_snarl : children) {
-                    stack.push_back(child_snarl);
-                }
-            }
-            else {
-                for (const Snarl* child_snarl : snarl_manager.children_of(snarl)) {
-                    stack.push_back(child_snarl);
-                }
-            }
-        }
-        
-        
+        });
+        write_index(all_snarls);
+    } else {
+        SnarlManager snarl_manager = snarl_finder->find_snarls();
+        write_snarls(snarl_manager, snarl_manager.top_level_snarls());
+        write_index(snarl_manager);
     }
+    
     // flush
     stream::write_buffered(cout, snarl_buffer, 0);
     if (!traversal_file.empty()) {
@@ -265,7 +335,6 @@ int main_snarl(int argc, char** argv) {
     }
     
     delete snarl_finder;
-    delete trav_finder;
     delete graph;
 
     return 0;
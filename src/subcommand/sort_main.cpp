@@ -14,6 +14,7 @@
 
 #include "../vg.hpp"
 #include "../flow_sort.hpp"
+#include "../packed_graph.hpp"
 
 
 using namespace std;
@@ -28,6 +29,7 @@ void help_sort(char** argv){
          << "           -r, --ref              reference name" << endl
          << "           -w, --without-grooming no grooming mode" << endl
          << "           -f, --fast             sort using Eades algorithm, otherwise max-flow sorting is used" << endl   
+         << "           -J, --packed           use the compact packed graph representation (requires -f; no grooming)" << endl
          << endl;
 }
 
@@ -39,6 +41,7 @@ int main_sort(int argc, char *argv[]) {
     string reference_name = "";
     bool without_grooming = false;
     bool use_fast_algorithm = false;
+    bool packed = false;
     int c;
     while (true) {
         static struct option long_options[] =
@@ -48,11 +51,12 @@ int main_sort(int argc, char *argv[]) {
                 {"ref", required_argument, 0, 'r'},
                 {"without-grooming", no_argument, 0, 'w'},
                 {"fast", no_argument, 0, 'f'},
+                {"packed", no_argument, 0, 'J'},
                 {0, 0, 0, 0}
             };
 
         int option_index = 0;
-        c = getopt_long (argc, argv, "i:r:gwf",
+        c = getopt_long (argc, argv, "i:r:gwfJ",
                          long_options, &option_index);
 
         /* Detect the end of the options. */
@@ -76,6 +80,9 @@ int main_sort(int argc, char *argv[]) {
         case 'f':
             use_fast_algorithm = true;
             break;
+        case 'J':
+            packed = true;
+            break;
         case 'h':
         case '?':
             /* getopt_long already printed an error message. */
@@ -91,6 +98,20 @@ int main_sort(int argc, char *argv[]) {
         help_sort(argv);
         exit(1);
     }
+
+    if (packed) {
+        if (gfa_input || !use_fast_algorithm) {
+            cerr << "error:[vg sort] --packed only supports the fast sort (-f) of a .vg graph" << endl;
+            exit(1);
+        }
+        PackedGraph graph;
+        get_input_file(file_name, [&](istream& in) {
+            graph.load(in);
+        });
+        FlowSort::fast_linear_sort(graph, reference_name);
+        graph.serialize(std::cout);
+        return 0;
+    }
     
     ifstream in;
     std::unique_ptr<VG> graph;
@@ -0,0 +1,119 @@
+/**
+ * unittest/cluster.cpp: test cases for pairing up MEM clusters between read ends
+ */
+
+#include "catch.hpp"
+#include "cluster.hpp"
+#include "json2pb.h"
+#include "xg.hpp"
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+TEST_CASE("Pairing clusters by path projection agrees with the distance tree", "[cluster][mapping]") {
+
+    // A reference path over 1, 2 and 3, another path over 4 and 5 that
+    // continues on from it, and a separate component with its own path
+    const string graph_json = R"(
+
+    {
+        "node": [
+            {"id": 1, "sequence": "CAAATAAGGC"},
+            {"id": 2, "sequence": "TTGGAAATTT"},
+            {"id": 3, "sequence": "TCTGGAGTTC"},
+            {"id": 4, "sequence": "TATTATATCC"},
+            {"id": 5, "sequence": "AACTCTCTGA"},
+            {"id": 6, "sequence": "GCCTCCAAGT"},
+            {"id": 7, "sequence": "AATGGAAGCA"}
+        ],
+        "edge": [
+            {"from": 1, "to": 2},
+            {"from": 2, "to": 3},
+            {"from": 3, "to": 4},
+            {"from": 4, "to": 5},
+            {"from": 6, "to": 7}
+        ],
+        "path": [
+            {"name": "ref", "mapping": [
+                {"position": {"node_id": 1}, "rank": 1},
+                {"position": {"node_id": 2}, "rank": 2},
+                {"position": {"node_id": 3}, "rank": 3}
+            ]},
+            {"name": "other", "mapping": [
+                {"position": {"node_id": 4}, "rank": 1},
+                {"position": {"node_id": 5}, "rank": 2}
+            ]},
+            {"name": "island", "mapping": [
+                {"position": {"node_id": 6}, "rank": 1},
+                {"position": {"node_id": 7}, "rank": 2}
+            ]}
+        ]
+    }
+
+    )";
+
+    Graph graph;
+    json2pb(graph, graph_json.c_str(), graph_json.size());
+    xg::XG xg_index(graph);
+
+    Alignment read_1, read_2;
+    read_1.set_sequence("CAAATAAGGCTTGGAAATTT");
+    read_2.set_sequence("TCTGGAGTTCTATTATATCC");
+
+    // Each cluster is a single 10 bp MEM at the start of its read
+    MaximalExactMatch mem_1(read_1.sequence().begin(), read_1.sequence().begin() + 10, gcsa::range_type(0, 0));
+    MaximalExactMatch mem_2(read_2.sequence().begin(), read_2.sequence().begin() + 10, gcsa::range_type(0, 0));
+
+    vector<OrientedDistanceClusterer::cluster_t> left {
+        {{&mem_1, make_pos_t(1, false, 0)}},
+        {{&mem_1, make_pos_t(2, false, 5)}},
+        {{&mem_1, make_pos_t(6, false, 0)}}
+    };
+    vector<OrientedDistanceClusterer::cluster_t> right {
+        // on the reference path with the first two left clusters
+        {{&mem_2, make_pos_t(3, false, 5)}},
+        // only on the other path, so it shares no path with any left cluster
+        {{&mem_2, make_pos_t(5, false, 0)}},
+        // on the separate component with the last left cluster
+        {{&mem_2, make_pos_t(7, false, 5)}}
+    };
+    vector<OrientedDistanceClusterer::cluster_t*> left_clusters, right_clusters;
+    for (auto& cluster : left) {
+        left_clusters.push_back(&cluster);
+    }
+    for (auto& cluster : right) {
+        right_clusters.push_back(&cluster);
+    }
+
+    OrientedDistanceClusterer::paths_of_node_memo_t paths_of_node_memo;
+    OrientedDistanceClusterer::oriented_occurences_memo_t oriented_occurences_memo;
+    OrientedDistanceClusterer::handle_memo_t handle_memo;
+
+    auto projected = OrientedDistanceClusterer::pair_clusters(read_1, read_2, left_clusters, right_clusters,
+                                                              &xg_index, 0, 200, false, &paths_of_node_memo,
+                                                              &oriented_occurences_memo, &handle_memo);
+    auto from_tree = OrientedDistanceClusterer::pair_clusters_by_distance_tree(read_1, read_2, left_clusters, right_clusters,
+                                                                               &xg_index, 0, 200, false, &paths_of_node_memo,
+                                                                               &oriented_occurences_memo, &handle_memo);
+
+    sort(projected.begin(), projected.end());
+    sort(from_tree.begin(), from_tree.end());
+
+    SECTION("Both find the same pairs at the same distances") {
+        REQUIRE(projected == from_tree);
+    }
+
+    SECTION("Pairs that share no path are still found") {
+        set<pair<size_t, size_t>> pairs;
+        for (auto& found : projected) {
+            pairs.insert(found.first);
+        }
+        set<pair<size_t, size_t>> expected {{0, 0}, {0, 1}, {1, 0}, {1, 1}, {2, 2}};
+        REQUIRE(pairs == expected);
+    }
+}
+
+}
+}
@@ -1264,5 +1264,80 @@ GATTACACATTAG
 
 }
 
+
+TEST_CASE( "Constructing chunks in parallel gives the same graph as a serial build", "[constructor]" ) {
+
+    // Make two contigs of pseudorandom sequence, with variants dense enough to
+    // fill many small chunks
+    string fasta_data;
+    stringstream vcf_data;
+    vcf_data << "##fileformat=VCFv4.0" << endl
+        << "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">" << endl
+        << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT" << endl;
+    uint32_t state = 12345;
+    for (string contig : {"ref1", "ref2"}) {
+        string sequence;
+        for (size_t i = 0; i < 3000; i++) {
+            state = state * 1103515245 + 12345;
+            sequence.push_back("ACGT"[(state >> 16) % 4]);
+        }
+        fasta_data += ">" + contig + "\n" + sequence + "\n";
+        for (size_t pos = 10; pos + 10 < sequence.size(); pos += 7 + pos % 13) {
+            // 1-based VCF positions
+            if (pos % 5 == 0) {
+                vcf_data << contig << "\t" << pos + 1 << "\t.\t" << sequence.substr(pos, 3) << "\t"
+                    << sequence[pos] << "\t29\tPASS\t.\tGT" << endl;
+            } else {
+                char alt = sequence[pos] == 'A' ? 'C' : 'A';
+                vcf_data << contig << "\t" << pos + 1 << "\t.\t" << sequence[pos] << "\t"
+                    << alt << "\t29\tPASS\t.\tGT" << endl;
+            }
+        }
+    }
+
+    string fasta_filename = tmpfilename();
+    ofstream fasta_stream(fasta_filename);
+    fasta_stream << fasta_data;
+    fasta_stream.close();
+
+    // Build the graph with the given number of threads and serialize the
+    // chunks in the order they come out
+    auto construct_with_threads = [&](int threads) {
+        stringstream vcf_stream(vcf_data.str());
+        vcflib::VariantCallFile vcf;
+        vcf.open(vcf_stream);
+        vector<vcflib::VariantCallFile*> vcf_pointers {&vcf};
+        FastaReference reference;
+        reference.open(fasta_filename);
+        vector<FastaReference*> fasta_pointers {&reference};
+        vector<FastaReference*> ins_pointers;
+
+        vector<string> serialized;
+        auto callback = [&](Graph& constructed) {
+            serialized.emplace_back();
+            constructed.SerializeToString(&serialized.back());
+        };
+
+        Constructor constructor;
+        constructor.alt_paths = true;
+        constructor.max_node_size = 50;
+        constructor.vars_per_chunk = 5;
+        constructor.bases_per_chunk = 100;
+
+        int old_threads = omp_get_max_threads();
+        omp_set_num_threads(threads);
+        constructor.construct_graph(fasta_pointers, vcf_pointers, ins_pointers, callback);
+        omp_set_num_threads(old_threads);
+        return serialized;
+    };
+
+    auto serial = construct_with_threads(1);
+    auto parallel = construct_with_threads(4);
+    remove(fasta_filename.c_str());
+
+    REQUIRE(serial.size() > 20);
+    REQUIRE(parallel == serial);
+}
+
 }
 }
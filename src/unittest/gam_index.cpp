@@ -0,0 +1,116 @@
+/**
+ * unittest/gam_index.cpp: test cases for the node range index over sorted GAMs
+ */
+
+#include "catch.hpp"
+#include "../gam_index.hpp"
+#include "../gamsorter.hpp"
+#include "../stream.hpp"
+
+#include <set>
+#include <sstream>
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+/// Make an alignment visiting the given nodes in order
+static Alignment make_indexable_alignment(size_t index, const vector<id_t>& nodes) {
+    Alignment aln;
+    aln.set_name("read" + to_string(index));
+    for (id_t node_id : nodes) {
+        aln.mutable_path()->add_mapping()->mutable_position()->set_node_id(node_id);
+    }
+    return aln;
+}
+
+/// Get the names of the alignments that visit a node in any of the ranges
+static set<string> expected_names(const vector<Alignment>& alns, const vector<pair<id_t, id_t>>& ranges) {
+    set<string> names;
+    for (auto& aln : alns) {
+        for (auto& mapping : aln.path().mapping()) {
+            for (auto& range : ranges) {
+                if (mapping.position().node_id() >= range.first && mapping.position().node_id() <= range.second) {
+                    names.insert(aln.name());
+                }
+            }
+        }
+    }
+    return names;
+}
+
+TEST_CASE("GAMIndex finds alignments in a sorted GAM by node ID", "[gamsort][gamindex]") {
+
+    // Mostly short reads, some unmapped, and some long reads that double back
+    // to much lower IDs than they sort at
+    vector<Alignment> input;
+    for (size_t i = 0; i < 5000; i++) {
+        id_t start = 1 + (i * 104729) % 2000;
+        if (i % 5 == 0) {
+            input.push_back(make_indexable_alignment(i, {}));
+        }
+        else if (i % 101 == 0) {
+            input.push_back(make_indexable_alignment(i, {start, start / 3 + 1, start + 1}));
+        }
+        else {
+            input.push_back(make_indexable_alignment(i, {start, start + 1, start + 2}));
+        }
+    }
+
+    stringstream unsorted;
+    vector<Alignment> to_write = input;
+    stream::write_buffered(unsorted, to_write, 0);
+
+    GAMIndex index;
+    stringstream sorted;
+    GAMSorter sorter(20000);
+    sorter.stream_sort(unsorted, sorted, false, &index);
+
+    // Output comes in chunks of 1000 reads, and the chunk of only unmapped
+    // reads at the end isn't indexed
+    REQUIRE(index.chunk_count() == 4);
+
+    // The index survives a round trip
+    stringstream saved;
+    index.save(saved);
+    GAMIndex loaded;
+    loaded.load(saved);
+    REQUIRE(loaded.chunk_count() == index.chunk_count());
+
+    SECTION("Range queries find exactly the alignments that visit the ranges") {
+        vector<vector<pair<id_t, id_t>>> queries {
+            {{1, 1}},
+            {{500, 520}},
+            {{100, 110}, {1500, 1600}, {105, 120}},
+            {{1999, 5000}},
+            {{3000, 4000}}
+        };
+        for (auto& ranges : queries) {
+            set<string> found;
+            loaded.find(sorted, ranges, [&](const Alignment& aln) {
+                // Each alignment comes out once
+                REQUIRE(found.count(aln.name()) == 0);
+                found.insert(aln.name());
+            });
+            REQUIRE(found == expected_names(input, ranges));
+        }
+    }
+
+    SECTION("ID queries find exactly the alignments that visit the IDs") {
+        vector<id_t> ids {7, 8, 9, 300, 1201, 1203};
+        vector<pair<id_t, id_t>> ranges;
+        for (id_t id : ids) {
+            ranges.emplace_back(id, id);
+        }
+        set<string> found;
+        loaded.find(sorted, ids, [&](const Alignment& aln) {
+            found.insert(aln.name());
+        });
+        REQUIRE(!found.empty());
+        REQUIRE(found == expected_names(input, ranges));
+    }
+}
+
+}
+}
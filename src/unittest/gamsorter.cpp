@@ -0,0 +1,115 @@
+/**
+ * unittest/gamsorter.cpp: test cases for sorting GAM streams
+ */
+
+#include "catch.hpp"
+#include "../gamsorter.hpp"
+#include "../stream.hpp"
+
+#include <sstream>
+#include <limits>
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+/// Make an alignment named by its input index, mapped at the given node and
+/// offset, or unmapped if the node is 0
+static Alignment make_sortable_alignment(size_t index, int64_t node_id, int64_t offset) {
+    Alignment aln;
+    aln.set_name("read" + to_string(index));
+    aln.set_sequence("GATTACA");
+    if (node_id != 0) {
+        Mapping* mapping = aln.mutable_path()->add_mapping();
+        mapping->mutable_position()->set_node_id(node_id);
+        mapping->mutable_position()->set_offset(offset);
+    }
+    return aln;
+}
+
+/// Get the key an alignment should be sorted by
+static pair<int64_t, int64_t> expected_key(const Alignment& aln) {
+    if (aln.path().mapping_size() == 0) {
+        return make_pair(numeric_limits<int64_t>::max(), numeric_limits<int64_t>::max());
+    }
+    return make_pair(aln.path().mapping(0).position().node_id(), aln.path().mapping(0).position().offset());
+}
+
+static vector<Alignment> read_all(const string& gam) {
+    vector<Alignment> alns;
+    stringstream in(gam);
+    function<void(Alignment&)> collect = [&](Alignment& aln) {
+        alns.push_back(aln);
+    };
+    stream::for_each(in, collect);
+    return alns;
+}
+
+TEST_CASE("GAMSorter sorts GAM streams with bounded memory", "[gamsort]") {
+
+    // Make a bunch of reads with lots of ties and some unmapped
+    vector<Alignment> input;
+    for (size_t i = 0; i < 2000; i++) {
+        int64_t node_id = (i * 7919) % 13 == 0 ? 0 : 1 + (i * 104729) % 50;
+        input.push_back(make_sortable_alignment(i, node_id, (i * 31) % 3));
+    }
+    stringstream gam;
+    vector<Alignment> to_write = input;
+    stream::write_buffered(gam, to_write, 0);
+
+    SECTION("Single reads are sorted stably through many temporary runs") {
+        // Use a tiny memory budget so there are enough runs to need more than one merge pass
+        GAMSorter sorter(1000);
+        stringstream in(gam.str());
+        stringstream out;
+        sorter.stream_sort(in, out);
+
+        vector<Alignment> sorted = read_all(out.str());
+        REQUIRE(sorted.size() == input.size());
+        for (size_t i = 1; i < sorted.size(); i++) {
+            auto prev_key = expected_key(sorted[i - 1]);
+            auto key = expected_key(sorted[i]);
+            REQUIRE(prev_key <= key);
+            if (prev_key == key) {
+                // Ties keep their input order
+                REQUIRE(stoi(sorted[i - 1].name().substr(4)) < stoi(sorted[i].name().substr(4)));
+            }
+        }
+
+        // The in-memory sort agrees exactly
+        GAMSorter dumb_sorter;
+        stringstream dumb_in(gam.str());
+        stringstream dumb_out;
+        dumb_sorter.dumb_sort(dumb_in, dumb_out);
+        vector<Alignment> dumb_sorted = read_all(dumb_out.str());
+        REQUIRE(dumb_sorted.size() == sorted.size());
+        for (size_t i = 0; i < sorted.size(); i++) {
+            REQUIRE(dumb_sorted[i].name() == sorted[i].name());
+        }
+    }
+
+    SECTION("Pairs are kept together and sorted by their lower mate") {
+        GAMSorter sorter(5000);
+        stringstream in(gam.str());
+        stringstream out;
+        sorter.stream_sort(in, out, true);
+
+        vector<Alignment> sorted = read_all(out.str());
+        REQUIRE(sorted.size() == input.size());
+        pair<int64_t, int64_t> prev_key(numeric_limits<int64_t>::min(), numeric_limits<int64_t>::min());
+        for (size_t i = 0; i < sorted.size(); i += 2) {
+            // Mates stay adjacent and in order
+            size_t first_index = stoi(sorted[i].name().substr(4));
+            REQUIRE(first_index % 2 == 0);
+            REQUIRE(sorted[i + 1].name() == "read" + to_string(first_index + 1));
+
+            auto key = min(expected_key(sorted[i]), expected_key(sorted[i + 1]));
+            REQUIRE(prev_key <= key);
+            prev_key = key;
+        }
+    }
+}
+
+}
+}
@@ -0,0 +1,60 @@
+/**
+ * unittest/index.cpp: test cases for the RocksDB-backed index
+ */
+
+#include "catch.hpp"
+#include "../index.hpp"
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+TEST_CASE("Index can parse just the path out of a serialized alignment", "[index]") {
+
+    Alignment alignment;
+    alignment.set_sequence("GATTACA");
+    alignment.set_name("read");
+    alignment.set_quality(string({10, 20, 30, 40, 30, 20, 10}));
+    alignment.set_score(7);
+    for (int64_t i = 0; i < 3; i++) {
+        Mapping* mapping = alignment.mutable_path()->add_mapping();
+        mapping->mutable_position()->set_node_id(10 + i);
+        mapping->set_rank(i + 1);
+        Edit* edit = mapping->add_edit();
+        edit->set_from_length(2);
+        edit->set_to_length(2);
+    }
+    // A nested alignment has a path of its own, which must not be picked up
+    alignment.mutable_fragment_next()->mutable_path()->add_mapping()->mutable_position()->set_node_id(99);
+    alignment.set_is_secondary(true);
+
+    string data;
+    alignment.SerializeToString(&data);
+
+    SECTION("The path comes out exactly as it went in") {
+        Path path;
+        REQUIRE(Index::parse_alignment_path(data.data(), data.size(), path));
+        REQUIRE(path.SerializeAsString() == alignment.path().SerializeAsString());
+    }
+
+    SECTION("An alignment with no path gives an empty path") {
+        Alignment unmapped;
+        unmapped.set_sequence("GATTACA");
+        string unmapped_data;
+        unmapped.SerializeToString(&unmapped_data);
+
+        Path path;
+        path.add_mapping();
+        REQUIRE(Index::parse_alignment_path(unmapped_data.data(), unmapped_data.size(), path));
+        REQUIRE(path.mapping_size() == 0);
+    }
+
+    SECTION("Truncated data is rejected") {
+        Path path;
+        REQUIRE(!Index::parse_alignment_path(data.data(), data.size() - 1, path));
+    }
+}
+
+}
+}
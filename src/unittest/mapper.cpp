@@ -297,6 +297,104 @@ TEST_CASE( "Mapper finds optimal mapping for read starting with node-border MEM"
     
 }
 
+    
+/// Robustly estimate the mean and standard deviation of some lengths the
+/// same way the fragment length distribution originally did, from a sorted list
+static pair<double, double> reference_robust_estimate(vector<int64_t> lengths, double robust_estimation_fraction) {
+    sort(lengths.begin(), lengths.end());
+    size_t to_skip = (size_t) (lengths.size() * (1.0 - robust_estimation_fraction) * 0.5);
+    double count = 0.0, sum = 0.0, sum_of_sqs = 0.0;
+    for (size_t i = to_skip; i < lengths.size() - to_skip; i++) {
+        count += 1.0;
+        sum += lengths[i];
+        sum_of_sqs += (double) lengths[i] * lengths[i];
+    }
+    double mu = sum / count;
+    double a = normal_inverse_cdf(1.0 - 0.5 * (1.0 - robust_estimation_fraction));
+    double sigma = sqrt((sum_of_sqs / count - mu * mu) / (1.0 - 2.0 * a * normal_pdf(a, 0.0, 1.0)));
+    return make_pair(mu, sigma);
+}
+    
+TEST_CASE( "FragmentLengthDistribution matches the robust estimator", "[mapping][mapper][fragment]" ) {
+    
+    // Some lengths with repeated values and outliers in both tails
+    vector<int64_t> lengths;
+    for (size_t i = 0; i < 1000; i++) {
+        lengths.push_back(300 + (int64_t) ((i * 7919) % 97) - 48);
+        if (i % 50 == 0) {
+            lengths.push_back(i % 100 == 0 ? 5 : 100000);
+        }
+    }
+    
+    SECTION("Measurements registered from one thread give the reference estimate at every reestimation") {
+        FragmentLengthDistribution distr(0, 100, 0.95);
+        for (size_t i = 0; i < lengths.size(); i++) {
+            distr.register_fragment_length(lengths[i]);
+            if ((i + 1) % 100 == 0) {
+                auto expected = reference_robust_estimate(vector<int64_t>(lengths.begin(), lengths.begin() + i + 1), 0.95);
+                auto estimate = distr.snapshot();
+                REQUIRE(estimate.sample_size == i + 1);
+                REQUIRE(estimate.mean == Approx(expected.first));
+                REQUIRE(estimate.stdev == Approx(expected.second));
+            }
+        }
+        REQUIRE(!distr.is_finalized());
+    }
+    
+    SECTION("Measurements registered from many threads give the reference estimate once finalized") {
+        FragmentLengthDistribution distr(lengths.size(), lengths.size(), 0.95);
+#pragma omp parallel for
+        for (size_t i = 0; i < lengths.size(); i++) {
+            distr.register_fragment_length(lengths[i]);
+        }
+        // Merge any measurements still sitting in thread buffers
+        distr.flush();
+        REQUIRE(distr.is_finalized());
+        
+        // Every measurement was used
+        vector<int64_t> used;
+        for (auto iter = distr.measurements_begin(); iter != distr.measurements_end(); iter++) {
+            used.insert(used.end(), iter->second, iter->first);
+        }
+        vector<int64_t> sorted_lengths = lengths;
+        sort(sorted_lengths.begin(), sorted_lengths.end());
+        REQUIRE(used == sorted_lengths);
+        REQUIRE(distr.curr_sample_size() == lengths.size());
+        
+        auto expected = reference_robust_estimate(used, 0.95);
+        REQUIRE(distr.mean() == Approx(expected.first));
+        REQUIRE(distr.stdev() == Approx(expected.second));
+    }
+    
+    SECTION("Measurements that threads stopped with are counted once flushed") {
+        FragmentLengthDistribution distr(0, 64, 0.95);
+        // Fewer measurements per thread than fill a merge batch, and fewer in
+        // total than trigger a reestimation
+#pragma omp parallel for num_threads(4) schedule(static, 5)
+        for (size_t i = 0; i < 20; i++) {
+            distr.register_fragment_length(lengths[i]);
+        }
+        distr.flush();
+        REQUIRE(distr.curr_sample_size() == 20);
+        
+        auto expected = reference_robust_estimate(vector<int64_t>(lengths.begin(), lengths.begin() + 20), 0.95);
+        auto estimate = distr.snapshot();
+        REQUIRE(estimate.sample_size == 20);
+        REQUIRE(estimate.mean == Approx(expected.first));
+        REQUIRE(estimate.stdev == Approx(expected.second));
+    }
+    
+    SECTION("Forced parameters stop estimation") {
+        FragmentLengthDistribution distr(100, 10, 0.95);
+        distr.force_parameters(400.0, 25.0);
+        distr.register_fragment_length(100);
+        REQUIRE(distr.is_finalized());
+        REQUIRE(distr.curr_sample_size() == 0);
+        REQUIRE(distr.mean() == 400.0);
+        REQUIRE(distr.stdev() == 25.0);
+    }
+}
+
 }
 
 }
@@ -0,0 +1,142 @@
+/**
+ * unittest/mapping_quality.cpp: test cases for the mapping quality kernels
+ */
+
+#include <cmath>
+#include <random>
+#include "catch.hpp"
+#include "../mapping_quality.hpp"
+#include "../utility.hpp"
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+/// The scalar mapping quality computation, one add_log at a time
+static double reference_max_score_error_neg_log(vector<double> scores, size_t* max_idx_out) {
+    if (scores.size() == 1) {
+        scores.push_back(0.0);
+    }
+    double log_sum_exp = numeric_limits<double>::lowest();
+    double max_score = numeric_limits<double>::lowest();
+    for (int64_t i = scores.size() - 1; i >= 0; i--) {
+        log_sum_exp = add_log(log_sum_exp, scores[i]);
+        if (scores[i] > max_score) {
+            *max_idx_out = i;
+            max_score = scores[i];
+        }
+    }
+    return -subtract_log(0.0, max_score - log_sum_exp);
+}
+
+/// The scalar group mapping quality computation
+static double reference_group_error_neg_log(const vector<double>& scores, const vector<size_t>& group) {
+    double total_log_sum_exp = numeric_limits<double>::lowest();
+    double non_group_log_sum_exp = numeric_limits<double>::lowest();
+    int64_t group_idx = group.size() - 1;
+    for (int64_t i = scores.size() - 1; i >= 0; i--) {
+        total_log_sum_exp = add_log(total_log_sum_exp, scores[i]);
+        if (group_idx >= 0 && i == group[group_idx]) {
+            group_idx--;
+        }
+        else {
+            non_group_log_sum_exp = add_log(non_group_log_sum_exp, scores[i]);
+        }
+    }
+    return total_log_sum_exp - non_group_log_sum_exp;
+}
+
+TEST_CASE("fast_exp approximates exp closely", "[mapq]") {
+    for (double x = -700.0; x < 5.0; x += 0.0137) {
+        REQUIRE(fast_exp(x) == Approx(exp(x)).epsilon(1e-8));
+    }
+    REQUIRE(fast_exp(0.0) == 1.0);
+    // Very negative values underflow to 0
+    REQUIRE(fast_exp(-10000.0) == 0.0);
+}
+
+TEST_CASE("ScaledScores holds more scores than fit on the stack", "[mapq]") {
+    ScaledScores small(3);
+    ScaledScores large(ScaledScores::STACK_CAPACITY * 2 + 1);
+    for (size_t i = 0; i < large.size(); i++) {
+        large[i] = i;
+    }
+    REQUIRE(small.size() == 3);
+    REQUIRE(large.size() == ScaledScores::STACK_CAPACITY * 2 + 1);
+    REQUIRE(large.data()[ScaledScores::STACK_CAPACITY * 2] == ScaledScores::STACK_CAPACITY * 2);
+}
+
+TEST_CASE("Mapping quality kernels match the scalar computation", "[mapq]") {
+
+    default_random_engine generator(8675309);
+
+    for (bool approximate_exp : {false, true}) {
+        for (size_t count : {1, 2, 3, 7, 16, 33, 200}) {
+            for (double spread : {0.5, 3.0, 20.0}) {
+                // Scores clustered near the top, as for a read in a repeat
+                normal_distribution<double> distribution(60.0, spread);
+                vector<double> scores(count);
+                ScaledScores scaled_scores(count);
+                for (size_t i = 0; i < count; i++) {
+                    scores[i] = distribution(generator);
+                    scaled_scores[i] = scores[i];
+                }
+
+                size_t expected_idx, max_idx;
+                double expected = reference_max_score_error_neg_log(scores, &expected_idx);
+                double observed = max_score_error_neg_log(scaled_scores.data(), count, &max_idx, approximate_exp);
+                if (expected < 15.0) {
+                    // The reference loses precision when the error probability is tiny
+                    REQUIRE(observed == Approx(expected).epsilon(1e-6));
+                }
+                else {
+                    REQUIRE(observed > 14.0);
+                }
+                REQUIRE(scores[max_idx] == scores[expected_idx]);
+
+                if (count > 1) {
+                    double lse = numeric_limits<double>::lowest();
+                    for (double score : scores) {
+                        lse = add_log(lse, score);
+                    }
+                    REQUIRE(log_sum_exp(scaled_scores.data(), count, approximate_exp) == Approx(lse).epsilon(1e-9));
+                }
+                if (count > 2) {
+                    vector<size_t> group{0, count / 2};
+                    REQUIRE(group_error_neg_log(scaled_scores.data(), count, group, approximate_exp)
+                            == Approx(reference_group_error_neg_log(scores, group)).epsilon(1e-6));
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("Mapping quality kernels handle extreme cases", "[mapq]") {
+
+    SECTION("A lone score is compared to a null alignment") {
+        double score = 2.0;
+        size_t max_idx = 1;
+        REQUIRE(max_score_error_neg_log(&score, 1, &max_idx, false) == Approx(log1p(exp(2.0))));
+        REQUIRE(max_idx == 0);
+        REQUIRE(max_score_error_neg_log_approx(&score, 1, &max_idx) == Approx(2.0));
+        REQUIRE(max_idx == 0);
+    }
+
+    SECTION("Tied scores give a low mapping quality") {
+        vector<double> scores{40.0, 40.0};
+        size_t max_idx;
+        REQUIRE(max_score_error_neg_log(scores.data(), 2, &max_idx, false) == Approx(log(2.0)));
+    }
+
+    SECTION("An overwhelming maximum gives an infinite mapping quality") {
+        vector<double> scores{2000.0, 1.0};
+        size_t max_idx;
+        REQUIRE(std::isinf(max_score_error_neg_log(scores.data(), 2, &max_idx, false)));
+        REQUIRE(max_idx == 0);
+        REQUIRE(std::isinf(group_error_neg_log(scores.data(), 2, vector<size_t>{0, 1}, false)));
+    }
+}
+
+}
+}
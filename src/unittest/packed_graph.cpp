@@ -0,0 +1,206 @@
+/**
+ * unittest/packed_graph.cpp: test cases for the compact packed handle graph
+ */
+
+#include "catch.hpp"
+#include "../packed_graph.hpp"
+#include "../vg.hpp"
+#include "../json2pb.h"
+#include "../stream.hpp"
+#include "../algorithms/topological_sort.hpp"
+
+#include <sstream>
+#include <vector>
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+TEST_CASE("PackedGraph stores sequences and edges", "[handle][packedgraph]") {
+
+    PackedGraph graph;
+    handle_t h1 = graph.create_handle("GATTACA");
+    handle_t h2 = graph.create_handle("CANNRTG");
+    handle_t h3 = graph.create_handle("T");
+
+    REQUIRE(graph.node_size() == 3);
+    REQUIRE(graph.get_id(h1) == 1);
+    REQUIRE(graph.get_id(h3) == 3);
+
+    SECTION("Sequences other than ACGT survive packing") {
+        REQUIRE(graph.get_sequence(h2) == "CANNRTG");
+        REQUIRE(graph.get_sequence(graph.flip(h2)) == reverse_complement("CANNRTG"));
+        REQUIRE(graph.get_length(h2) == 7);
+    }
+
+    SECTION("Edges are deduplicated and visible from both ends") {
+        graph.create_edge(h1, h2);
+        graph.create_edge(graph.flip(h2), graph.flip(h1));
+        graph.create_edge(h2, graph.flip(h3));
+        graph.create_edge(h3, h3);
+        REQUIRE(graph.edge_count() == 3);
+
+        vector<handle_t> found;
+        graph.follow_edges(h2, true, [&](const handle_t& other) {
+            found.push_back(other);
+        });
+        REQUIRE(found == vector<handle_t>{h1});
+
+        found.clear();
+        graph.follow_edges(h3, false, [&](const handle_t& other) {
+            found.push_back(other);
+        });
+        REQUIRE(found.size() == 2);
+
+        SECTION("Destroying a node removes its edges") {
+            graph.destroy_handle(h2);
+            REQUIRE(graph.node_size() == 2);
+            REQUIRE(graph.edge_count() == 1);
+            REQUIRE(graph.follow_edges(h1, false, [&](const handle_t& other) {
+                return false;
+            }));
+        }
+
+        SECTION("Reorienting a node keeps its ID and flips its edges") {
+            handle_t modified = graph.apply_orientation(graph.flip(h2));
+            REQUIRE(graph.get_id(modified) == 2);
+            REQUIRE(graph.get_sequence(modified) == reverse_complement("CANNRTG"));
+            found.clear();
+            graph.follow_edges(modified, false, [&](const handle_t& other) {
+                found.push_back(other);
+            });
+            REQUIRE(found == vector<handle_t>{graph.flip(h1)});
+        }
+
+        SECTION("Dividing a node keeps its edges on the outer parts") {
+            auto parts = graph.divide_handle(graph.flip(h1), vector<size_t>{2, 5});
+            REQUIRE(parts.size() == 3);
+            REQUIRE(graph.get_sequence(parts[0]) == "TG");
+            REQUIRE(graph.get_sequence(parts[1]) == "TAA");
+            REQUIRE(graph.get_sequence(parts[2]) == "TC");
+            REQUIRE(graph.get_id(parts[2]) == 1);
+            found.clear();
+            graph.follow_edges(parts[0], true, [&](const handle_t& other) {
+                found.push_back(other);
+            });
+            REQUIRE(found == vector<handle_t>{graph.flip(h2)});
+        }
+    }
+}
+
+TEST_CASE("PackedGraph round trips through the .vg format", "[packedgraph]") {
+
+    string graph_json = R"(
+    {"node": [{"id": 10, "sequence": "GAT"}, {"id": 3, "sequence": "TACA"}, {"id": 7, "sequence": "NN"}],
+     "edge": [{"from": 10, "to": 3}, {"from": 3, "to": 7, "from_start": true}, {"from": 10, "to": 42}],
+     "path": [{"name": "ref", "mapping": [
+        {"position": {"node_id": 3, "is_reverse": true}, "edit": [{"from_length": 4, "to_length": 4}], "rank": 2},
+        {"position": {"node_id": 10}, "edit": [{"from_length": 3, "to_length": 3}], "rank": 1}]}]}
+    )";
+    Graph source;
+    json2pb(source, graph_json.c_str(), graph_json.size());
+
+    // Put the edges and the path in a chunk before their nodes
+    Graph edges_first;
+    *edges_first.mutable_edge() = source.edge();
+    *edges_first.mutable_path() = source.path();
+    source.clear_edge();
+    source.clear_path();
+    stringstream in;
+    vector<Graph> chunks {edges_first, source};
+    stream::write_buffered(in, chunks, 0);
+
+    PackedGraph graph(in);
+
+    // The sparse IDs are kept, and the edge to the missing node is dropped
+    REQUIRE(graph.node_size() == 3);
+    REQUIRE(graph.edge_count() == 2);
+    REQUIRE(graph.min_node_id() == 3);
+    REQUIRE(graph.max_node_id() == 10);
+    REQUIRE(graph.get_sequence(graph.get_handle(7)) == "NN");
+
+    stringstream out;
+    graph.serialize(out);
+    VG vg(out);
+
+    REQUIRE(vg.node_count() == 3);
+    REQUIRE(vg.edge_count() == 2);
+    REQUIRE(vg.get_node(3)->sequence() == "TACA");
+    REQUIRE(vg.paths.has_path("ref"));
+    auto& mappings = vg.paths.get_path("ref");
+    REQUIRE(mappings.size() == 2);
+    REQUIRE(mappings.front().position().node_id() == 10);
+    REQUIRE(mappings.back().position().node_id() == 3);
+    REQUIRE(mappings.back().position().is_reverse());
+
+    SECTION("Paths can be read back as handles") {
+        size_t path_count = 0;
+        graph.for_each_path([&](const string& name, const vector<handle_t>& steps) {
+            path_count++;
+            REQUIRE(name == "ref");
+            REQUIRE(steps.size() == 2);
+            REQUIRE(steps[0] == graph.get_handle(10));
+            REQUIRE(steps[1] == graph.get_handle(3, true));
+        });
+        REQUIRE(path_count == 1);
+    }
+
+    SECTION("Compacting IDs after a sort numbers the nodes in sort order") {
+        algorithms::sort(&graph);
+        graph.compact_ids();
+        REQUIRE(graph.min_node_id() == 1);
+        REQUIRE(graph.max_node_id() == 3);
+        REQUIRE(graph.get_sequence(graph.get_handle(1)) == "GAT");
+
+        PackedGraph copy;
+        stringstream compacted;
+        graph.serialize(compacted);
+        copy.load(compacted);
+        REQUIRE(copy.edge_count() == 2);
+        REQUIRE(copy.get_sequence(copy.get_handle(2)) == graph.get_sequence(graph.get_handle(2)));
+    }
+}
+
+TEST_CASE("PackedGraph divides many nodes and rewrites paths through them", "[packedgraph]") {
+
+    string graph_json = R"(
+    {"node": [{"id": 1, "sequence": "GATTACA"}, {"id": 2, "sequence": "CT"}, {"id": 3, "sequence": "GGCCAA"}],
+     "edge": [{"from": 1, "to": 2}, {"from": 2, "to": 3, "to_end": true}],
+     "path": [{"name": "ref", "mapping": [
+        {"position": {"node_id": 1}, "edit": [{"from_length": 7, "to_length": 7}], "rank": 1},
+        {"position": {"node_id": 2}, "edit": [{"from_length": 2, "to_length": 2}], "rank": 2},
+        {"position": {"node_id": 3, "is_reverse": true}, "edit": [{"from_length": 6, "to_length": 6}], "rank": 3}]}]}
+    )";
+    Graph source;
+    json2pb(source, graph_json.c_str(), graph_json.size());
+    PackedGraph graph;
+    graph.extend(source);
+
+    REQUIRE(graph.has_node(2));
+    REQUIRE(!graph.has_node(4));
+
+    graph.divide_handles({make_pair(graph.get_handle(1), vector<size_t>{3}),
+                          make_pair(graph.get_handle(3, true), vector<size_t>{2, 4})});
+    REQUIRE(graph.node_size() == 6);
+
+    stringstream out;
+    graph.serialize(out);
+    VG vg(out);
+
+    // The path spells the same sequence through the parts
+    auto& mappings = vg.paths.get_path("ref");
+    REQUIRE(mappings.size() == 6);
+    string spelled;
+    for (auto& mapping : mappings) {
+        spelled += graph.get_sequence(graph.get_handle(mapping.position().node_id(),
+                                                       mapping.position().is_reverse()));
+    }
+    REQUIRE(spelled == "GATTACA" "CT" + reverse_complement("GGCCAA"));
+    REQUIRE(mappings.front().position().node_id() == 1);
+    REQUIRE(mappings.back().position().node_id() == 3);
+    REQUIRE(mappings.back().position().is_reverse());
+}
+
+}
+}
@@ -0,0 +1,184 @@
+/**
+ * unittest/pileup.cpp: test cases for the compact node pileup store
+ */
+
+#include "catch.hpp"
+#include "../pileup.hpp"
+#include "../stream.hpp"
+
+#include <sstream>
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+TEST_CASE("CompactNodePileup converts to and from NodePileup", "[pileup]") {
+
+    NodePileup np;
+    np.set_node_id(3);
+    BasePileup* bp = np.add_base_pileup();
+    bp->set_ref_base('A');
+    bp->set_bases(".,+2AC,T-1;3;0;0;4;1;0a+2gt.");
+    bp->set_num_bases(9);
+    bp->set_qualities(string({10, 20, 30, 40, 50, 60, 70, 80, 90}));
+    np.add_base_pileup()->set_ref_base('C');
+
+    CompactNodePileup pileup(np);
+    REQUIRE(pileup.node_id() == 3);
+    REQUIRE(pileup.size() == 2);
+
+    SECTION("Bases are counted by forward strand base and strand") {
+        auto& column = pileup.column(0);
+        REQUIRE(column.depth == 9);
+        REQUIRE(column.counts[0][0] == 2);
+        REQUIRE(column.counts[0][1] == 2);
+        // "a" on the reverse strand is a T
+        REQUIRE(column.counts[3][0] == 1);
+        REQUIRE(column.counts[3][1] == 1);
+        REQUIRE(column.qual_counts[0] == 4);
+        REQUIRE(column.qual_sums[0] == 10 + 20 + 40 + 90);
+        REQUIRE(pileup.column(1).depth == 0);
+    }
+
+    SECTION("Indels on both strands share a forward strand token") {
+        auto indels = pileup.indels_at(0);
+        REQUIRE(indels.second - indels.first == 2);
+        REQUIRE(indels.first->token == "+2AC");
+        REQUIRE(indels.first->counts[0] == 1);
+        REQUIRE(indels.first->counts[1] == 1);
+        REQUIRE((indels.first + 1)->token == "-0;3;0;0;4;1;0");
+        REQUIRE((indels.first + 1)->counts[1] == 1);
+        REQUIRE(pileup.indels_at(1).first == pileup.indels_at(1).second);
+    }
+
+    SECTION("Tokens come back grouped in canonical order") {
+        NodePileup converted;
+        pileup.to_protobuf(converted);
+        REQUIRE(converted.base_pileup_size() == 2);
+        REQUIRE(converted.base_pileup(0).bases() == "..,,Ta+2AC+2gt-1;3;0;0;4;1;0");
+        REQUIRE(converted.base_pileup(0).num_bases() == 9);
+        REQUIRE(converted.base_pileup(0).qualities().size() == 9);
+        REQUIRE(converted.base_pileup(1).bases().empty());
+
+        NodePileup round_trip;
+        CompactNodePileup(converted).to_protobuf(round_trip);
+        REQUIRE(round_trip.base_pileup(0).bases() == converted.base_pileup(0).bases());
+        REQUIRE(round_trip.base_pileup(0).qualities() == converted.base_pileup(0).qualities());
+    }
+}
+
+TEST_CASE("CompactNodePileup merges respect the maximum depth", "[pileup]") {
+
+    CompactNodePileup p1(1, "AC");
+    CompactNodePileup p2(1, "AC");
+    for (int i = 0; i < 6; ++i) {
+        p1.add_base(0, 'A', i % 2, 30, 10);
+        p2.add_base(0, 'G', i % 2, 20, 10);
+        p2.add_indel(0, "+1T", false, -1, 10);
+    }
+    REQUIRE(p2.column(0).depth == 10);
+    REQUIRE(!p2.add_base(0, 'G', false, 20, 10));
+
+    p1.merge(p2, 10);
+    auto& column = p1.column(0);
+    REQUIRE(column.depth == 10);
+    REQUIRE(column.counts[2][0] + column.counts[2][1] == 4);
+    REQUIRE(column.qual_counts[2] == 4);
+    REQUIRE(column.qual_sums[2] == 80);
+    REQUIRE(p1.indels_at(0).first == p1.indels_at(0).second);
+    REQUIRE(p2.size() == 0);
+}
+
+/// Make a 10 base read starting at an offset on a node of a chain of 10 base
+/// nodes, optionally with a SNP on its first base, an insertion after that,
+/// and base qualities
+static Alignment make_pileup_read(VG& graph, int64_t node_id, size_t offset, bool snp, bool insertion,
+                                  bool qualities) {
+    Alignment aln;
+    size_t bases_left = 10;
+    for (int rank = 1; bases_left > 0; ++rank, ++node_id, offset = 0) {
+        const string& ref = graph.get_node(node_id)->sequence();
+        size_t length = min(ref.size() - offset, bases_left);
+        Mapping* mapping = aln.mutable_path()->add_mapping();
+        mapping->mutable_position()->set_node_id(node_id);
+        mapping->mutable_position()->set_offset(offset);
+        mapping->set_rank(rank);
+        size_t matched_from = offset;
+        if (rank == 1 && snp) {
+            string alt(1, ref[offset] == 'A' ? 'C' : 'A');
+            Edit* edit = mapping->add_edit();
+            edit->set_from_length(1);
+            edit->set_to_length(1);
+            edit->set_sequence(alt);
+            aln.mutable_sequence()->append(alt);
+            ++matched_from;
+        }
+        if (rank == 1 && insertion) {
+            if (matched_from == offset) {
+                Edit* edit = mapping->add_edit();
+                edit->set_from_length(1);
+                edit->set_to_length(1);
+                aln.mutable_sequence()->append(ref.substr(offset, 1));
+                ++matched_from;
+            }
+            Edit* edit = mapping->add_edit();
+            edit->set_to_length(1);
+            edit->set_sequence("G");
+            aln.mutable_sequence()->append("G");
+        }
+        Edit* edit = mapping->add_edit();
+        edit->set_from_length(offset + length - matched_from);
+        edit->set_to_length(offset + length - matched_from);
+        aln.mutable_sequence()->append(ref.substr(matched_from, offset + length - matched_from));
+        bases_left -= length;
+    }
+    if (qualities) {
+        for (size_t i = 0; i < aln.sequence().size(); ++i) {
+            aln.mutable_quality()->push_back((char)(10 + (node_id * 7 + offset + i) % 30));
+        }
+    }
+    return aln;
+}
+
+TEST_CASE("ShardedPileups come out the same whether or not they are spilled", "[pileup]") {
+
+    // A chain of 10 nodes of 10 bases each
+    VG graph;
+    string sequence = "GATTACACATTAGGACCATGTGCAAATCGGCTAAGCTTAGCCATGGACTTAGCATGCAATCCGATACGGTACTAGGCATCGATTGACCTAGTACAGATC";
+    Node* prev = nullptr;
+    for (int64_t id = 1; id <= 10; ++id) {
+        Node* node = graph.create_node(sequence.substr((id - 1) * 10, 10), id);
+        if (prev != nullptr) {
+            graph.create_edge(prev, node);
+        }
+        prev = node;
+    }
+
+    // Enough reads to make several batches, with and without qualities
+    vector<Alignment> reads;
+    for (int64_t i = 0; i < 5000; ++i) {
+        reads.push_back(make_pileup_read(graph, 1 + (i / 9) % 9, i % 9, i % 5 == 0, i % 11 == 0, i % 3 != 0));
+    }
+    stringstream gam;
+    stream::write_buffered(gam, reads, 0);
+
+    // Get the pileups written out by a set of sharded pileups
+    auto pileup_output = [&](size_t max_shard_bases) {
+        ShardedPileups pileups(&graph, 2, max_shard_bases);
+        stringstream in(gam.str());
+        pileups.compute_from_stream(in);
+        stringstream out;
+        pileups.consume([](Pileups& shard) {}, &out);
+        return out.str();
+    };
+
+    // Spill after every batch
+    string spilled = pileup_output(1);
+    string unspilled = pileup_output(0);
+    REQUIRE(!unspilled.empty());
+    REQUIRE(spilled == unspilled);
+}
+
+}
+}
@@ -0,0 +1,180 @@
+/**
+ * unittest/read_cache.cpp: test cases for the identical-read alignment cache
+ */
+
+#include "catch.hpp"
+#include "read_cache.hpp"
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+TEST_CASE("ReadAlignmentCache returns relabeled results for identical reads", "[mapping][readcache]") {
+
+    ReadAlignmentCache cache(100, false);
+
+    Alignment read;
+    read.set_name("first");
+    read.set_sequence("GATTACA");
+
+    vector<Alignment> alns(1);
+    alns[0].set_name("first");
+    alns[0].set_sequence("GATTACA");
+    alns[0].set_score(7);
+
+    vector<Alignment> found;
+    REQUIRE(!cache.lookup(read, found));
+    cache.store(read, alns);
+
+    Alignment duplicate = read;
+    duplicate.set_name("second");
+    REQUIRE(cache.lookup(duplicate, found));
+    REQUIRE(found.size() == 1);
+    REQUIRE(found[0].name() == "second");
+    REQUIRE(found[0].score() == 7);
+
+    Alignment different = read;
+    different.set_sequence("GATTACC");
+    REQUIRE(!cache.lookup(different, found));
+
+    REQUIRE(cache.hits() == 1);
+    REQUIRE(cache.misses() == 2);
+}
+
+TEST_CASE("ReadAlignmentCache distinguishes qualities only when asked to", "[mapping][readcache]") {
+
+    Alignment read;
+    read.set_name("first");
+    read.set_sequence("GATTACA");
+    read.set_quality(string(7, (char) 30));
+
+    Alignment requalified = read;
+    requalified.set_quality(string(7, (char) 10));
+
+    vector<Alignment> alns(1);
+    vector<Alignment> found;
+
+    SECTION("Qualities are ignored by default") {
+        ReadAlignmentCache cache(100, false);
+        cache.store(read, alns);
+        REQUIRE(cache.lookup(requalified, found));
+    }
+
+    SECTION("A hit carries the qualities and read group of the query read") {
+        alns[0] = read;
+        alns[0].set_read_group("first-group");
+        alns.push_back(alns[0]);
+        alns.back().set_score(1);
+
+        ReadAlignmentCache cache(100, false);
+        cache.store(read, alns);
+
+        Alignment query = requalified;
+        query.set_quality(string(1, (char) 5) + string(6, (char) 10));
+        query.set_read_group("second-group");
+        REQUIRE(cache.lookup(query, found));
+        REQUIRE(found.size() == 2);
+        REQUIRE(found[0].quality() == query.quality());
+        REQUIRE(found[0].read_group() == "second-group");
+        REQUIRE(found[1].quality() == query.quality());
+        REQUIRE(found[1].read_group() == "second-group");
+    }
+
+    SECTION("Qualities are part of the key when quality adjustment is on") {
+        ReadAlignmentCache cache(100, true);
+        cache.store(read, alns);
+        REQUIRE(!cache.lookup(requalified, found));
+        REQUIRE(cache.lookup(read, found));
+    }
+}
+
+TEST_CASE("ReadAlignmentCache caches pairs and rewrites mate names", "[mapping][readcache]") {
+
+    ReadAlignmentCache cache(100, false);
+
+    Alignment read1, read2;
+    read1.set_name("pair/1");
+    read1.set_sequence("GATTACA");
+    read2.set_name("pair/2");
+    read2.set_sequence("CATTAG");
+
+    pair<vector<Alignment>, vector<Alignment>> alns;
+    alns.first.resize(1);
+    alns.second.resize(1);
+    cache.store_pair(read1, read2, alns);
+
+    Alignment other1 = read1, other2 = read2;
+    other1.set_name("other/1");
+    other2.set_name("other/2");
+
+    pair<vector<Alignment>, vector<Alignment>> found;
+    REQUIRE(cache.lookup_pair(other1, other2, found));
+    REQUIRE(found.first[0].name() == "other/1");
+    REQUIRE(found.first[0].fragment_next().name() == "other/2");
+    REQUIRE(found.second[0].name() == "other/2");
+    REQUIRE(found.second[0].fragment_prev().name() == "other/1");
+
+    // The mates are not interchangeable
+    REQUIRE(!cache.lookup_pair(other2, other1, found));
+}
+
+TEST_CASE("ReadAlignmentCache stays within its capacity", "[mapping][readcache]") {
+
+    ReadAlignmentCache cache(1, false, 1);
+
+    Alignment read1, read2;
+    read1.set_sequence("GATTACA");
+    read2.set_sequence("CATTAG");
+
+    vector<Alignment> alns(1);
+    vector<Alignment> found;
+    cache.store(read1, alns);
+    cache.store(read2, alns);
+
+    REQUIRE(!cache.lookup(read1, found));
+    REQUIRE(cache.lookup(read2, found));
+}
+
+TEST_CASE("ReadAlignmentCache with more shards than entries stays within its capacity", "[mapping][readcache]") {
+
+    ReadAlignmentCache cache(4, false, 64);
+
+    vector<Alignment> alns(1);
+    vector<Alignment> reads;
+    string bases = "ACGT";
+    for (size_t i = 0; i < 64; i++) {
+        reads.emplace_back();
+        for (size_t j = i; j > 0; j /= 4) {
+            reads.back().mutable_sequence()->push_back(bases[j % 4]);
+        }
+        reads.back().mutable_sequence()->append("TTTTTTTT");
+        cache.store(reads.back(), alns);
+    }
+
+    size_t cached = 0;
+    vector<Alignment> found;
+    for (auto& read : reads) {
+        if (cache.lookup(read, found)) {
+            cached++;
+        }
+    }
+    REQUIRE(cached > 0);
+    REQUIRE(cached <= 4);
+}
+
+TEST_CASE("ReadAlignmentCache with no capacity caches nothing", "[mapping][readcache]") {
+
+    ReadAlignmentCache cache(0, false);
+
+    Alignment read;
+    read.set_sequence("GATTACA");
+    vector<Alignment> alns(1);
+    vector<Alignment> found;
+    cache.store(read, alns);
+
+    REQUIRE(!cache.lookup(read, found));
+}
+
+}
+}
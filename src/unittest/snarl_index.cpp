@@ -0,0 +1,216 @@
+/**
+ * unittest/snarl_index.cpp: test cases for the memory-mappable snarl index
+ */
+
+#include "catch.hpp"
+#include "../snarl_index.hpp"
+#include "../snarls.hpp"
+#include "../utility.hpp"
+#include "../vg.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace vg {
+namespace unittest {
+
+using namespace std;
+
+TEST_CASE("SnarlIndex round-trips a snarl tree", "[snarls][snarlindex]") {
+
+    // A snarl from 1 to 8 holding a chain of a snarl from 2 to 4 and a snarl
+    // from 4 to 7, with a snarl from 5 to 6 in the second one
+    VG graph;
+
+    Node* n1 = graph.create_node("GCA");
+    Node* n2 = graph.create_node("T");
+    Node* n3 = graph.create_node("G");
+    Node* n4 = graph.create_node("CTGA");
+    Node* n5 = graph.create_node("GCA");
+    Node* n6 = graph.create_node("T");
+    Node* n7 = graph.create_node("G");
+    Node* n8 = graph.create_node("CTGA");
+    Node* n9 = graph.create_node("GCA");
+
+    graph.create_edge(n1, n2);
+    graph.create_edge(n1, n8);
+    graph.create_edge(n2, n3);
+    graph.create_edge(n2, n4);
+    graph.create_edge(n3, n4);
+    graph.create_edge(n4, n5);
+    graph.create_edge(n4, n7);
+    graph.create_edge(n5, n6);
+    graph.create_edge(n5, n9);
+    graph.create_edge(n9, n6);
+    graph.create_edge(n6, n7);
+    graph.create_edge(n7, n8);
+
+    SnarlManager original = CactusSnarlFinder(graph).find_snarls();
+
+    SnarlIndex built(original);
+    stringstream serialized;
+    built.serialize(serialized);
+
+    SECTION("The index has every snarl and chain") {
+        REQUIRE(built.snarl_count() == 4);
+        REQUIRE(built.chain_count() == 3);
+        REQUIRE(built.size_in_bytes() == serialized.str().size());
+
+        auto roots = built.chains_of(SnarlIndex::NONE);
+        REQUIRE(roots.second - roots.first == 1);
+        REQUIRE(built.chain_size(roots.first) == 1);
+        size_t top = built.chain_member(roots.first, 0);
+        REQUIRE(built.parent_of(top) == SnarlIndex::NONE);
+
+        auto children = built.chains_of(top);
+        REQUIRE(children.second - children.first == 1);
+        REQUIRE(built.chain_size(children.first) == 2);
+        for (size_t i = 0; i < 2; i++) {
+            size_t child = built.chain_member(children.first, i);
+            REQUIRE(built.parent_of(child) == top);
+            REQUIRE(built.chain_of(child) == children.first);
+            REQUIRE(built.get_snarl(child).parent().start() == built.get_start(top));
+        }
+    }
+
+    SECTION("A loaded index answers boundary queries like the SnarlManager") {
+        SnarlIndex loaded(serialized);
+        stringstream serialized_again(serialized.str());
+        SnarlManager wrapped(make_shared<const SnarlIndex>(serialized_again));
+
+        for (id_t id = 0; id <= 10; id++) {
+            for (bool reverse : {false, true}) {
+                const Snarl* expected = original.into_which_snarl(id, reverse);
+                size_t number = loaded.into_which_snarl(id, reverse);
+                const Snarl* found = wrapped.into_which_snarl(id, reverse);
+                if (expected == nullptr) {
+                    REQUIRE(number == SnarlIndex::NONE);
+                    REQUIRE(found == nullptr);
+                } else {
+                    REQUIRE(number != SnarlIndex::NONE);
+                    REQUIRE(loaded.get_start(number) == expected->start());
+                    REQUIRE(loaded.get_end(number) == expected->end());
+                    REQUIRE(found != nullptr);
+                    REQUIRE(found->start() == expected->start());
+                    REQUIRE(found->end() == expected->end());
+                    REQUIRE(found->type() == expected->type());
+                }
+            }
+        }
+    }
+
+    SECTION("A SnarlManager wrapping an index answers tree queries like the original") {
+        stringstream serialized_again(serialized.str());
+        SnarlManager wrapped(make_shared<const SnarlIndex>(serialized_again));
+
+        vector<const Snarl*> expected;
+        original.for_each_snarl_preorder([&](const Snarl* snarl) {
+            expected.push_back(snarl);
+        });
+        vector<const Snarl*> found;
+        wrapped.for_each_snarl_preorder([&](const Snarl* snarl) {
+            found.push_back(snarl);
+        });
+        REQUIRE(found.size() == expected.size());
+
+        for (size_t i = 0; i < found.size(); i++) {
+            REQUIRE(found[i]->start() == expected[i]->start());
+            REQUIRE(found[i]->end() == expected[i]->end());
+            REQUIRE(wrapped.manage(*expected[i]) == found[i]);
+            REQUIRE(wrapped.is_root(found[i]) == original.is_root(expected[i]));
+            REQUIRE(wrapped.is_leaf(found[i]) == original.is_leaf(expected[i]));
+            REQUIRE(wrapped.in_nontrivial_chain(found[i]) == original.in_nontrivial_chain(expected[i]));
+            REQUIRE(wrapped.children_of(found[i]).size() == original.children_of(expected[i]).size());
+            REQUIRE(wrapped.chains_of(found[i]).size() == original.chains_of(expected[i]).size());
+
+            const Chain* chain = wrapped.chain_of(found[i]);
+            REQUIRE(chain->size() == original.chain_of(expected[i])->size());
+            REQUIRE(find(chain->begin(), chain->end(), found[i]) != chain->end());
+
+            const Snarl* parent = wrapped.parent_of(found[i]);
+            if (original.parent_of(expected[i]) == nullptr) {
+                REQUIRE(parent == nullptr);
+            } else {
+                REQUIRE(parent != nullptr);
+                REQUIRE(parent->start() == original.parent_of(expected[i])->start());
+                REQUIRE(find(wrapped.children_of(parent).begin(), wrapped.children_of(parent).end(), found[i])
+                        != wrapped.children_of(parent).end());
+            }
+        }
+
+        Snarl stranger;
+        stranger.mutable_start()->set_node_id(2);
+        stranger.mutable_end()->set_node_id(7);
+        REQUIRE_THROWS(wrapped.manage(stranger));
+    }
+
+    SECTION("A SnarlManager wrapping a mapped index has the same tree") {
+        string filename = tmpfilename("snarl-index");
+        {
+            ofstream out(filename, ios::binary);
+            built.serialize(out);
+        }
+        REQUIRE(SnarlIndex::is_snarl_index(filename));
+
+        SnarlManager wrapped(make_shared<const SnarlIndex>(filename));
+        REQUIRE(wrapped.top_level_snarls().size() == 1);
+
+        const Snarl* top = wrapped.top_level_snarls().front();
+        REQUIRE(top->start() == original.top_level_snarls().front()->start());
+        REQUIRE(wrapped.children_of(top).size() == 2);
+        REQUIRE(wrapped.chains_of(top).size() == 1);
+        REQUIRE(wrapped.chains_of(top).front().size() == 2);
+        REQUIRE(wrapped.in_nontrivial_chain(wrapped.children_of(top).front()));
+
+        for (const Snarl* child : wrapped.children_of(top)) {
+            REQUIRE(wrapped.parent_of(child) == top);
+            REQUIRE(wrapped.into_which_snarl(child->start()) == child);
+        }
+
+        SECTION("Adding a snarl keeps the old snarls findable") {
+            Snarl extra;
+            extra.mutable_start()->set_node_id(100);
+            extra.mutable_end()->set_node_id(101);
+            const Snarl* added = wrapped.add_snarl(extra);
+            wrapped.add_chain(Chain{added}, nullptr);
+
+            REQUIRE(wrapped.into_which_snarl(100, false) == added);
+            REQUIRE(wrapped.into_which_snarl(top->start()) == top);
+            REQUIRE(wrapped.top_level_snarls().size() == 2);
+            REQUIRE(wrapped.is_root(added));
+            REQUIRE(wrapped.children_of(top).size() == 2);
+            for (const Snarl* child : wrapped.children_of(top)) {
+                REQUIRE(wrapped.parent_of(child) == top);
+                REQUIRE(wrapped.chain_of(child)->size() == 2);
+            }
+        }
+
+        SECTION("Flipping a snarl keeps its place in the tree") {
+            const Snarl* child = wrapped.children_of(top).front();
+            wrapped.flip(child);
+
+            REQUIRE(wrapped.parent_of(child) == top);
+            REQUIRE(wrapped.into_which_snarl(child->start()) == child);
+            REQUIRE(wrapped.chain_of(child)->size() == 2);
+        }
+
+        remove(filename.c_str());
+    }
+
+    SECTION("Other files are not snarl indexes") {
+        string filename = tmpfilename("snarl-index");
+        {
+            ofstream out(filename);
+            out << "not an index";
+        }
+        REQUIRE(!SnarlIndex::is_snarl_index(filename));
+        REQUIRE_THROWS(SnarlIndex{filename});
+        remove(filename.c_str());
+    }
+}
+
+}
+}
@@ -1833,6 +1833,108 @@ namespace vg {
                 
         }
 
+        TEST_CASE("snarls can be found in each connected component", "[snarls]") {
+    
+            // Build a toy graph with two components
+            const string graph_json = R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "G"},
+                    {"id": 2, "sequence": "A"},
+                    {"id": 3, "sequence": "T"},
+                    {"id": 4, "sequence": "GGG"},
+                    {"id": 5, "sequence": "T"},
+                    {"id": 6, "sequence": "A"},
+                    {"id": 7, "sequence": "C"},
+                    {"id": 8, "sequence": "A"},
+                    {"id": 9, "sequence": "A"},
+                    {"id": 10, "sequence": "C"},
+                    {"id": 11, "sequence": "A"},
+                    {"id": 12, "sequence": "G"},
+                    {"id": 13, "sequence": "T"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2},
+                    {"from": 1, "to": 6},
+                    {"from": 2, "to": 3},
+                    {"from": 2, "to": 4},
+                    {"from": 3, "to": 5},
+                    {"from": 4, "to": 5},
+                    {"from": 5, "to": 6},
+                    {"from": 6, "to": 7},
+                    {"from": 6, "to": 8},
+                    {"from": 7, "to": 9},
+                    {"from": 8, "to": 9},
+                    {"from": 10, "to": 11},
+                    {"from": 10, "to": 12},
+                    {"from": 11, "to": 13},
+                    {"from": 12, "to": 13}
+                ],
+                "path": [
+                    {"name": "hint", "mapping": [
+                        {"position": {"node_id": 1}, "rank" : 1 },
+                        {"position": {"node_id": 6}, "rank" : 2 },
+                        {"position": {"node_id": 8}, "rank" : 3 },
+                        {"position": {"node_id": 9}, "rank" : 4 }
+                    ]}
+                ]
+            }
+            
+            )";
+            
+            VG graph;
+            Graph chunk;
+            json2pb(chunk, graph_json.c_str(), graph_json.size());
+            graph.extend(chunk);
+            
+            // Put a snarl's boundaries in ascending ID order
+            auto bounds = [](const Snarl* snarl) {
+                return make_pair(min(snarl->start().node_id(), snarl->end().node_id()),
+                                 max(snarl->start().node_id(), snarl->end().node_id()));
+            };
+            
+            SECTION("Components are reported separately and in order") {
+                vector<vector<pair<id_t, id_t>>> reported;
+                CactusSnarlFinder(graph).for_each_component_snarls([&](SnarlManager& snarl_manager) {
+                    reported.emplace_back();
+                    for (const Snarl* root : snarl_manager.top_level_snarls()) {
+                        reported.back().push_back(bounds(root));
+                    }
+                    sort(reported.back().begin(), reported.back().end());
+                });
+                
+                REQUIRE(reported.size() == 2);
+                REQUIRE(reported[0] == vector<pair<id_t, id_t>>{{1, 6}, {6, 9}});
+                REQUIRE(reported[1] == vector<pair<id_t, id_t>>{{10, 13}});
+            }
+            
+            SECTION("Merged snarls keep their trees and chains") {
+                SnarlManager snarl_manager = CactusSnarlFinder(graph).find_snarls();
+                
+                auto& roots = snarl_manager.top_level_snarls();
+                REQUIRE(roots.size() == 3);
+                REQUIRE(bounds(roots[2]) == pair<id_t, id_t>(10, 13));
+                
+                for (size_t i = 0; i < 2; i++) {
+                    // The first component's snarls form one chain
+                    REQUIRE(snarl_manager.chain_of(roots[i])->size() == 2);
+                    if (bounds(roots[i]) == pair<id_t, id_t>(1, 6)) {
+                        REQUIRE(snarl_manager.children_of(roots[i]).size() == 1);
+                        const Snarl* child = snarl_manager.children_of(roots[i]).front();
+                        REQUIRE(bounds(child) == pair<id_t, id_t>(2, 5));
+                        REQUIRE(snarl_manager.parent_of(child) == roots[i]);
+                    } else {
+                        REQUIRE(bounds(roots[i]) == pair<id_t, id_t>(6, 9));
+                        REQUIRE(snarl_manager.is_leaf(roots[i]));
+                    }
+                }
+                
+                REQUIRE(snarl_manager.into_which_snarl(10, false) == roots[2]);
+                REQUIRE(snarl_manager.chain_of(roots[2])->size() == 1);
+            }
+        }
+
         TEST_CASE("bubbles can be found in graphs with only heads", "[bubbles]") {
             
             // Build a toy graph
@@ -2919,6 +3021,521 @@ namespace vg {
             
         }
         
+        /// Describe each snarl by its boundary nodes, smaller first, and its
+        /// parent's, so snarl trees from different finders can be compared.
+        static set<pair<pair<id_t, id_t>, pair<id_t, id_t>>> describe_snarl_tree(SnarlManager& manager) {
+            auto ends = [](const Snarl* snarl) {
+                return snarl == nullptr ? make_pair((id_t) 0, (id_t) 0) :
+                    make_pair(min(snarl->start().node_id(), snarl->end().node_id()),
+                              max(snarl->start().node_id(), snarl->end().node_id()));
+            };
+            set<pair<pair<id_t, id_t>, pair<id_t, id_t>>> described;
+            manager.for_each_snarl_preorder([&](const Snarl* snarl) {
+                described.emplace(ends(snarl), ends(manager.parent_of(snarl)));
+            });
+            return described;
+        }
+        
+        TEST_CASE("HandleGraphSnarlFinder finds the same snarls as CactusSnarlFinder", "[snarls]") {
+            // Same graph as above: a snarl from 1 to 8 holding a chain of a
+            // snarl from 2 to 4 and a snarl from 4 to 7, with a snarl from 5 to
+            // 6 in the second one
+            VG graph;
+                
+            Node* n1 = graph.create_node("GCA");
+            Node* n2 = graph.create_node("T");
+            Node* n3 = graph.create_node("G");
+            Node* n4 = graph.create_node("CTGA");
+            Node* n5 = graph.create_node("GCA");
+            Node* n6 = graph.create_node("T");
+            Node* n7 = graph.create_node("G");
+            Node* n8 = graph.create_node("CTGA");
+            Node* n9 = graph.create_node("GCA");
+            
+            graph.create_edge(n1, n2);
+            graph.create_edge(n1, n8);
+            graph.create_edge(n2, n3);
+            graph.create_edge(n2, n4);
+            graph.create_edge(n3, n4);
+            graph.create_edge(n4, n5);
+            graph.create_edge(n4, n7);
+            graph.create_edge(n5, n6);
+            graph.create_edge(n5, n9);
+            graph.create_edge(n9, n6);
+            graph.create_edge(n6, n7);
+            graph.create_edge(n7, n8);
+            
+            SnarlManager cactus_manager = CactusSnarlFinder(graph).find_snarls();
+            SnarlManager handle_manager = HandleGraphSnarlFinder(graph).find_snarls();
+            
+            SECTION("The snarl trees are the same") {
+                REQUIRE(describe_snarl_tree(handle_manager) == describe_snarl_tree(cactus_manager));
+                REQUIRE(describe_snarl_tree(handle_manager).size() == 4);
+            }
+            
+            SECTION("The top snarl has the same chain") {
+                const Snarl* top_snarl = handle_manager.top_level_snarls().at(0);
+                auto& chains = handle_manager.chains_of(top_snarl);
+                REQUIRE(chains.size() == 1);
+                
+                auto& chain = chains.at(0);
+                REQUIRE(chain.size() == 2);
+                
+                // The chain can run either way, but must have both ends
+                set<id_t> boundaries;
+                for (const Snarl* snarl : chain) {
+                    boundaries.insert(snarl->start().node_id());
+                    boundaries.insert(snarl->end().node_id());
+                }
+                REQUIRE(boundaries == set<id_t>{2, 4, 7});
+            }
+            
+            SECTION("Contents are the same") {
+                handle_manager.for_each_snarl_preorder([&](const Snarl* snarl) {
+                    const Snarl* matching = cactus_manager.into_which_snarl(snarl->start().node_id(), snarl->start().backward());
+                    if (matching == nullptr) {
+                        matching = cactus_manager.into_which_snarl(snarl->end().node_id(), snarl->end().backward());
+                    }
+                    REQUIRE(matching != nullptr);
+                    REQUIRE(handle_manager.deep_contents(snarl, graph, true).first.size() ==
+                            cactus_manager.deep_contents(matching, graph, true).first.size());
+                });
+            }
+        }
+        
+        TEST_CASE("HandleGraphSnarlFinder agrees with CactusSnarlFinder on the snarl-finding test graphs", "[snarls]") {
+            // The graphs from the CactusSnarlFinder test cases above
+            auto compare = [](const string& graph_json) {
+                VG graph;
+                Graph chunk;
+                json2pb(chunk, graph_json.c_str(), graph_json.size());
+                graph.extend(chunk);
+                
+                SnarlManager cactus_manager = CactusSnarlFinder(graph).find_snarls();
+                SnarlManager handle_manager = HandleGraphSnarlFinder(graph).find_snarls();
+                REQUIRE(describe_snarl_tree(handle_manager) == describe_snarl_tree(cactus_manager));
+                REQUIRE(handle_manager.top_level_snarls().size() == cactus_manager.top_level_snarls().size());
+            };
+            
+            SECTION("They agree on a bubble chain with a path") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "G"},
+                    {"id": 2, "sequence": "A"},
+                    {"id": 3, "sequence": "T"},
+                    {"id": 4, "sequence": "GGG"},
+                    {"id": 5, "sequence": "T"},
+                    {"id": 6, "sequence": "A"},
+                    {"id": 7, "sequence": "C"},
+                    {"id": 8, "sequence": "A"},
+                    {"id": 9, "sequence": "A"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2},
+                    {"from": 1, "to": 6},
+                    {"from": 2, "to": 3},
+                    {"from": 2, "to": 4},
+                    {"from": 3, "to": 5},
+                    {"from": 4, "to": 5},
+                    {"from": 5, "to": 6},
+                    {"from": 6, "to": 7},
+                    {"from": 6, "to": 8},
+                    {"from": 7, "to": 9},
+                    {"from": 8, "to": 9}
+                    
+                ],
+                "path": [
+                    {"name": "hint", "mapping": [
+                        {"position": {"node_id": 1}, "rank" : 1 },
+                        {"position": {"node_id": 6}, "rank" : 2 },
+                        {"position": {"node_id": 8}, "rank" : 3 },
+                        {"position": {"node_id": 9}, "rank" : 4 }
+                    ]}
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on two connected components, one with a path") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "G"},
+                    {"id": 2, "sequence": "A"},
+                    {"id": 3, "sequence": "T"},
+                    {"id": 4, "sequence": "GGG"},
+                    {"id": 5, "sequence": "T"},
+                    {"id": 6, "sequence": "A"},
+                    {"id": 7, "sequence": "C"},
+                    {"id": 8, "sequence": "A"},
+                    {"id": 9, "sequence": "A"},
+                    {"id": 10, "sequence": "C"},
+                    {"id": 11, "sequence": "A"},
+                    {"id": 12, "sequence": "G"},
+                    {"id": 13, "sequence": "T"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2},
+                    {"from": 1, "to": 6},
+                    {"from": 2, "to": 3},
+                    {"from": 2, "to": 4},
+                    {"from": 3, "to": 5},
+                    {"from": 4, "to": 5},
+                    {"from": 5, "to": 6},
+                    {"from": 6, "to": 7},
+                    {"from": 6, "to": 8},
+                    {"from": 7, "to": 9},
+                    {"from": 8, "to": 9},
+                    {"from": 10, "to": 11},
+                    {"from": 10, "to": 12},
+                    {"from": 11, "to": 13},
+                    {"from": 12, "to": 13}
+                ],
+                "path": [
+                    {"name": "hint", "mapping": [
+                        {"position": {"node_id": 1}, "rank" : 1 },
+                        {"position": {"node_id": 6}, "rank" : 2 },
+                        {"position": {"node_id": 8}, "rank" : 3 },
+                        {"position": {"node_id": 9}, "rank" : 4 }
+                    ]}
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on an inverted node and only heads") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "G"},
+                    {"id": 2, "sequence": "A"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2, "to_end": true}
+                    
+                ],
+                "path": [
+                    {"name": "hint", "mapping": [
+                        {"position": {"node_id": 1}, "rank" : 1 },
+                        {"position": {"node_id": 2, "is_reverse": true}, "rank" : 2 }
+                    ]}
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on a bigger graph with an inverted end and only heads") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "G"},
+                    {"id": 2, "sequence": "A"},
+                    {"id": 3, "sequence": "T"},
+                    {"id": 4, "sequence": "GGG"},
+                    {"id": 5, "sequence": "T"},
+                    {"id": 6, "sequence": "A"},
+                    {"id": 7, "sequence": "C"},
+                    {"id": 8, "sequence": "A"},
+                    {"id": 9, "sequence": "T"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2},
+                    {"from": 1, "to": 6},
+                    {"from": 2, "to": 3},
+                    {"from": 2, "to": 4},
+                    {"from": 3, "to": 5},
+                    {"from": 4, "to": 5},
+                    {"from": 5, "to": 6},
+                    {"from": 6, "to": 7},
+                    {"from": 6, "to": 8},
+                    {"from": 7, "to": 9, "to_end": true},
+                    {"from": 8, "to": 9, "to_end": true}
+                    
+                ],
+                "path": [
+                    {"name": "hint", "mapping": [
+                        {"position": {"node_id": 1}, "rank" : 1 },
+                        {"position": {"node_id": 6}, "rank" : 2 },
+                        {"position": {"node_id": 8}, "rank" : 3 },
+                        {"position": {"node_id": 9, "is_reverse": true}, "rank" : 4 }
+                    ]}
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on an inverted start and only tails") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "C"},
+                    {"id": 2, "sequence": "A"},
+                    {"id": 3, "sequence": "T"},
+                    {"id": 4, "sequence": "GGG"},
+                    {"id": 5, "sequence": "T"},
+                    {"id": 6, "sequence": "A"},
+                    {"id": 7, "sequence": "C"},
+                    {"id": 8, "sequence": "A"},
+                    {"id": 9, "sequence": "A"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2, "from_start": true},
+                    {"from": 1, "to": 6, "from_start": true},
+                    {"from": 2, "to": 3},
+                    {"from": 2, "to": 4},
+                    {"from": 3, "to": 5},
+                    {"from": 4, "to": 5},
+                    {"from": 5, "to": 6},
+                    {"from": 6, "to": 7},
+                    {"from": 6, "to": 8},
+                    {"from": 7, "to": 9},
+                    {"from": 8, "to": 9}
+                    
+                ],
+                "path": [
+                    {"name": "hint", "mapping": [
+                        {"position": {"node_id": 1, "is_reverse": true}, "rank" : 1 },
+                        {"position": {"node_id": 6}, "rank" : 2 },
+                        {"position": {"node_id": 8}, "rank" : 3 },
+                        {"position": {"node_id": 9}, "rank" : 4 }
+                    ]}
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on self loops where the head cannot reach the tail") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "A"},
+                    {"id": 2, "sequence": "A"},
+                    {"id": 3, "sequence": "A"},
+                    {"id": 4, "sequence": "A"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 3},
+                    {"from": 2, "to": 4},
+                    {"from": 2, "to": 3},
+                    {"from": 2, "to": 2},
+                    {"from": 3, "to": 3}            
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on a cycle with no tips and a path") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "G"},
+                    {"id": 2, "sequence": "A"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2},
+                    {"from": 2, "to": 1}
+                    
+                ],
+                "path": [
+                    {"name": "hint", "mapping": [
+                        {"position": {"node_id": 1}, "rank" : 1 },
+                        {"position": {"node_id": 2}, "rank" : 2 }
+                    ]}
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on a cycle with no tips and no path") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "G"},
+                    {"id": 2, "sequence": "A"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2},
+                    {"from": 2, "to": 1}
+                    
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on tips that aren't on a path") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "A"},
+                    {"id": 2, "sequence": "A"},
+                    {"id": 3, "sequence": "A"},
+                    {"id": 4, "sequence": "A"},
+                    {"id": 5, "sequence": "A"},
+                    {"id": 6, "sequence": "A"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 3},
+                    {"from": 2, "to": 4},
+                    {"from": 2, "to": 3},
+                    {"from": 5, "to": 2},
+                    {"from": 3, "to": 6}
+                ]
+            }
+            
+            )");
+            }
+            
+            SECTION("They agree on a chain of bubbles with no path") {
+                compare(R"(
+            
+            {
+                "node": [
+                    {"id": 1, "sequence": "A"},
+                    {"id": 2, "sequence": "A"},
+                    {"id": 3, "sequence": "A"},
+                    {"id": 4, "sequence": "A"},
+                    {"id": 5, "sequence": "A"},
+                    {"id": 6, "sequence": "A"},
+                    {"id": 7, "sequence": "A"},
+                    {"id": 8, "sequence": "A"},
+                    {"id": 9, "sequence": "A"},
+                    {"id": 10, "sequence": "A"}
+                ],
+                "edge": [
+                    {"from": 1, "to": 2},
+                    {"from": 1, "to": 3},
+                    {"from": 2, "to": 4},
+                    {"from": 3, "to": 4},
+                    {"from": 4, "to": 5},
+                    {"from": 4, "to": 6},
+                    {"from": 5, "to": 7},
+                    {"from": 6, "to": 7},
+                    {"from": 7, "to": 8},
+                    {"from": 7, "to": 9},
+                    {"from": 8, "to": 10},
+                    {"from": 9, "to": 10}
+                ]
+            }
+            
+            )");
+            }
+        }
+        
+        TEST_CASE("HandleGraphSnarlFinder leaves out nested unary snarls", "[snarls]") {
+            // The graph from the nested unary snarls NetGraph test, where
+            // CactusSnarlFinder would make unary snarls on 2 and 4
+            VG graph;
+            
+            Node* n1 = graph.create_node("GCA");
+            Node* n2 = graph.create_node("T");
+            Node* n3 = graph.create_node("G");
+            Node* n4 = graph.create_node("CTGA");
+            Node* n5 = graph.create_node("GCA");
+            Node* n6 = graph.create_node("T");
+            Node* n7 = graph.create_node("G");
+            Node* n8 = graph.create_node("CTGA");
+            
+            graph.create_edge(n1, n2);
+            graph.create_edge(n1, n4);
+            graph.create_edge(n1, n8);
+            graph.create_edge(n2, n3);
+            graph.create_edge(n4, n5);
+            graph.create_edge(n4, n6);
+            graph.create_edge(n5, n7);
+            graph.create_edge(n6, n7);
+            graph.create_edge(n7, n7, false, true);
+            graph.create_edge(n8, n4, true, false);
+            graph.create_edge(n8, n2, true, false);
+            
+            SnarlManager snarl_manager = HandleGraphSnarlFinder(graph).find_snarls();
+            
+            SECTION("No unary snarls are reported") {
+                snarl_manager.for_each_snarl_preorder([&](const Snarl* snarl) {
+                    REQUIRE(snarl->type() != UNARY);
+                    REQUIRE(snarl->start().node_id() != snarl->end().node_id());
+                });
+            }
+            
+            SECTION("The snarls around the dead ends are still found") {
+                // 3 to 2 and 2 to 8 make a chain, and 4 to 7 nests in 2 to 8
+                // where the unary snarls would have been
+                set<pair<pair<id_t, id_t>, pair<id_t, id_t>>> expected {
+                    {{2, 3}, {0, 0}},
+                    {{2, 8}, {0, 0}},
+                    {{4, 7}, {2, 8}}
+                };
+                REQUIRE(describe_snarl_tree(snarl_manager) == expected);
+                REQUIRE(snarl_manager.top_level_snarls().size() == 2);
+            }
+        }
+        
+        TEST_CASE("HandleGraphSnarlFinder finds snarls in each connected component", "[snarls]") {
+            // Two copies of a bubble chain, where each has a snarl containing a
+            // nested bubble followed by a plain bubble
+            VG graph;
+            
+            for (size_t copy = 0; copy < 2; copy++) {
+                Node* n1 = graph.create_node("G");
+                Node* n2 = graph.create_node("A");
+                Node* n3 = graph.create_node("T");
+                Node* n4 = graph.create_node("GGG");
+                Node* n5 = graph.create_node("T");
+                Node* n6 = graph.create_node("A");
+                Node* n7 = graph.create_node("C");
+                Node* n8 = graph.create_node("A");
+                Node* n9 = graph.create_node("A");
+                
+                graph.create_edge(n1, n2);
+                graph.create_edge(n1, n6);
+                graph.create_edge(n2, n3);
+                graph.create_edge(n2, n4);
+                graph.create_edge(n3, n5);
+                graph.create_edge(n4, n5);
+                graph.create_edge(n5, n6);
+                graph.create_edge(n6, n7);
+                graph.create_edge(n6, n8);
+                graph.create_edge(n7, n9);
+                graph.create_edge(n8, n9);
+            }
+            
+            SnarlManager snarl_manager = HandleGraphSnarlFinder(graph).find_snarls();
+            
+            REQUIRE(snarl_manager.top_level_snarls().size() == 4);
+            
+            size_t snarl_count = 0;
+            snarl_manager.for_each_snarl_preorder([&](const Snarl* snarl) {
+                snarl_count++;
+                REQUIRE(snarl->type() == ULTRABUBBLE);
+            });
+            REQUIRE(snarl_count == 6);
+            
+            for (const Snarl* snarl : snarl_manager.top_level_snarls()) {
+                // Each top level snarl is either the one around 2 to 5 or the
+                // plain bubble after it
+                id_t low = min(snarl->start().node_id(), snarl->end().node_id());
+                id_t high = max(snarl->start().node_id(), snarl->end().node_id());
+                REQUIRE(high - low == (low % 9 == 1 ? 5 : 3));
+                REQUIRE(snarl_manager.children_of(snarl).size() == (low % 9 == 1 ? 1 : 0));
+            }
+        }
         
     }
 }
@@ -5,6 +5,9 @@
 #include "catch.hpp"
 #include "../vg.hpp"
 #include "../utility.hpp"
+#include "../stream.hpp"
+
+#include <sstream>
 
 namespace vg {
 namespace unittest {
@@ -2127,5 +2130,68 @@ TEST_CASE("create_handle() correctly creates handles using given sequence and id
     
 }
 
+TEST_CASE("VG survives a round trip through a stream of many chunks", "[vg][serialize]") {
+    VG vg;
+    handle_t prev = vg.create_handle("GATTACA");
+    for (size_t i = 0; i < 5000; i++) {
+        handle_t next = vg.create_handle(i % 2 ? "T" : "CA");
+        vg.create_edge(prev, next);
+        prev = next;
+    }
+    Path path;
+    path.set_name("ref");
+    for (id_t id = 1; id <= 5001; id += 2) {
+        Mapping* mapping = path.add_mapping();
+        mapping->mutable_position()->set_node_id(id);
+        mapping->set_rank(path.mapping_size());
+    }
+    vg.paths.extend(path);
+    vg.paths.to_graph(vg.graph);
+
+    // Small chunks, so the chunks get spread over threads
+    stringstream serialized;
+    vg.serialize_to_ostream(serialized, 10);
+    VG loaded(serialized);
+
+    REQUIRE(loaded.node_count() == 5001);
+    REQUIRE(loaded.edge_count() == 5000);
+    for (id_t i = 0; i < loaded.graph.node_size(); i++) {
+        // Nodes come back in the same order
+        REQUIRE(loaded.graph.node(i).id() == i + 1);
+        REQUIRE(loaded.get_node(i + 1) == loaded.graph.mutable_node(i));
+    }
+    REQUIRE(loaded.has_edge(NodeSide(4000, true), NodeSide(4001, false)));
+    auto& mappings = loaded.paths.get_path("ref");
+    REQUIRE(mappings.size() == 2501);
+    id_t expected = 1;
+    for (auto& mapping : mappings) {
+        REQUIRE(mapping.position().node_id() == expected);
+        expected += 2;
+    }
+}
+
+TEST_CASE("VG drops nodes and edges repeated across stream chunks", "[vg][serialize]") {
+    string chunk_json = R"(
+    {"node": [{"id": 1, "sequence": "GAT"}, {"id": 2, "sequence": "TACA"}],
+     "edge": [{"from": 1, "to": 2}]}
+    )";
+    vector<Graph> chunks(3);
+    for (auto& chunk : chunks) {
+        json2pb(chunk, chunk_json.c_str(), chunk_json.size());
+    }
+    chunks[1].mutable_node(0)->set_id(3);
+    chunks[1].mutable_edge(0)->set_from(3);
+
+    stringstream serialized;
+    stream::write_buffered(serialized, chunks, 0);
+    VG loaded(serialized, false, false);
+
+    REQUIRE(loaded.graph.node_size() == 3);
+    REQUIRE(loaded.graph.edge_size() == 2);
+    REQUIRE(loaded.get_node(3)->sequence() == "GAT");
+    REQUIRE(loaded.has_edge(NodeSide(3, true), NodeSide(2, false)));
+    REQUIRE(loaded.is_valid());
+}
+
 }
 }
@@ -16,6 +16,8 @@
 #include "algorithms/weakly_connected_components.hpp"
 #include "algorithms/distance_to_head.hpp"
 #include "algorithms/distance_to_tail.hpp"
+#include "algorithms/dijkstra.hpp"
+#include "algorithms/find_shortest_paths.hpp"
 #include "vg.hpp"
 #include "json2pb.h"
 
@@ -1943,6 +1945,128 @@ namespace vg {
             }
         }
         
+        TEST_CASE( "Strict max length pruning keeps nodes whose shortest path is reached late", "[algorithms]" ) {
+            VG vg;
+            
+            Node* n1 = vg.create_node("GA");
+            Node* n2 = vg.create_node("CCCC");
+            Node* n3 = vg.create_node("T");
+            Node* n4 = vg.create_node("T");
+            Node* n5 = vg.create_node("AAAA");
+            Node* n6 = vg.create_node("CCCC");
+            
+            // a short path 1-2-3-4-6 and a long node 5 that joins in from 1 and 2
+            vg.create_edge(n1, n2);
+            vg.create_edge(n2, n3);
+            vg.create_edge(n3, n4);
+            vg.create_edge(n4, n6);
+            vg.create_edge(n1, n5);
+            vg.create_edge(n5, n6);
+            vg.create_edge(n2, n5);
+            
+            // Going backward from node 6, node 5 is reached before node 3, so node 2 is first queued
+            // through node 5. Its distance through nodes 3 and 4 is shorter, and only that one puts it
+            // on a path under the maximum length.
+            Graph g;
+            algorithms::extract_connecting_graph(&vg, g, 10, make_pos_t(n1->id(), false, 0),
+                                                 make_pos_t(n6->id(), false, 2),
+                                                 false, false, true, true, true);
+            
+            set<id_t> node_ids;
+            for (const Node& node : g.node()) {
+                node_ids.insert(node.id());
+            }
+            REQUIRE(node_ids == set<id_t>{n1->id(), n2->id(), n3->id(), n4->id(), n5->id(), n6->id()});
+            
+            set<pair<id_t, id_t>> edges;
+            for (const Edge& edge : g.edge()) {
+                REQUIRE(edge.from_start() == edge.to_end());
+                edges.insert(edge.from_start() ? make_pair(edge.to(), edge.from()) : make_pair(edge.from(), edge.to()));
+            }
+            // the edge from 2 to 5 is only on paths over the maximum length
+            REQUIRE(edges == set<pair<id_t, id_t>>{{n1->id(), n2->id()}, {n2->id(), n3->id()}, {n3->id(), n4->id()},
+                                                   {n4->id(), n6->id()}, {n1->id(), n5->id()}, {n5->id(), n6->id()}});
+        }
+        
+        TEST_CASE( "Connecting graph extraction gives the same results with a reused workspace or into a handle graph", "[algorithms]" ) {
+            VG vg;
+            
+            Node* n0 = vg.create_node("CGA");
+            Node* n1 = vg.create_node("TTGG");
+            Node* n2 = vg.create_node("GT");
+            Node* n3 = vg.create_node("ATG");
+            Node* n4 = vg.create_node("TGAG");
+            Node* n5 = vg.create_node("CA");
+            Node* n6 = vg.create_node("T");
+            
+            vg.create_edge(n1, n0, true, true);
+            vg.create_edge(n1, n2);
+            vg.create_edge(n1, n3);
+            vg.create_edge(n1, n4, false, true);
+            vg.create_edge(n1, n5);
+            vg.create_edge(n3, n3, true, true);
+            vg.create_edge(n4, n6, true, false);
+            vg.create_edge(n5, n6);
+            vg.create_edge(n6, n1);
+            
+            // summarize a graph in a way that doesn't depend on the order of its nodes and edges
+            auto summarize = [](const Graph& g) {
+                set<pair<id_t, string>> nodes;
+                for (const Node& node : g.node()) {
+                    nodes.emplace(node.id(), node.sequence());
+                }
+                set<tuple<id_t, bool, id_t, bool>> edges;
+                for (const Edge& edge : g.edge()) {
+                    edges.insert(min(make_tuple(edge.from(), edge.from_start(), edge.to(), edge.to_end()),
+                                     make_tuple(edge.to(), !edge.to_end(), edge.from(), !edge.from_start())));
+                }
+                return make_pair(nodes, edges);
+            };
+            
+            vector<pair<pos_t, pos_t>> queries {
+                make_pair(make_pos_t(n0->id(), false, 1), make_pos_t(n6->id(), false, 0)),
+                make_pair(make_pos_t(n1->id(), false, 2), make_pos_t(n5->id(), false, 1)),
+                make_pair(make_pos_t(n6->id(), true, 0), make_pos_t(n0->id(), true, 2)),
+                make_pair(make_pos_t(n2->id(), false, 0), make_pos_t(n6->id(), false, 0)),
+                make_pair(make_pos_t(n5->id(), false, 1), make_pos_t(n4->id(), true, 3))
+            };
+            
+            algorithms::ConnectingGraphWorkspace workspace;
+            
+            for (int64_t max_len : {3, 8, 20}) {
+                for (size_t i = 0; i < queries.size(); i++) {
+                    for (int flags = 0; flags < 32; flags++) {
+                        
+                        Graph fresh;
+                        auto fresh_trans = algorithms::extract_connecting_graph(&vg, fresh, max_len,
+                                                                                queries[i].first, queries[i].second,
+                                                                                flags & 1, flags & 2, flags & 4,
+                                                                                flags & 8, flags & 16);
+                        
+                        Graph reused;
+                        auto reused_trans = algorithms::extract_connecting_graph(&vg, reused, max_len,
+                                                                                 queries[i].first, queries[i].second,
+                                                                                 workspace,
+                                                                                 flags & 1, flags & 2, flags & 4,
+                                                                                 flags & 8, flags & 16);
+                        
+                        REQUIRE(summarize(fresh) == summarize(reused));
+                        REQUIRE(fresh_trans == reused_trans);
+                        
+                        VG handles;
+                        auto handle_trans = algorithms::extract_connecting_graph(&vg, &handles, max_len,
+                                                                                 queries[i].first, queries[i].second,
+                                                                                 workspace,
+                                                                                 flags & 1, flags & 2, flags & 4,
+                                                                                 flags & 8, flags & 16);
+                        
+                        REQUIRE(summarize(handles.graph) == summarize(fresh));
+                        REQUIRE(handle_trans == fresh_trans);
+                    }
+                }
+            }
+        }
+        
         TEST_CASE( "Containing graph extraction algorithm produces expected results", "[algorithms]" ) {
             
             VG vg;
@@ -2850,6 +2974,52 @@ namespace vg {
                   
         }
         
+        TEST_CASE( "Topological sort order is stable on cyclic and reversing graphs",
+                  "[algorithms][topologicalsort]" ) {
+            
+            VG vg;
+            
+            Node* n1 = vg.create_node("GAT", 1);
+            Node* n2 = vg.create_node("TA", 2);
+            Node* n3 = vg.create_node("CA", 3);
+            Node* n4 = vg.create_node("GGA", 4);
+            Node* n5 = vg.create_node("T", 5);
+            Node* n6 = vg.create_node("AC", 6);
+            Node* n7 = vg.create_node("CCA", 7);
+            Node* n8 = vg.create_node("G", 8);
+            // A second head with a much higher ID
+            Node* n12 = vg.create_node("TTC", 12);
+            
+            vg.create_edge(n1, n2);
+            vg.create_edge(n12, n3);
+            // A cycle
+            vg.create_edge(n2, n3);
+            vg.create_edge(n3, n2);
+            // An inversion
+            vg.create_edge(n3, n4, false, true);
+            vg.create_edge(n4, n5, true, false);
+            // Self loops, one reversing
+            vg.create_edge(n5, n5);
+            vg.create_edge(n5, n6);
+            vg.create_edge(n6, n6, false, true);
+            // A cycle we can only enter backward
+            vg.create_edge(n6, n8, false, true);
+            vg.create_edge(n7, n8);
+            vg.create_edge(n8, n7);
+            
+            auto handle_sort = algorithms::topological_sort(&vg);
+            
+            // Heads are taken in ID order, with nodes freed up along the way
+            // interleaved by ID, and cycles are entered where we first saw them
+            vector<pair<id_t, bool>> expected {{1, false}, {12, false}, {2, false}, {3, false}, {4, true},
+                {5, false}, {6, false}, {8, true}, {7, true}};
+            vector<pair<id_t, bool>> found;
+            for (auto& handle : handle_sort) {
+                found.emplace_back(vg.get_id(handle), vg.get_is_reverse(handle));
+            }
+            REQUIRE(found == expected);
+        }
+        
         TEST_CASE( "Weakly connected components works",
                   "[algorithms]" ) {
             
@@ -2908,6 +3078,94 @@ namespace vg {
             
             }
         }
+        
+        TEST_CASE( "Weakly connected component labels are numbered by lowest node ID",
+                  "[algorithms]" ) {
+            
+            VG vg;
+            
+            // Sparse IDs, added out of order, with a reversing edge and a
+            // reversing self loop
+            Node* n20 = vg.create_node("A", 20);
+            Node* n3 = vg.create_node("C", 3);
+            Node* n11 = vg.create_node("G", 11);
+            Node* n7 = vg.create_node("T", 7);
+            Node* n15 = vg.create_node("A", 15);
+            vg.create_node("C", 9);
+            
+            vg.create_edge(n20, n3, false, true);
+            vg.create_edge(n11, n7);
+            vg.create_edge(n15, n15, false, true);
+            
+            vector<id_t> node_ids;
+            vector<size_t> labels;
+            size_t component_count = algorithms::weakly_connected_component_labels(&vg, node_ids, labels);
+            
+            REQUIRE(component_count == 4);
+            REQUIRE(node_ids == vector<id_t>{3, 7, 9, 11, 15, 20});
+            REQUIRE(labels == vector<size_t>{0, 1, 2, 1, 3, 0});
+            
+            auto components = algorithms::weakly_connected_components(&vg);
+            REQUIRE(components.size() == 4);
+            REQUIRE(components[0] == unordered_set<id_t>{3, 20});
+            REQUIRE(components[3] == unordered_set<id_t>{15});
+        }
+        TEST_CASE("Dijkstra search finds shortest distances between handles", "[algorithms]") {
+            VG vg;
+            Node* n1 = vg.create_node("AA");
+            Node* n2 = vg.create_node("ACTGA");
+            Node* n3 = vg.create_node("G");
+            Node* n4 = vg.create_node("AT");
+            Node* n5 = vg.create_node("CCC");
+            vg.create_edge(n1, n2);
+            vg.create_edge(n1, n3);
+            vg.create_edge(n2, n4);
+            vg.create_edge(n3, n4);
+            vg.create_edge(n4, n5);
+            
+            handle_t h1 = vg.get_handle(n1->id());
+            unordered_map<id_t, size_t> found;
+            auto record = [&](const handle_t& here, size_t distance) {
+                REQUIRE(!vg.get_is_reverse(here));
+                REQUIRE(!found.count(vg.get_id(here)));
+                found[vg.get_id(here)] = distance;
+                return true;
+            };
+            
+            SECTION("Every handle is visited once at its shortest distance") {
+                algorithms::dijkstra(&vg, h1, record);
+                REQUIRE(found == unordered_map<id_t, size_t>{{n2->id(), 0}, {n3->id(), 0}, {n4->id(), 1}, {n5->id(), 3}});
+            }
+            
+            SECTION("Handles past the maximum distance are not visited") {
+                algorithms::dijkstra(&vg, h1, record, 2);
+                REQUIRE(found == unordered_map<id_t, size_t>{{n2->id(), 0}, {n3->id(), 0}, {n4->id(), 1}});
+            }
+            
+            SECTION("Each start contributes its own initial distance") {
+                vector<pair<handle_t, size_t>> starts{{vg.get_handle(n2->id()), 0}, {vg.get_handle(n3->id()), 10}};
+                algorithms::dijkstra(&vg, starts, record);
+                REQUIRE(found == unordered_map<id_t, size_t>{{n4->id(), 0}, {n5->id(), 2}});
+            }
+            
+            SECTION("The visit function can stop the search") {
+                algorithms::dijkstra(&vg, h1, [&](const handle_t& here, size_t distance) {
+                    record(here, distance);
+                    return vg.get_id(here) != n4->id();
+                });
+                REQUIRE(found.size() == 3);
+                REQUIRE(found.count(n4->id()));
+            }
+            
+            SECTION("Shortest paths from a handle include the handle itself") {
+                auto distances = algorithms::find_shortest_paths(&vg, h1);
+                REQUIRE(distances.size() == 5);
+                REQUIRE(distances[h1] == 0);
+                REQUIRE(distances[vg.get_handle(n4->id())] == 1);
+                REQUIRE(distances[vg.get_handle(n5->id())] == 3);
+            }
+        }
+
         TEST_CASE("distance_to_head() using HandleGraph produces expected results", "[vg]") {
             VG vg;
             Node* n0 = vg.create_node("AA");
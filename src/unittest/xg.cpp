@@ -8,6 +8,7 @@
 #include "vg.hpp"
 #include "xg.hpp"
 #include "graph.hpp"
+#include "xg_position.hpp"
 #include <stdio.h>
 
 namespace vg {
@@ -235,6 +236,120 @@ TEST_CASE("We can build the xg index on a small graph with discontinuous node id
 
 }
 
+TEST_CASE("Position distances in XG respect the maximum", "[xg]") {
+
+    // 1 reaches 3 both directly and through 2
+    string graph_json = R"(
+    {"node":[{"id":1,"sequence":"GATT"},
+    {"id":2,"sequence":"ACA"},
+    {"id":3,"sequence":"TTG"}],
+    "edge":[{"from":1,"to":2},{"from":2,"to":3},{"from":1,"to":3}]}
+    )";
+    
+    Graph proto_graph;
+    json2pb(proto_graph, graph_json.c_str(), graph_json.size());
+    xg::XG xg_index(proto_graph);
+    
+    const int64_t unreachable = numeric_limits<int64_t>::max();
+    
+    // The maximum counts the positions searched one base at a time after pos1, and a position past
+    // the start of its node is seen from the base before it
+    
+    SECTION("Positions on the same node are one level closer when past the start") {
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(1, false, 2), 0, &xg_index) == 2);
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(1, false, 3), 1, &xg_index) == 3);
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(1, false, 3), 0, &xg_index) == unreachable);
+    }
+    
+    SECTION("The start of the next node is found at its own level") {
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(2, false, 0), 3, &xg_index) == 4);
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(2, false, 0), 2, &xg_index) == unreachable);
+    }
+    
+    SECTION("A position past the start of the next node is found one level early") {
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(2, false, 1), 3, &xg_index) == 5);
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(2, false, 1), 2, &xg_index) == unreachable);
+    }
+    
+    SECTION("A position past the end of a node is found from its last base") {
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(2, false, 3), 5, &xg_index) == 7);
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(2, false, 3), 4, &xg_index) == unreachable);
+    }
+    
+    SECTION("A search from past the end of a node starts on the next node") {
+        REQUIRE(xg_distance(make_pos_t(1, false, 4), make_pos_t(2, false, 0), 0, &xg_index) == 0);
+        REQUIRE(xg_distance(make_pos_t(1, false, 4), make_pos_t(2, false, 2), 1, &xg_index) == 2);
+        REQUIRE(xg_distance(make_pos_t(1, false, 4), make_pos_t(2, false, 2), 0, &xg_index) == unreachable);
+    }
+    
+    SECTION("The shortest way around is the one measured") {
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(3, false, 0), 3, &xg_index) == 4);
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(3, false, 0), 2, &xg_index) == unreachable);
+        REQUIRE(xg_distance(make_pos_t(1, false, 2), make_pos_t(3, false, 1), 1, &xg_index) == 3);
+        REQUIRE(xg_distance(make_pos_t(1, false, 2), make_pos_t(3, false, 1), 0, &xg_index) == unreachable);
+    }
+    
+    SECTION("A negative maximum means no limit") {
+        REQUIRE(xg_distance(make_pos_t(1, false, 0), make_pos_t(2, false, 3), -1, &xg_index) == 7);
+        REQUIRE(xg_distance(make_pos_t(2, false, 0), make_pos_t(1, false, 0), -1, &xg_index) == unreachable);
+    }
+    
+    SECTION("Every pair of positions agrees with a search one base at a time") {
+        // the search used before the distances were taken from a shortest path search
+        auto base_search = [&](pos_t pos1, pos_t pos2, int64_t maximum) -> int64_t {
+            if (pos1 == pos2) return 0;
+            int64_t adj = (offset(pos1) == xg_node_length(id(pos1), &xg_index) ? 0 : 1);
+            set<pos_t> seen;
+            set<pos_t> nexts = xg_next_pos(pos1, false, &xg_index);
+            int64_t distance = 0;
+            while (!nexts.empty()) {
+                set<pos_t> todo;
+                for (auto& next : nexts) {
+                    if (!seen.count(next)) {
+                        seen.insert(next);
+                        if (next == pos2) {
+                            return distance + adj;
+                        }
+                        if (make_pos_t(id(next), is_rev(next), offset(next) + 1) == pos2) {
+                            return distance + adj + 1;
+                        }
+                        for (auto& x : xg_next_pos(next, false, &xg_index)) {
+                            todo.insert(x);
+                        }
+                    }
+                }
+                if (distance == maximum) {
+                    break;
+                }
+                nexts = todo;
+                ++distance;
+            }
+            return unreachable;
+        };
+        
+        vector<pos_t> positions;
+        for (id_t node_id = 1; node_id <= 3; node_id++) {
+            for (bool backward : {false, true}) {
+                for (size_t off = 0; off <= xg_node_length(node_id, &xg_index); off++) {
+                    positions.push_back(make_pos_t(node_id, backward, off));
+                }
+            }
+        }
+        for (auto& pos1 : positions) {
+            for (auto& pos2 : positions) {
+                if (id(pos1) == id(pos2) && is_rev(pos1) == is_rev(pos2) && offset(pos1) + 1 == offset(pos2)
+                    && offset(pos2) == xg_node_length(id(pos2), &xg_index)) {
+                    // the base search never looked at the end of the base it started on
+                    continue;
+                }
+                for (int64_t maximum = -1; maximum <= 10; maximum++) {
+                    REQUIRE(xg_distance(pos1, pos2, maximum, &xg_index) == base_search(pos1, pos2, maximum));
+                }
+            }
+        }
+    }
+}
+
 TEST_CASE("Target to alignment extraction", "[xg-target-to-aln]") {
 
     VG vg;
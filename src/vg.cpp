@@ -4,6 +4,7 @@
 // We need to use ultrabubbles for dot output
 #include "genotypekit.hpp"
 #include "algorithms/topological_sort.hpp"
+#include "algorithms/weakly_connected_components.hpp"
 #include <raptor2/raptor2.h>
 #include <stPinchGraphs.h>
 
@@ -28,15 +29,21 @@ VG::VG(istream& in, bool showp, bool warn_on_duplicates) {
         create_progress("loading graph", count);
     };
 
-    // the graph is read in chunks, which are attached to this graph
+    // the graph is read in chunks, which are parsed on worker threads and
+    // attached to this graph in order. We index everything at the end.
     uint64_t i = 0;
-    function<void(Graph&)> lambda = [this, &i, &warn_on_duplicates](Graph& g) {
-        update_progress(++i);
-        // We usually expect these to not overlap in nodes or edges, so complain unless we've been told not to.
-        extend(g, warn_on_duplicates);
+    function<void(vector<Graph>&)> lambda = [this, &i](vector<Graph>& chunks) {
+        for (auto& chunk : chunks) {
+            update_progress(++i);
+            absorb_chunk(chunk);
+        }
     };
 
-    stream::for_each(in, lambda, handle_count);
+    stream::for_each_batch_parallel(in, lambda, handle_count);
+
+    // We usually expect the chunks to not overlap in nodes or edges, so
+    // complain unless we've been told not to.
+    build_indexes_dropping_duplicates(warn_on_duplicates);
 
     // Collate all the path mappings we got from all the different chunks. A
     // mapping from any chunk might fall anywhere in a path (because paths may
@@ -65,12 +72,14 @@ VG::VG(function<bool(Graph&)>& get_next_graph, bool showp, bool warn_on_duplicat
     bool got_subgraph = get_next_graph(subgraph);
     while(got_subgraph) {
         // If there is a valid subgraph, add it to ourselves.
-        // We usually expect these to not overlap in nodes or edges, so complain unless we've been told not to.
-        extend(subgraph, warn_on_duplicates);
+        absorb_chunk(subgraph);
         // Try and load the next subgraph, if it exists.
         got_subgraph = get_next_graph(subgraph);
     }
 
+    // We usually expect these to not overlap in nodes or edges, so complain unless we've been told not to.
+    build_indexes_dropping_duplicates(warn_on_duplicates);
+
     // store paths in graph
     paths.to_graph(graph);
 }
@@ -353,7 +362,9 @@ void VG::serialize_to_ostream(ostream& out, id_t chunk_size) {
     
     create_progress("saving graph", graph.node_size());
     
-    // Have a function to grab the chunk for the given range of nodes
+    // Have a function to grab the chunk for the given range of nodes. It runs
+    // on several threads at once, so it must not modify the graph or its
+    // indexes.
     function<Graph(uint64_t, uint64_t)> lambda = [this](uint64_t element_start, uint64_t element_length) -> Graph {
     
         VG g;
@@ -365,6 +376,10 @@ void VG::serialize_to_ostream(ostream& out, id_t chunk_size) {
             // Grab the node and only the edges where it has the lower ID.
             // This prevents duplication of edges in the serialized output.
             nonoverlapping_node_context_without_paths(node, g);
+            if (!paths.has_node_mapping(node)) {
+                // Looking it up would add an entry
+                continue;
+            }
             auto& mappings = paths.get_node_mapping(node);
             //cerr << "getting node mappings for " << node->id() << endl;
             for (auto m : mappings) {
@@ -411,8 +426,8 @@ void VG::serialize_to_ostream(ostream& out, id_t chunk_size) {
     };
 
     // Write all the dynamically sized chunks, starting with our selected chunk
-    // size as a guess.
-    stream::write(out, graph.node_size(), chunk_size, lambda);
+    // size as a guess. Make a chunk per thread at a time.
+    stream::write_parallel(out, graph.node_size(), chunk_size, lambda, omp_get_max_threads());
 
     destroy_progress();
 }
@@ -2408,6 +2423,80 @@ void VG::extend(Graph& graph, bool warn_on_duplicates) {
     paths.append(graph);
 }
 
+void VG::absorb_chunk(Graph& chunk) {
+    // Move the nodes and edges over without copying their contents
+    graph.mutable_node()->Reserve(graph.node_size() + chunk.node_size());
+    for (id_t i = 0; i < chunk.node_size(); ++i) {
+        Node* n = chunk.mutable_node(i);
+        if (n->id() == 0) {
+            cerr << "[vg] warning: node ID 0 is not allowed. Skipping." << endl;
+        } else {
+            graph.add_node()->Swap(n);
+        }
+    }
+    graph.mutable_edge()->Reserve(graph.edge_size() + chunk.edge_size());
+    for (id_t i = 0; i < chunk.edge_size(); ++i) {
+        graph.add_edge()->Swap(chunk.mutable_edge(i));
+    }
+    // Append the path mappings from this graph, but don't sort by rank
+    paths.append(chunk);
+    chunk.Clear();
+}
+
+void VG::build_indexes_dropping_duplicates(bool warn_on_duplicates) {
+    clear_indexes();
+#ifdef USE_DENSE_HASH
+    node_by_id.resize(graph.node_size());
+    node_index.resize(graph.node_size());
+    edges_on_start.resize(graph.node_size());
+    edges_on_end.resize(graph.node_size());
+    edge_by_sides.resize(graph.edge_size());
+    edge_index.resize(graph.edge_size());
+#endif
+
+    // Keep the first copy of each node, and move the others to the end so we
+    // can drop them. Swapping elements doesn't move the Node objects.
+    id_t kept = 0;
+    for (id_t i = 0; i < graph.node_size(); ++i) {
+        Node* n = graph.mutable_node(i);
+        if (node_by_id.count(n->id())) {
+            if (warn_on_duplicates) {
+                cerr << "[vg] warning: node ID " << n->id() << " appears multiple times. Skipping." << endl;
+            }
+            continue;
+        }
+        if (i != kept) {
+            graph.mutable_node()->SwapElements(i, kept);
+        }
+        node_by_id[n->id()] = n;
+        node_index[n] = kept++;
+    }
+    while (graph.node_size() > kept) {
+        graph.mutable_node()->RemoveLast();
+    }
+
+    // Do the same for edges
+    kept = 0;
+    for (id_t i = 0; i < graph.edge_size(); ++i) {
+        Edge* e = graph.mutable_edge(i);
+        if (edge_by_sides.count(NodeSide::pair_from_edge(e))) {
+            if (warn_on_duplicates) {
+                cerr << "[vg] warning: edge " << e->from() << (e->from_start() ? " start" : " end") << " <-> "
+                     << e->to() << (e->to_end() ? " end" : " start") << " appears multiple times. Skipping." << endl;
+            }
+            continue;
+        }
+        if (i != kept) {
+            graph.mutable_edge()->SwapElements(i, kept);
+        }
+        index_edge_by_node_sides(e);
+        edge_index[e] = kept++;
+    }
+    while (graph.edge_size() > kept) {
+        graph.mutable_edge()->RemoveLast();
+    }
+}
+
 // extend this graph by g, connecting the tails of this graph to the heads of the other
 // the ids of the second graph are modified for compact representation
 void VG::append(VG& g) {
@@ -7083,27 +7172,27 @@ void VG::collect_subgraph(Node* start_node, set<Node*>& subgraph) {
 }
 
 void VG::disjoint_subgraphs(list<VG>& subgraphs) {
-    vector<Node*> heads;
-    head_nodes(heads);
-    map<Node*, set<Node*> > subgraph_by_head;
-    map<Node*, set<Node*>* > subgraph_membership;
-    // start at the heads, but keep in mind that we need to explore fully
-    for (vector<Node*>::iterator h = heads.begin(); h != heads.end(); ++h) {
-        if (subgraph_membership.find(*h) == subgraph_membership.end()) {
-            set<Node*>& subgraph = subgraph_by_head[*h];
-            collect_subgraph(*h, subgraph);
-            for (set<Node*>::iterator n = subgraph.begin(); n != subgraph.end(); ++n) {
-                subgraph_membership[*n] = &subgraph;
-            }
+    vector<id_t> node_ids;
+    vector<size_t> component_of_node;
+    size_t component_count = algorithms::weakly_connected_component_labels(this, node_ids, component_of_node);
+    
+    // we only want the components we could reach from a head
+    vector<set<Node*>> component_nodes(component_count);
+    vector<bool> has_head(component_count, false);
+    for (size_t i = 0; i < node_ids.size(); i++) {
+        Node* node = get_node(node_ids[i]);
+        component_nodes[component_of_node[i]].insert(node);
+        if (is_head_node(node)) {
+            has_head[component_of_node[i]] = true;
+        }
+    }
+    for (size_t i = 0; i < component_count; i++) {
+        if (has_head[i]) {
+            set<Edge*> edges;
+            edges_of_nodes(component_nodes[i], edges);
+            subgraphs.push_back(VG(component_nodes[i], edges));
         }
     }
-    for (map<Node*, set<Node*> >::iterator g = subgraph_by_head.begin();
-         g != subgraph_by_head.end(); ++ g) {
-        set<Node*>& nodes = g->second;
-        set<Edge*> edges;
-        edges_of_nodes(nodes, edges);
-        subgraphs.push_back(VG(nodes, edges));
-    }
 }
 
 bool VG::is_head_node(id_t id) {
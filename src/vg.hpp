@@ -491,6 +491,15 @@ public:
     /// Paths::rebuild_mapping_aux() after you are done adding in graphs to this
     /// graph.
     void extend(Graph& graph, bool warn_on_duplicates = false);
+    /// Move the nodes, edges, and path mappings out of a Graph, such as a
+    /// chunk from a stream, without updating any indexes. Path mappings are
+    /// not sorted by rank. Call build_indexes_dropping_duplicates() after the
+    /// last chunk.
+    void absorb_chunk(Graph& chunk);
+    /// Build the node and edge indexes in one pass, sized for the whole graph,
+    /// and remove all but the first copy of any node or edge that was added
+    /// more than once.
+    void build_indexes_dropping_duplicates(bool warn_on_duplicates = false);
     // TODO: Do a member group for these overloads
 
     /// Add another graph into this graph, attaching tails to heads.
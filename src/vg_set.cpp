@@ -1,6 +1,9 @@
 #include "vg_set.hpp"
 #include "stream.hpp"
 
+#include <chrono>
+#include <limits>
+
 namespace vg {
 // sets of VGs on disk
 
@@ -233,16 +236,38 @@ void VGset::write_gcsa_kmers_binary(ostream& out, int kmer_size,
 // writes to a set of temp files and returns their names
 vector<string> VGset::write_gcsa_kmers_binary(int kmer_size,
                                               id_t head_id, id_t tail_id) {
+    size_t size_limit = numeric_limits<size_t>::max();
+    return write_gcsa_kmers_binary(kmer_size, size_limit, head_id, tail_id);
+}
+
+vector<string> VGset::write_gcsa_kmers_binary(int kmer_size, size_t& size_limit,
+                                              id_t head_id, id_t tail_id) {
     vector<string> tmpnames;
-    for_each([&](VG* g) {
-            Node* head_node = nullptr; Node* tail_node = nullptr;
-            g->add_start_end_markers(kmer_size, '#', '$', head_node, tail_node, head_id, tail_id);
-            tmpnames.push_back(
-                write_gcsa_kmers_to_tmpfile(*g,
-                                            kmer_size,
-                                            head_id,
-                                            tail_id));
-        });
+    try {
+        for_each([&](VG* g) {
+                Node* head_node = nullptr; Node* tail_node = nullptr;
+                g->add_start_end_markers(kmer_size, '#', '$', head_node, tail_node, head_id, tail_id);
+                size_t size_before = size_limit;
+                auto start = std::chrono::system_clock::now();
+                tmpnames.push_back(
+                    write_gcsa_kmers_to_tmpfile(*g,
+                                                kmer_size,
+                                                size_limit,
+                                                head_id,
+                                                tail_id));
+                if (show_progress) {
+                    std::chrono::duration<double> elapsed_seconds = std::chrono::system_clock::now() - start;
+                    cerr << "[vg::VGset] wrote " << (size_before - size_limit) << " bytes of kmers for "
+                         << g->name << " in " << elapsed_seconds.count() << " seconds" << endl;
+                }
+            });
+    } catch (SizeLimitExceededException& e) {
+        // Don't leave the files we did manage to write behind
+        for (auto& tmpname : tmpnames) {
+            remove(tmpname.c_str());
+        }
+        throw;
+    }
     return tmpnames;
 }
 
@@ -58,6 +58,11 @@ public:
                                  int64_t head_id=0, int64_t tail_id=0);
     vector<string> write_gcsa_kmers_binary(int kmer_size,
                                            int64_t head_id=0, int64_t tail_id=0);
+    // Write kmers to temp files within size_limit bytes in total, taking off
+    // what was used. Throws SizeLimitExceededException, after removing the
+    // files already written, if the kmers don't fit.
+    vector<string> write_gcsa_kmers_binary(int kmer_size, size_t& size_limit,
+                                           int64_t head_id=0, int64_t tail_id=0);
 
     // Should we show our progress running through each graph?             
     bool show_progress = false;
@@ -1,5 +1,6 @@
 #include "xg.hpp"
 #include "stream.hpp"
+#include "algorithms/weakly_connected_components.hpp"
 
 #include <bitset>
 #include <arpa/inet.h>
@@ -1289,66 +1290,24 @@ void XG::index_component_path_sets() {
     component_path_set_of_path.clear();
     component_path_sets.clear();
     
-    // to record which node ranks have been added to queue
-    sdsl::bit_vector enqueued(node_count, 0);
+    // find the weakly connected components in parallel. Our ranks are in ID
+    // order, so node IDs come back in rank order, and the components are
+    // numbered in order of their lowest-ranked nodes.
+    vector<id_t> node_ids;
+    vector<size_t> component_of_node;
+    size_t component_count = algorithms::weakly_connected_component_labels(this, node_ids, component_of_node);
+    component_path_sets.resize(component_count);
     
-    for (size_t i = 0; i < node_count; i++) {
+    // add the paths of each node to its component's set
+    for (size_t i = 0; i < node_ids.size(); i++) {
 #ifdef debug_component_index
-        cerr << "i = " << i << endl;
+        cerr << "node " << node_ids[i] << " at rank " << i + 1 << " is in component " << component_of_node[i] << endl;
 #endif
-        if (enqueued[i]) {
-            continue;
-        }
-#ifdef debug_component_index
-        cerr << "not yet enqueued, beginning traversal" << endl;
-#endif
-        // a node that hasn't been traversed means a new component
-        component_path_sets.emplace_back();
-        unordered_set<size_t>& component_path_set = component_path_sets.back();
-        
-        // init a BFS queue
-        std::queue<handle_t> queue;
-        
-        // to call on each subsequent handle we navigate to
-        function<bool(const handle_t&)> record_paths_and_enqueue = [&](const handle_t& handle) {
-            size_t node_rank = id_to_rank(get_id(handle));
-#ifdef debug_component_index
-            cerr << "traverse to handle on node " << get_id(handle) << " at rank " << node_rank << endl;
-#endif
-
-            // don't queue up the same node twice
-            if (!enqueued[node_rank - 1]) {
-                // add the paths of the new node
-                for (size_t path_rank : paths_of_node(get_id(handle))) {
-#ifdef debug_component_index
-                    cerr << "node is on path " << path_rank << endl;
-#endif
-                    component_path_set.insert(path_rank);
-                }
-                // and add it to the queue
-                queue.push(handle);
-                enqueued[node_rank - 1] = 1;
-            }
+        for (size_t path_rank : paths_of_node(node_ids[i])) {
 #ifdef debug_component_index
-            else {
-                cerr << "already enqueued" << endl;
-            }
+            cerr << "node is on path " << path_rank << endl;
 #endif
-            return true;
-        };
-        
-        // queue up the first node
-        // TODO: somewhat wasteful use of get_handle, but this only gets called once per component
-        record_paths_and_enqueue(get_handle(rank_to_id(i + 1), false));
-        
-        // do the BFS traversal
-        while (!queue.empty()) {
-            handle_t handle = queue.front();
-            queue.pop();
-            
-            // traverse in both directions
-            follow_edges(handle, false, record_paths_and_enqueue);
-            follow_edges(handle, true, record_paths_and_enqueue);
+            component_path_sets[component_of_node[i]].insert(path_rank);
         }
     }
     
@@ -1,4 +1,5 @@
 #include "xg_position.hpp"
+#include "algorithms/dijkstra.hpp"
 
 namespace vg {
 
@@ -137,34 +138,46 @@ set<pos_t> xg_next_pos(pos_t pos, bool whole_node, xg::XG* xgidx) {
 int64_t xg_distance(pos_t pos1, pos_t pos2, int64_t maximum, xg::XG* xgidx) {
     //cerr << "distance from " << pos1 << " to " << pos2 << endl;
     if (pos1 == pos2) return 0;
+    // A position just past the end of its node counts as the start of whatever follows it
     int64_t adj = (offset(pos1) == xg_node_length(id(pos1), xgidx) ? 0 : 1);
-    set<pos_t> seen;
-    set<pos_t> nexts = xg_next_pos(pos1, false, xgidx);
-    int64_t distance = 0;
-    while (!nexts.empty()) {
-        set<pos_t> todo;
-        for (auto& next : nexts) {
-            if (!seen.count(next)) {
-                seen.insert(next);
-                if (next == pos2) {
-                    return distance+adj;
-                }
-                // handle the edge case that we are looking for the position after the end of this node
-                if (make_pos_t(id(next), is_rev(next), offset(next)+1) == pos2) {
-                    return distance+adj+1;
-                }
-                for (auto& x : xg_next_pos(next, false, xgidx)) {
-                    todo.insert(x);
-                }
+    
+    // Work out the number of bases between the positions along the shortest walk
+    int64_t distance = numeric_limits<int64_t>::max();
+    if (id(pos1) == id(pos2) && is_rev(pos1) == is_rev(pos2) && offset(pos2) > offset(pos1)) {
+        // We can just go along the node
+        distance = offset(pos2) - offset(pos1);
+    } else {
+        // Search outward from the end of the first node
+        handle_t start = xgidx->get_handle(id(pos1), is_rev(pos1));
+        handle_t target = xgidx->get_handle(id(pos2), is_rev(pos2));
+        size_t start_distance = xgidx->get_length(start) - offset(pos1);
+        // Anything found farther than this is over the maximum
+        size_t max_distance = maximum < 0 ? numeric_limits<size_t>::max() : maximum + 2;
+        algorithms::dijkstra(xgidx, vector<pair<handle_t, size_t>>{make_pair(start, start_distance)},
+                             [&](const handle_t& here, size_t here_distance) {
+            if (here == target) {
+                distance = here_distance + offset(pos2);
+                return false;
             }
+            return true;
+        }, max_distance);
+    }
+    
+    if (distance == numeric_limits<int64_t>::max()) {
+        return distance;
+    }
+    if (maximum >= 0) {
+        // Apply the maximum the way a search one base at a time would. Its level 0 is the base after
+        // pos1, and it spots a position past the start of a node from the base before it, one level early.
+        int64_t level = distance - adj;
+        if (offset(pos2) > 0 && level > 0) {
+            --level;
         }
-        if (distance == maximum) {
-            break;
+        if (level > maximum) {
+            return numeric_limits<int64_t>::max();
         }
-        nexts = todo;
-        ++distance;
     }
-    return numeric_limits<int64_t>::max();
+    return distance;
 }
 
 set<pos_t> xg_positions_bp_from(pos_t pos, int64_t distance, bool rev, xg::XG* xgidx) {
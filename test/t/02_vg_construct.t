@@ -7,7 +7,7 @@ PATH=../bin:$PATH # for vg
 
 export LC_ALL="C" # force a consistent sort order 
 
-plan tests 23
+plan tests 25
 
 is $(vg construct -r small/x.fa -v small/x.vcf.gz | vg stats -z - | grep nodes | cut -f 2) 210 "construction produces the right number of nodes"
 
@@ -106,3 +106,14 @@ is $? 0 "vg construct does not require a vcf"
 is $short_enough 1 "vg construct respects node size limit"
 
 is $(vg construct -CR 'gi|568815592:29791752-29792749' -r GRCh38_alts/FASTA/HLA/V-352962.fa | vg view - | grep TCTAGAAGAGTCCACGGGGACAGGTAAG | wc -l) 1 "--region can be interpreted to be a reference sequence (and not parsed as a region spec)"
+
+vg construct -r small/x.fa -v small/x.vcf.gz -a > x.vg
+vg index -x x.xg x.vg
+vg construct -r small/x.fa -v small/x.vcf.gz -a -x direct.xg
+is $(md5sum < direct.xg | cut -f1 -d' ') $(md5sum < x.xg | cut -f1 -d' ') "construction can write an xg index directly"
+
+vg construct -r small/x.fa -v small/x.vcf.gz -z 10 -t 4 > y.vg
+vg index -x y.xg y.vg
+vg construct -r small/x.fa -v small/x.vcf.gz -z 10 -t 4 -x direct.xg
+is $(md5sum < direct.xg | cut -f1 -d' ') $(md5sum < y.xg | cut -f1 -d' ') "directly written xg index matches with many parallel chunks"
+rm -f x.vg x.xg y.vg y.xg direct.xg
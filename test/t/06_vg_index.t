@@ -7,7 +7,7 @@ PATH=../bin:$PATH # for vg
 
 export LC_ALL="en_US.utf8" # force ekg's favorite sort order 
 
-plan tests 35
+plan tests 38
 
 vg construct -r small/x.fa -v small/x.vcf.gz >x.vg
 
@@ -38,7 +38,7 @@ rm -f x.gcsa x.gcsa.lcp x.graph
 vg index -x x.xg -g x.gcsa -k 11 x.vg
 vg map -T <(vg sim -s 1337 -n 100 -x x.xg) -d x > x1337.gam
 vg index -a x1337.gam -d x.vg.aln
-is $(vg index -D -d x.vg.aln | wc -l) 101 "index can store alignments"
+is $(vg index -D -d x.vg.aln | wc -l) 102 "index can store alignments"
 is $(vg index -A -d x.vg.aln | vg view -a - | wc -l) 100 "index can dump alignments"
 
 # repeat with an unmapped read (sequence from phiX)
@@ -53,10 +53,21 @@ is $(vg index -A -d x.vg.aln | vg view -a - | wc -l) 2 "alignment index stores u
 rm -rf x.vg.aln
 vg index -a x1337.gam -d x.vg.aln
 vg index -a x1337.gam -d x.vg.aln
-is $(vg index -D -d x.vg.aln | wc -l) 201 "alignment index can be loaded using sequential invocations; next_nonce persistence"
+is $(vg index -D -d x.vg.aln | wc -l) 202 "alignment index can be loaded using sequential invocations; next_nonce persistence"
+
+rm -rf x.vg.aln x.vg.aln.sst
+vg index -a x1337.gam -d x.vg.aln
+vg index -a x1337.gam -I -y -d x.vg.aln.sst
+is $(vg index -A -d x.vg.aln.sst | vg view -a - | sort | md5sum | cut -f1 -d' ') $(vg index -A -d x.vg.aln | vg view -a - | sort | md5sum | cut -f1 -d' ') "alignments can be bulk loaded by ingesting SST files"
+
+rm -rf x.vg.aln x.vg.aln.sst
+vg index -N x1337.gam -d x.vg.aln
+vg index -N x1337.gam -I -d x.vg.aln.sst
+is $(vg index -D -d x.vg.aln.sst | wc -l) $(vg index -D -d x.vg.aln | wc -l) "node alignment cross references can be bulk loaded by ingesting SST files"
+rm -rf x.vg.aln x.vg.aln.sst
 
 vg map -T <(vg sim -s 1337 -n 100 -x x.xg) -d x | vg index -m - -d x.vg.map
-is $(vg index -D -d x.vg.map | wc -l) 1477 "index stores all mappings"
+is $(vg index -D -d x.vg.map | wc -l) 1478 "index stores all mappings"
 
 rm -rf x.idx x.vg.map x.vg.aln x1337.gam
 
@@ -113,13 +124,13 @@ vg index -k 11 -g r.gcsa reversing/reversing_x.vg
 is $? 0 "can index kmers for backward nodes"
 
 vg map -T <(vg sim -s 1338 -n 100 -x r.xg) -d r | vg index -a - -d r.aln.idx
-is $(vg index -D -d r.aln.idx | wc -l) 101 "index can store alignments to backward nodes"
+is $(vg index -D -d r.aln.idx | wc -l) 102 "index can store alignments to backward nodes"
 
 rm -rf r.aln.idx r.xg r.gcsa
 
 vg index -x c.xg -g c.gcsa -k 11 cyclic/all.vg
 vg map -T <(vg sim -s 1337 -n 100 -x c.xg) -d c | vg index -a - -d all.vg.aln
-is $(vg index -D -d all.vg.aln | wc -l) 101 "index can store alignments to cyclic graphs"
+is $(vg index -D -d all.vg.aln | wc -l) 102 "index can store alignments to cyclic graphs"
 
 rm -rf all.vg.aln c.xg c.gcsa
 
@@ -137,6 +148,8 @@ rm -f x.gcsa x.gcsa.lcp
 
 is $(vg construct -r tiny/tiny.fa -v tiny/tiny.vcf.gz | vg index -g t.gcsa -k 16 -V - 2>&1 |  grep 'Index verification complete' | wc -l) 1 "GCSA2 indexing of a tiny graph works"
 
+is $(vg construct -r tiny/tiny.fa -v tiny/tiny.vcf.gz | vg index -g t.gcsa -k 16 -Z 1 -V - 2>&1 |  grep 'Index verification complete' | wc -l) 1 "GCSA2 indexing works with a size limit of 1 GB"
+
 is $(vg construct -r tiny/tiny.fa -v tiny/tiny.vcf.gz | vg index -g t.gcsa -k 16 -V - 2>&1 | grep 'Index verification complete' | wc -l) 1 "GCSA2 forward-only indexing of a tiny graph works"
 
 is $(vg construct -r tiny/tiny.fa | vg index -g t.gcsa -k 16 -V - 2>&1 | grep 'Index verification complete' | wc -l) 1 "GCSA2 indexing succeeds on a single-node graph"
@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 46
+plan tests 47
 
 vg construct -r small/x.fa -v small/x.vcf.gz >x.vg
 vg index -x x.xg -g x.gcsa -k 11 x.vg
@@ -99,6 +99,11 @@ is $(vg map -T x.reads -d x -j -t 1 | jq -c '.path.mapping[0].position.node_id'
 
 is $(vg map -T <(head -1 x.reads) -d x -j -t 1 -Q 30 | jq .mapping_quality) 30 "the mapping quality may be capped"
 
+vg map -T <(head -100 x.reads) -d x -j -t 1 | jq -r '.mapping_quality // 0' >exact.mq
+vg map -T <(head -100 x.reads) -d x -j -t 1 --fast-exp-mq | jq -r '.mapping_quality // 0' >fast.mq
+is "$(paste exact.mq fast.mq | awk '{ d = $1 - $2; if (d < -1 || d > 1) n++ } END { print n + 0 }')" 0 "mapping qualities from the approximate exponential are within 1 of the exact ones"
+rm -f exact.mq fast.mq
+
 vg index -x graphs/refonly-lrc_kir.vg.xg -g graphs/refonly-lrc_kir.vg.gcsa -k 16 graphs/refonly-lrc_kir.vg
 
 vg map -x graphs/refonly-lrc_kir.vg.xg -g graphs/refonly-lrc_kir.vg.gcsa -f reads/grch38_lrc_kir_paired.fq -i -u 4 -j  > temp_paired_alignment.json
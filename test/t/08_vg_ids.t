@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 8
+plan tests 11
 
 num_nodes=$(vg construct -r small/x.fa -v small/x.vcf.gz | vg ids -c - | vg view -g - | grep ^S | wc -l)
 
@@ -40,3 +40,11 @@ is $(vg ids -s ids/unordered.vg | vg view -j - | jq -c '.node[1] == {"id":2,"seq
 
 vg ids -s graphs/snp1kg-brca2-unsorted.vg | vg validate -
 is $? 0 "can handle graphs with out-of-order mappings"
+
+is $(vg construct -r small/x.fa -v small/x.vcf.gz | vg ids -J -i 1000 - | vg ids -J -c - | vg view -g - | grep ^S | cut -f 2 | tail -1) $num_nodes "packed graphs can increment and compact ids"
+
+is $(vg ids -J -s ids/unordered.vg | vg view -j - | jq -c '.node[1] == {"id":2,"sequence":"T"}') "true" "sorting a packed graph assigns node IDs in topological order"
+
+vg construct -r small/x.fa -v small/x.vcf.gz >x.vg
+is "$(vg ids -J x.vg | vg view -j - | jq -c '.node[], .edge[], .path[].mapping[].position' | sort | md5sum)" "$(vg view -j x.vg | jq -c '.node[], .edge[], .path[].mapping[].position' | sort | md5sum)" "packed graphs round trip through the vg format"
+rm x.vg
@@ -7,7 +7,7 @@ PATH=../bin:$PATH # for vg
 
 export LC_ALL="C" # force a consistent sort order 
 
-plan tests 43
+plan tests 45
 
 is $(vg construct -r small/x.fa -v small/x.vcf.gz | vg mod -k x - | vg view - | grep "^P" | cut -f 3 | grep -o "[0-9]\+" |  wc -l) \
     $(vg construct -r small/x.fa -v small/x.vcf.gz | vg mod -k x - | vg view - | grep "^S" | wc -l) \
@@ -145,3 +145,7 @@ is "$(vg view -Fv overlaps/two_snvs_assembly4.gfa | vg mod --bluntify - | vg sta
 is "$(vg view -Fv overlaps/incorrect_overlap.gfa | vg mod --bluntify - | vg stats -l - | cut -f2)" "283" "bluntifying overlaps works even when we have overlap description errors"
 
 is $(vg mod -M 5 jumble/j.vg|  vg stats -s - | wc -l) 7 "removal of high-degree nodes results in the expected number of subgraphs"
+
+is $(vg mod -J -M 5 jumble/j.vg | vg stats -s - | wc -l) 7 "removal of high-degree nodes works on packed graphs"
+
+is "$(vg mod -J -X 10 jumble/j.vg | vg stats -l - | cut -f2)" "$(vg stats -l jumble/j.vg | cut -f2)" "chopping packed graphs keeps the sequence"
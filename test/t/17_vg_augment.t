@@ -6,7 +6,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 PATH=../bin:$PATH # for vg
 
 
-plan tests 5
+plan tests 6
 
 vg view -J -v pileup/tiny.json > tiny.vg
 
@@ -17,7 +17,10 @@ vg view -J -a -G pileup/alignment.json > alignment.gam
 vg augment tiny.vg alignment.gam -P tiny.gpu > /dev/null
 vg view tiny.gpu -l -j | jq . > tiny.gpu.json
 is $(jq --argfile a tiny.gpu.json --argfile b pileup/truth.json -n '($a == $b)') true "vg augment -P produces the expected output for test case on tiny graph."
-rm -f alignment.gam tiny.gpu tiny.gpu.json
+vg augment tiny.vg alignment.gam -t 1 -P tiny.1.gpu > /dev/null
+vg augment tiny.vg alignment.gam -t 3 -P tiny.3.gpu > /dev/null
+is "$(vg view tiny.1.gpu -l -j | md5sum)" "$(vg view tiny.3.gpu -l -j | md5sum)" "vg augment -P output does not depend on the number of threads"
+rm -f alignment.gam tiny.gpu tiny.gpu.json tiny.1.gpu tiny.3.gpu
 
 # Make sure well-supported edits are augmented in
 vg view -J -a -G pileup/edits.json > edits.gam
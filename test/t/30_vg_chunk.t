@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 15
+plan tests 17
 
 # Construct a graph with alt paths so we can make a gPBWT and later a GBWT
 vg construct -r small/x.fa -v small/x.vcf.gz -a >x.vg
@@ -36,6 +36,13 @@ is $(ls -l _chunk_test*.vg | wc -l) 2 "gam chunker produces correct number of gr
 is $(ls -l _chunk_test*.gam | wc -l) 2 "gam chunker produces correct number of gams"
 is $(grep x _chunk_test_out.bed | wc -l) 2 "gam chunker prodcues bed with correct number of chunks"
 
+#check that a gam sorted and indexed by gamsort can be chunked without rocksdb
+vg gamsort -i x.sorted.gam.gai x.gam > x.sorted.gam
+vg chunk -x x.xg -a x.sorted.gam -r 10:40 -c 0 -b _chunk_sorted_test
+is $(vg view -a _chunk_sorted_test*.gam | wc -l) $(vg view -a x.gam | jq -c 'select([.path.mapping[].position.node_id | select(. >= 10 and . <= 40)] | length > 0)' | wc -l) "gam chunker finds all reads touching an id range in a sorted gam"
+vg chunk -x x.xg -a x.sorted.gam -r 10:40 -c 0 -f -b _chunk_sorted_contained
+is $(vg view -a _chunk_sorted_contained*.gam | wc -l) $(vg view -a x.gam | jq -c 'select(.path.mapping | length > 0) | select([.path.mapping[].position.node_id | select(. < 10 or . > 40)] | length == 0)' | wc -l) "gam chunker finds fully contained reads in a sorted gam"
+
 #check that id ranges work
 is $(vg chunk -x x.xg -r 1:3 -c 0 | vg view - -j | jq .node | grep id |  wc -l) 3 "id chunker produces correct chunk size"
 is $(vg chunk -x x.xg -r 1 -c 0 | vg view - -j | jq .node | grep id | wc -l) 1 "id chunker produces correct single chunk"
@@ -58,5 +65,5 @@ mkdir x.chunk
 vg chunk -x x.xg -n 5 -b x.chunk/
 is $(cat x.chunk/*vg | vg view -V - 2>/dev/null | md5sum | cut -f 1 -d\ ) $(vg view x.vg | md5sum | cut -f 1 -d\ ) "n-chunking works and chunks over the full graph"
 
-rm -rf x.gam.index x.gam.unsrt.index _chunk_test_bed.bed _chunk_test* x.chunk
+rm -rf x.gam.index x.gam.unsrt.index _chunk_test_bed.bed _chunk_test* _chunk_sorted_* x.sorted.gam x.sorted.gam.gai x.chunk
 rm -f x.vg x.xg xg.gbwt x.gam x.gam.json filter_chunk*.gam chunks.bed
@@ -5,12 +5,19 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 2
+plan tests 5
 
 vg view -J -v snarls/snarls.json > snarls.vg
 is $(vg snarls snarls.vg -r st.pb | vg view -R - | wc -l) 3 "vg snarls made right number of protobuf Snarls"
 is $(vg view -E st.pb | wc -l) 6 "vg snarls made right number of protobuf SnarlTraversals"
+is "$(vg snarls -a handle snarls.vg | vg view -R - | jq -c '[.start.node_id, .end.node_id] | sort' | sort | tr '\n' ' ')" "$(vg snarls snarls.vg | vg view -R - | jq -c '[.start.node_id, .end.node_id] | sort' | sort | tr '\n' ' ')" "vg snarls finds the same snarls with either algorithm"
 
-rm -f snarls.vg st.pb 
+vg view -J -v snarls/snarls.json > other.vg
+vg ids -j snarls.vg other.vg
+cat snarls.vg other.vg > both.vg
+is $(vg snarls -T 2 both.vg | vg view -R - | wc -l) 6 "vg snarls finds the snarls of each connected component"
+is "$(vg snarls -T 2 both.vg | vg view -R - | jq -c '[.start.node_id, .end.node_id]' | sort | uniq | wc -l)" 6 "vg snarls reports each snarl once"
+
+rm -f snarls.vg other.vg both.vg st.pb 
  
 
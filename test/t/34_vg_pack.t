@@ -5,7 +5,7 @@ BASH_TAP_ROOT=../deps/bash-tap
 
 PATH=../bin:$PATH # for vg
 
-plan tests 6
+plan tests 10
 
 vg construct -r tiny/tiny.fa >flat.vg
 vg view flat.vg| sed 's/CAAATAAGGCTTGGAAATTTTCTGGAGTTCTATTATATTCCAACTCTCTG/CAAATAAGGCTTGGAAATTTTCTGGAGATCTATTATACTCCAACTCTCTG/' | vg view -Fv - >2snp.vg
@@ -39,4 +39,16 @@ y=$(vg pack -x flat.xg -di 2snp.gam.cx.3x | wc -c)
 
 is $x $y "pack index merging produces the expected result"
 
-rm -f flat.vg 2snp.vg 2snp.xg 2snp.sim flat.gcsa flat.gcsa.lcp flat.xg 2snp.xg 2snp.gam 2snp.gam.cx 2snp.gam.cx.3x 2snp.gam.vgpu
+vg pack -x flat.xg -o 2snp.gam.cx -g 2snp.gam
+vg pack -x flat.xg -o 2snp.gam.cx.mt -g 2snp.gam -t 4
+is $(vg pack -x flat.xg -di 2snp.gam.cx.mt | cut -f 1-3 | md5sum | cut -f 1 -d\ ) $(vg pack -x flat.xg -di 2snp.gam.cx | cut -f 1-3 | md5sum | cut -f 1 -d\ ) "packing with many threads into shared counters gives the same result as one thread"
+
+vg pack -x flat.xg -o 2snp.gam.cx.b -b 10 -g 2snp.gam
+vg pack -x flat.xg -o 2snp.gam.cx.b3x -t 4 -i 2snp.gam.cx.b -i 2snp.gam.cx.b -i 2snp.gam.cx.b
+is $(vg pack -x flat.xg -di 2snp.gam.cx.b3x | cut -f 1-3 | md5sum | cut -f 1 -d\ ) $(vg pack -x flat.xg -di 2snp.gam.cx.3x | cut -f 1-3 | md5sum | cut -f 1 -d\ ) "merging binned packs with many threads gives the same result"
+
+printf "x\t10\t30\nx\t0\t1000000\n" > 2snp.bed
+is "$(vg pack -x flat.xg -i 2snp.gam.cx -R 2snp.bed | head -1 | cut -f 4-6)" "$(vg pack -x flat.xg -di 2snp.gam.cx | awk 'BEGIN { mx = 0 } $1 >= 10 && $1 < 30 { s += $2; if (n == 0 || $2 < mn) mn = $2; if ($2 > mx) mx = $2; n++ } END { print s/n "\t" mn "\t" mx }')" "interval depth on a path agrees with the coverage table"
+is "$(vg pack -x flat.xg -i 2snp.gam.cx -R 2snp.bed | tail -1 | cut -f 4)" "$(vg pack -x flat.xg -di 2snp.gam.cx | awk '{ s += $2; n++ } END { print s/n }')" "interval depth is clipped to the path"
+
+rm -f flat.vg 2snp.vg 2snp.xg 2snp.sim flat.gcsa flat.gcsa.lcp flat.xg 2snp.xg 2snp.gam 2snp.gam.cx 2snp.gam.cx.3x 2snp.gam.cx.mt 2snp.gam.cx.b 2snp.gam.cx.b3x 2snp.gam.vgpu 2snp.bed
@@ -0,0 +1,20 @@
+#!/usr/bin/env bash
+
+BASH_TAP_ROOT=../deps/bash-tap
+. ../deps/bash-tap/bash-tap-bootstrap
+
+PATH=../bin:$PATH # for vg
+
+plan tests 4
+
+vg construct -r small/x.fa -v small/x.vcf.gz >x.vg
+
+is "$(vg prune -J -k 16 -e 2 x.vg | vg stats -z -)" "$(vg prune -k 16 -e 2 x.vg | vg stats -z -)" "pruning a packed graph leaves the same number of nodes and edges"
+
+is "$(vg prune -J -k 16 -e 2 x.vg | vg view -j - | jq -c '.node[]' | sort | md5sum)" "$(vg prune -k 16 -e 2 x.vg | vg view -j - | jq -c '.node[]' | sort | md5sum)" "pruning a packed graph keeps the same nodes"
+
+is $(vg prune -J x.vg | vg paths -L -v - | wc -l) 0 "pruning a packed graph removes the paths"
+
+is "$(vg prune -J jumble/j.vg | vg stats -z -)" "$(vg prune jumble/j.vg | vg stats -z -)" "pruning a packed graph works on a complex graph"
+
+rm -f x.vg
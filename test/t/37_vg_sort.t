@@ -0,0 +1,25 @@
+#!/usr/bin/env bash
+
+BASH_TAP_ROOT=../deps/bash-tap
+. ../deps/bash-tap/bash-tap-bootstrap
+
+PATH=../bin:$PATH # for vg
+
+plan tests 4
+
+vg construct -r small/x.fa -v small/x.vcf.gz >x.vg
+# Store the nodes backwards so sorting has something to do
+vg view -j x.vg | jq '.node |= reverse' | vg view -Jv - >x.rev.vg
+
+# Every edge of the construct graph goes from an earlier node to a later one
+in_order='(.node | map(.id | tostring) | to_entries | map({key: .value, value: .key}) | from_entries) as $pos | [.edge[] | $pos[.from | tostring] < $pos[.to | tostring]] | all'
+
+is "$(vg sort -f -r x -i x.rev.vg | vg view -j - | jq "$in_order")" "true" "fast sorting puts the nodes in order"
+
+is "$(vg sort -J -f -r x -i x.rev.vg | vg view -j - | jq "$in_order")" "true" "fast sorting a packed graph puts the nodes in order"
+
+is "$(vg sort -J -f -r x -i x.rev.vg | vg stats -z -)" "$(vg stats -z x.vg)" "sorting a packed graph keeps all the nodes and edges"
+
+is "$(vg sort -J -f -r x -i x.rev.vg | vg paths -L -v -)" "x" "sorting a packed graph keeps the paths"
+
+rm -f x.vg x.rev.vg